@@ -1,4 +1,11 @@
 #version 450
+#ifdef MATERIAL_BINDING_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+// variant defines: HAS_ALBEDO_TEXTURE, HAS_NORMAL_MAP, LIGHT_COUNT
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outNormal;
 struct VS_OUT {
@@ -22,25 +29,74 @@ layout(binding = 2) uniform UBOLight {
 }
 uboLight;
 
-layout(binding = 3) uniform UBOMaterial {
+// texture reference, bindless: handle lo/hi, texture array: array index + 1, layer, per draw: texture unit + 1
+struct MaterialEntry {
     vec4 baseColor;
     float shininess;
-    int baseColorTexIndex;
-    int normalTexIndex;
+    uvec2 baseColorTex;
+    uvec2 normalTex;
 };
+
+#if defined(MATERIAL_BINDING_BINDLESS) || defined(MATERIAL_BINDING_TEXTURE_ARRAY)
+layout(location = 4) flat in int materialIndex;
+layout(std430, binding = 0) readonly buffer MaterialTable { MaterialEntry materials[]; };
+#define MATERIAL materials[materialIndex]
+#else
+// slot of the material table bound as a range
+layout(binding = 3) uniform UBOMaterial { MaterialEntry material; };
+#define MATERIAL material
+#endif
+
+#if defined(MATERIAL_BINDING_BINDLESS)
+vec4 sampleMaterialTexture(uvec2 ref, vec2 uv) { return texture(sampler2D(ref), uv); }
+#elif defined(MATERIAL_BINDING_TEXTURE_ARRAY)
+layout(binding = 0) uniform sampler2DArray texArrays[MAX_MATERIAL_TEXTURE_ARRAYS];
+vec4 sampleMaterialTexture(uvec2 ref, vec2 uv) { return texture(texArrays[ref.x - 1], vec3(uv, ref.y)); }
+#else
 layout(binding = 0) uniform sampler2D tex[8];
+vec4 sampleMaterialTexture(uvec2 ref, vec2 uv) { return texture(tex[ref.x - 1], uv); }
+#endif
+
+#ifdef HAS_NORMAL_MAP
+// no tangents in the vertex data, build the tangent frame from screen space derivatives
+vec3 perturbNormal(vec3 N, vec3 p, vec2 uv, vec3 tangentNormal) {
+    vec3 dp1 = dFdx(p);
+    vec3 dp2 = dFdy(p);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+    vec3 dp2perp = cross(dp2, N);
+    vec3 dp1perp = cross(N, dp1);
+    vec3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+    float invmax = inversesqrt(max(dot(T, T), dot(B, B)));
+    return normalize(mat3(T * invmax, B * invmax, N) * tangentNormal);
+}
+#endif
+
 void main() {
+    MaterialEntry m = MATERIAL;
+    vec3 N = normalize(fs_in.normal);
+#ifdef HAS_NORMAL_MAP
+    vec3 tangentNormal = sampleMaterialTexture(m.normalTex, fs_in.texcoord).xyz * 2 - 1;
+    N = perturbNormal(N, fs_in.position, fs_in.texcoord, tangentNormal);
+#endif
+#ifdef HAS_ALBEDO_TEXTURE
+    vec4 albedo = sampleMaterialTexture(m.baseColorTex, fs_in.texcoord);
+#else
+    vec4 albedo = m.baseColor;
+#endif
+    vec3 ambientColor = vec3(0.1) * albedo.rgb;
+#if LIGHT_COUNT > 0
     // diectional light
     vec3 V = normalize(eyePos - fs_in.position);
     vec3 L = normalize(uboLight.direction);
     vec3 H = normalize(L + V);
-    vec3 N = fs_in.normal;
     float NdotL = max(0, dot(N, L));
     float NdotH = max(0, dot(N, H));
-    vec4 albedo = baseColor;
-    if (baseColorTexIndex >= 0) albedo = texture(tex[baseColorTexIndex], fs_in.texcoord);
-    vec3 ambientColor = vec3(0.1) * albedo.rgb;
     outColor =
-        vec4(uboLight.color * uboLight.intensity * (albedo.rgb * NdotL + pow(NdotH, shininess)) + ambientColor, 1);
-    outNormal = vec4(N,1);
-}
\ No newline at end of file
+        vec4(uboLight.color * uboLight.intensity * (albedo.rgb * NdotL + pow(NdotH, m.shininess)) + ambientColor, 1);
+#else
+    outColor = vec4(ambientColor, 1);
+#endif
+    outNormal = vec4(N, 1);
+}
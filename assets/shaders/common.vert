@@ -17,11 +17,22 @@ out gl_PerVertex
 	vec4 gl_Position;
 };
 layout(location = 0) out VS_OUT vs_out;
+// material table index, see MaterialTable
+layout(location = 4) flat out int vs_materialIndex;
 
+#ifdef INSTANCING
+// one model matrix per instance
+layout(std430, binding = 1) readonly buffer InstanceTransforms
+{
+	mat4 instanceM[];
+};
+#define M instanceM[gl_InstanceID]
+#else
 layout(binding=0) uniform UBOM
 {
 	mat4 M;
 };
+#endif
 layout(binding=1) uniform UBOVP
 {
 	mat4 V;
@@ -36,4 +47,5 @@ void main()
   vs_out.color = inColor;
   vs_out.normal= mat3(M)*normalize(inNormal);
   vs_out.texcoord= inTexcoord;
+  vs_materialIndex = gl_BaseInstance;
 }
@@ -1,10 +1,59 @@
 #include "appbase.h"
 
+#include <cstdlib>
+#include <filesystem>
+
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "filewatcher.h"
+#include "jobsystem.h"
+#include "material.h"
+#include "model.h"
+#include "profiler.h"
+#include "resource.h"
+#include "shadercache.h"
+#include "texture.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 static GLint glVersion{46};  // set glversion,such as 33 mean use version 33 , if 0, use latest
 
+#ifdef HEADLESS_EGL
+// glfw only picks egl configs that can render to a window, mesa's surfaceless platform has none. a context without
+// config and surface (EGL_KHR_no_config_context, EGL_KHR_surfaceless_context) works on it
+static bool createSurfacelessContext(void **display, void **context) {
+    auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!getPlatformDisplay) return false;
+    auto d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (d == EGL_NO_DISPLAY || !eglInitialize(d, nullptr, nullptr)) return false;
+    EGLint attribs[]{EGL_CONTEXT_MAJOR_VERSION,
+                     glVersion / 10,
+                     EGL_CONTEXT_MINOR_VERSION,
+                     glVersion % 10,
+                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef NDEBUG
+                     EGL_CONTEXT_OPENGL_DEBUG,
+                     EGL_TRUE,
+#endif
+                     EGL_NONE};
+    auto c = eglBindAPI(EGL_OPENGL_API) ? eglCreateContext(d, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs)
+                                        : EGL_NO_CONTEXT;
+    if (c == EGL_NO_CONTEXT || !eglMakeCurrent(d, EGL_NO_SURFACE, EGL_NO_SURFACE, c)) {
+        if (c != EGL_NO_CONTEXT) eglDestroyContext(d, c);
+        eglTerminate(d);
+        return false;
+    }
+    *display = d;
+    *context = c;
+    return true;
+}
+#endif
+
 static void window_size_callback(GLFWwindow *window, int width, int height) {}
 static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     Input::onFramebufferResize(width, height);
@@ -57,7 +106,7 @@ static void mouse_button_callback(GLFWwindow *window, int button, int action, in
     Input::onMouseButton(button, action, mods);
 }
 static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    Input::scrollSignal(xoffset, yoffset);
+    Input::onScroll(xoffset, yoffset);
 }
 static void joystick_callback(int jid, int event) {
     if (event == GLFW_CONNECTED) {
@@ -73,18 +122,120 @@ static void drop_callback(GLFWwindow *window, int count, const char **paths) {
 }
 
 //============================================================
-AppBase::AppBase() {}
+AppCreateInfo parseCommandLine(int argc, const char **argv) {
+    AppCreateInfo ret{};
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        auto next = [&]() -> const char * {
+            if (i + 1 >= argc) THROW("missing value of command line option", arg);
+            return argv[++i];
+        };
+        if (arg == "--headless")
+            ret.headless = true;
+        else if (arg == "--frames")
+            ret.frameCount = static_cast<uint32_t>(std::stoul(next()));
+        else if (arg == "--fixed-dt")
+            ret.fixedTimeStep_ms = std::stof(next());
+        else if (arg == "--capture")
+            ret.captureDir = next();
+        else if (arg == "--capture-interval")
+            ret.captureInterval = std::max(1u, static_cast<uint32_t>(std::stoul(next())));
+        else if (arg == "--profile")
+            ret.profile = true;
+        else if (arg == "--trace")
+            ret.tracePath = next();
+        else if (arg == "--tick-rate")
+            ret.tickRate_hz = std::stof(next());
+        else if (arg == "--fps-cap")
+            ret.frameCap_fps = std::stof(next());
+        else if (arg == "--pipelined")
+            ret.pipelined = true;
+        else if (arg == "--record-input")
+            ret.recordInputPath = next();
+        else if (arg == "--replay-input")
+            ret.replayInputPath = next();
+        else if (arg == "--size") {
+            if (sscanf(next(), "%dx%d", &ret.width, &ret.height) != 2) THROW("--size expects WxH");
+        }
+    }
+    return ret;
+}
+
+//============================================================
+AppBase::AppBase(AppCreateInfo const &createInfo) : _createInfo(createInfo) {
+    // replay is keyed on frame index, the frames of a recording and its replay advance by the same fixed step
+    if (!_createInfo.replayInputPath.empty()) {
+        _inputReplay = std::make_unique<InputReplay>(_createInfo.replayInputPath);
+        if (_createInfo.headless && _createInfo.frameCount == 0) _createInfo.frameCount = _inputReplay->getFrameCount();
+        auto &&timing = _inputReplay->getTiming();
+        if (_createInfo.fixedTimeStep_ms > 0 && _createInfo.fixedTimeStep_ms != timing.fixedTimeStep_ms)
+            LOG("--fixed-dt replaced by the time step of the input recording", timing.fixedTimeStep_ms);
+        _createInfo.fixedTimeStep_ms = timing.fixedTimeStep_ms;
+        _createInfo.tickRate_hz = timing.tickRate_hz;
+    }
+    if (!_createInfo.recordInputPath.empty()) {
+        // one tick per frame at the tick rate unless a step is given, the cap keeps the session in real time
+        if (_createInfo.fixedTimeStep_ms <= 0) {
+            _createInfo.fixedTimeStep_ms = 1000 / _createInfo.tickRate_hz;
+            if (_createInfo.frameCap_fps <= 0) _createInfo.frameCap_fps = _createInfo.tickRate_hz;
+        }
+        _inputRecorder = std::make_unique<InputRecorder>(
+            _createInfo.recordInputPath, InputRecordingTiming{_createInfo.fixedTimeStep_ms, _createInfo.tickRate_hz});
+        Input::recorder = _inputRecorder.get();
+    }
+    FrameScheduler::Settings settings{};
+    settings.tickRate_hz = _createInfo.tickRate_hz;
+    settings.frameCap_fps = _createInfo.frameCap_fps;
+    settings.fixedFrameTime_ms = _createInfo.fixedTimeStep_ms;
+    _scheduler.setSettings(settings);
+    if (_createInfo.headless && _createInfo.frameCount == 0) THROW("headless mode needs a frame count");
+    if (!_createInfo.captureDir.empty()) std::filesystem::create_directories(_createInfo.captureDir);
+    // the thread creating the job system is its main thread, the same goes for the consumer of the main event queue
+    JobSystem::getSingleton();
+    MainEventQueue::getSingleton();
+}
 AppBase::~AppBase() {
+    stopSimulationThread();
+    // static techniques would unwatch their files after AssetReloader is destroyed and delete programs without a
+    // context
+    for (auto &&e : Material::techniques) e.reset();
+    // scenes are gone, free every resource while the context is alive. models hold materials, materials hold
+    // textures, the managers themselves outlive the context
+    if (window) {
+        ModelManager::getSingleton().clear();
+        MaterialManager::getSingleton().clear();
+        TextureManager::getSingleton().clear();
+    }
+    ResourceManager::getSingleton().flush();
+    _offscreenTarget.reset();
     glfwDestroyWindow(window);
     glfwTerminate();
+#ifdef HEADLESS_EGL
+    if (_eglContext) {
+        eglMakeCurrent(_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(_eglDisplay, _eglContext);
+        eglTerminate(_eglDisplay);
+    }
+#endif
 }
 void AppBase::initWindow() {
     startTime = std::chrono::system_clock::now();
+    // null platform needs no display server, it only supports EGL and OSMesa contexts
+    if (_createInfo.headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
     auto err = glfwInit();
     if (err == GLFW_FALSE) {
         THROW("failed to init glfw,err", err);
     }
 
+#ifndef _WIN32
+    // mesa software rasterizers (llvmpipe) advertise 4.5, the shaders are #version 460 for draw parameters, which
+    // they implement. only affects mesa, an override set by the user wins
+    if (_createInfo.headless) {
+        setenv("MESA_GL_VERSION_OVERRIDE", "4.6", 0);
+        setenv("MESA_GLSL_VERSION_OVERRIDE", "460", 0);
+    }
+#endif
+
     // set gl versiont
     if (glVersion > 0) {
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glVersion / 10);
@@ -97,7 +248,25 @@ void AppBase::initWindow() {
     glfwWindowHint(GLFW_SRGB_CAPABLE, GL_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    window = glfwCreateWindow(1200, 800, __FILE__, nullptr, nullptr);
+    if (_createInfo.headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_SAMPLES, 0);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
+    window = glfwCreateWindow(_createInfo.width, _createInfo.height, __FILE__, nullptr, nullptr);
+    if (!window && _createInfo.headless) {
+        LOG("failed to create egl context, try osmesa");
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(_createInfo.width, _createInfo.height, __FILE__, nullptr, nullptr);
+    }
+#ifdef HEADLESS_EGL
+    if (!window && _createInfo.headless && createSurfacelessContext(&_eglDisplay, &_eglContext)) {
+        LOG("failed to create osmesa context, using a surfaceless egl context");
+        // the window only carries size and callbacks then, the context is ours
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window = glfwCreateWindow(_createInfo.width, _createInfo.height, __FILE__, nullptr, nullptr);
+    }
+#endif
     if (!window) {
         // char strs[10][200];
         const char *data;
@@ -106,7 +275,10 @@ void AppBase::initWindow() {
         THROW("failed to create window", err, "description", data);
     }
 
-    glfwMakeContextCurrent(window);
+#ifdef HEADLESS_EGL
+    if (!_eglContext)
+#endif
+        glfwMakeContextCurrent(window);
     glfwSetWindowUserPointer(window, this);
 
     glfwSetWindowSizeCallback(window, window_size_callback);
@@ -118,12 +290,15 @@ void AppBase::initWindow() {
     glfwSetWindowFocusCallback(window, window_focus_callback);
     glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
-    glfwSetKeyCallback(window, key_callback);
+    // a replayed session must not see the real input
+    if (!_inputReplay) {
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, cursor_position_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+    }
     glfwSetCharCallback(window, character_callback);
-    glfwSetCursorPosCallback(window, cursor_position_callback);
     glfwSetCursorEnterCallback(window, cursor_enter_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-    glfwSetScrollCallback(window, scroll_callback);
     glfwSetJoystickCallback(joystick_callback);
     glfwSetDropCallback(window, drop_callback);
 
@@ -133,6 +308,8 @@ void AppBase::initWindow() {
 }
 void AppBase::initOpengl() {
     GLenum err = glewInit();
+    // a glx build of glew still loads every gl entry point before it looks for the (missing) x display
+    if (_createInfo.headless && err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
     if (GLEW_OK != err) {
         /* Problem: glewInit failed, something is seriously wrong. */
         fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
@@ -152,20 +329,180 @@ void AppBase::initOpengl() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
     glBlendEquation(GL_FUNC_ADD);
+
+    if (_createInfo.headless) createOffscreenTarget();
+}
+void AppBase::createOffscreenTarget() {
+    // surfaceless contexts have no default framebuffer, present into this one instead
+    _offscreenTarget = std::make_unique<RenderTarget>();
+    _offscreenTarget->images.resize(2);
+    glGenTextures(2, _offscreenTarget->images.data());
+    glBindTexture(GL_TEXTURE_2D, _offscreenTarget->images[0]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_SRGB8_ALPHA8, Input::framebufferWidth, Input::framebufferHeight);
+    glBindTexture(GL_TEXTURE_2D, _offscreenTarget->images[1]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, Input::framebufferWidth, Input::framebufferHeight);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &_offscreenTarget->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _offscreenTarget->fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _offscreenTarget->images[0], 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, _offscreenTarget->images[1], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        THROW("offscreen framebuffer is not complete");
+
+    // without a surface the initial viewport is empty
+    glViewport(0, 0, Input::framebufferWidth, Input::framebufferHeight);
+    RenderServer::outputFramebuffer = _offscreenTarget->fbo;
+}
+void AppBase::captureFrame() {
+    auto width = Input::framebufferWidth;
+    auto height = Input::framebufferHeight;
+    auto rowSize = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> pixels(rowSize * height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, RenderServer::outputFramebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    // gl rows start at the bottom
+    for (int i = 0; i < height / 2; ++i)
+        std::swap_ranges(pixels.begin() + i * rowSize, pixels.begin() + (i + 1) * rowSize,
+                         pixels.begin() + (height - 1 - i) * rowSize);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/frame_%05u.png", _frameIndex);
+    if (!saveImage(_createInfo.captureDir + name, "PNG", width, height, 3, pixels.data()))
+        LOG("failed to save frame", _frameIndex);
+}
+void AppBase::simulate(uint32_t ticks, float alpha) {
+    {
+        PROFILE_SCOPE("simulation");
+        for (uint32_t i = 0; i < ticks; ++i) tickSignal(_scheduler.getTickInterval_ms());
+    }
+    snapshotSignal(_framePipeline.beginWrite(), alpha);
+    _framePipeline.publish();
+}
+void AppBase::simulationLoop() {
+    std::unique_lock lock(_simulationMutex);
+    while (true) {
+        _simulationCondition.wait(lock, [this] { return _simulationPending || _simulationQuit; });
+        if (_simulationQuit) return;
+        lock.unlock();
+        simulate(_simulationTicks, _simulationAlpha);
+        lock.lock();
+        _simulationPending = false;
+        _simulationCondition.notify_all();
+    }
+}
+void AppBase::startSimulation(uint32_t ticks, float alpha) {
+    if (!_simulationThread.joinable()) _simulationThread = std::thread(&AppBase::simulationLoop, this);
+    std::lock_guard lock(_simulationMutex);
+    _simulationTicks = ticks;
+    _simulationAlpha = alpha;
+    _simulationPending = true;
+    _simulationCondition.notify_all();
+}
+void AppBase::waitSimulation() {
+    std::unique_lock lock(_simulationMutex);
+    _simulationCondition.wait(lock, [this] { return !_simulationPending; });
+}
+void AppBase::stopSimulationThread() {
+    if (!_simulationThread.joinable()) return;
+    {
+        std::lock_guard lock(_simulationMutex);
+        _simulationQuit = true;
+        _simulationCondition.notify_all();
+    }
+    _simulationThread.join();
 }
 void AppBase::mainLoop() {
-    curTime = std::chrono::system_clock::now();
+    bool firstFrame = true;
+    if (_createInfo.profile) Profiler::setEnabled(true);
+    if (!_createInfo.tracePath.empty())
+        Profiler::getSingleton().captureTrace(_createInfo.tracePath,
+                                              _createInfo.frameCount ? _createInfo.frameCount : 300);
     while (!glfwWindowShouldClose(window)) {
-        auto temptime = std::chrono::system_clock::now();
-        frameTimeInterval_ms =
-            std::chrono::duration<float, std::chrono::milliseconds::period>(temptime - curTime).count();
-        curTime = temptime;
-        FPS = static_cast<uint32_t>(1000 / frameTimeInterval_ms);
+        auto ticks = _scheduler.beginFrame();
+        frameTimeInterval_ms = _scheduler.getFrameTime_ms();
+        FPS = frameTimeInterval_ms > 0 ? static_cast<uint32_t>(1000 / frameTimeInterval_ms) : 0;
 
-        glfwPollEvents();
+        Profiler::getSingleton().newFrame();
+        {
+            PROFILE_SCOPE("frame");
+            {
+                PROFILE_SCOPE("poll events");
+                if (_inputRecorder) _inputRecorder->setFrameIndex(_frameIndex, Input::guiWantCaptureMouse);
+                glfwPollEvents();
+                if (_inputReplay) _inputReplay->replay(_frameIndex);
+            }
+            {
+                PROFILE_SCOPE("dispatch events");
+                MainEventQueue::getSingleton().dispatch();
+            }
+            {
+                PROFILE_SCOPE("asset reload");
+                // safe point for gl work triggered by modified assets
+                AssetReloader::getSingleton().update();
+            }
+            {
+                PROFILE_SCOPE("main thread jobs");
+                JobSystem::getSingleton().processMainThreadJobs();
+            }
+            // pipelined, the snapshot of this frame was simulated during the previous one and the next one is
+            // simulated while this one renders, the first frame draws the initial state. latency stays at one frame
+            // because the simulation is waited for before the next frame starts. the window callbacks and
+            // Input::nextFrame (Scene::update) never overlap: events are polled above, before the simulation starts,
+            // and the next poll comes after the wait below
+            if (!_createInfo.pipelined)
+                simulate(ticks, _scheduler.getAlpha());
+            else if (!_renderSnapshot)
+                simulate(0, 1.f);
+            _renderSnapshot = _framePipeline.acquire();
+            if (_createInfo.pipelined) startSimulation(ticks, _scheduler.getAlpha());
+            {
+                PROFILE_SCOPE("render");
+                renderSignal(frameTimeInterval_ms);
+            }
+            if (!_createInfo.captureDir.empty() && _frameIndex % _createInfo.captureInterval == 0) {
+                PROFILE_SCOPE("capture frame");
+                captureFrame();
+            }
+            {
+                PROFILE_SCOPE("present");
+                // nothing to present offscreen, wait for the gpu so frame times stay meaningful
+                if (_createInfo.headless)
+                    glFinish();
+                else
+                    glfwSwapBuffers(window);
+            }
+            {
+                PROFILE_SCOPE("wait simulation");
+                if (_createInfo.pipelined) waitSimulation();
+            }
+            {
+                // after the simulation so nothing it still reads is collected, the fence covers this frame
+                PROFILE_SCOPE("resources");
+                ResourceManager::getSingleton().update();
+            }
+        }
 
-        renderSignal(frameTimeInterval_ms);
+        // most techniques are created lazily, report once everything of the first frame is compiled
+        if (firstFrame) {
+            firstFrame = false;
+            auto startup_ms =
+                std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::system_clock::now() -
+                                                                                startTime)
+                    .count();
+            std::cout << "startup " << startup_ms << " ms, ";
+            ProgramCache::getSingleton().printReport(std::cout);
+            TechniquePermutations::printReport(std::cout);
+            ResourceManager::getSingleton().printReport(std::cout);
+        }
+        if (++_frameIndex == _createInfo.frameCount) break;
 
-        glfwSwapBuffers(window);
+        PROFILE_SCOPE("frame pacing");
+        _scheduler.endFrame();
     }
+    stopSimulationThread();
 }
\ No newline at end of file
@@ -1,27 +1,110 @@
 #pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "common.h"
+#include "framepipeline.h"
+#include "framescheduler.h"
 #include "game.h"
 #include "gui.h"
 #include "image.h"
 #include "imgui.h"
 #include "input.h"
+#include "inputrecorder.h"
 #include "node.h"
 #include "prerequisites.h"
 #include "renderserver.h"
 #include "scene.h"
 
+struct AppCreateInfo {
+    int width{1200};
+    int height{800};
+    // no window system: the context comes from EGL (surfaceless/pbuffer on mesa) or OSMesa through the glfw null
+    // platform, frames are rendered into an offscreen framebuffer
+    bool headless{false};
+    // stop after this many frames, 0 runs until the window is closed
+    uint32_t frameCount{0};
+    // > 0: every frame advances by this step instead of the measured frame time, makes runs reproducible
+    float fixedTimeStep_ms{0};
+    // every captureInterval-th frame is written as png into captureDir, empty disables capture
+    std::string captureDir;
+    uint32_t captureInterval{1};
+    // enable the profiler from the first frame
+    bool profile{false};
+    // chrome trace of the first frameCount frames (300 if unbounded), enables the profiler
+    std::string tracePath;
+    // simulation ticks per second, Game::tick always receives 1000 / tickRate_hz ms
+    float tickRate_hz{60};
+    // 0: uncapped
+    float frameCap_fps{0};
+    // simulate frame N+1 on the simulation thread while frame N renders, waited for (waitSimulation) before frame
+    // N+1 starts, see Game::buildSnapshot
+    bool pipelined{false};
+    // write the window input into this file, see InputRecorder. without fixedTimeStep_ms every frame runs one tick
+    // and frames are capped to the tick rate
+    std::string recordInputPath;
+    // feed the input of a recording instead of the window's, headless runs default to its frame count. the time
+    // step and tick rate of the recording replace fixedTimeStep_ms and tickRate_hz
+    std::string replayInputPath;
+};
+
+/**
+ * @brief --headless --frames N --fixed-dt ms --capture dir --capture-interval N --size WxH --profile --trace file
+ * --tick-rate hz --fps-cap fps --pipelined --record-input file --replay-input file
+ */
+AppCreateInfo parseCommandLine(int argc, const char **argv);
+
 class AppBase {
 protected:
+    AppCreateInfo _createInfo;
+    uint32_t _frameIndex{};
+
+    // replaces the default framebuffer in headless mode
+    std::unique_ptr<RenderTarget> _offscreenTarget;
+
+    void createOffscreenTarget();
+    void captureFrame();
+
+    FrameScheduler _scheduler;
+
+    // snapshots from the simulation stage to the render stage
+    FramePipeline _framePipeline;
+    RenderSnapshot const *_renderSnapshot{};
+    void simulate(uint32_t ticks, float alpha);
+
+    // pipelined mode simulates on a thread of its own, a job would sit in the main thread's deque and be run inline
+    // by the main thread as soon as it waits for other jobs (the draw recording parallelFor)
+    std::thread _simulationThread;
+    std::mutex _simulationMutex;
+    std::condition_variable _simulationCondition;
+    uint32_t _simulationTicks{};
+    float _simulationAlpha{};
+    bool _simulationPending{false};
+    bool _simulationQuit{false};
+    void simulationLoop();
+    void startSimulation(uint32_t ticks, float alpha);
+    void waitSimulation();
+    void stopSimulationThread();
+
+    std::unique_ptr<InputRecorder> _inputRecorder;
+    std::unique_ptr<InputReplay> _inputReplay;
+
     uint32_t FPS;
     float frameTimeInterval_ms;
-    std::chrono::system_clock::time_point curTime;
     std::chrono::system_clock::time_point startTime;
 
-    GLFWwindow *window;
+    GLFWwindow *window{};
     bool framebufferResized{true};
 
+#ifdef HEADLESS_EGL
+    // surfaceless context created without glfw when it finds no usable egl config, see initWindow
+    void *_eglDisplay{};
+    void *_eglContext{};
+#endif
+
 public:
-    AppBase();
+    AppBase(AppCreateInfo const &createInfo = {});
 
     virtual ~AppBase();
 
@@ -31,7 +114,25 @@ public:
     void mainLoop();
 
     GLFWwindow *getWindow() const { return window; }
+    constexpr AppCreateInfo const &getCreateInfo() const { return _createInfo; }
+    constexpr uint32_t getFrameIndex() const { return _frameIndex; }
+
+    /**
+     * @brief render position between the last two simulation ticks, see Scene::interpolate
+     */
+    float getInterpolationAlpha() const { return _scheduler.getAlpha(); }
+    FrameScheduler &getScheduler() { return _scheduler; }
+
+    /**
+     * @brief the snapshot to draw in render(), built one frame earlier in pipelined mode
+     */
+    RenderSnapshot const *getRenderSnapshot() const { return _renderSnapshot; }
 
+    // fixed step simulation, 0..n times per frame
+    Signal<void(float)> tickSignal;
+    // once per frame after the ticks, with the snapshot to fill and the interpolation alpha
+    Signal<void(RenderSnapshot &, float)> snapshotSignal;
+    // once per frame with the frame time
     Signal<void(float)> renderSignal;
 
     template <typename T, typename... Args>
@@ -42,6 +143,8 @@ public:
         auto game = T(args...);
         game.setParent(this);
 
+        tickSignal.Connect(&Game::tick, &game);
+        snapshotSignal.Connect(&Game::buildSnapshot, &game);
         renderSignal.Connect(&Game::render, &game);
 
         game.init();
@@ -23,17 +23,17 @@ void Camera::init() {
                      a, &_pvBuffer);
     updateProjectionMatrix();
 }
-void Camera::updatePVBuffer() {
-    UBO a{
-        getViewMatrix(), getProjectionMatrix(),
-        _parent->getComponent<Transform>()->getGlobalPosition(), _near, _far};
-
+Camera::UBO Camera::getUBO() {
+    return UBO{getViewMatrix(), getProjectionMatrix(), _parent->getComponent<Transform>()->getRenderPosition(), _near,
+               _far};
+}
+void Camera::uploadPVBuffer(UBO const &ubo) {
     glBindBuffer(GL_UNIFORM_BUFFER, _pvBuffer);
-    glm::mat4 *data = (glm::mat4 *)glMapBufferRange(
+    auto data = static_cast<UBO *>(glMapBufferRange(
         GL_UNIFORM_BUFFER, 0, sizeof(UBO),
         GL::Map((GL::BufferMapFlagBits)(GL::BUFFER_MAP_COHERENT_BIT | GL::BUFFER_MAP_PERSISTENT_BIT |
-                                        GL::BUFFER_MAP_WRITE_BIT)));
-    memcpy(data, &a, sizeof(UBO));
+                                        GL::BUFFER_MAP_WRITE_BIT))));
+    *data = ubo;
     glUnmapBuffer(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
@@ -58,7 +58,7 @@ Camera *Camera::setFarPlane(float f) {
     return this;
 }
 glm::mat4 Camera::getViewMatrix() {
-    return glm::inverse(_parent->getComponent<Transform>()->getGlobalTransformMatrix());
+    return glm::inverse(_parent->getComponent<Transform>()->getRenderMatrix());
 }
 void Camera::updateProjectionMatrix() {
     if (auto p = std::get_if<PerspectiveDescription>(&_extraDesc)) {
@@ -105,9 +105,7 @@ void Camera::updateProjectionMatrix() {
     }
     // make screen y coordinate downwards
     //_perspectiveMatrix[1][1] *= -1;
-    updatePVBuffer();
 }
-void Camera::update() { updatePVBuffer(); }
 void Camera::bind(uint32_t binding) { glBindBufferRange(GL_UNIFORM_BUFFER, 1, _pvBuffer, 0, sizeof(UBO)); }
 
 //=======================
@@ -186,69 +184,24 @@ void EditCameraController::updatePerFrame(float frameDtMs) {
         dir *= _speed * frameDtMs / 1000;
         _parent->getComponent<Transform>()->translate(dir, TransformSpace::LOCAL);
     }
-}
-void EditCameraController::onScroll(double xoffset, double yoffset) {
-    static float c = 0.1;
-    _parent->getComponent<Transform>()->translate(
-        glm::vec3(0, 0, -glm::length(_parent->getComponent<Transform>()->getGlobalPosition()) * c * yoffset),
-        TransformSpace::LOCAL);
-}
-void EditCameraController::onMouseMove(double xpos, double ypos) {
-    if (Input::guiWantCaptureMouse) return;
-    //=============================================================
-    // auto keyStateMouseL = Shit::GetKeyState(Shit::KeyCode::KEY_LBUTTON);
-    auto keyStateMouseR = Input::inputState[INPUT_MOUSE_BUTTON_RIGHT];
-    auto keyStateMouseL = Input::inputState[INPUT_MOUSE_BUTTON_LEFT];
-    auto keyStateMouseM = Input::inputState[INPUT_MOUSE_BUTTON_MIDDLE];
-
-    // wheel
-    // auto keyStateAltL = Shit::GetKeyState(Shit::KeyCode::KEY_LMENU);
-    static bool flag = true;
-    static double preCursorX, preCursorY, cursorX, cursorY;
 
-    if (keyStateMouseL == STATE_PRESS)  //|| (keyStateMouseL.down && keyStateAltL.down))
-    {
-        static float c = 0.001;
-        // pWindow->GetCursorPos(cursorX, cursorY);
-        cursorX = xpos;
-        cursorY = ypos;
-        if (flag) {
-            preCursorX = xpos;
-            preCursorY = ypos;
-            flag = false;
-        }
-        if (cursorX != preCursorX) {
-            _parent->getComponent<Transform>()->yaw((preCursorX - cursorX) * c, TransformSpace::PARENT);
-        }
-        if (cursorY != preCursorY) {
-            _parent->getComponent<Transform>()->pitch((preCursorY - cursorY) * c, TransformSpace::LOCAL);
-        }
-        preCursorX = cursorX, preCursorY = cursorY;
-    } else if (keyStateMouseR == GLFW_PRESS) {
+    auto &&input = Input::getFrame();
+    auto transform = _parent->getComponent<Transform>();
+    if (input.scroll.y != 0) {
+        static float c = 0.1;
+        transform->translate(glm::vec3(0, 0, -glm::length(transform->getGlobalPosition()) * c * input.scroll.y),
+                             TransformSpace::LOCAL);
+    }
+    if (input.guiWantCaptureMouse || input.cursorDelta == glm::dvec2(0)) return;
+    if (input.isDown(INPUT_MOUSE_BUTTON_LEFT)) {
         static float c = 0.001;
-        c = 0.001 * glm::length(_parent->getComponent<Transform>()->getGlobalPosition());
-        cursorX = xpos;
-        cursorY = ypos;
-        if (flag) {
-            preCursorX = xpos;
-            preCursorY = ypos;
-            flag = false;
-        }
-        if (cursorX != preCursorX) {
-            _parent->getComponent<Transform>()->translate(glm::vec3((preCursorX - cursorX) * c, 0, 0),
-                                                          TransformSpace::LOCAL);
-        }
-        if (cursorY != preCursorY) {
-            _parent->getComponent<Transform>()->translate(glm::vec3(0, (cursorY - preCursorY) * c, 0),
-                                                          TransformSpace::LOCAL);
-        }
-        preCursorX = cursorX, preCursorY = cursorY;
-    } else {
-        flag = true;
+        transform->yaw(-input.cursorDelta.x * c, TransformSpace::PARENT);
+        transform->pitch(-input.cursorDelta.y * c, TransformSpace::LOCAL);
+    } else if (input.isDown(INPUT_MOUSE_BUTTON_RIGHT)) {
+        float c = 0.001 * glm::length(transform->getGlobalPosition());
+        transform->translate(glm::vec3(-input.cursorDelta.x * c, input.cursorDelta.y * c, 0), TransformSpace::LOCAL);
     }
 }
-void EditCameraController::onMouseButton(KeyCode, KeyState) {}
-
 void EditCameraController::onKey(KeyCode keyCode, KeyState keyState)
 {
     float speed = 0.01;
@@ -284,56 +237,29 @@ void EditCameraController::onKey(KeyCode keyCode, KeyState keyState)
 }
 
 void EditCameraController2::prepare() { _parent->getComponent<Transform>()->setInitTranslation({0, 0, 3}); }
-void EditCameraController2::updatePerFrame(float frameDtMs) {}
-void EditCameraController2::onScroll(double xoffset, double yoffset) {
-    _parent->getComponent<Transform>()->translate(_parent->getComponent<Transform>()->getLocalRotation() *
-                                                  glm::vec3{0, 0, yoffset * 0.1});
-}
-void EditCameraController2::onMouseMove(double xpos, double ypos) {
-    if (Input::guiWantCaptureMouse) return;
-    auto keyStateMouseR = Input::inputState[INPUT_MOUSE_BUTTON_RIGHT];
-    auto keyStateMouseL = Input::inputState[INPUT_MOUSE_BUTTON_LEFT];
-    auto keyStateMouseM = Input::inputState[INPUT_MOUSE_BUTTON_MIDDLE];
-
-    static bool flag = false;
-    static double preCursorX, preCursorY, cursorX, cursorY;
+void EditCameraController2::updatePerFrame(float frameDtMs) {
+    auto &&input = Input::getFrame();
+    auto transform = _parent->getComponent<Transform>();
+    if (input.scroll.y != 0)
+        transform->translate(transform->getLocalRotation() * glm::vec3{0, 0, input.scroll.y * 0.1});
 
-    if (keyStateMouseL == STATE_PRESS || keyStateMouseR == STATE_PRESS) {
-        cursorX = xpos;
-        cursorY = ypos;
-
-        if (flag) {
-            float sens = 2.f;
-            auto dx = sens * (cursorX - preCursorX);
-            auto dy = -sens * (cursorY - preCursorY);
-            if (keyStateMouseL == GLFW_PRESS) {
-                // drag rotate scene around zero
-                glm::vec3 a = glm::normalize(glm::vec3(dx, dy, 0));
-                glm::vec3 rotAxis = glm::cross(a, glm::vec3(0, 0, 1));
-                auto dl = glm::length(glm::vec2(dx, dy));
-                _parent->getComponent<Transform>()->rotate(
-                    glm::rotate(glm::quat{1, 0, 0, 0}, glm::radians(dl), rotAxis), TransformSpace::LOCAL);
-
-                _parent->getComponent<Transform>()->setLocalTranslation(
-                    _parent->getComponent<Transform>()->getLocalRotation() *
-                    _parent->getComponent<Transform>()->getInitTranslation());
-            } else if (keyStateMouseR == GLFW_PRESS) {
-                // y rotate global y
-                // x rotate local x
-                _parent->getComponent<Transform>()->yaw(glm::radians(dx), TransformSpace::PARENT);
-                _parent->getComponent<Transform>()->pitch(glm::radians(dy), TransformSpace::LOCAL);
-            }
-
-            preCursorX = xpos;
-            preCursorY = ypos;
+    if (!input.guiWantCaptureMouse && input.cursorDelta != glm::dvec2(0)) {
+        float sens = 2.f;
+        auto dx = sens * input.cursorDelta.x;
+        auto dy = -sens * input.cursorDelta.y;
+        if (input.isDown(INPUT_MOUSE_BUTTON_LEFT)) {
+            // drag rotate scene around zero
+            glm::vec3 a = glm::normalize(glm::vec3(dx, dy, 0));
+            glm::vec3 rotAxis = glm::cross(a, glm::vec3(0, 0, 1));
+            auto dl = glm::length(glm::vec2(dx, dy));
+            transform->rotate(glm::rotate(glm::quat{1, 0, 0, 0}, glm::radians(dl), rotAxis), TransformSpace::LOCAL);
+            transform->setLocalTranslation(transform->getLocalRotation() * transform->getInitTranslation());
+        } else if (input.isDown(INPUT_MOUSE_BUTTON_RIGHT)) {
+            // y rotate global y
+            // x rotate local x
+            transform->yaw(glm::radians(dx), TransformSpace::PARENT);
+            transform->pitch(glm::radians(dy), TransformSpace::LOCAL);
         }
-        flag = true;
-    } else {
-        flag = false;
     }
+    if (input.wasReleased(INPUT_MOUSE_BUTTON_LEFT)) transform->reset();
 }
-void EditCameraController2::onMouseButton(KeyCode keyCode, KeyState keyState) {
-    if (keyCode == INPUT_MOUSE_BUTTON_LEFT && keyState == STATE_RELEASE) {
-        _parent->getComponent<Transform>()->reset();
-    }
-}
\ No newline at end of file
@@ -27,6 +27,11 @@ class Camera : public Component {
 
     GL::BufferHandle _pvBuffer;
 
+    void updateProjectionMatrix();
+
+    void init();
+
+public:
     struct UBO {
         glm::mat4 V;
         glm::mat4 P;
@@ -35,12 +40,6 @@ class Camera : public Component {
         float far;
     };
 
-    void updatePVBuffer();
-    void updateProjectionMatrix();
-
-    void init();
-
-public:
     Camera(Node *parent);
     Camera(Node *parent, OrthogonalDescription orth, float n, float f);
     Camera(Node *parent, PerspectiveDescription persp, float n, float f);
@@ -54,7 +53,14 @@ public:
     glm::mat4 getViewMatrix();
     constexpr glm::mat4 const &getProjectionMatrix() const { return _perspectiveMatrix; }
 
-    void update() override;
+    /**
+     * @brief view and projection of the current render pose, no gl call
+     */
+    UBO getUBO();
+    /**
+     * @brief render stage, write ubo (taken from a snapshot) into the pv buffer
+     */
+    void uploadPVBuffer(UBO const &ubo);
 
     constexpr GL::BufferHandle getPVBuffer() const { return _pvBuffer; }
 
@@ -75,9 +81,6 @@ public:
 
     void prepare() override;
     void updatePerFrame(float frameDtMs) override;
-    void onScroll(double xoffset, double yoffset) override;
-    void onMouseMove(double xpos, double ypos) override;
-    void onMouseButton(KeyCode, KeyState) override;
     // keyboard event
     void onKey(KeyCode keyCode, KeyState keyState);
 };
@@ -95,7 +98,4 @@ public:
 
     void prepare() override;
     void updatePerFrame(float frameDtMs) override;
-    void onScroll(double xoffset, double yoffset) override;
-    void onMouseMove(double xpos, double ypos) override;
-    void onMouseButton(KeyCode, KeyState) override;
 };
\ No newline at end of file
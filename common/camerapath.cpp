@@ -0,0 +1,46 @@
+#include "camerapath.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "transform.h"
+
+static glm::vec3 catmullRom(glm::vec3 const &p0, glm::vec3 const &p1, glm::vec3 const &p2, glm::vec3 const &p3,
+                            float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (2.f * p1 + (p2 - p0) * t + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 +
+                   (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+}
+
+CameraPath::ControlPoint CameraPath::evaluate(float t) const {
+    if (points.empty()) return {{0, 0, 0}, {0, 0, -1}};
+    if (points.size() == 1) return points[0];
+
+    auto segmentCount = points.size() - 1;
+    float s = std::clamp(t, 0.f, 1.f) * segmentCount;
+    auto i = std::min(static_cast<size_t>(s), segmentCount - 1);
+    float u = s - i;
+
+    // phantom end points are duplicated so the curve passes through the first and last control point
+    auto &&p0 = points[i == 0 ? 0 : i - 1];
+    auto &&p1 = points[i];
+    auto &&p2 = points[i + 1];
+    auto &&p3 = points[std::min(i + 2, points.size() - 1)];
+    return {catmullRom(p0.position, p1.position, p2.position, p3.position, u),
+            catmullRom(p0.target, p1.target, p2.target, p3.target, u)};
+}
+void CameraPath::apply(float t, Transform *transform) const {
+    auto point = evaluate(t);
+    auto direction = point.target - point.position;
+    if (glm::dot(direction, direction) < 1e-8f) direction = {0, 0, -1};
+    transform->setLocalTranslation(point.position);
+    transform->setLocalRotation(getLookRotation(direction));
+}
+glm::quat CameraPath::getLookRotation(glm::vec3 direction) {
+    direction = glm::normalize(direction);
+    // the y up vector is parallel to the direction, quatLookAtRH would return nan
+    glm::vec3 up{0, 1, 0};
+    if (std::abs(direction.y) > 0.9999f) up = {0, 0, -1};
+    return glm::quatLookAtRH(direction, up);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+class Transform;
+
+/**
+ * @brief uniform catmull-rom spline through camera control points, evaluated by normalized time so the same path
+ * yields the same camera for a given frame index whatever the frame rate
+ */
+class CameraPath {
+public:
+    struct ControlPoint {
+        glm::vec3 position;
+        glm::vec3 target;  // look-at point
+    };
+    std::vector<ControlPoint> points;
+
+    /**
+     * @brief t in [0, 1] over the whole path, segments share time equally, end points are clamped
+     */
+    ControlPoint evaluate(float t) const;
+
+    /**
+     * @brief place the camera node at t, looking at the interpolated target
+     */
+    void apply(float t, Transform *transform) const;
+
+    /**
+     * @brief rotation of a camera looking along direction with y up, or with -z up when looking straight up or down
+     */
+    static glm::quat getLookRotation(glm::vec3 direction);
+};
@@ -0,0 +1,115 @@
+#include "commandbuffer.h"
+
+#include <array>
+
+namespace GL {
+
+std::byte *CommandBuffer::allocate(uint32_t size) {
+    if (_blockIndex < _blocks.size() && _blocks[_blockIndex].used + size > BLOCK_SIZE) ++_blockIndex;
+    if (_blockIndex == _blocks.size()) _blocks.emplace_back(Block{std::make_unique<std::byte[]>(BLOCK_SIZE), 0});
+    auto &&block = _blocks[_blockIndex];
+    auto p = block.data.get() + block.used;
+    block.used += size;
+    return p;
+}
+void CommandBuffer::reset() {
+    for (auto &&e : _blocks) e.used = 0;
+    _blockIndex = 0;
+    _commandCount = 0;
+}
+
+namespace {
+// last state set by the replay, vertex and index buffer bindings belong to the vao
+struct ReplayState {
+    static constexpr GLuint UNKNOWN = ~0u;
+    GLuint pipeline{UNKNOWN};
+    GLuint vao{UNKNOWN};
+    std::array<CmdBindVertexBuffer, 8> vertexBuffers;
+    BufferHandle indexBuffer{UNKNOWN};
+
+    ReplayState() { resetVertexState(); }
+    void resetVertexState() {
+        for (auto &&e : vertexBuffers) e = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+        indexBuffer = UNKNOWN;
+    }
+};
+
+template <typename T>
+T read(std::byte const *p) {
+    T cmd;
+    memcpy(&cmd, p + sizeof(CommandHeader), sizeof(T));
+    return cmd;
+}
+}  // namespace
+
+void executeCommandBuffers(std::span<CommandBuffer const *const> commandBuffers) {
+    ReplayState state;
+    for (auto commandBuffer : commandBuffers) {
+        for (uint32_t blockIndex = 0; blockIndex < commandBuffer->_blocks.size(); ++blockIndex) {
+            auto &&block = commandBuffer->_blocks[blockIndex];
+            for (uint32_t offset = 0; offset < block.used;) {
+                auto p = block.data.get() + offset;
+                CommandHeader header;
+                memcpy(&header, p, sizeof(header));
+                offset += header.size;
+
+                switch (header.type) {
+                    case CommandType::BIND_PIPELINE: {
+                        auto cmd = read<CmdBindPipeline>(p);
+                        if (cmd.pipeline != state.pipeline) {
+                            glBindProgramPipeline(cmd.pipeline);
+                            state.pipeline = cmd.pipeline;
+                        }
+                        if (cmd.vao != state.vao) {
+                            glBindVertexArray(cmd.vao);
+                            state.vao = cmd.vao;
+                            state.resetVertexState();
+                        }
+                        break;
+                    }
+                    case CommandType::BIND_VERTEX_BUFFER: {
+                        auto cmd = read<CmdBindVertexBuffer>(p);
+                        if (cmd.binding < state.vertexBuffers.size()) {
+                            auto &&current = state.vertexBuffers[cmd.binding];
+                            if (memcmp(&current, &cmd, sizeof(cmd)) == 0) break;
+                            current = cmd;
+                        }
+                        glBindVertexBuffer(cmd.binding, cmd.buffer, cmd.offset, cmd.stride);
+                        break;
+                    }
+                    case CommandType::BIND_INDEX_BUFFER: {
+                        auto cmd = read<CmdBindIndexBuffer>(p);
+                        if (cmd.buffer != state.indexBuffer) {
+                            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cmd.buffer);
+                            state.indexBuffer = cmd.buffer;
+                        }
+                        break;
+                    }
+                    case CommandType::BIND_BUFFER_RANGE: {
+                        auto cmd = read<CmdBindBufferRange>(p);
+                        glBindBufferRange(cmd.target, cmd.index, cmd.buffer, cmd.offset, cmd.size);
+                        break;
+                    }
+                    case CommandType::BIND_TEXTURE: {
+                        auto cmd = read<CmdBindTexture>(p);
+                        glActiveTexture(GL_TEXTURE0 + cmd.unit);
+                        glBindTexture(cmd.target, cmd.texture);
+                        break;
+                    }
+                    case CommandType::DRAW: {
+                        auto cmd = read<CmdDraw>(p);
+                        Draw(cmd.topology, cmd.indirectCmd);
+                        break;
+                    }
+                    case CommandType::DRAW_INDEXED: {
+                        auto cmd = read<CmdDrawIndexed>(p);
+                        DrawIndexed(cmd.topology, cmd.indexType, cmd.indexedIndirectCmd);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+}  // namespace GL
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "device.h"
+
+namespace GL {
+
+enum class CommandType : uint16_t {
+    BIND_PIPELINE,
+    BIND_VERTEX_BUFFER,
+    BIND_INDEX_BUFFER,
+    BIND_BUFFER_RANGE,
+    BIND_TEXTURE,
+    DRAW,
+    DRAW_INDEXED,
+};
+
+// commands are plain data, a header followed by one of the structs below, 4 byte aligned
+struct CommandHeader {
+    CommandType type;
+    uint16_t size;  // header included
+};
+struct CmdBindPipeline {
+    GLuint pipeline;
+    GLuint vao;
+};
+struct CmdBindVertexBuffer {
+    uint32_t binding;
+    BufferHandle buffer;
+    uint32_t offset;
+    uint32_t stride;
+};
+struct CmdBindIndexBuffer {
+    BufferHandle buffer;
+};
+struct CmdBindBufferRange {
+    GLenum target;
+    uint32_t index;
+    BufferHandle buffer;
+    uint32_t offset;
+    uint32_t size;
+};
+struct CmdBindTexture {
+    uint32_t unit;
+    GLenum target;
+    GLuint texture;
+};
+struct CmdDraw {
+    PrimitiveTopology topology;
+    DrawIndirectCommand indirectCmd;
+};
+struct CmdDrawIndexed {
+    PrimitiveTopology topology;
+    DataType indexType;
+    DrawIndexedIndirectCommand indexedIndirectCmd;
+};
+
+/**
+ * @brief deferred list of gl commands. recording makes no gl call, so a command buffer can be filled on any thread
+ * (one thread at a time), the gl thread replays it with executeCommandBuffers.
+ * commands are appended to a linear allocator of fixed size blocks, reset() keeps the blocks for the next frame
+ */
+class CommandBuffer {
+public:
+    static constexpr uint32_t BLOCK_SIZE = 64 * 1024;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        uint32_t used;
+    };
+    std::vector<Block> _blocks;
+    uint32_t _blockIndex{};
+    uint32_t _commandCount{};
+
+    std::byte *allocate(uint32_t size);
+
+    template <typename T>
+    void push(CommandType type, T const &cmd) {
+        static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % 4 == 0);
+        constexpr auto size = uint32_t(sizeof(CommandHeader) + sizeof(T));
+        auto p = allocate(size);
+        CommandHeader header{type, uint16_t(size)};
+        memcpy(p, &header, sizeof(header));
+        memcpy(p + sizeof(header), &cmd, sizeof(T));
+        ++_commandCount;
+    }
+
+    friend void executeCommandBuffers(std::span<CommandBuffer const *const> commandBuffers);
+
+public:
+    CommandBuffer() = default;
+    CommandBuffer(CommandBuffer const &) = delete;
+    CommandBuffer &operator=(CommandBuffer const &) = delete;
+
+    void reset();
+
+    uint32_t getCommandCount() const { return _commandCount; }
+    // bytes reserved by the allocator
+    size_t getCapacity() const { return _blocks.size() * size_t(BLOCK_SIZE); }
+
+    void bindPipeline(PipelineHandle const &pipeline) { bindPipeline(pipeline.pipeline, pipeline.vao); }
+    void bindPipeline(GLuint pipeline, GLuint vao) {
+        push(CommandType::BIND_PIPELINE, CmdBindPipeline{pipeline, vao});
+    }
+    void bindVertexBuffer(uint32_t binding, BufferHandle buffer, uint32_t offset, uint32_t stride) {
+        push(CommandType::BIND_VERTEX_BUFFER, CmdBindVertexBuffer{binding, buffer, offset, stride});
+    }
+    void bindIndexBuffer(BufferHandle buffer) { push(CommandType::BIND_INDEX_BUFFER, CmdBindIndexBuffer{buffer}); }
+    void bindBufferRange(GLenum target, uint32_t index, BufferHandle buffer, uint32_t offset, uint32_t size) {
+        push(CommandType::BIND_BUFFER_RANGE, CmdBindBufferRange{target, index, buffer, offset, size});
+    }
+    void bindTexture(uint32_t unit, GLenum target, GLuint texture) {
+        push(CommandType::BIND_TEXTURE, CmdBindTexture{unit, target, texture});
+    }
+    void draw(PrimitiveTopology topology, DrawIndirectCommand const &indirectCmd) {
+        push(CommandType::DRAW, CmdDraw{topology, indirectCmd});
+    }
+    void drawIndexed(PrimitiveTopology topology, DataType indexType,
+                     DrawIndexedIndirectCommand const &indexedIndirectCmd) {
+        push(CommandType::DRAW_INDEXED, CmdDrawIndexed{topology, indexType, indexedIndirectCmd});
+    }
+};
+
+/**
+ * @brief replay the command buffers in order on the gl thread, binds repeating the current state are skipped,
+ * the state tracking starts unknown on every call
+ */
+void executeCommandBuffers(std::span<CommandBuffer const *const> commandBuffers);
+
+}  // namespace GL
@@ -6,7 +6,7 @@
 
 class Transform;
 class Node;
-class Component : public IdObject {
+class Component : public IdObject<Component> {
 protected:
     Node *_parent;
     std::string _name;
@@ -24,13 +24,9 @@ public:
 
 class Behaviour : public Component {
 public:
-    Behaviour(Node *parent) : Component(parent) {
-        Input::mouseButtonSignal.Connect(&Behaviour::onMouseButton, this);
-        Input::mouseMoveSignal.Connect(&Behaviour::onMouseMove, this);
-        Input::scrollSignal.Connect(&Behaviour::onScroll, this);
-    }
-    virtual void updatePerFrame(float frameDtMs) {}
-    virtual void onScroll(double xoffset, double yoffset) {}
-    virtual void onMouseMove(double xpos, double ypos) {}
-    virtual void onMouseButton(KeyCode, KeyState) {}
+    Behaviour(Node *parent) : Component(parent) {}
+    /**
+     * @brief called by Scene::update, Input::getFrame() holds the input since the previous update
+     */
+    virtual void updatePerFrame(float /*frameDtMs*/) {}
 };
\ No newline at end of file
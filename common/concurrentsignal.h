@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "signal.h"
+
+/**
+ * @brief signal that can be emitted, connected and disconnected from any thread.
+ * emitters read an immutable slot list published through an atomic pointer, connect and disconnect copy the list
+ * under a mutex and publish the copy. a replaced list is freed once every emission that could still read it has
+ * left (epoch reclaim: two reader counters by epoch parity, the epoch advances when the counter of the previous
+ * parity is zero). emitting is wait-free: two atomic increments and a pointer load around the slot calls.
+ * a slot may still be called by an emission in flight after Disconnect returns, call synchronize() before
+ * destroying its object. slots must not call synchronize() of their own signal.
+ * QUEUED and COALESCED connections post to an event queue like Signal's, their events are dropped once disconnected
+ */
+template <typename _Signature, typename _Group = int>
+class ConcurrentSignal;
+
+template <typename... Args, typename _Group>
+class ConcurrentSignal<void(Args...), _Group> {
+public:
+    using signature_type = void(Args...);
+    using group_type = _Group;
+    using slot_type = Slot<signature_type>;
+    using slot_function_type = typename slot_type::function_type;
+    using connection_id = uint64_t;
+
+private:
+    using deferred_delivery_type = DeferredDelivery<signature_type>;
+
+    struct Entry {
+        connection_id id;
+        group_type group;
+        // the slot, or the forwarder of a deferred connection
+        slot_function_type function;
+        std::shared_ptr<ConnectionBodyBase> body;
+        std::shared_ptr<deferred_delivery_type> deferred;
+
+        bool matches(slot_function_type const &f) const { return (deferred ? deferred->function : function) == f; }
+    };
+    struct SlotList {
+        std::vector<Entry> entries;
+    };
+    struct RetiredList {
+        std::unique_ptr<SlotList const> list;
+        uint64_t epoch;
+    };
+
+    std::atomic<SlotList const *> _current{};
+    std::atomic<uint64_t> _epoch{0};
+    // emissions in flight, by the parity of the epoch they started in
+    mutable std::array<std::atomic<uint32_t>, 2> _readers{};
+
+    // writers only
+    std::mutex _writeMutex;
+    std::vector<RetiredList> _retired;
+    connection_id _nextId{1};
+
+    // the lists retired at epoch E are unreachable once the epoch is E + 2
+    void tryReclaim() {
+        for (int i = 0; i < 2; ++i) {
+            auto epoch = _epoch.load();
+            if (_readers[(epoch + 1) & 1].load() != 0) break;
+            _epoch.store(epoch + 1);
+        }
+        auto epoch = _epoch.load();
+        std::erase_if(_retired, [epoch](auto &&e) { return e.epoch + 2 <= epoch; });
+    }
+    // under _writeMutex
+    void publish(std::unique_ptr<SlotList const> list) {
+        auto previous = _current.exchange(list.release());
+        if (previous) _retired.emplace_back(RetiredList{std::unique_ptr<SlotList const>(previous), _epoch.load()});
+        tryReclaim();
+    }
+    // seq_cst on purpose: the counter increment must be ordered before the list load, against a writer that
+    // publishes a list and then checks the counters
+    struct ReadScope {
+        ConcurrentSignal const &signal;
+        uint64_t epoch;
+        explicit ReadScope(ConcurrentSignal const &s) : signal(s), epoch(s._epoch.load()) {
+            signal._readers[epoch & 1].fetch_add(1);
+        }
+        ~ReadScope() { signal._readers[epoch & 1].fetch_sub(1); }
+    };
+
+    connection_id insert(Entry &&entry) {
+        std::lock_guard lock(_writeMutex);
+        auto current = _current.load();
+        auto list = current ? std::make_unique<SlotList>(*current) : std::make_unique<SlotList>();
+        auto it = std::upper_bound(list->entries.begin(), list->entries.end(), entry.group,
+                                   [](group_type const &group, auto &&e) { return group < e.group; });
+        entry.id = _nextId++;
+        auto id = entry.id;
+        list->entries.emplace(it, std::move(entry));
+        publish(std::move(list));
+        return id;
+    }
+
+    template <typename Pred>
+    bool removeIf(Pred &&pred) {
+        std::lock_guard lock(_writeMutex);
+        auto current = _current.load();
+        if (!current) return false;
+        auto it = std::find_if(current->entries.begin(), current->entries.end(), pred);
+        if (it == current->entries.end()) return false;
+        // queued events of the connection check the body
+        if (it->body) it->body->Disconnect();
+        auto list = std::make_unique<SlotList>(*current);
+        list->entries.erase(list->entries.begin() + (it - current->entries.begin()));
+        publish(std::move(list));
+        return true;
+    }
+
+public:
+    ConcurrentSignal() = default;
+    ConcurrentSignal(ConcurrentSignal const &) = delete;
+    ConcurrentSignal &operator=(ConcurrentSignal const &) = delete;
+    ~ConcurrentSignal() { delete _current.load(); }
+
+    template <typename Function, typename T>
+    connection_id Connect(Function &&f, T *owner, group_type group = 0) {
+        return Connect(slot_type(f, owner), group);
+    }
+    template <typename Function>
+    connection_id Connect(Function &&f, group_type group = 0) {
+        slot_type slot(std::forward<Function>(f));
+        return insert(Entry{0, group, slot.SlotFunction(), nullptr, nullptr});
+    }
+    connection_id Connect(slot_type const &slot, group_type group = 0) {
+        return Connect(slot.SlotFunction(), group);
+    }
+    /**
+     * @brief connect with a delivery policy, deferred slots run when queue is dispatched
+     */
+    template <typename Function, typename T>
+    connection_id Connect(Function &&f, T *owner, DeliveryPolicy policy,
+                          EventQueue &queue = MainEventQueue::getSingleton(), group_type group = 0) {
+        return Connect(slot_type(f, owner), policy, queue, group);
+    }
+    connection_id Connect(slot_type const &slot, DeliveryPolicy policy,
+                          EventQueue &queue = MainEventQueue::getSingleton(), group_type group = 0) {
+        static_assert(deferred_delivery_type::supported,
+                      "only signals returning void with small copyable arguments can defer delivery");
+        if (policy == DeliveryPolicy::DIRECT) return Connect(slot, group);
+        Entry entry{0, group, {}, std::make_shared<ConnectionBodyBase>(), std::make_shared<deferred_delivery_type>()};
+        entry.deferred->function = slot.SlotFunction();
+        entry.deferred->body = entry.body;
+        entry.deferred->queue = &queue;
+        entry.function = deferred_delivery_type::makeForwarder(entry.deferred, policy);
+        return insert(std::move(entry));
+    }
+
+    // false if the connection was already removed
+    bool Disconnect(connection_id id) {
+        return removeIf([id](auto &&e) { return e.id == id; });
+    }
+    template <typename Function, typename T>
+    bool Disconnect(Function &&f, T *owner) {
+        return removeIf([slot = slot_type(f, owner)](auto &&e) { return e.matches(slot.SlotFunction()); });
+    }
+    void DisconnectAllConnections() {
+        std::lock_guard lock(_writeMutex);
+        auto current = _current.load();
+        if (!current) return;
+        for (auto &&e : current->entries)
+            if (e.body) e.body->Disconnect();
+        publish(std::make_unique<SlotList>());
+    }
+
+    size_t ConnectionNum() const {
+        ReadScope scope(*this);
+        auto current = _current.load();
+        return current ? current->entries.size() : 0;
+    }
+    bool Empty() const { return ConnectionNum() == 0; }
+
+    /**
+     * @brief returns when every emission that started before the call has finished and the replaced slot lists are
+     * freed, blocks the calling thread
+     */
+    void synchronize() {
+        std::lock_guard lock(_writeMutex);
+        // two epoch advances cover the emissions of both parities
+        auto target = _epoch.load() + 2;
+        while (_epoch.load() < target || !_retired.empty()) {
+            tryReclaim();
+            if (_epoch.load() < target) std::this_thread::yield();
+        }
+    }
+
+    template <typename... A>
+    void operator()(A &&...args) const {
+        ReadScope scope(*this);
+        if (auto current = _current.load()) {
+            for (auto &&e : current->entries) e.function(args...);
+        }
+    }
+};
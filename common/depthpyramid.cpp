@@ -0,0 +1,196 @@
+#include "depthpyramid.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "technique.h"
+
+namespace {
+// std140 layout of UBODispatch in depthpyramid.comp
+struct DispatchParams {
+    glm::ivec2 srcSize;
+    int32_t srcLevel;
+    int32_t levelCount;
+    int32_t srcIsDepth;
+};
+
+glm::uvec2 levelZeroSize(glm::uvec2 frameSize) {
+    return {std::bit_ceil((frameSize.x + 1) / 2), std::bit_ceil((frameSize.y + 1) / 2)};
+}
+uint32_t levelCount(glm::uvec2 size) { return std::bit_width((std::max)(size.x, size.y)); }
+}  // namespace
+
+glm::vec2 DepthPyramidReadback::getDepthRange(glm::uvec2 pixelMin, glm::uvec2 pixelMax) const {
+    auto shift = level + 1;
+    auto last = size - 1u;
+    auto begin = glm::min(pixelMin >> shift, last);
+    auto end = glm::min(pixelMax >> shift, last);
+    glm::vec2 ret{1, 0};
+    for (auto y = begin.y; y <= end.y; ++y) {
+        for (auto x = begin.x; x <= end.x; ++x) {
+            auto e = at(x, y);
+            ret = {(std::min)(ret.x, e.x), (std::max)(ret.y, e.y)};
+        }
+    }
+    return ret;
+}
+
+//==================================
+DepthPyramid::DepthPyramid() { _technique = std::make_unique<TechniqueDepthPyramid>(); }
+DepthPyramid::~DepthPyramid() {
+    destroy();
+    for (auto &&e : _readbacks) {
+        if (e.fence) glDeleteSync(e.fence);
+        glDeleteBuffers(1, &e.buffer);
+    }
+}
+void DepthPyramid::destroy() {
+    glDeleteTextures(1, &_image);
+    glDeleteBuffers(1, &_dispatchBuffer);
+    _image = _dispatchBuffer = 0;
+    _frameSize = _size = {};
+    _levelCount = 0;
+}
+void DepthPyramid::create(glm::uvec2 frameSize) {
+    destroy();
+    _frameSize = frameSize;
+    _size = levelZeroSize(frameSize);
+    _levelCount = levelCount(_size);
+
+    glGenTextures(1, &_image);
+    glBindTexture(GL_TEXTURE_2D, _image);
+    glTexStorage2D(GL_TEXTURE_2D, _levelCount, GL_RG32F, _size.x, _size.y);
+    // texelFetch of any level, single texels for the consumers
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the first dispatch reads the depth buffer, the others the last level written before
+    GLint alignment{};
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = (std::max)(alignment, 1);
+    _dispatchStride = (sizeof(DispatchParams) + alignment - 1) / alignment * alignment;
+    auto dispatchCount = (_levelCount + LEVELS_PER_DISPATCH - 1) / LEVELS_PER_DISPATCH;
+    std::vector<char> data(_dispatchStride * dispatchCount);
+    for (uint32_t i = 0; i < dispatchCount; ++i) {
+        auto first = i * LEVELS_PER_DISPATCH;
+        DispatchParams params{glm::ivec2(first ? getLevelSize(first - 1) : frameSize), int32_t(first ? first - 1 : 0),
+                              int32_t((std::min)(LEVELS_PER_DISPATCH, _levelCount - first)), first == 0};
+        memcpy(data.data() + _dispatchStride * i, &params, sizeof(params));
+    }
+    GL::createBuffer(GL::BufferCreateInfo{{}, data.size(), {}}, data.data(), &_dispatchBuffer);
+}
+void DepthPyramid::build(GL::ImageHandle depth, glm::uvec2 frameSize, uint64_t frameIndex) {
+    if (frameSize != _frameSize) create(frameSize);
+    _technique->bind();
+    glActiveTexture(GL_TEXTURE0);
+    for (uint32_t first = 0, i = 0; first < _levelCount; first += LEVELS_PER_DISPATCH, ++i) {
+        // the source level was written by the previous dispatch
+        if (first) glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glBindTexture(GL_TEXTURE_2D, first ? _image : depth);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, _dispatchBuffer, _dispatchStride * i, sizeof(DispatchParams));
+        auto count = (std::min)(LEVELS_PER_DISPATCH, _levelCount - first);
+        for (uint32_t j = 0; j < count; ++j)
+            glBindImageTexture(j, _image, first + j, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        auto size = getLevelSize(first);
+        glDispatchCompute((size.x + 15) / 16, (size.y + 15) / 16, 1);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    // later passes sample it, readbacks copy it
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    _frameIndex = frameIndex;
+}
+bool DepthPyramid::requestReadback(uint32_t level) {
+    if (!_image) return false;
+    auto it = std::find_if(_readbacks.begin(), _readbacks.end(), [](auto &&e) { return !e.fence; });
+    if (it == _readbacks.end()) return false;
+    level = (std::min)(level, _levelCount - 1);
+    auto size = getLevelSize(level);
+    auto bytes = size_t(size.x) * size.y * sizeof(glm::vec2);
+
+    if (!it->buffer) glGenBuffers(1, &it->buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, it->buffer);
+    if (it->capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        it->capacity = bytes;
+    }
+    glBindTexture(GL_TEXTURE_2D, _image);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RG, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    it->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    it->sequence = ++_readbackSequence;
+    it->frameIndex = _frameIndex;
+    it->level = level;
+    it->size = size;
+    return true;
+}
+bool DepthPyramid::pollReadback(DepthPyramidReadback &out) {
+    Readback *oldest{};
+    for (auto &&e : _readbacks)
+        if (e.fence && (!oldest || e.sequence < oldest->sequence)) oldest = &e;
+    // fences signal in order, a newer one is not done before the oldest
+    if (!oldest) return false;
+    // the flush makes sure the fence signals even if nothing else is submitted
+    if (glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(oldest->fence);
+    oldest->fence = nullptr;
+
+    out.frameIndex = oldest->frameIndex;
+    out.level = oldest->level;
+    out.size = oldest->size;
+    out.texels.resize(size_t(out.size.x) * out.size.y);
+    auto bytes = out.texels.size() * sizeof(glm::vec2);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->buffer);
+    if (auto p = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT)) {
+        memcpy(out.texels.data(), p, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+DepthPyramidReadback DepthPyramid::readLevel(uint32_t level) const {
+    if (!_image) return {};
+    level = (std::min)(level, _levelCount - 1);
+    DepthPyramidReadback ret{_frameIndex, level, getLevelSize(level), {}};
+    ret.texels.resize(size_t(ret.size.x) * ret.size.y);
+    glBindTexture(GL_TEXTURE_2D, _image);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RG, GL_FLOAT, ret.texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return ret;
+}
+std::vector<DepthPyramidReadback> DepthPyramid::buildReference(std::span<float const> depth, glm::uvec2 frameSize) {
+    auto size = levelZeroSize(frameSize);
+    auto count = levelCount(size);
+    std::vector<DepthPyramidReadback> ret(count);
+    for (uint32_t level = 0; level < count; ++level) {
+        auto &&e = ret[level];
+        e.level = level;
+        e.size = glm::max(size >> level, glm::uvec2(1));
+        e.texels.resize(size_t(e.size.x) * e.size.y);
+        // source texel, clamped to the edge
+        auto srcSize = level ? ret[level - 1].size : frameSize;
+        auto load = [&](uint32_t x, uint32_t y) {
+            x = (std::min)(x, srcSize.x - 1);
+            y = (std::min)(y, srcSize.y - 1);
+            if (level) return ret[level - 1].at(x, y);
+            auto d = depth[size_t(y) * frameSize.x + x];
+            return glm::vec2(d, d);
+        };
+        for (uint32_t y = 0; y < e.size.y; ++y) {
+            for (uint32_t x = 0; x < e.size.x; ++x) {
+                glm::vec2 v{1, 0};
+                for (uint32_t i = 0; i < 4; ++i) {
+                    auto s = load(x * 2 + (i & 1), y * 2 + (i >> 1));
+                    v = {(std::min)(v.x, s.x), (std::max)(v.y, s.y)};
+                }
+                e.texels[size_t(y) * e.size.x + x] = v;
+            }
+        }
+    }
+    return ret;
+}
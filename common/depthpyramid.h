@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "noncopyable.h"
+#include "prerequisites.h"
+
+struct TechniqueDepthPyramid;
+
+/**
+ * @brief one level of the pyramid on the cpu
+ */
+struct DepthPyramidReadback {
+    uint64_t frameIndex;  // frame the pyramid was built in
+    uint32_t level;
+    glm::uvec2 size;
+    // min and max depth, rows from the bottom of the frame like gl
+    std::vector<glm::vec2> texels;
+
+    glm::vec2 at(uint32_t x, uint32_t y) const { return texels[size_t(y) * size.x + x]; }
+
+    /**
+     * @brief min and max depth over the frame pixels [pixelMin, pixelMax], conservative: every depth buffer value
+     * of the rectangle lies in the range
+     */
+    glm::vec2 getDepthRange(glm::uvec2 pixelMin, glm::uvec2 pixelMax) const;
+
+    /**
+     * @brief cpu occlusion query, true if something whose nearest depth is nearestDepth and that covers the
+     * rectangle is behind every depth drawn there
+     */
+    bool isOccluded(glm::uvec2 pixelMin, glm::uvec2 pixelMax, float nearestDepth) const {
+        return nearestDepth > getDepthRange(pixelMin, pixelMax).y;
+    }
+};
+
+/**
+ * @brief hierarchical min and max depth of a frame, built from the depth buffer with a compute shader
+ * (depthpyramid.comp). rg32f mip chain, r min and g max of the depth buffer values. level 0 has half the frame
+ * resolution rounded up to a power of two so every level halves exactly: texel (x, y) of level i covers the frame
+ * pixels [x, x + 1) * 2^(i + 1), texels past the frame repeat its edge.
+ * later passes sample getImage() (nearest, clamp to edge), the cpu reads coarse levels back without stalling through
+ * requestReadback and pollReadback
+ */
+class DepthPyramid : public NonCopyable {
+public:
+    // levels reduced in shared memory per dispatch
+    static constexpr uint32_t LEVELS_PER_DISPATCH = 5;
+    // readbacks in flight
+    static constexpr uint32_t READBACK_SLOTS = 3;
+
+private:
+    struct Readback {
+        GL::BufferHandle buffer;
+        size_t capacity;
+        GLsync fence;  // null when the slot is free
+        uint64_t sequence;
+        uint64_t frameIndex;
+        uint32_t level;
+        glm::uvec2 size;
+    };
+
+    std::unique_ptr<TechniqueDepthPyramid> _technique;
+    GL::ImageHandle _image{};
+    // parameters of every dispatch, bound as ranges
+    GL::BufferHandle _dispatchBuffer{};
+    size_t _dispatchStride{};
+    glm::uvec2 _frameSize{};
+    glm::uvec2 _size{};
+    uint32_t _levelCount{};
+    uint64_t _frameIndex{};
+
+    std::array<Readback, READBACK_SLOTS> _readbacks{};
+    uint64_t _readbackSequence{};
+
+    void create(glm::uvec2 frameSize);
+    void destroy();
+
+public:
+    DepthPyramid();
+    ~DepthPyramid();
+
+    /**
+     * @brief rebuild from a depth texture of frameSize, storage is recreated when the size changes. main thread
+     */
+    void build(GL::ImageHandle depth, glm::uvec2 frameSize, uint64_t frameIndex);
+
+    GL::ImageHandle getImage() const { return _image; }
+    uint32_t getLevelCount() const { return _levelCount; }
+    glm::uvec2 getLevelSize(uint32_t level) const { return glm::max(_size >> level, glm::uvec2(1)); }
+    glm::uvec2 getFrameSize() const { return _frameSize; }
+    uint64_t getFrameIndex() const { return _frameIndex; }
+
+    /**
+     * @brief copy a level of the last build into a pixel buffer, the copy runs on the gpu and nothing waits.
+     * level is clamped to the coarsest one. false if every slot is in flight
+     */
+    bool requestReadback(uint32_t level);
+    /**
+     * @brief oldest requested level if the gpu is done with it, does not wait
+     */
+    bool pollReadback(DepthPyramidReadback &out);
+    /**
+     * @brief level of the last build, waits for the gpu
+     */
+    DepthPyramidReadback readLevel(uint32_t level) const;
+
+    /**
+     * @brief the same pyramid built on the cpu from depth buffer values (rows from the bottom), the reference the
+     * gpu result is checked against
+     */
+    static std::vector<DepthPyramidReadback> buildReference(std::span<float const> depth, glm::uvec2 frameSize);
+};
@@ -188,6 +188,9 @@ void EnableDebugOutput(const void *userParam) {
         if (GLEW_VERSION_4_3) {
             glDebugMessageCallback(GL::DebugOutputCallback, userParam);
             glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+            // gpu profiler scopes push a debug group each, every frame
+            glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, NULL, GL_FALSE);
+            glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, NULL, GL_FALSE);
         } else {
 #ifdef GL_ARB_debug_output
             glDebugMessageCallbackARB(GL::DebugOutputCallback, userParam);
@@ -227,7 +230,9 @@ void createShader(const ShaderCreateInfo &createInfo, ShaderHandle *pShader) {
     }
     *pShader = glCreateShader(shaderType);
     if (*pShader) {
-        glShaderSource(*pShader, 1, &createInfo.code, NULL);
+        // code is not required to be null terminated (e.g. a mapped file)
+        auto length = static_cast<GLint>(createInfo.size);
+        glShaderSource(*pShader, 1, &createInfo.code, &length);
         glCompileShader(*pShader);
         glReleaseShaderCompiler();
 #ifndef NDEBUG
@@ -415,6 +420,24 @@ void createComputePipeline(ComputePipelineCreateInfo const &createInfo, Pipeline
     glUseProgramStages(pPipeline->pipeline, stages, pPipeline->programs.back());
     glBindProgramPipeline(0);
 }
+void createGraphicsPipeline(ProgramHandle program, ShaderStageFlags stages,
+                            VertexInputStateCreateInfo const &vertexInputState, PipelineHandle *pPipeline) {
+    if (!GLEW_VERSION_4_1) throw std::runtime_error("failed to create pipelines");
+    glGenProgramPipelines(1, &pPipeline->pipeline);
+    glBindProgramPipeline(pPipeline->pipeline);
+    pPipeline->programs.emplace_back(program);
+    glUseProgramStages(pPipeline->pipeline, Map(ShaderStageFlagBits(stages)), program);
+    createVertexArray(vertexInputState, &pPipeline->vao);
+    glBindProgramPipeline(0);
+}
+void createComputePipeline(ProgramHandle program, PipelineHandle *pPipeline) {
+    if (!GLEW_VERSION_4_1) throw std::runtime_error("failed to create compute pipelines");
+    glGenProgramPipelines(1, &pPipeline->pipeline);
+    glBindProgramPipeline(pPipeline->pipeline);
+    pPipeline->programs.emplace_back(program);
+    glUseProgramStages(pPipeline->pipeline, GL_COMPUTE_SHADER_BIT, program);
+    glBindProgramPipeline(0);
+}
 void createBuffer(const BufferCreateInfo &createInfo, const void *pData, BufferHandle *pBuffer) {
     glGenBuffers(1, pBuffer);
     // target do not matter when creating buffer
@@ -723,7 +746,29 @@ ImageTiling findSupportedTilingType(const std::vector<ImageTiling> &candidateTil
     }
     throw std::runtime_error("failed to find supported tiling type");
 }
+static DrawStats drawStats{};
+
+static uint64_t countTriangles(PrimitiveTopology topology, uint32_t vertexCount) {
+    switch (topology) {
+        case PrimitiveTopology::TRIANGLE_LIST:
+            return vertexCount / 3;
+        case PrimitiveTopology::TRIANGLE_STRIP:
+        case PrimitiveTopology::TRIANGLE_FAN:
+            return vertexCount > 2 ? vertexCount - 2 : 0;
+        case PrimitiveTopology::TRIANGLE_LIST_WITH_ADJACENCY:
+            return vertexCount / 6;
+        case PrimitiveTopology::TRIANGLE_STRIP_WITH_ADJACENCY:
+            return vertexCount > 4 ? (vertexCount - 4) / 2 : 0;
+        default:
+            return 0;
+    }
+}
+DrawStats const &getDrawStats() { return drawStats; }
+void resetDrawStats() { drawStats = {}; }
+
 void Draw(PrimitiveTopology topology, DrawIndirectCommand const &indirectCmd) {
+    ++drawStats.drawCalls;
+    drawStats.triangles += countTriangles(topology, indirectCmd.vertexCount) * indirectCmd.instanceCount;
     // glDrawArrays(Map(topology), indirectCmd.firstVertex, indirectCmd.vertexCount);
     // glDrawArraysInstanced(
     //	Map(topology),
@@ -739,6 +784,9 @@ void DrawIndexed(PrimitiveTopology topology, DataType indexType, DrawIndexedIndi
     //	indexedIndirectCmd.indexCount,
     //	Map(indexType),
     //);
+    ++drawStats.drawCalls;
+    drawStats.triangles +=
+        countTriangles(topology, indexedIndirectCmd.indexCount) * indexedIndirectCmd.instanceCount;
     auto offset = indexedIndirectCmd.firstIndex * getDataTypeSize(indexType);
     // glDrawElementsInstanced(
     //	Map(topology),
@@ -418,6 +418,13 @@ void createProgram2(std::vector<PipelineShaderStageCreateInfo> const &stageCreat
 void createGraphicsPipeline(const GraphicsPipelineCreateInfo &createInfo, PipelineHandle *pPipeline);
 
 void createComputePipeline(ComputePipelineCreateInfo const &createInfo, PipelineHandle *pPipeline);
+
+/**
+ * @brief wrap an already linked separable program, the pipeline takes ownership of it
+ */
+void createGraphicsPipeline(ProgramHandle program, ShaderStageFlags stages,
+                            VertexInputStateCreateInfo const &vertexInputState, PipelineHandle *pPipeline);
+void createComputePipeline(ProgramHandle program, PipelineHandle *pPipeline);
 // void createGraphicsPipeline2(const GraphicsPipelineCreateInfo &createInfo, PipelineHandle *pPipeline,
 // std::vector<ProgramHandle> *pPrograms);
 
@@ -461,6 +468,16 @@ ImageTiling findSupportedTilingType(const std::vector<ImageTiling> &candidateTil
 void Draw(PrimitiveTopology topology, DrawIndirectCommand const &indirectCmd);
 void DrawIndexed(PrimitiveTopology topology, DataType indexType, DrawIndexedIndirectCommand const &indexedIndirectCmd);
 
+/**
+ * @brief counted by Draw and DrawIndexed, raw gl draw calls (fullscreen passes, gui) are not included
+ */
+struct DrawStats {
+    uint64_t drawCalls;
+    uint64_t triangles;  // triangle topologies only, instances included
+};
+DrawStats const &getDrawStats();
+void resetDrawStats();
+
 void Clear(ImageAspectFlagBits imageAspect);
 
 void createDescriptorSetLayout(const DescriptorSetLayoutCreateInfo &createInfo, DescriptorSetLayout &outSetLayout);
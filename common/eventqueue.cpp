@@ -0,0 +1,48 @@
+#include "eventqueue.h"
+
+#include <algorithm>
+#include <bit>
+
+EventQueue::EventQueue(uint32_t capacity)
+    : _cells(std::make_unique<Cell[]>(std::bit_ceil((std::max)(capacity, 2u)))),
+      _mask(std::bit_ceil((std::max)(capacity, 2u)) - 1),
+      _consumerThread(std::this_thread::get_id()) {
+    for (uint64_t i = 0; i <= _mask; ++i) _cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+bool EventQueue::tryPost(Event &&event) {
+    auto pos = _enqueuePos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &_cells[pos & _mask];
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(sequence - pos);
+        if (diff == 0) {
+            if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // the consumer has not freed the cell of the previous round yet
+            return false;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->event = std::move(event);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+uint32_t EventQueue::dispatch() {
+    _consumerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    auto end = _enqueuePos.load(std::memory_order_acquire);
+    uint32_t count = 0;
+    // a claimed cell may not be filled yet, its producer is between the claim and the publish, stop there and keep
+    // the order
+    while (_dequeuePos < end) {
+        auto &&cell = _cells[_dequeuePos & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != _dequeuePos + 1) break;
+        auto event = std::move(cell.event);
+        cell.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+        ++_dequeuePos;
+        event();
+        ++count;
+    }
+    return count;
+}
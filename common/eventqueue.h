@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "singleton.h"
+#include "smallfunction.h"
+
+/**
+ * @brief bounded lock-free multi producer single consumer queue of events (small callables).
+ * any thread posts, the consumer thread runs them in post order with dispatch(). an event is stored inline in its
+ * cell, memory is fixed at construction. a producer finding the queue full waits for the consumer, the consumer
+ * itself dispatches the queued events first, so posting never drops an event
+ */
+class EventQueue {
+public:
+    static constexpr size_t EVENT_SIZE = 64;
+    using Event = SmallFunction<void(), EVENT_SIZE>;
+
+private:
+    // Vyukov's bounded queue: a cell is free for position p when sequence == p, holds the event of p when
+    // sequence == p + 1
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        Event event;
+    };
+    std::unique_ptr<Cell[]> _cells;
+    uint64_t _mask;
+    alignas(64) std::atomic<uint64_t> _enqueuePos{0};
+    // consumer only
+    alignas(64) uint64_t _dequeuePos{0};
+    std::atomic<std::thread::id> _consumerThread;
+
+    bool tryPost(Event &&event);
+
+public:
+    /**
+     * @brief capacity is rounded up to a power of two, the calling thread is the consumer until dispatch() is called
+     * from another one
+     */
+    explicit EventQueue(uint32_t capacity = 4096);
+    EventQueue(EventQueue const &) = delete;
+    EventQueue &operator=(EventQueue const &) = delete;
+
+    template <typename F>
+    void post(F &&f) {
+        static_assert(Event::storedInline<std::decay_t<F>>, "event captures too much to be stored inline");
+        Event event(std::forward<F>(f));
+        while (!tryPost(std::move(event))) {
+            if (std::this_thread::get_id() == _consumerThread.load(std::memory_order_relaxed))
+                dispatch();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief run the events posted before the call on the consumer thread, returns how many ran.
+     * events posted by the handlers run in the next dispatch
+     */
+    uint32_t dispatch();
+
+    uint32_t getCapacity() const { return static_cast<uint32_t>(_mask + 1); }
+};
+
+/**
+ * @brief events for the main (gl) thread, AppBase dispatches them once per frame right after polling the window
+ * events
+ */
+class MainEventQueue : public EventQueue, public Singleton<MainEventQueue> {};
@@ -0,0 +1,134 @@
+#include "fileview.h"
+
+#include <utility>
+
+#include "prerequisites.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileView::FileView(std::string_view path) {
+    if (!open(path)) THROW("failed to open file", path);
+}
+FileView::~FileView() { close(); }
+FileView::FileView(FileView &&other) noexcept { *this = std::move(other); }
+FileView &FileView::operator=(FileView &&other) noexcept {
+    if (this == &other) return *this;
+    close();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _opened = std::exchange(other._opened, false);
+#ifdef _WIN32
+    _file = std::exchange(other._file, nullptr);
+    _mapping = std::exchange(other._mapping, nullptr);
+#else
+    _fd = std::exchange(other._fd, -1);
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+bool FileView::open(std::string_view path) {
+    close();
+    std::string p(path);
+    HANDLE file = CreateFileA(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    _file = file;
+    _size = static_cast<size_t>(size.QuadPart);
+    _opened = true;
+    // empty files cannot be mapped
+    if (_size == 0) {
+        _data = "";
+        return true;
+    }
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping) _data = static_cast<const char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!_data) {
+        close();
+        return false;
+    }
+    return true;
+}
+void FileView::close() {
+    if (_mapping) {
+        if (_data) UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+    }
+    if (_file) CloseHandle(_file);
+    _file = _mapping = nullptr;
+    _data = nullptr;
+    _size = 0;
+    _opened = false;
+}
+#else
+bool FileView::open(std::string_view path) {
+    close();
+    std::string p(path);
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    _fd = fd;
+    _size = static_cast<size_t>(st.st_size);
+    _opened = true;
+    // empty files cannot be mapped
+    if (_size == 0) {
+        _data = "";
+        return true;
+    }
+    void *addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    madvise(addr, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char *>(addr);
+    return true;
+}
+void FileView::close() {
+    if (_data && _size) munmap(const_cast<char *>(_data), _size);
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+    _opened = false;
+}
+#endif
+
+//===============================
+FileViewStreamBuf::pos_type FileViewStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                       std::ios_base::openmode which) {
+    // read only, there is no put area to move
+    if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+    char *base;
+    if (dir == std::ios_base::beg)
+        base = eback();
+    else if (dir == std::ios_base::cur)
+        base = gptr();
+    else
+        base = egptr();
+    auto p = base + off;
+    if (p < eback() || p > egptr()) return pos_type(off_type(-1));
+    setg(eback(), p, egptr());
+    return pos_type(p - eback());
+}
+FileViewStreamBuf::pos_type FileViewStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief read only view of a whole file, backed by a memory mapping (mmap on posix, file mapping on windows)
+ * the bytes are paged in by the os on demand and never copied into a heap buffer
+ */
+class FileView {
+    const char *_data{};
+    size_t _size{};
+    bool _opened{false};
+
+#ifdef _WIN32
+    void *_file{};
+    void *_mapping{};
+#else
+    int _fd{-1};
+#endif
+
+    void close();
+
+public:
+    FileView() = default;
+
+    /**
+     * @brief map the file, throw if the file cannot be opened
+     *
+     * @param path
+     */
+    explicit FileView(std::string_view path);
+    ~FileView();
+
+    FileView(FileView const &) = delete;
+    FileView &operator=(FileView const &) = delete;
+    FileView(FileView &&other) noexcept;
+    FileView &operator=(FileView &&other) noexcept;
+
+    /**
+     * @brief map the file
+     *
+     * @param path
+     * @return false if the file cannot be opened or mapped
+     */
+    bool open(std::string_view path);
+
+    constexpr bool isOpen() const { return _opened; }
+    constexpr const char *data() const { return _data; }
+    constexpr size_t size() const { return _size; }
+    constexpr std::string_view view() const { return {_data, _size}; }
+};
+
+/**
+ * @brief streambuf reading directly from a mapped file, used by parsers taking std::istream (tinyobjloader)
+ */
+class FileViewStreamBuf : public std::streambuf {
+public:
+    FileViewStreamBuf(const char *data, size_t size) {
+        auto p = const_cast<char *>(data);
+        setg(p, p, p + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
+
+class FileViewStream : public std::istream {
+    FileViewStreamBuf _buf;
+
+public:
+    explicit FileViewStream(FileView const &file) : std::istream(nullptr), _buf(file.data(), file.size()) {
+        rdbuf(&_buf);
+    }
+};
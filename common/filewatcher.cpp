@@ -0,0 +1,158 @@
+#include "filewatcher.h"
+
+#include <algorithm>
+
+#include "prerequisites.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+std::string FileWatcher::normalize(std::string_view path) {
+    std::error_code ec;
+    auto p = std::filesystem::absolute(std::filesystem::path(path), ec);
+    if (ec) p = std::filesystem::path(path);
+    return p.lexically_normal().generic_string();
+}
+
+#ifdef __linux__
+FileWatcher::FileWatcher() {
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0) LOG("inotify_init1 failed, file watching disabled, errno", errno);
+}
+FileWatcher::~FileWatcher() {
+    if (_fd >= 0) close(_fd);
+}
+void FileWatcher::watch(std::string_view path) {
+    auto file = normalize(path);
+    if (_files.contains(file)) return;
+    _files.emplace(file, WatchedFile{});
+    if (_fd < 0) return;
+
+    auto dir = std::filesystem::path(file).parent_path().generic_string();
+    if (std::find_if(_dirs.begin(), _dirs.end(), [&](auto &&e) { return e.second == dir; }) != _dirs.end()) return;
+    int wd = inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+        LOG("failed to watch directory", dir, "errno", errno);
+        return;
+    }
+    _dirs.emplace(wd, dir);
+}
+void FileWatcher::unwatch(std::string_view path) {
+    auto file = normalize(path);
+    if (!_files.erase(file)) return;
+    _pending.erase(file);
+
+    // the directory watch goes with the last file in it
+    auto dir = std::filesystem::path(file).parent_path().generic_string();
+    for (auto &&e : _files)
+        if (std::filesystem::path(e.first).parent_path().generic_string() == dir) return;
+    auto it = std::find_if(_dirs.begin(), _dirs.end(), [&](auto &&e) { return e.second == dir; });
+    if (it == _dirs.end()) return;
+    inotify_rm_watch(_fd, it->first);
+    _dirs.erase(it);
+}
+void FileWatcher::readEvents() {
+    if (_fd < 0) return;
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        auto len = read(_fd, buffer, sizeof(buffer));
+        if (len <= 0) break;
+        for (char *p = buffer; p < buffer + len;) {
+            auto event = reinterpret_cast<inotify_event *>(p);
+            p += sizeof(inotify_event) + event->len;
+            auto it = _dirs.find(event->wd);
+            if (it == _dirs.end() || event->len == 0) continue;
+            auto file = it->second + "/" + event->name;
+            if (_files.contains(file)) _pending[file] = Clock::now();
+        }
+    }
+}
+#else
+FileWatcher::FileWatcher() {}
+FileWatcher::~FileWatcher() {}
+void FileWatcher::watch(std::string_view path) {
+    auto file = normalize(path);
+    if (_files.contains(file)) return;
+    std::error_code ec;
+    _files.emplace(file, WatchedFile{std::filesystem::last_write_time(file, ec)});
+}
+void FileWatcher::unwatch(std::string_view path) {
+    auto file = normalize(path);
+    _files.erase(file);
+    _pending.erase(file);
+}
+void FileWatcher::pollFiles() {
+    auto now = Clock::now();
+    if (now - _lastPoll < pollInterval) return;
+    _lastPoll = now;
+    for (auto &&[path, file] : _files) {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(path, ec);
+        if (ec || time == file.lastWriteTime) continue;
+        file.lastWriteTime = time;
+        _pending[path] = now;
+    }
+}
+#endif
+std::vector<std::string> FileWatcher::poll() {
+#ifdef __linux__
+    readEvents();
+#else
+    pollFiles();
+#endif
+    std::vector<std::string> ret;
+    auto now = Clock::now();
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        if (now - it->second >= settleTime) {
+            ret.emplace_back(it->first);
+            it = _pending.erase(it);
+        } else
+            ++it;
+    }
+    return ret;
+}
+
+//===============================
+uint64_t AssetReloader::watch(std::string_view path, std::function<void()> onChanged) {
+    auto file = FileWatcher::normalize(path);
+    _watcher.watch(file);
+    auto id = _nextId++;
+    _callbacks[file].emplace_back(Callback{id, std::move(onChanged)});
+    return id;
+}
+void AssetReloader::unwatch(uint64_t id) {
+    for (auto file = _callbacks.begin(); file != _callbacks.end(); ++file) {
+        auto &&callbacks = file->second;
+        auto it = std::find_if(callbacks.begin(), callbacks.end(), [id](auto &&e) { return e.id == id; });
+        if (it != callbacks.end()) {
+            callbacks.erase(it);
+            if (callbacks.empty()) {
+                _watcher.unwatch(file->first);
+                _callbacks.erase(file);
+            }
+            return;
+        }
+    }
+}
+void AssetReloader::update() {
+    if (!enabled) return;
+    for (auto &&path : _watcher.poll()) {
+        auto it = _callbacks.find(path);
+        if (it == _callbacks.end()) continue;
+        LOG("reload", path);
+        // a callback may register or remove watches, one removed by an earlier callback of the batch is skipped
+        auto callbacks = it->second;
+        for (auto &&e : callbacks) {
+            auto current = _callbacks.find(path);
+            if (current == _callbacks.end()) break;
+            if (std::none_of(current->second.begin(), current->second.end(), [&](auto &&c) { return c.id == e.id; }))
+                continue;
+            e.func();
+        }
+        ++_reloadCount;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "singleton.h"
+
+/**
+ * @brief reports files modified on disk, inotify on linux (directories are watched so that editors replacing the
+ * file by a rename are seen), modification time polling elsewhere
+ */
+class FileWatcher {
+    using Clock = std::chrono::steady_clock;
+
+    struct WatchedFile {
+        std::filesystem::file_time_type lastWriteTime;
+    };
+    std::unordered_map<std::string, WatchedFile> _files;
+
+    // path -> time of last event, reported once no new event came for settleTime
+    std::unordered_map<std::string, Clock::time_point> _pending;
+
+#ifdef __linux__
+    int _fd{-1};
+    // watch descriptor -> directory
+    std::unordered_map<int, std::string> _dirs;
+    void readEvents();
+#else
+    Clock::time_point _lastPoll{};
+    void pollFiles();
+#endif
+
+public:
+    // editors often write a file in several steps, wait for this quiet period before reporting it
+    std::chrono::milliseconds settleTime{50};
+#ifndef __linux__
+    std::chrono::milliseconds pollInterval{250};
+#endif
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(FileWatcher const &) = delete;
+    FileWatcher &operator=(FileWatcher const &) = delete;
+
+    /**
+     * @brief paths are normalized, watching the same file twice is a no-op
+     */
+    void watch(std::string_view path);
+
+    /**
+     * @brief stop reporting path, a change already pending is dropped
+     */
+    void unwatch(std::string_view path);
+
+    /**
+     * @brief non blocking, files changed since last call
+     */
+    std::vector<std::string> poll();
+
+    static std::string normalize(std::string_view path);
+};
+
+/**
+ * @brief maps watched asset files to rebuild callbacks, callbacks run on the gl thread from update(), called once
+ * per frame by AppBase::mainLoop outside of any rendering
+ */
+class AssetReloader : public Singleton<AssetReloader> {
+    FileWatcher _watcher;
+
+    struct Callback {
+        uint64_t id;
+        std::function<void()> func;
+    };
+    std::unordered_map<std::string, std::vector<Callback>> _callbacks;
+    uint64_t _nextId{1};
+    uint64_t _reloadCount{};
+
+public:
+    bool enabled{true};
+
+    /**
+     * @brief call onChanged after path changes on disk
+     *
+     * @return id used to remove the callback
+     */
+    uint64_t watch(std::string_view path, std::function<void()> onChanged);
+    /**
+     * @brief the file stops being watched with its last callback, a removed callback never runs again, even in
+     * the update() that removed it
+     */
+    void unwatch(uint64_t id);
+
+    /**
+     * @brief dispatch callbacks of changed files, must be called where gl work is allowed
+     */
+    void update();
+
+    constexpr uint64_t getReloadCount() const { return _reloadCount; }
+};
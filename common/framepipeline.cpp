@@ -0,0 +1,25 @@
+#include "framepipeline.h"
+
+void RenderSnapshot::clear() {
+    frameIndex = 0;
+    camera = nullptr;
+    draws.clear();
+    lights.clear();
+}
+
+//===============================================================
+
+void FramePipeline::publish() {
+    _snapshots[_writeSlot].frameIndex = ++_publishedCount;
+    // a published slot the reader did not take yet comes back and is overwritten, the reader only wants the newest
+    auto previous = _ready.exchange(_writeSlot | FRESH_BIT, std::memory_order_acq_rel);
+    _writeSlot = previous & SLOT_MASK;
+}
+RenderSnapshot const *FramePipeline::acquire() {
+    if (_ready.load(std::memory_order_relaxed) & FRESH_BIT) {
+        auto previous = _ready.exchange(_readSlot, std::memory_order_acq_rel);
+        _readSlot = previous & SLOT_MASK;
+        _hasRead = true;
+    }
+    return _hasRead ? &_snapshots[_readSlot] : nullptr;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "camera.h"
+#include "light.h"
+
+class Renderer;
+class Transform;
+
+/**
+ * @brief what the render stage needs from one simulated frame. poses, the view and the light parameters are copied,
+ * so the simulation can go on with the next frame while this one is drawn. renderers, transforms and lights are only
+ * referenced for their gl objects, which the render stage alone touches
+ */
+struct RenderSnapshot {
+    struct Draw {
+        Renderer *renderer;
+        Transform *transform;
+        glm::mat4 model;
+        uint64_t poseVersion;
+    };
+    struct LightData {
+        Light *light;
+        Light::UBO ubo;
+    };
+
+    // 1 for the first published snapshot
+    uint64_t frameIndex{};
+    Camera *camera{};
+    Camera::UBO cameraData{};
+    // no culling yet, every renderer of the scene
+    std::vector<Draw> draws;
+    std::vector<LightData> lights;
+
+    // keeps the capacity
+    void clear();
+};
+
+/**
+ * @brief triple buffered snapshots between the simulation stage and the render stage.
+ * the writer fills the snapshot from beginWrite() and publishes it, the reader takes the newest published one,
+ * neither side blocks. one writer thread and one reader thread at a time
+ */
+class FramePipeline {
+    static constexpr uint32_t SLOT_MASK = 3;
+    // set while the slot in _ready was published and not read yet
+    static constexpr uint32_t FRESH_BIT = 4;
+
+    std::array<RenderSnapshot, 3> _snapshots;
+    std::atomic<uint32_t> _ready{1};
+    // writer only
+    uint32_t _writeSlot{0};
+    uint64_t _publishedCount{};
+    // reader only
+    uint32_t _readSlot{2};
+    bool _hasRead{false};
+
+public:
+    RenderSnapshot &beginWrite() { return _snapshots[_writeSlot]; }
+    void publish();
+
+    /**
+     * @brief newest published snapshot, the last one again when nothing new was published, null before the first.
+     * it stays valid until the next acquire()
+     */
+    RenderSnapshot const *acquire();
+};
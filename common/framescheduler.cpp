@@ -0,0 +1,56 @@
+#include "framescheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+FrameScheduler::Duration toDuration(double ms) {
+    return std::chrono::duration_cast<FrameScheduler::Duration>(std::chrono::duration<double, std::milli>(ms));
+}
+}  // namespace
+
+FrameScheduler::FrameScheduler() { setSettings(Settings{}); }
+FrameScheduler::FrameScheduler(Settings const &settings) { setSettings(settings); }
+void FrameScheduler::setSettings(Settings const &settings) {
+    _settings = settings;
+    _settings.tickRate_hz = std::max(_settings.tickRate_hz, 1.f);
+    _tickInterval = toDuration(1000.0 / _settings.tickRate_hz);
+    _nextFrameTime = {};
+}
+uint32_t FrameScheduler::beginFrame() {
+    auto now = Clock::now();
+    Duration frameTime{};
+    if (_settings.fixedFrameTime_ms > 0)
+        frameTime = toDuration(_settings.fixedFrameTime_ms);
+    else if (_started)
+        frameTime = now - _lastFrameStart;
+    _started = true;
+    _lastFrameStart = now;
+    return beginFrame(frameTime);
+}
+uint32_t FrameScheduler::beginFrame(Duration frameTime) {
+    _frameTime = frameTime;
+    _accumulator += frameTime;
+    uint64_t ticks = _accumulator / _tickInterval;
+    _accumulator -= _tickInterval * ticks;
+    if (ticks > _settings.maxTicksPerFrame) {
+        _droppedTicks += ticks - _settings.maxTicksPerFrame;
+        ticks = _settings.maxTicksPerFrame;
+    }
+    _ticks = static_cast<uint32_t>(ticks);
+    _tickIndex += _ticks;
+    return _ticks;
+}
+void FrameScheduler::endFrame() {
+    if (_settings.frameCap_fps <= 0) return;
+
+    auto period = toDuration(1000.0 / _settings.frameCap_fps);
+    auto now = Clock::now();
+    // deadlines follow a fixed grid so small oversleeps do not accumulate, fell too far behind: restart the grid
+    _nextFrameTime += period;
+    if (_nextFrameTime < now - period) _nextFrameTime = now;
+
+    auto sleepUntil = _nextFrameTime - _settings.spinThreshold;
+    if (sleepUntil > now) std::this_thread::sleep_until(sleepUntil);
+    while (Clock::now() < _nextFrameTime) std::this_thread::yield();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief fixed step simulation with a decoupled, optionally capped, render rate
+ *
+ * every frame the elapsed time is added to an accumulator that is consumed in whole ticks of tickInterval, the
+ * remainder gives the interpolation factor between the last two ticks. time is kept in integer nanoseconds, the
+ * same sequence of frame times always yields the same sequence of tick counts.
+ */
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::nanoseconds;
+
+    struct Settings {
+        float tickRate_hz{60};
+        // ticks beyond this are dropped instead of letting a slow frame cause even more ticks next frame
+        uint32_t maxTicksPerFrame{8};
+        // 0: uncapped
+        float frameCap_fps{0};
+        // > 0: frames advance by this time instead of the measured one
+        float fixedFrameTime_ms{0};
+        // the last part of a frame cap wait is spun, sleep is not precise enough for it
+        std::chrono::microseconds spinThreshold{1500};
+    };
+
+private:
+    Settings _settings;
+    Duration _tickInterval;
+    Duration _accumulator{};
+    Duration _frameTime{};
+    uint32_t _ticks{};
+    uint64_t _tickIndex{};
+    uint64_t _droppedTicks{};
+
+    Clock::time_point _lastFrameStart{};
+    Clock::time_point _nextFrameTime{};
+    bool _started{false};
+
+public:
+    FrameScheduler();
+    explicit FrameScheduler(Settings const &settings);
+
+    void setSettings(Settings const &settings);
+    constexpr Settings const &getSettings() const { return _settings; }
+
+    /**
+     * @brief start a frame with the measured (or fixed) frame time
+     *
+     * @return number of simulation ticks to run this frame
+     */
+    uint32_t beginFrame();
+
+    /**
+     * @brief start a frame advancing by an explicit time
+     */
+    uint32_t beginFrame(Duration frameTime);
+
+    /**
+     * @brief wait until the frame cap allows the next frame, sleeps then spins for the last spinThreshold
+     */
+    void endFrame();
+
+    float getTickInterval_ms() const { return std::chrono::duration<float, std::milli>(_tickInterval).count(); }
+    float getFrameTime_ms() const { return std::chrono::duration<float, std::milli>(_frameTime).count(); }
+
+    /**
+     * @brief position of the render between the previous and the current tick, in [0, 1)
+     */
+    float getAlpha() const { return float(_accumulator.count()) / _tickInterval.count(); }
+
+    constexpr uint32_t getTicks() const { return _ticks; }
+    constexpr uint64_t getTickIndex() const { return _tickIndex; }
+    constexpr uint64_t getDroppedTicks() const { return _droppedTicks; }
+};
@@ -2,6 +2,7 @@
 #include "prerequisites.h"
 
 class AppBase;
+struct RenderSnapshot;
 class Game {
     AppBase* _appBase{};
 
@@ -18,5 +19,18 @@ public:
 
     virtual void init() {}
 
-    virtual void render(float dt) {}
+    /**
+     * @brief fixed step simulation, called 0..n times per frame before render
+     */
+    virtual void tick(float /*dt*/) {}
+
+    /**
+     * @brief once per frame after the ticks, fill snapshot with what render draws, alpha is the interpolation
+     * factor. with AppCreateInfo::pipelined set, runs with the ticks on the simulation thread of AppBase while the
+     * previous frame renders, the main thread waits for it (AppBase::waitSimulation) after presenting: no gl calls
+     * and no changes of nodes, components or materials here or in tick
+     */
+    virtual void buildSnapshot(RenderSnapshot &/*snapshot*/, float /*alpha*/) {}
+
+    virtual void render(float /*dt*/) {}
 };
\ No newline at end of file
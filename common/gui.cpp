@@ -5,6 +5,7 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
+#include "profiler.h"
 
 GUI::GUI(Game* game) : _game(game) {
     // Setup Dear ImGui context
@@ -31,6 +32,7 @@ GUI::~GUI() {
 }
 
 void GUI::render(float dt) {
+    PROFILE_GPU_SCOPE("gui");
     Input::guiWantCaptureMouse = ImGui::GetIO().WantCaptureMouse;
 
     ImGui_ImplOpenGL3_NewFrame();
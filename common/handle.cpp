@@ -0,0 +1,35 @@
+#include "handle.h"
+
+IdType HandleAllocator::allocate() {
+    std::lock_guard lock(_mutex);
+    if (!_freeIndices.empty()) {
+        auto index = _freeIndices.back();
+        _freeIndices.pop_back();
+        return makeHandle(index, _generations[index]);
+    }
+    auto index = static_cast<uint32_t>(_generations.size());
+    _generations.emplace_back(1);
+    return makeHandle(index, 1);
+}
+void HandleAllocator::free(IdType id) {
+    auto index = getHandleIndex(id);
+    std::lock_guard lock(_mutex);
+    if (index >= _generations.size() || _generations[index] != getHandleGeneration(id)) return;
+    // generation 0 is reserved for invalid handles, an index that wrapped around skips it
+    if (++_generations[index] == 0) _generations[index] = 1;
+    _freeIndices.emplace_back(index);
+}
+bool HandleAllocator::isAlive(IdType id) const {
+    auto index = getHandleIndex(id);
+    std::lock_guard lock(_mutex);
+    return index < _generations.size() && _generations[index] == getHandleGeneration(id) &&
+           getHandleGeneration(id) != 0;
+}
+uint32_t HandleAllocator::getCapacity() const {
+    std::lock_guard lock(_mutex);
+    return static_cast<uint32_t>(_generations.size());
+}
+uint32_t HandleAllocator::getAliveCount() const {
+    std::lock_guard lock(_mutex);
+    return static_cast<uint32_t>(_generations.size() - _freeIndices.size());
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+using IdType = uint64_t;
+
+/**
+ * @brief ids are generational handles, slot index in the low 32 bits and the generation of the slot in the high
+ * 32 bits. generations start at 1, so 0 is never a valid id
+ */
+constexpr IdType INVALID_ID = 0;
+
+constexpr IdType makeHandle(uint32_t index, uint32_t generation) { return IdType(generation) << 32 | index; }
+constexpr uint32_t getHandleIndex(IdType id) { return static_cast<uint32_t>(id); }
+constexpr uint32_t getHandleGeneration(IdType id) { return static_cast<uint32_t>(id >> 32); }
+
+/**
+ * @brief hands out handles whose indices stay dense, a freed index is reused with the next generation so a stale
+ * handle never matches the new owner of its index. thread safe
+ */
+class HandleAllocator {
+    mutable std::mutex _mutex;
+    // current generation per index, bumped on free
+    std::vector<uint32_t> _generations;
+    std::vector<uint32_t> _freeIndices;
+
+public:
+    IdType allocate();
+    /**
+     * @brief invalid or stale handles are ignored
+     */
+    void free(IdType id);
+    bool isAlive(IdType id) const;
+
+    // indices handed out so far, an upper bound for the index of every live handle
+    uint32_t getCapacity() const;
+    uint32_t getAliveCount() const;
+};
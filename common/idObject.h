@@ -1,34 +1,52 @@
 #pragma once
 #include <cstdint>
 
-using IdType = uint64_t;
+#include "handle.h"
 
-// template <typename T>
+/**
+ * @brief gives every object a generational id from the allocator of T, the id is released on destruction and its
+ * index reused by a later object, so tables indexed by ids (SlotMap) stay dense.
+ * a moved object hands its id over, a copy gets its own
+ */
+template <typename T>
 class IdObject {
-    IdType _id{};
+    IdType _id;
 
-    IdType generateId() {
-        static IdType i = 0;
-        return i++;
+    void freeId() {
+        if (_id != INVALID_ID) getHandleAllocator().free(_id);
+        _id = INVALID_ID;
     }
 
 public:
-    IdObject() { _id = generateId(); }
+    /**
+     * @brief never destroyed, objects owned by singletons still release their ids during static destruction
+     */
+    static HandleAllocator &getHandleAllocator() {
+        static auto allocator = new HandleAllocator;
+        return *allocator;
+    }
+
+    IdObject() : _id(getHandleAllocator().allocate()) {}
     // move
-    IdObject(IdObject &&other) { _id = other._id; }
+    IdObject(IdObject &&other) noexcept : _id(other._id) { other._id = INVALID_ID; }
     // copy
-    IdObject(IdObject const &other) { _id = generateId(); }
+    IdObject(IdObject const &other) : _id(getHandleAllocator().allocate()) {}
+    ~IdObject() { freeId(); }
 
     // move
-    IdObject &operator=(IdObject &&other) {
-        _id = other._id;
+    IdObject &operator=(IdObject &&other) noexcept {
+        if (this != &other) {
+            freeId();
+            _id = other._id;
+            other._id = INVALID_ID;
+        }
         return *this;
     }
-    // copy
+    // copy, the object keeps its id
     IdObject &operator=(IdObject const &other) {
-        _id = generateId();
+        if (_id == INVALID_ID) _id = getHandleAllocator().allocate();
         return *this;
     }
 
     constexpr IdType getId() const { return _id; }
-};
\ No newline at end of file
+};
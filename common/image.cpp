@@ -1,37 +1,52 @@
 #include "image.h"
 
+#include <climits>
+
+#include "fileview.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
 #include "stb_image_write.h"
 
 bool saveImage(std::string_view path, std::string_view imageType, int width, int height, int componentNum, void *data) {
+    std::string file(path);
     if (imageType == "PNG")
-        stbi_write_png(path.data(), width, height, componentNum, data, componentNum);
+        return stbi_write_png(file.c_str(), width, height, componentNum, data, width * componentNum);
     else if (imageType == "BMP")
-        stbi_write_bmp(path.data(), width, height, componentNum, data);
+        return stbi_write_bmp(file.c_str(), width, height, componentNum, data);
     else if (imageType == "TGA")
-        stbi_write_tga(path.data(), width, height, componentNum, data);
+        return stbi_write_tga(file.c_str(), width, height, componentNum, data);
     else if (imageType == "JPG")
-        stbi_write_jpg(path.data(), width, height, componentNum, data, 90);
+        return stbi_write_jpg(file.c_str(), width, height, componentNum, data, 90);
     else if (imageType == "HDR")
-        stbi_write_hdr(path.data(), width, height, componentNum, (float *)data);
+        return stbi_write_hdr(file.c_str(), width, height, componentNum, (float *)data);
     else
         throw std::runtime_error("failed to save image");
 }
 
 bool ImageLoaderSTB::load(Image *pImage) {
-    auto path = pImage->_path;
-
-    int componentNum;
+    // decode straight from the mapped file, stb never sees a stdio stream or an intermediate copy
+    FileView file;
+    if (!file.open(pImage->_path)) return false;
+    // stb takes the length as an int
+    if (file.size() > INT_MAX) {
+        LOG("image file too large", pImage->_path, file.size(), "bytes");
+        return false;
+    }
+    auto bytes = reinterpret_cast<stbi_uc const *>(file.data());
+    auto len = static_cast<int>(file.size());
 
-    stbi_set_flip_vertically_on_load(true);
-    if (stbi_is_hdr(pImage->_path.c_str())) {
-        pImage->_data = stbi_loadf(pImage->_path.c_str(), &pImage->_width, &pImage->_height, &pImage->_componentNum, 4);
+    // images are decoded on job threads, the global flag would be a data race
+    stbi_set_flip_vertically_on_load_thread(true);
+    if (stbi_is_hdr_from_memory(bytes, len)) {
+        pImage->_data =
+            stbi_loadf_from_memory(bytes, len, &pImage->_width, &pImage->_height, &pImage->_componentNum, 4);
         pImage->_format = GL_RGBA32F;
         pImage->_dataType = GL::DATA_TYPE_FLOAT;
     } else {
-        pImage->_data = stbi_load(pImage->_path.c_str(), &pImage->_width, &pImage->_height, &pImage->_componentNum, 4);
+        pImage->_data =
+            stbi_load_from_memory(bytes, len, &pImage->_width, &pImage->_height, &pImage->_componentNum, 4);
         pImage->_dataType = GL::DATA_TYPE_UNSIGNED_BYTE;
         if (pImage->_isSRGB)
             pImage->_format = GL_SRGB8_ALPHA8;
@@ -39,18 +54,32 @@ bool ImageLoaderSTB::load(Image *pImage) {
             pImage->_format = GL_RGBA8;
     }
     pImage->_baseFormat = GL_RGBA;
+    pImage->_dataSize = size_t(pImage->_width) * pImage->_height * 4 * GL::getDataTypeSize(pImage->_dataType);
     if (pImage->_data) return true;
     return false;
 }
-void ImageLoaderSTB::unload(Image *pImage) { stbi_image_free(pImage->_data); }
+void ImageLoaderSTB::unload(Image *pImage) {
+    stbi_image_free(pImage->_data);
+    pImage->_data = nullptr;
+}
 
 //========================
-Image::Image(std::string_view path, ImageLoader *loader) : _path(path), _loader(loader) {}
+Image::Image(std::string_view path, ImageLoader *loader) : Resource(RESOURCE_IMAGE), _path(path), _loader(loader) {}
 Image::Image(std::string_view path, uint32_t width, uint32_t height, GL::Format format, GL::Format baseFormat,
              GL::DataType dataType, size_t size, void *data)
-    : _path(path), _width(width), _height(height), _format(format), _baseFormat(baseFormat), _dataType(dataType) {
+    : Resource(RESOURCE_IMAGE),
+      _path(path),
+      _width(width),
+      _height(height),
+      _format(format),
+      _baseFormat(baseFormat),
+      _dataType(dataType) {
     _data = new char[size];
     memcpy(_data, data, size);
+    _dataSize = size;
+    _loaded = true;
+    setCpuBytes(size);
+    setState(RESOURCE_STATE_LOADED);
 }
 Image::~Image() { unload(); }
 // Image::Image(std::string_view name, ImageDescription const &desc,
@@ -58,19 +87,30 @@ Image::~Image() { unload(); }
 // {
 // }
 void Image::load() {
-    if (_loaded) return;
-    if (_loader && !_loader->load(this)) LOG("failed to load image path ", _path);
+    if (_loaded || !_loader) return;
+    setState(RESOURCE_STATE_LOADING);
+    if (_loader->load(this)) {
+        _loaded = true;
+        setCpuBytes(_dataSize);
+        setState(RESOURCE_STATE_LOADED);
+    } else {
+        setState(RESOURCE_STATE_FAILED);
+        LOG("failed to load image path ", _path);
+    }
 }
 void Image::unload() {
     if (!_loaded) return;
     _loaded = false;
+    setCpuBytes(0);
+    setState(RESOURCE_STATE_UNLOADED);
     if (_loader) {
         _loader->unload(this);
     } else {
-        delete _data;
+        delete[] static_cast<char *>(_data);
         _data = 0;
     }
 }
+size_t Image::getDataSize() const { return _loaded ? _dataSize : 0; }
 //==================================
 ImageManager::ImageManager() { registerImageLoader<ImageLoaderSTB>("default"); }
 ImageLoader *ImageManager::getImageLoader(std::string_view name) const {
@@ -78,14 +118,22 @@ ImageLoader *ImageManager::getImageLoader(std::string_view name) const {
     if (it != _imageLoaders.cend()) return it->second.get();
     return nullptr;
 }
-Image *ImageManager::create(std::string_view path, std::string_view loaderName) {
-    if (auto loader = getImageLoader(loaderName))
-        return _images.emplace(path, std::make_unique<Image>(path, loader)).first->second.get();
+ResourceHandle<Image> ImageManager::addImage(std::unique_ptr<Image> image) {
+    auto ret = _images.emplace(image->getId(), std::move(image)).first->get();
+    _imageIds.emplace(ret->_path, ret->getId());
+    return ret;
+}
+ResourceHandle<Image> ImageManager::create(std::string_view path, std::string_view loaderName) {
+    if (auto it = _imageIds.find(std::string(path)); it != _imageIds.end()) return _images.at(it->second).get();
+    if (auto loader = getImageLoader(loaderName)) return addImage(std::make_unique<Image>(path, loader));
     LOG("cannot find image loader");
     return nullptr;
 }
-Image *ImageManager::create(std::string_view path, uint32_t width, uint32_t height, GL::Format format,
-                            GL::Format baseFormat, GL::DataType dataType, size_t size, void *data) {
-    return _images.emplace(path, std::make_unique<Image>(path, width, height, format, baseFormat, dataType, size, data))
-        .first->second.get();
+ResourceHandle<Image> ImageManager::create(std::string_view path, uint32_t width, uint32_t height, GL::Format format,
+                                           GL::Format baseFormat, GL::DataType dataType, size_t size, void *data) {
+    if (auto it = _imageIds.find(std::string(path)); it != _imageIds.end()) return _images.at(it->second).get();
+    return addImage(std::make_unique<Image>(path, width, height, format, baseFormat, dataType, size, data));
+}
+size_t ImageManager::collectGarbage() {
+    return eraseUnreferenced(_images, [this](Image &image) { _imageIds.erase(image._path); });
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "idObject.h"
 #include "prerequisites.h"
+#include "resource.h"
+#include "slotmap.h"
 
 // struct ImageDescription
 // {
@@ -56,8 +58,8 @@ public:
 
 class ImageManager;
 
-class Image : public IdObject {
-    friend class ImageManger;
+class Image : public IdObject<Image>, public Resource {
+    friend class ImageManager;
 
 public:
     std::string _path;
@@ -66,6 +68,7 @@ public:
     bool _loaded{false};
 
     void *_data{};
+    size_t _dataSize{};
     int _width;
     int _height;
     int _componentNum;
@@ -93,22 +96,43 @@ public:
 
     void unload();
 
+    /**
+     * @brief images created from memory cannot be decoded again once unloaded
+     */
+    constexpr bool canReload() const { return _loader != nullptr; }
+
+    /**
+     * @brief size of decoded pixels kept on cpu, 0 if not loaded
+     */
+    size_t getDataSize() const;
+
     // ImageDescription const &getDescription() const { return _desc; }
 };
 
 class ImageManager : public Singleton<ImageManager> {
-    std::unordered_map<std::string, std::unique_ptr<Image>> _images;
+    SlotMap<std::unique_ptr<Image>> _images;
+    std::unordered_map<std::string, IdType> _imageIds;
     std::unordered_map<std::string, std::unique_ptr<ImageLoader>> _imageLoaders;
 
+    ResourceHandle<Image> addImage(std::unique_ptr<Image> image);
+
 public:
     ImageManager();
 
-    Image *create(std::string_view path, std::string_view loaderName = "default");
+    /**
+     * @brief images are shared by path, the file is decoded on the first load()
+     */
+    ResourceHandle<Image> create(std::string_view path, std::string_view loaderName = "default");
+
+    ResourceHandle<Image> create(std::string_view path, uint32_t width, uint32_t height, GL::Format format,
+                                 GL::Format baseFormat, GL::DataType dataType, size_t size, void *data);
 
-    Image *create(std::string_view path, uint32_t width, uint32_t height, GL::Format format, GL::Format baseFormat,
-                  GL::DataType dataType, size_t size, void *data);
+    Image *getImage(std::string_view name) const { return _images.at(_imageIds.at(std::string(name))).get(); }
 
-    Image *getImage(std::string_view name) const { return _images.at(std::string(name)).get(); }
+    /**
+     * @brief destroy images no texture references, see ResourceManager::collectGarbage
+     */
+    size_t collectGarbage();
 
     ImageLoader *getImageLoader(std::string_view name) const;
 
@@ -1,20 +1,30 @@
 #include "input.h"
 
-Signal<void(int, int)> Input::framebufferResizeSignal;
-Signal<void(KeyCode, KeyState)> Input::mouseButtonSignal;
-Signal<void(double, double)> Input::mouseMoveSignal;
-Signal<void(double, double)> Input::scrollSignal;
-Signal<void(KeyCode, KeyState)> Input::keyboardSignal;
+#include "inputrecorder.h"
+
+ConcurrentSignal<void(int, int)> Input::framebufferResizeSignal;
+ConcurrentSignal<void(KeyCode, KeyState)> Input::mouseButtonSignal;
+ConcurrentSignal<void(double, double)> Input::mouseMoveSignal;
+ConcurrentSignal<void(double, double)> Input::scrollSignal;
+ConcurrentSignal<void(KeyCode, KeyState)> Input::keyboardSignal;
 std::array<KeyState, INPUT_NUM> Input::inputState{};
-bool Input::guiWantCaptureMouse = false;
+std::atomic<bool> Input::guiWantCaptureMouse{false};
 int Input::framebufferWidth;
 int Input::framebufferHeight;
+std::array<InputEvent, Input::EVENT_CAPACITY> Input::_events;
+uint64_t Input::_eventHead;
+uint64_t Input::_frameEventBegin;
+InputFrame Input::_pending;
+InputFrame Input::_frame;
+bool Input::_cursorValid;
+InputRecorder *Input::recorder;
 
 namespace {
 KeyCode getGLFWKeyCode(int scancode);
 }
 
 void Input::onKeyBoard(int key, int scancode, int action, int mods) {
+    if (recorder) recorder->write(InputEventType::KEY, action, mods, key, scancode);
     auto keycode = getGLFWKeyCode(scancode);
     auto keyState = STATE_RELEASE;
 
@@ -22,9 +32,11 @@ void Input::onKeyBoard(int key, int scancode, int action, int mods) {
         switch (action) {
             case GLFW_PRESS:
                 keyState = inputState[keycode] = STATE_PRESS;
+                record({InputEventType::KEY, keycode, keyState});
                 break;
             case GLFW_RELEASE:
                 keyState = inputState[keycode] = STATE_RELEASE;
+                record({InputEventType::KEY, keycode, keyState});
                 break;
         }
     }
@@ -32,26 +44,90 @@ void Input::onKeyBoard(int key, int scancode, int action, int mods) {
     keyboardSignal(keycode, keyState);
 }
 void Input::onMouseButton(int button, int action, int mods) {
+    if (recorder) recorder->write(InputEventType::MOUSE_BUTTON, action, mods, button, 0);
     auto keycode = getGLFWKeyCode(button);
     auto keyState = STATE_RELEASE;
     if (keycode >= 0) {
         switch (action) {
             case GLFW_PRESS:
                 keyState = inputState[keycode] = STATE_PRESS;
+                record({InputEventType::MOUSE_BUTTON, keycode, keyState});
                 break;
             case GLFW_RELEASE:
                 keyState = inputState[keycode] = STATE_RELEASE;
+                record({InputEventType::MOUSE_BUTTON, keycode, keyState});
                 break;
         }
     }
     mouseButtonSignal(keycode, keyState);
 }
-void Input::onMouseMove(double xpos, double ypos) { mouseMoveSignal(xpos, ypos); }
+void Input::onMouseMove(double xpos, double ypos) {
+    if (recorder) recorder->write(InputEventType::MOUSE_MOVE, 0, 0, 0, 0, xpos, ypos);
+    record({InputEventType::MOUSE_MOVE, {}, {}, xpos, ypos});
+    mouseMoveSignal(xpos, ypos);
+}
+void Input::onScroll(double xoffset, double yoffset) {
+    if (recorder) recorder->write(InputEventType::SCROLL, 0, 0, 0, 0, xoffset, yoffset);
+    record({InputEventType::SCROLL, {}, {}, xoffset, yoffset});
+    scrollSignal(xoffset, yoffset);
+}
 void Input::onFramebufferResize(int width, int height) {
     framebufferWidth = width;
     framebufferHeight = height;
     framebufferResizeSignal(width, height);
 }
+void Input::record(InputEvent const &event) {
+    _events[_eventHead++ % EVENT_CAPACITY] = event;
+    ++_pending.eventCount;
+    switch (event.type) {
+        case InputEventType::KEY:
+        case InputEventType::MOUSE_BUTTON:
+            if (event.state == STATE_PRESS) {
+                _pending.down.set(event.key);
+                _pending.pressed.set(event.key);
+            } else {
+                _pending.down.reset(event.key);
+                _pending.released.set(event.key);
+            }
+            break;
+        case InputEventType::MOUSE_MOVE: {
+            glm::dvec2 cursor{event.x, event.y};
+            // the first position has nothing to be relative to
+            if (_cursorValid) _pending.cursorDelta += cursor - _pending.cursor;
+            _pending.cursor = cursor;
+            _cursorValid = true;
+            break;
+        }
+        case InputEventType::SCROLL:
+            _pending.scroll += glm::dvec2{event.x, event.y};
+            break;
+    }
+}
+void Input::nextFrame() {
+    _frame = _pending;
+    _frame.guiWantCaptureMouse = guiWantCaptureMouse.load(std::memory_order_relaxed);
+    _frameEventBegin = _eventHead - _pending.eventCount;
+
+    // held keys and the cursor carry over, everything else starts again
+    _pending.pressed.reset();
+    _pending.released.reset();
+    _pending.cursorDelta = {};
+    _pending.scroll = {};
+    _pending.eventCount = 0;
+}
+void Input::reset() {
+    inputState = {};
+    guiWantCaptureMouse = false;
+    _eventHead = 0;
+    _frameEventBegin = 0;
+    _pending = {};
+    _frame = {};
+    _cursorValid = false;
+}
+InputEvent const &Input::getFrameEvent(uint32_t i) {
+    auto count = (std::min)(uint64_t(_frame.eventCount), uint64_t(EVENT_CAPACITY));
+    return _events[(_frameEventBegin + _frame.eventCount - count + i) % EVENT_CAPACITY];
+}
 
 namespace {
 KeyCode getGLFWKeyCode(int scancode) {
@@ -1,4 +1,8 @@
 #pragma once
+#include <atomic>
+#include <bitset>
+
+#include "concurrentsignal.h"
 #include "prerequisites.h"
 
 enum KeyCode {
@@ -132,22 +136,93 @@ enum KeyState {
     STATE_RELEASE,
     STATE_PRESS,
 };
+enum class InputEventType : uint8_t {
+    KEY,
+    MOUSE_BUTTON,
+    MOUSE_MOVE,
+    SCROLL,
+};
+// raw window event, x y hold the cursor position or scroll offset
+struct InputEvent {
+    InputEventType type;
+    KeyCode key;
+    KeyState state;
+    double x{};
+    double y{};
+};
+
+/**
+ * @brief everything that happened to the input since the previous frame was taken, built while the events are
+ * polled so reading it costs nothing per event
+ */
+struct InputFrame {
+    std::bitset<INPUT_NUM> down;
+    std::bitset<INPUT_NUM> pressed;
+    std::bitset<INPUT_NUM> released;
+    glm::dvec2 cursor{};
+    glm::dvec2 cursorDelta{};
+    glm::dvec2 scroll{};
+    // events recorded for the frame, the ring keeps the last EVENT_CAPACITY of them
+    uint32_t eventCount{};
+    bool guiWantCaptureMouse{};
+
+    bool isDown(KeyCode key) const { return down[key]; }
+    bool wasPressed(KeyCode key) const { return pressed[key]; }
+    bool wasReleased(KeyCode key) const { return released[key]; }
+};
+
+class InputRecorder;
 struct Input {
-    static bool guiWantCaptureMouse;
+    static constexpr uint32_t EVENT_CAPACITY = 1024;
+
+    // every event passed to the callbacks below is written to it while set
+    static InputRecorder *recorder;
+
+    static std::atomic<bool> guiWantCaptureMouse;
 
     static int framebufferWidth;
     static int framebufferHeight;
 
     static std::array<KeyState, INPUT_NUM> inputState;
 
-    static Signal<void(int, int)> framebufferResizeSignal;
-    static Signal<void(KeyCode, KeyState)> mouseButtonSignal;
-    static Signal<void(double, double)> mouseMoveSignal;
-    static Signal<void(double, double)> scrollSignal;
-    static Signal<void(KeyCode, KeyState)> keyboardSignal;
+    // emitted by the window callbacks on the main thread, connected and disconnected from any thread (behaviours on
+    // the pipelined simulation thread)
+    static ConcurrentSignal<void(int, int)> framebufferResizeSignal;
+    static ConcurrentSignal<void(KeyCode, KeyState)> mouseButtonSignal;
+    static ConcurrentSignal<void(double, double)> mouseMoveSignal;
+    static ConcurrentSignal<void(double, double)> scrollSignal;
+    static ConcurrentSignal<void(KeyCode, KeyState)> keyboardSignal;
 
     static void onKeyBoard(int, int, int, int);
     static void onMouseButton(int, int, int);
     static void onMouseMove(double, double);
+    static void onScroll(double, double);
     static void onFramebufferResize(int, int);
+
+    /**
+     * @brief close the events recorded so far into the frame read by getFrame(), called by Scene::update before the
+     * behaviours. an update following another one in the same frame sees no edges or deltas, a frame without update
+     * hands its events on to the next one. must not overlap with the window callbacks
+     */
+    static void nextFrame();
+    /**
+     * @brief back to the state before the first event, a replay starts from it like a fresh process
+     */
+    static void reset();
+    static InputFrame const &getFrame() { return _frame; }
+    /**
+     * @brief raw events of the current frame in arrival order, i < min(getFrame().eventCount, EVENT_CAPACITY)
+     */
+    static InputEvent const &getFrameEvent(uint32_t i);
+
+private:
+    static void record(InputEvent const &event);
+
+    static std::array<InputEvent, EVENT_CAPACITY> _events;
+    // total number of recorded events, and the value it had when the current frame was taken
+    static uint64_t _eventHead;
+    static uint64_t _frameEventBegin;
+    static InputFrame _pending;
+    static InputFrame _frame;
+    static bool _cursorValid;
 };
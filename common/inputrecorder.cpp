@@ -0,0 +1,139 @@
+#include "inputrecorder.h"
+
+#include <cstring>
+
+namespace {
+constexpr char MAGIC[4]{'I', 'N', 'P', 'R'};
+// 2: timing after the version, gui capture records
+constexpr uint32_t VERSION = 2;
+// record type after the InputEventType values, action holds guiWantCaptureMouse
+constexpr uint8_t GUI_CAPTURE_RECORD = 0x80;
+
+struct RecordHeader {
+    uint32_t frameIndex;
+    float time_ms;
+    uint8_t type;
+    uint8_t action;
+    uint16_t mods;
+};
+static_assert(sizeof(RecordHeader) == 12);
+static_assert(sizeof(InputRecordingTiming) == 8);
+
+template <typename T>
+void writeValue(std::ofstream &os, T const &value) {
+    os.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+template <typename T>
+bool readValue(std::ifstream &is, T &value) {
+    return bool(is.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+}  // namespace
+
+InputRecorder::InputRecorder(std::string const &path, InputRecordingTiming const &timing)
+    : _file(path, std::ios::binary | std::ios::trunc), _start(std::chrono::steady_clock::now()) {
+    if (!_file) THROW("failed to open input recording", path);
+    if (timing.fixedTimeStep_ms <= 0) THROW("input recordings need a fixed time step", path);
+    _file.write(MAGIC, sizeof(MAGIC));
+    writeValue(_file, VERSION);
+    writeValue(_file, timing);
+}
+InputRecorder::~InputRecorder() {
+    if (Input::recorder == this) Input::recorder = nullptr;
+}
+void InputRecorder::writeHeader(uint8_t type, int action, int mods) {
+    RecordHeader header{_frameIndex,
+                        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _start).count(),
+                        type, uint8_t(action), uint16_t(mods)};
+    writeValue(_file, header);
+    ++_recordCount;
+}
+void InputRecorder::setFrameIndex(uint32_t frameIndex, bool guiWantCaptureMouse) {
+    _frameIndex = frameIndex;
+    if (guiWantCaptureMouse == _guiWantCaptureMouse) return;
+    _guiWantCaptureMouse = guiWantCaptureMouse;
+    writeHeader(GUI_CAPTURE_RECORD, guiWantCaptureMouse, 0);
+}
+void InputRecorder::write(InputEventType type, int action, int mods, int code, int scancode, double x, double y) {
+    writeHeader(uint8_t(type), action, mods);
+    switch (type) {
+        case InputEventType::KEY:
+            writeValue(_file, int32_t(code));
+            writeValue(_file, int32_t(scancode));
+            break;
+        case InputEventType::MOUSE_BUTTON:
+            writeValue(_file, int32_t(code));
+            break;
+        case InputEventType::MOUSE_MOVE:
+        case InputEventType::SCROLL:
+            writeValue(_file, x);
+            writeValue(_file, y);
+            break;
+    }
+}
+
+//============================================================
+InputReplay::InputReplay(std::string const &path) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is) THROW("failed to open input recording", path);
+    char magic[4];
+    uint32_t version;
+    if (!is.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readValue(is, version))
+        THROW("not an input recording", path);
+    if (version != VERSION) THROW("unsupported input recording version", version, path);
+    if (!readValue(is, _timing) || _timing.fixedTimeStep_ms <= 0 || _timing.tickRate_hz <= 0)
+        THROW("corrupt input recording", path, "timing");
+
+    RecordHeader header;
+    while (readValue(is, header)) {
+        if (header.type == GUI_CAPTURE_RECORD) {
+            _guiCaptureChanges.emplace_back(header.frameIndex, header.action != 0);
+            continue;
+        }
+        InputRecord record{header.frameIndex, header.time_ms, InputEventType(header.type), header.action,
+                           header.mods};
+        bool complete = true;
+        switch (record.type) {
+            case InputEventType::KEY:
+                complete = readValue(is, record.code) && readValue(is, record.scancode);
+                break;
+            case InputEventType::MOUSE_BUTTON:
+                complete = readValue(is, record.code);
+                break;
+            case InputEventType::MOUSE_MOVE:
+            case InputEventType::SCROLL:
+                complete = readValue(is, record.x) && readValue(is, record.y);
+                break;
+            default:
+                THROW("corrupt input recording", path, "record", _records.size());
+        }
+        // a recording cut off by a crash keeps the events written before
+        if (!complete) break;
+        _records.emplace_back(record);
+    }
+    // the recording started from the input state of a fresh process
+    Input::reset();
+}
+void InputReplay::replay(uint32_t frameIndex) {
+    for (; _nextGuiCapture < _guiCaptureChanges.size() && _guiCaptureChanges[_nextGuiCapture].first <= frameIndex;
+         ++_nextGuiCapture)
+        _guiWantCaptureMouse = _guiCaptureChanges[_nextGuiCapture].second;
+    // the gui of this run wrote its own value last frame
+    Input::guiWantCaptureMouse = _guiWantCaptureMouse;
+    for (; _next < _records.size() && _records[_next].frameIndex <= frameIndex; ++_next) {
+        auto &&e = _records[_next];
+        switch (e.type) {
+            case InputEventType::KEY:
+                Input::onKeyBoard(e.code, e.scancode, e.action, e.mods);
+                break;
+            case InputEventType::MOUSE_BUTTON:
+                Input::onMouseButton(e.code, e.action, e.mods);
+                break;
+            case InputEventType::MOUSE_MOVE:
+                Input::onMouseMove(e.x, e.y);
+                break;
+            case InputEventType::SCROLL:
+                Input::onScroll(e.x, e.y);
+                break;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "input.h"
+
+/**
+ * @brief one raw window event as the glfw callbacks received it.
+ * code is the glfw key or mouse button, x y the cursor position or scroll offset
+ */
+struct InputRecord {
+    uint32_t frameIndex;
+    // since the recording started, informative only, replay is driven by frameIndex
+    float time_ms;
+    InputEventType type;
+    int32_t action;
+    int32_t mods;
+    int32_t code{};
+    int32_t scancode{};
+    double x{};
+    double y{};
+};
+
+/**
+ * @brief simulation timing of a recording, replay is keyed on frame index so it must advance time the same way
+ */
+struct InputRecordingTiming {
+    float fixedTimeStep_ms;
+    float tickRate_hz;
+};
+
+/**
+ * @brief writes every event passed to the Input callbacks into a binary log while it is installed as
+ * Input::recorder. the log starts with "INPR", a version and the InputRecordingTiming, followed by one record per
+ * event: frame index, time, type, action, mods (12 bytes) and either key + scancode, the button or x + y.
+ * changes of Input::guiWantCaptureMouse are records of their own, the gui of a replay does not see the same cursor
+ */
+class InputRecorder {
+    std::ofstream _file;
+    std::chrono::steady_clock::time_point _start;
+    uint32_t _frameIndex{};
+    uint32_t _recordCount{};
+    bool _guiWantCaptureMouse{};
+
+    void writeHeader(uint8_t type, int action, int mods);
+
+public:
+    // timing.fixedTimeStep_ms must be > 0
+    InputRecorder(std::string const &path, InputRecordingTiming const &timing);
+    ~InputRecorder();
+
+    InputRecorder(InputRecorder const &) = delete;
+    InputRecorder &operator=(InputRecorder const &) = delete;
+
+    /**
+     * @brief events written from now on belong to this frame, set before the window events are polled.
+     * guiWantCaptureMouse is what the simulation of this frame will see
+     */
+    void setFrameIndex(uint32_t frameIndex, bool guiWantCaptureMouse);
+    void write(InputEventType type, int action, int mods, int code, int scancode, double x = 0, double y = 0);
+
+    uint32_t getRecordCount() const { return _recordCount; }
+};
+
+/**
+ * @brief a log written by InputRecorder, fed back into the Input callbacks frame by frame. with a fixed time step
+ * the replayed session simulates the same ticks with the same input on every run
+ */
+class InputReplay {
+    InputRecordingTiming _timing{};
+    std::vector<InputRecord> _records;
+    size_t _next{};
+    // frame index and value of every guiWantCaptureMouse change
+    std::vector<std::pair<uint32_t, bool>> _guiCaptureChanges;
+    size_t _nextGuiCapture{};
+    bool _guiWantCaptureMouse{};
+
+public:
+    explicit InputReplay(std::string const &path);
+
+    /**
+     * @brief call the Input callbacks with the events recorded up to frameIndex, in recording order, and set
+     * Input::guiWantCaptureMouse to its recorded value
+     */
+    void replay(uint32_t frameIndex);
+
+    constexpr InputRecordingTiming const &getTiming() const { return _timing; }
+
+    bool finished() const { return _next == _records.size(); }
+    // frames up to and including the last one with an event
+    uint32_t getFrameCount() const {
+        auto last = _records.empty() ? 0 : _records.back().frameIndex + 1;
+        return _guiCaptureChanges.empty() ? last : (std::max)(last, _guiCaptureChanges.back().first + 1);
+    }
+    std::vector<InputRecord> const &getRecords() const { return _records; }
+};
@@ -0,0 +1,180 @@
+#include "jobsystem.h"
+
+#include "prerequisites.h"
+
+namespace {
+thread_local JobSystem const *tlJobSystem{};
+thread_local uint32_t tlWorkerIndex{UINT32_MAX};
+}  // namespace
+
+//===============================================================
+
+bool WorkStealingDeque::push(Job *job) {
+    auto b = _bottom.load(std::memory_order_relaxed);
+    auto t = _top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY) return false;
+    _jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    _bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+Job *WorkStealingDeque::pop() {
+    auto b = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = _top.load(std::memory_order_relaxed);
+    if (t > b) {
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto job = _jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // last job, race the thieves for it
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+Job *WorkStealingDeque::steal() {
+    auto t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = _bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    auto job = _jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+//===============================================================
+
+JobSystem::JobSystem() : JobSystem((std::max)(std::thread::hardware_concurrency(), 2u) - 1) {}
+JobSystem::JobSystem(uint32_t workerThreadCount) : _mainThreadId(std::this_thread::get_id()) {
+    _workers.reserve(workerThreadCount + 1);
+    for (uint32_t i = 0; i <= workerThreadCount; ++i) _workers.emplace_back(std::make_unique<Worker>());
+    tlJobSystem = this;
+    tlWorkerIndex = 0;
+    _threads.reserve(workerThreadCount);
+    for (uint32_t i = 1; i <= workerThreadCount; ++i) _threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+JobSystem::~JobSystem() {
+    processMainThreadJobs();
+    _running.store(false);
+    {
+        std::lock_guard lock(_sleepMutex);
+        _wakeCondition.notify_all();
+    }
+    for (auto &&e : _threads) e.join();
+    if (tlJobSystem == this) {
+        tlJobSystem = nullptr;
+        tlWorkerIndex = UINT32_MAX;
+    }
+}
+uint32_t JobSystem::getWorkerIndex() const { return tlJobSystem == this ? tlWorkerIndex : UINT32_MAX; }
+Job *JobSystem::allocateJob() {
+    auto index = getWorkerIndex();
+    if (index == UINT32_MAX) {
+        auto job = new Job;
+        job->heapAllocated = true;
+        return job;
+    }
+    auto &&worker = *_workers[index];
+    if (worker.deque.full()) return nullptr;
+    auto job = &worker.jobs[worker.nextJob % worker.jobs.size()];
+    // stolen a whole ring ago and still running, its storage and counter are in use
+    if (!job->finished.load(std::memory_order_acquire)) return nullptr;
+    ++worker.nextJob;
+    job->finished.store(false, std::memory_order_relaxed);
+    job->heapAllocated = false;
+    return job;
+}
+void JobSystem::submit(Job *job) {
+    auto index = getWorkerIndex();
+    if (index == UINT32_MAX) {
+        std::lock_guard lock(_injectedMutex);
+        _injectedJobs.emplace_back(job);
+    } else {
+        _workers[index]->deque.push(job);
+    }
+    _queuedJobs.fetch_add(1, std::memory_order_release);
+    if (_sleepingWorkers.load(std::memory_order_acquire) > 0) {
+        std::lock_guard lock(_sleepMutex);
+        _wakeCondition.notify_one();
+    }
+}
+Job *JobSystem::findJob(uint32_t workerIndex) {
+    Job *job{};
+    if (workerIndex != UINT32_MAX) job = _workers[workerIndex]->deque.pop();
+    if (!job) {
+        std::unique_lock lock(_injectedMutex, std::try_to_lock);
+        if (lock.owns_lock() && !_injectedJobs.empty()) {
+            job = _injectedJobs.back();
+            _injectedJobs.pop_back();
+        }
+    }
+    if (!job) {
+        // start at a different victim per thief so they do not all hammer worker 0
+        auto count = static_cast<uint32_t>(_workers.size());
+        auto first = workerIndex == UINT32_MAX ? 0 : workerIndex + 1;
+        for (uint32_t i = 0; i < count && !job; ++i) {
+            auto victim = (first + i) % count;
+            if (victim != workerIndex) job = _workers[victim]->deque.steal();
+        }
+    }
+    if (job) _queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+void JobSystem::execute(Job *job) {
+    job->invoke(*job);
+    if (job->destroy) job->destroy(*job);
+    auto counter = job->counter;
+    if (job->heapAllocated)
+        delete job;
+    else
+        job->finished.store(true, std::memory_order_release);
+    if (counter) counter->_pending.fetch_sub(1, std::memory_order_release);
+}
+void JobSystem::workerLoop(uint32_t workerIndex) {
+    tlJobSystem = this;
+    tlWorkerIndex = workerIndex;
+    uint32_t idleSpins = 0;
+    while (_running.load(std::memory_order_relaxed)) {
+        if (auto job = findJob(workerIndex)) {
+            execute(job);
+            idleSpins = 0;
+        } else if (++idleSpins < 64) {
+            std::this_thread::yield();
+        } else {
+            // the timeout covers a wake up racing with the check, sleeping workers cost nothing between bursts
+            std::unique_lock lock(_sleepMutex);
+            _sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+            _wakeCondition.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                return _queuedJobs.load(std::memory_order_acquire) > 0 || !_running.load(std::memory_order_relaxed);
+            });
+            _sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+            idleSpins = 0;
+        }
+    }
+}
+void JobSystem::wait(JobCounter &counter) {
+    auto workerIndex = getWorkerIndex();
+    auto mainThread = isMainThread();
+    while (!counter.isDone()) {
+        // a job waiting for gl work would deadlock if the main thread did not serve the queue here
+        if (mainThread) processMainThreadJobs();
+        if (auto job = findJob(workerIndex))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+void JobSystem::processMainThreadJobs() {
+    if (!isMainThread()) THROW("main thread jobs can only be processed on the main thread");
+    std::vector<Job *> jobs;
+    {
+        std::lock_guard lock(_mainThreadMutex);
+        if (_mainThreadJobs.empty()) return;
+        jobs.swap(_mainThreadJobs);
+    }
+    for (auto e : jobs) execute(e);
+}
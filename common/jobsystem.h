@@ -0,0 +1,217 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "singleton.h"
+
+/**
+ * @brief number of unfinished jobs attached to it, wait on it to express a dependency
+ */
+class JobCounter {
+    friend class JobSystem;
+    std::atomic<uint32_t> _pending{0};
+
+public:
+    JobCounter() = default;
+    JobCounter(JobCounter const &) = delete;
+    JobCounter &operator=(JobCounter const &) = delete;
+
+    bool isDone() const { return _pending.load(std::memory_order_acquire) == 0; }
+};
+
+/**
+ * @brief type erased callable, small captures are stored inline so spawning does not allocate
+ */
+struct Job {
+    static constexpr size_t STORAGE_SIZE = 48;
+
+    void (*invoke)(Job &);
+    // null when the callable needs no destruction
+    void (*destroy)(Job &);
+    JobCounter *counter;
+    // created by a thread outside the job system, deleted after execution
+    bool heapAllocated;
+    // ring jobs: the slot may be reused, cleared when spawned and set once execute() no longer touches it
+    std::atomic<bool> finished{true};
+    alignas(std::max_align_t) std::byte storage[STORAGE_SIZE];
+
+    template <typename F>
+    void set(F &&f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (sizeof(Fn) <= STORAGE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Fn>) {
+            new (storage) Fn(std::forward<F>(f));
+            invoke = [](Job &job) { (*std::launder(reinterpret_cast<Fn *>(job.storage)))(); };
+            if constexpr (std::is_trivially_destructible_v<Fn>)
+                destroy = nullptr;
+            else
+                destroy = [](Job &job) { std::launder(reinterpret_cast<Fn *>(job.storage))->~Fn(); };
+        } else {
+            auto p = new Fn(std::forward<F>(f));
+            memcpy(storage, &p, sizeof(p));
+            invoke = [](Job &job) {
+                Fn *p;
+                memcpy(&p, job.storage, sizeof(p));
+                (*p)();
+            };
+            destroy = [](Job &job) {
+                Fn *p;
+                memcpy(&p, job.storage, sizeof(p));
+                delete p;
+            };
+        }
+    }
+};
+
+/**
+ * @brief Chase-Lev deque, the owner pushes and pops at the bottom, other workers steal from the top.
+ * fixed capacity, a thread with a full deque runs new jobs inline
+ */
+class WorkStealingDeque {
+public:
+    static constexpr int64_t CAPACITY = 1 << 12;
+
+private:
+    alignas(64) std::atomic<int64_t> _top{0};
+    alignas(64) std::atomic<int64_t> _bottom{0};
+    std::array<std::atomic<Job *>, CAPACITY> _jobs{};
+
+public:
+    bool push(Job *job);
+    Job *pop();
+    Job *steal();
+    // owner only
+    bool full() const {
+        return _bottom.load(std::memory_order_relaxed) - _top.load(std::memory_order_acquire) >= CAPACITY;
+    }
+};
+
+/**
+ * @brief work-stealing scheduler. the thread that creates it (the main thread for the singleton) is worker 0 and
+ * only executes jobs while it waits, the other workers are dedicated threads.
+ * gl calls must stay on the main thread, queue them with runOnMainThread, they run in processMainThreadJobs()
+ * (once per frame in the main loop) or while the main thread waits on a counter.
+ * jobs spawned by a thread come from a ring of twice the deque capacity, a slot whose job is still running when the
+ * ring comes round to it is skipped like a full deque, the new job runs inline
+ */
+class JobSystem : public Singleton<JobSystem> {
+    struct Worker {
+        WorkStealingDeque deque;
+        std::array<Job, WorkStealingDeque::CAPACITY * 2> jobs;
+        uint32_t nextJob{};
+    };
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::thread::id _mainThreadId;
+
+    std::atomic<bool> _running{true};
+    // spawned but not yet taken, idle workers sleep when it is zero
+    std::atomic<int32_t> _queuedJobs{0};
+    std::atomic<uint32_t> _sleepingWorkers{0};
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeCondition;
+
+    // jobs spawned by threads the system does not own
+    std::mutex _injectedMutex;
+    std::vector<Job *> _injectedJobs;
+
+    std::mutex _mainThreadMutex;
+    std::vector<Job *> _mainThreadJobs;
+
+    // index of the calling thread in _workers, UINT32_MAX for foreign threads
+    uint32_t getWorkerIndex() const;
+    // null when the deque of the calling thread is full or its next ring slot still runs
+    Job *allocateJob();
+    void submit(Job *job);
+    Job *findJob(uint32_t workerIndex);
+    void execute(Job *job);
+    void workerLoop(uint32_t workerIndex);
+
+public:
+    /**
+     * @brief hardware_concurrency - 1 worker threads
+     */
+    JobSystem();
+    explicit JobSystem(uint32_t workerThreadCount);
+    ~JobSystem();
+
+    JobSystem(JobSystem const &) = delete;
+    JobSystem &operator=(JobSystem const &) = delete;
+
+    template <typename F>
+    void run(F &&f, JobCounter *counter = nullptr) {
+        auto job = allocateJob();
+        if (!job) {
+            f();
+            return;
+        }
+        job->set(std::forward<F>(f));
+        job->counter = counter;
+        if (counter) counter->_pending.fetch_add(1, std::memory_order_relaxed);
+        submit(job);
+    }
+
+    /**
+     * @brief f runs on the main thread, for work that touches the gl context
+     */
+    template <typename F>
+    void runOnMainThread(F &&f, JobCounter *counter = nullptr) {
+        auto job = new Job;
+        job->set(std::forward<F>(f));
+        job->counter = counter;
+        job->heapAllocated = true;
+        if (counter) counter->_pending.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard lock(_mainThreadMutex);
+        _mainThreadJobs.emplace_back(job);
+    }
+
+    /**
+     * @brief returns when every job attached to counter finished, the calling thread executes jobs meanwhile
+     */
+    void wait(JobCounter &counter);
+
+    /**
+     * @brief f(begin, end) over [0, count) in chunks of grainSize, the calling thread takes part and returns when
+     * every chunk is done
+     */
+    template <typename F>
+    void parallelFor(uint32_t count, uint32_t grainSize, F &&f) {
+        if (count == 0) return;
+        grainSize = (std::max)(grainSize, 1u);
+        JobCounter counter;
+        for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+            auto end = (std::min)(begin + grainSize, count);
+            run([&f, begin, end] { f(begin, end); }, &counter);
+        }
+        f(0u, (std::min)(grainSize, count));
+        wait(counter);
+    }
+    /**
+     * @brief grain size giving every thread about four chunks
+     */
+    template <typename F>
+    void parallelFor(uint32_t count, F &&f) {
+        parallelFor(count, (std::max)(count / (getThreadCount() * 4), 1u), std::forward<F>(f));
+    }
+
+    /**
+     * @brief run the queued main thread jobs, called by the main loop once per frame
+     */
+    void processMainThreadJobs();
+
+    // worker threads and the main thread
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(_workers.size()); }
+    bool isMainThread() const { return std::this_thread::get_id() == _mainThreadId; }
+};
@@ -11,10 +11,10 @@ void Light::prepare() {
         },
         &uboData, &uboBuffer);
 }
-void Light::update() {
+void Light::uploadUBO(UBO const &ubo) {
     glBindBuffer(GL_UNIFORM_BUFFER, uboBuffer);
     void *data = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-    memcpy(data, &uboData, sizeof(UBO));
+    memcpy(data, &ubo, sizeof(UBO));
     glUnmapBuffer(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
@@ -1,3 +1,4 @@
+#pragma once
 #include "component.h"
 
 enum LightType {
@@ -16,7 +17,10 @@ struct Light : public Component {
     Light(Node *parent);
 
     void prepare() override;
-    void update() override;
+    /**
+     * @brief render stage, write ubo (taken from a snapshot) into the light buffer
+     */
+    void uploadUBO(UBO const &ubo);
 
     void bind(uint32_t binding);
 };
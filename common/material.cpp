@@ -1,12 +1,17 @@
 #include "material.h"
 
+#include <algorithm>
+
 #include "common.h"
 
 std::array<std::unique_ptr<Technique>, MATERIAL_Num> Material::techniques;
+uint32_t Material::lightCountClass{1};
 
 Technique *Material::getTechnique() {
     if (materialType == MATERIAL_BLINNPHONG) {
-        if (!techniques[MATERIAL_BLINNPHONG]) techniques[MATERIAL_BLINNPHONG] = std::make_unique<TechniqueBlinnPhong>();
+        if (!techniques[MATERIAL_BLINNPHONG])
+            techniques[MATERIAL_BLINNPHONG] =
+                std::make_unique<TechniqueBlinnPhong>(MaterialTable::getSingleton().getShaderDefines());
         return techniques[MATERIAL_BLINNPHONG].get();
     } else if (materialType == MATERIAL_UNLITCOLOR) {
         if (!techniques[MATERIAL_UNLITCOLOR]) techniques[MATERIAL_UNLITCOLOR] = std::make_unique<TechniqueUnlitColor>();
@@ -15,77 +20,144 @@ Technique *Material::getTechnique() {
     return techniques[MATERIAL_BLINNPHONG].get();
 }
 
+void Material::prepareDraw() {
+    auto frame = TextureManager::getSingleton().getFrameIndex();
+    if (_drawPreparedFrame == frame) return;
+    _drawPreparedFrame = frame;
+    if (!prepared) prepare();
+    _drawPipeline = getTechnique()->getPipeline(getVariantKey());
+    prepareDrawImpl();
+}
+
+void Material::prepareDraws(std::span<Material *const> materials) {
+    auto frame = TextureManager::getSingleton().getFrameIndex();
+    std::vector<std::pair<Technique *, std::vector<ShaderVariantKey>>> keys;
+    for (auto material : materials) {
+        if (material->_drawPreparedFrame == frame) continue;
+        material->prepare();
+        auto technique = material->getTechnique();
+        auto it = std::find_if(keys.begin(), keys.end(), [&](auto &&e) { return e.first == technique; });
+        if (it == keys.end()) it = keys.insert(it, {technique, {}});
+        it->second.emplace_back(material->getVariantKey());
+    }
+    for (auto &&[technique, e] : keys) technique->buildPipelines(e);
+    for (auto material : materials) material->prepareDraw();
+}
+
 //=====================================
 void MaterialUnlitColor::bind(bool bindTechinique) {
     if (!prepared) prepare();
     if (bindTechinique) getTechnique()->bind();
 }
+void MaterialUnlitColor::record(GL::CommandBuffer &cmd, bool bindTechinique) const {
+    if (bindTechinique) cmd.bindPipeline(*_drawPipeline);
+}
 
 //=====================================
 MaterialBlinnPhong::MaterialBlinnPhong() {}
 MaterialBlinnPhong::MaterialBlinnPhong(std::string_view name) : Material(name) {}
-MaterialBlinnPhong::~MaterialBlinnPhong() { glDeleteBuffers(1, &uboBuffer); 
-    for(auto e:textures)
-    {
-        TextureManager::getSingleton();
-    }
+MaterialBlinnPhong::~MaterialBlinnPhong() {
+    if (prepared) MaterialTable::getSingleton().freeSlot(tableSlot);
 }
 void MaterialBlinnPhong::prepareImpl() {
-    // create ubo buffer
-    GL::createBuffer(GL::BufferCreateInfo{{},
-                                          sizeof(GpuData),
-                                          GL::BufferStorageFlagBits::BUFFER_STORAGE_MAP_COHERENT_BIT |
-                                              GL::BufferStorageFlagBits::BUFFER_STORAGE_MAP_PERSISTENT_BIT |
-                                              GL::BufferStorageFlagBits::BUFFER_STORAGE_MAP_WRITE_BIT |
-                                              GL::BufferStorageFlagBits::BUFFER_STORAGE_MAP_READ_BIT},
-                     &gpuData, &uboBuffer);
-}
-void MaterialBlinnPhong::setBaseColor(glm::vec4 const &color) { gpuData.baseColor = color; }
-void MaterialBlinnPhong::setShininess(float shininess) { gpuData.shininess = shininess; }
+    tableSlot = MaterialTable::getSingleton().allocateSlot();
+    updateTableEntry();
+}
+void MaterialBlinnPhong::updateTableEntry() {
+    if (!prepared) return;
+    MaterialTable::getSingleton().setEntry(tableSlot, MaterialEntry{baseColor, shininess}, baseColorTexture,
+                                           normalTexture);
+}
+void MaterialBlinnPhong::setBaseColor(glm::vec4 const &color) {
+    baseColor = color;
+    updateTableEntry();
+}
+void MaterialBlinnPhong::setShininess(float shininess_) {
+    shininess = shininess_;
+    updateTableEntry();
+}
 void MaterialBlinnPhong::setBaseColorImage(Image *image) {
-    if (gpuData.baseColorTexIndex < 0){
-        gpuData.baseColorTexIndex = textures.size();
-        textures.emplace_back();
-    }
-    textures[gpuData.baseColorTexIndex]=TextureManager::getSingleton().createTexture(image);
+    auto texture = image ? TextureManager::getSingleton().createTexture(image) : nullptr;
+    replaceDependency(baseColorTexture, texture.get());
+    baseColorTexture = texture.get();
+    updateTableEntry();
 }
 void MaterialBlinnPhong::setNormalImage(Image *image) {
-    if (gpuData.normalTexIndex < 0) {
-        gpuData.normalTexIndex = textures.size();
-        textures.emplace_back();
-    }
-    textures[gpuData.baseColorTexIndex] = TextureManager::getSingleton().createTexture(image);
+    auto texture = image ? TextureManager::getSingleton().createTexture(image) : nullptr;
+    replaceDependency(normalTexture, texture.get());
+    normalTexture = texture.get();
+    updateTableEntry();
+}
+ShaderVariantKey MaterialBlinnPhong::getVariantKey() const {
+    ShaderVariantKey key{0, lightCountClass};
+    if (!prepared) return key;
+    // use the table references, a texture may have been rejected (e.g. no array slot left)
+    auto &&entry = MaterialTable::getSingleton().getEntry(tableSlot);
+    if (entry.baseColorTex != MaterialTextureRef{}) key.features |= SHADER_FEATURE_ALBEDO_TEXTURE_BIT;
+    if (entry.normalTex != MaterialTextureRef{}) key.features |= SHADER_FEATURE_NORMAL_MAP_BIT;
+    return key;
 }
 void MaterialBlinnPhong::bind(bool bindTechinique) {
     if (!prepared) prepare();
-    if (bindTechinique) getTechnique()->bind();
-    glBindBufferRange(GL_UNIFORM_BUFFER, 3, uboBuffer, 0, sizeof(GpuData));
-    for (size_t i = 0; i < textures.size(); ++i) textures[i]->bind(i);
+    if (bindTechinique) getTechnique()->bind(getVariantKey());
+    auto &table = MaterialTable::getSingleton();
+    // parameters and textures are read from the material table
+    if (table.isEnabled()) return;
+    table.bindSlot(tableSlot);
+    if (baseColorTexture) baseColorTexture->bind(0);
+    if (normalTexture) normalTexture->bind(1);
+}
+void MaterialBlinnPhong::prepareDrawImpl() {
+    // texture arrays hold copies, bindless and per draw sample the textures themselves and keep them resident
+    if (MaterialTable::getSingleton().getBindingModel() == MATERIAL_BINDING_TEXTURE_ARRAY) return;
+    if (baseColorTexture) baseColorTexture->prepareBind();
+    if (normalTexture) normalTexture->prepareBind();
+}
+void MaterialBlinnPhong::record(GL::CommandBuffer &cmd, bool bindTechinique) const {
+    if (bindTechinique) cmd.bindPipeline(*_drawPipeline);
+    auto &table = MaterialTable::getSingleton();
+    if (table.isEnabled()) return;
+    table.recordBindSlot(cmd, tableSlot);
+    if (baseColorTexture) cmd.bindTexture(0, baseColorTexture->getTarget(), baseColorTexture->getImageView());
+    if (normalTexture) cmd.bindTexture(1, normalTexture->getTarget(), normalTexture->getImageView());
 }
 
 //============================
 MaterialManager::MaterialManager() {
+    // materials free their table slot and release their textures on destruction, both have to outlive them
+    MaterialTable::getSingleton();
+    TextureManager::getSingleton();
     for (int i = 0; i < MATERIAL_Num; ++i) {
-        _defaultMaterialIds[i] = createMaterial(MaterialType(i), "default")->getId();
+        _defaultMaterials[i] = createMaterial(MaterialType(i), "default");
     }
 }
-std::shared_ptr<Material> MaterialManager::createMaterial(MaterialType type, std::string_view name) {
-    std::shared_ptr<Material> ret;
+ResourceHandle<Material> MaterialManager::createMaterial(MaterialType type, std::string_view name) {
+    std::unique_ptr<Material> ret;
     switch (type) {
         case MATERIAL_BLINNPHONG:
-            ret = std::make_shared<MaterialBlinnPhong>(name);
+            ret = std::make_unique<MaterialBlinnPhong>(name);
             break;
         case MATERIAL_UNLITCOLOR:
-            ret = std::make_shared<MaterialUnlitColor>(name);
+            ret = std::make_unique<MaterialUnlitColor>(name);
             break;
+        default:
+            THROW("unknown material type", type);
     }
-    _materials.emplace(ret->getId(), ret);
-    return ret;
+    auto id = ret->getId();
+    return _materials.emplace(id, std::move(ret)).first->get();
 }
-std::shared_ptr<Material> MaterialManager::getMaterial(IdType id) const {
-    if (id == ~0u) return getDefaultMaterial(MATERIAL_BLINNPHONG);
+ResourceHandle<Material> MaterialManager::getMaterial(IdType id) const {
+    // meshes without a material
+    if (id == INVALID_ID) return getDefaultMaterial(MATERIAL_BLINNPHONG);
 
-    auto it = _materials.find(id);
-    if (it == _materials.end()) return nullptr;
-    return it->second;
+    auto p = _materials.find(id);
+    return p ? p->get() : nullptr;
+}
+size_t MaterialManager::collectGarbage() { return eraseUnreferenced(_materials, [](Material &) {}); }
+void MaterialManager::clear() {
+    for (auto &&e : _defaultMaterials) e.reset();
+    auto referenced = eraseAll(_materials, [](Material &) {});
+    if (referenced) LOG(referenced, "materials still referenced at shutdown");
+    // another AppBase may follow
+    for (int i = 0; i < MATERIAL_Num; ++i) _defaultMaterials[i] = createMaterial(MaterialType(i), "default");
 }
\ No newline at end of file
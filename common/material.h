@@ -1,60 +1,95 @@
 #pragma once
 #include <array>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "materialtable.h"
 #include "technique.h"
 #include "prerequisites.h"
+#include "slotmap.h"
 #include "texture.h"
 
-struct Material : public IdObject {
+struct Material : public IdObject<Material>, public Resource {
     static std::array<std::unique_ptr<Technique>, MATERIAL_Num> techniques;
 
+    // LIGHT_COUNT of the variants bound in the current pass, set by the renderer
+    static uint32_t lightCountClass;
+
     MaterialType materialType{MATERIAL_BLINNPHONG};
 
     std::string name;
 
     bool prepared{false};
 
+    // entry in MaterialTable, passed to shaders as gl_BaseInstance
+    uint32_t tableSlot{};
+
     Technique *getTechnique();
 
-    Material(std::string_view name_) : name(name_) {}
-    Material() {}
+    Material(std::string_view name_) : Resource(RESOURCE_MATERIAL), name(name_) { setState(RESOURCE_STATE_LOADED); }
+    Material() : Material("") {}
 
     virtual ~Material() {}
 
     // bind descriptorSet
     virtual void bind(bool bindTechinique = true) = 0;
 
+    virtual ShaderVariantKey getVariantKey() const { return {0, lightCountClass}; }
+
+    /**
+     * @brief main thread, before draws using the material are recorded: prepares it, builds its pipeline and marks
+     * its textures used. repeated calls in the same frame return immediately
+     */
+    void prepareDraw();
+    /**
+     * @brief prepareDraw for many materials, the missing pipeline variants of one technique compile as one batch
+     */
+    static void prepareDraws(std::span<Material *const> materials);
+    /**
+     * @brief the binds of bind() as commands, no gl call, valid after prepareDraw of the same frame
+     */
+    virtual void record(GL::CommandBuffer &cmd, bool bindTechinique = true) const = 0;
+
     void prepare() {
         if (prepared) return;
         prepared = true;
         prepareImpl();
     }
     virtual void prepareImpl() {}
+
+protected:
+    // resolved by prepareDraw for lightCountClass of that frame
+    GL::PipelineHandle const *_drawPipeline{};
+    uint64_t _drawPreparedFrame{};
+
+    virtual void prepareDrawImpl() {}
 };
 struct MaterialUnlitColor : Material {
     MaterialUnlitColor() { materialType = MATERIAL_UNLITCOLOR; };
     MaterialUnlitColor(std::string_view name) : Material(name) { materialType = MATERIAL_UNLITCOLOR; };
     void bind(bool bindTechinique = true);
+    void record(GL::CommandBuffer &cmd, bool bindTechinique = true) const override;
 };
 
 struct MaterialBlinnPhong : Material {
 private:
-    struct GpuData {
-        glm::vec4 baseColor{1, 1, 1, 1};
-        float shininess{200};
-        int baseColorTexIndex{-1};
-        int normalTexIndex{-1};
-    } gpuData{};
+    // gpu copy of the parameters lives in MaterialTable at tableSlot
+    glm::vec4 baseColor{1, 1, 1, 1};
+    float shininess{200};
+    // referenced as dependencies
+    Texture *baseColorTexture{};
+    Texture *normalTexture{};
 
-    GL::BufferHandle uboBuffer;
-
-    std::vector<Texture *> textures;
-    GLuint uboHandle{};
+    void updateTableEntry();
 
 public:
+    /**
+     * @brief shader variant matching the textures of the material, no texture presence test in the shader
+     */
+    ShaderVariantKey getVariantKey() const override;
+
     MaterialBlinnPhong();
     MaterialBlinnPhong(std::string_view name);
     ~MaterialBlinnPhong();
@@ -66,19 +101,31 @@ public:
     void setNormalImage(Image *image);
 
     void prepareImpl() override;
+    void prepareDrawImpl() override;
     void bind(bool bindTechinique = true) override;
+    void record(GL::CommandBuffer &cmd, bool bindTechinique = true) const override;
 };
 
 class MaterialManager : public Singleton<MaterialManager> {
-    std::unordered_map<IdType, std::shared_ptr<Material>> _materials;
-    std::array<int, MATERIAL_Num> _defaultMaterialIds;
+    SlotMap<std::unique_ptr<Material>> _materials;
+    // never collected
+    std::array<ResourceHandle<Material>, MATERIAL_Num> _defaultMaterials;
 
 public:
     MaterialManager();
 
-    std::shared_ptr<Material> createMaterial(MaterialType type, std::string_view name = "");
-    std::shared_ptr<Material> getMaterial(IdType id) const;
-    std::shared_ptr<Material> getDefaultMaterial(MaterialType materialType) const {
-        return _materials.at(_defaultMaterialIds[materialType]);
-    };
+    ResourceHandle<Material> createMaterial(MaterialType type, std::string_view name = "");
+    ResourceHandle<Material> getMaterial(IdType id) const;
+    // default materials are never collected, no reference needed
+    Material *getDefaultMaterial(MaterialType materialType) const { return _defaultMaterials[materialType].get(); };
+
+    /**
+     * @brief destroy materials no model or renderer references, see ResourceManager::collectGarbage
+     */
+    size_t collectGarbage();
+
+    /**
+     * @brief destroy every material, at shutdown after the models. the default materials are created again
+     */
+    void clear();
 };
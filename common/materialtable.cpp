@@ -0,0 +1,356 @@
+#include "materialtable.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureArrayPool::~TextureArrayPool() {
+    for (auto &&e : _arrays) glDeleteTextures(1, &e.image);
+}
+void TextureArrayPool::grow(Array &array) {
+    GLint maxLayers{};
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    auto capacity = std::min<uint32_t>(std::max(4u, array.capacity * 2), maxLayers);
+
+    GL::ImageHandle newImage;
+    GL::createImage(GL::ImageCreateInfo{0, GL::IMAGE_TYPE_2D, array.format, {array.width, array.height, capacity},
+                                        array.levels, GL::SAMPLE_COUNT_1_BIT},
+                    &newImage);
+    auto target = Map(GL::IMAGE_TYPE_2D, false);
+    if (array.layerCount) {
+        for (uint32_t i = 0; i < array.levels; ++i) {
+            glCopyImageSubData(array.image, target, i, 0, 0, 0, newImage, target, i, 0, 0, 0,
+                               std::max(1u, array.width >> i), std::max(1u, array.height >> i), array.layerCount);
+        }
+    }
+    glDeleteTextures(1, &array.image);
+
+    glBindTexture(target, newImage);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(target, 0);
+
+    array.image = newImage;
+    array.capacity = capacity;
+}
+MaterialTextureRef TextureArrayPool::addImage(Image *image) {
+    auto it = _refs.find(image->getId());
+    if (it != _refs.end()) return it->second;
+
+    bool wasLoaded = image->isLoaded();
+    if (!wasLoaded) image->load();
+    if (!image->_data) return {};
+
+    uint32_t width = image->_width;
+    uint32_t height = image->_height;
+    auto matches = [&](Array const &e) {
+        return e.width == width && e.height == height && e.format == image->_format;
+    };
+    // a matching array with a free layer, else one that can still grow, else a new one
+    auto arrayIt = std::find_if(_arrays.begin(), _arrays.end(), [&](auto &&e) {
+        return matches(e) && (!e.freeLayers.empty() || e.layerCount < e.capacity);
+    });
+    if (arrayIt == _arrays.end()) {
+        GLint maxLayers{};
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        arrayIt = std::find_if(_arrays.begin(), _arrays.end(),
+                               [&](auto &&e) { return matches(e) && e.capacity < uint32_t(maxLayers); });
+        if (arrayIt != _arrays.end()) {
+            grow(*arrayIt);
+        } else {
+            if (_arrays.size() == MAX_MATERIAL_TEXTURE_ARRAYS) {
+                LOG("texture array slots exhausted, texture ignored:", width, "x", height);
+                return {};
+            }
+            Array array{};
+            array.format = image->_format;
+            array.width = width;
+            array.height = height;
+            array.levels = std::floor(std::log2(std::max(width, height))) + 1;
+            grow(array);
+            _arrays.emplace_back(array);
+            arrayIt = _arrays.end() - 1;
+        }
+        updateBudget();
+    }
+
+    uint32_t layer;
+    if (!arrayIt->freeLayers.empty()) {
+        layer = arrayIt->freeLayers.back();
+        arrayIt->freeLayers.pop_back();
+    } else {
+        layer = arrayIt->layerCount++;
+    }
+    GL::updateImageSubData(arrayIt->image, GL::IMAGE_TYPE_2D,
+                           GL::ImageSubData{image->_baseFormat,
+                                            image->_dataType,
+                                            0,
+                                            {{0, 0, (int32_t)layer}, {width, height, 1}},
+                                            image->_data});
+    arrayIt->mipmapDirty = true;
+
+    // the pixels now live in the array
+    if (image->canReload() && (!wasLoaded || TextureManager::getSingleton().getBudget().freeCpuAfterUpload))
+        image->unload();
+
+    MaterialTextureRef ref{uint32_t(arrayIt - _arrays.begin()) + 1, layer};
+    _refs.emplace(image->getId(), ref);
+    return ref;
+}
+void TextureArrayPool::removeImage(Image *image) {
+    auto it = _refs.find(image->getId());
+    if (it == _refs.end()) return;
+    // gl orders the upload of the next image after the draws that still sample this one
+    _arrays[it->second.x - 1].freeLayers.emplace_back(it->second.y);
+    _refs.erase(it);
+}
+void TextureArrayPool::updateImage(Image *image) {
+    auto it = _refs.find(image->getId());
+    if (it == _refs.end() || it->second == MaterialTextureRef{}) return;
+    auto &&array = _arrays[it->second.x - 1];
+
+    bool wasLoaded = image->isLoaded();
+    if (!wasLoaded) image->load();
+    if (!image->_data) return;
+    if (uint32_t(image->_width) != array.width || uint32_t(image->_height) != array.height ||
+        image->_format != array.format) {
+        LOG("image size or format changed, restart to update texture array", image->_path);
+        return;
+    }
+    GL::updateImageSubData(array.image, GL::IMAGE_TYPE_2D,
+                           GL::ImageSubData{image->_baseFormat,
+                                            image->_dataType,
+                                            0,
+                                            {{0, 0, (int32_t)it->second.y}, {array.width, array.height, 1}},
+                                            image->_data});
+    array.mipmapDirty = true;
+    if (image->canReload() && (!wasLoaded || TextureManager::getSingleton().getBudget().freeCpuAfterUpload))
+        image->unload();
+}
+void TextureArrayPool::bind() {
+    auto target = Map(GL::IMAGE_TYPE_2D, false);
+    for (uint32_t i = 0; i < _arrays.size(); ++i) {
+        auto &&e = _arrays[i];
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(target, e.image);
+        if (e.mipmapDirty) {
+            glGenerateMipmap(target);
+            e.mipmapDirty = false;
+        }
+    }
+}
+void TextureArrayPool::updateBudget() const { TextureManager::getSingleton().setExternalGpuBytes(getGpuBytes()); }
+size_t TextureArrayPool::getGpuBytes() const {
+    size_t ret{};
+    for (auto &&e : _arrays) {
+        for (uint32_t i = 0; i < e.levels; ++i)
+            ret += size_t(std::max(1u, e.width >> i)) * std::max(1u, e.height >> i) * e.capacity *
+                   GL::getFormatSize(e.format);
+    }
+    return ret;
+}
+
+//===============================
+namespace {
+size_t computeStride(MaterialBindingModel model) {
+    if (model != MATERIAL_BINDING_PER_DRAW) return sizeof(MaterialEntry);
+    // slots are bound as ubo ranges, offsets must be aligned
+    GLint alignment{};
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    return (sizeof(MaterialEntry) + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+MaterialTable::MaterialTable()
+    : _bindingModel(detectBindingModel()),
+      _textureConnections{
+          TextureManager::getSingleton().textureReloadedSignal.Connect([this](Texture *texture) {
+              if (_bindingModel == MATERIAL_BINDING_TEXTURE_ARRAY) _arrayPool.updateImage(texture->getImage());
+          }),
+          TextureManager::getSingleton().textureStorageChangedSignal.Connect([this](Texture *texture) {
+              if (_bindingModel == MATERIAL_BINDING_BINDLESS && _textureSlots.count(texture))
+                  _staleTextures.emplace_back(texture);
+          })} {
+    _stride = computeStride(_bindingModel);
+}
+MaterialTable::~MaterialTable() {
+    for (auto &&e : _textureConnections) e.Disconnect();
+    glDeleteBuffers(1, &_buffer);
+}
+MaterialBindingModel MaterialTable::detectBindingModel() {
+    // gl_BaseInstance in the vertex shader carries the material index
+    bool hasDrawParameters = GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters;
+    bool hasSSBO = GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object;
+    if (!hasDrawParameters || !hasSSBO) return MATERIAL_BINDING_PER_DRAW;
+    if (GLEW_ARB_bindless_texture) return MATERIAL_BINDING_BINDLESS;
+    return MATERIAL_BINDING_TEXTURE_ARRAY;
+}
+void MaterialTable::setBindingModel(MaterialBindingModel model) {
+    if (_slotCount) {
+        LOG("material binding model cannot change once materials are prepared");
+        return;
+    }
+    auto supported = detectBindingModel();
+    if (model > supported) {
+        LOG("material binding model", model, "not supported, fall back to", supported);
+        model = supported;
+    }
+    _bindingModel = model;
+    _stride = computeStride(model);
+}
+std::vector<std::string> MaterialTable::getShaderDefines() const {
+    switch (_bindingModel) {
+        case MATERIAL_BINDING_TEXTURE_ARRAY:
+            return {"MATERIAL_BINDING_TEXTURE_ARRAY",
+                    "MAX_MATERIAL_TEXTURE_ARRAYS " + std::to_string(MAX_MATERIAL_TEXTURE_ARRAYS)};
+        case MATERIAL_BINDING_BINDLESS:
+            return {"MATERIAL_BINDING_BINDLESS"};
+        default:
+            return {};
+    }
+}
+uint32_t MaterialTable::allocateSlot() {
+    uint32_t slot;
+    if (!_freeSlots.empty()) {
+        slot = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        slot = _slotCount++;
+        _mirror.resize(_slotCount * _stride);
+        _entryTextures.emplace_back();
+        _dirtyBits.resize((_slotCount + 63) / 64);
+    }
+    entry(slot) = MaterialEntry{};
+    markDirty(slot);
+    return slot;
+}
+void MaterialTable::freeSlot(uint32_t slot) {
+    setEntryTextures(slot, {});
+    _freeSlots.emplace_back(slot);
+}
+void MaterialTable::setEntryTextures(uint32_t slot, std::array<Texture *, 2> const &textures) {
+    if (isEnabled()) {
+        // add before remove, a texture the entry keeps must not lose its array layer on the way
+        for (auto texture : textures)
+            if (texture) _textureSlots[texture].emplace_back(slot);
+        for (auto texture : _entryTextures[slot]) {
+            auto it = _textureSlots.find(texture);
+            if (it == _textureSlots.end()) continue;
+            // one reference each, base color and normal may be the same texture
+            it->second.erase(std::find(it->second.begin(), it->second.end(), slot));
+            if (!it->second.empty()) continue;
+            _textureSlots.erase(it);
+            if (_bindingModel == MATERIAL_BINDING_TEXTURE_ARRAY) _arrayPool.removeImage(texture->getImage());
+        }
+    }
+    _entryTextures[slot] = textures;
+}
+void MaterialTable::refreshBindlessRefs(uint32_t slot) {
+    auto &&e = entry(slot);
+    auto baseColorTex = makeRef(_entryTextures[slot][0], 0);
+    auto normalTex = makeRef(_entryTextures[slot][1], 1);
+    if (baseColorTex != e.baseColorTex || normalTex != e.normalTex) {
+        e.baseColorTex = baseColorTex;
+        e.normalTex = normalTex;
+        markDirty(slot);
+    }
+}
+MaterialTextureRef MaterialTable::makeRef(Texture *texture, uint32_t textureUnit) {
+    if (!texture) return {};
+    switch (_bindingModel) {
+        case MATERIAL_BINDING_BINDLESS: {
+            auto handle = texture->getBindlessHandle();
+            return {uint32_t(handle), uint32_t(handle >> 32)};
+        }
+        case MATERIAL_BINDING_TEXTURE_ARRAY:
+            return _arrayPool.addImage(texture->getImage());
+        default:
+            return {textureUnit + 1, 0};
+    }
+}
+void MaterialTable::setEntry(uint32_t slot, MaterialEntry const &value, Texture *baseColorTexture,
+                             Texture *normalTexture) {
+    auto &&e = entry(slot);
+    e = value;
+    e.baseColorTex = makeRef(baseColorTexture, 0);
+    e.normalTex = makeRef(normalTexture, 1);
+    setEntryTextures(slot, {baseColorTexture, normalTexture});
+    markDirty(slot);
+}
+void MaterialTable::upload() {
+    _lastUploadStats = {};
+
+    auto size = _slotCount * _stride;
+    if (_bufferCapacity < size) {
+        glDeleteBuffers(1, &_buffer);
+        _bufferCapacity = std::max(size, _bufferCapacity * 2);
+        GL::createBuffer(GL::BufferCreateInfo{{}, _bufferCapacity, GL::BUFFER_STORAGE_DYNAMIC_STORAGE_BIT}, nullptr,
+                         &_buffer);
+        // the new buffer is empty, send everything
+        std::fill(_dirtyBits.begin(), _dirtyBits.end(), ~uint64_t(0));
+        ++_lastUploadStats.reallocations;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+    auto isDirty = [this](uint32_t slot) { return (_dirtyBits[slot / 64] >> (slot % 64)) & 1; };
+    uint32_t slot = 0;
+    while (slot < _slotCount) {
+        // skip clean words quickly
+        if (_dirtyBits[slot / 64] == 0) {
+            slot = (slot / 64 + 1) * 64;
+            continue;
+        }
+        if (!isDirty(slot)) {
+            ++slot;
+            continue;
+        }
+        // extend the range over dirty slots and over short gaps of clean ones
+        uint32_t first = slot, last = slot;
+        for (uint32_t i = slot + 1; i < _slotCount && i <= last + mergeGap + 1; ++i) {
+            if (isDirty(i)) {
+                last = i;
+                ++_lastUploadStats.materials;
+            }
+        }
+        ++_lastUploadStats.materials;
+        auto offset = first * _stride;
+        auto bytes = (last - first + 1) * _stride;
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, _mirror.data() + offset);
+        ++_lastUploadStats.ranges;
+        _lastUploadStats.bytes += bytes;
+        slot = last + 1;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    std::fill(_dirtyBits.begin(), _dirtyBits.end(), 0);
+
+    _totalUploadStats.bytes += _lastUploadStats.bytes;
+    _totalUploadStats.ranges += _lastUploadStats.ranges;
+    _totalUploadStats.materials += _lastUploadStats.materials;
+    _totalUploadStats.reallocations += _lastUploadStats.reallocations;
+}
+void MaterialTable::bind() {
+    if (!_slotCount) return;
+
+    if (_bindingModel == MATERIAL_BINDING_BINDLESS) {
+        // the residency manager recreated or freed the storage of these since the last frame
+        for (auto texture : _staleTextures) {
+            auto it = _textureSlots.find(texture);
+            if (it == _textureSlots.end()) continue;
+            for (auto slot : it->second) refreshBindlessRefs(slot);
+        }
+        _staleTextures.clear();
+    } else if (_bindingModel == MATERIAL_BINDING_TEXTURE_ARRAY) {
+        _arrayPool.bind();
+    }
+
+    upload();
+    if (isEnabled()) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_TABLE_BINDING, _buffer);
+}
+void MaterialTable::bindSlot(uint32_t slot) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, 3, _buffer, slot * _stride, sizeof(MaterialEntry));
+}
+void MaterialTable::recordBindSlot(GL::CommandBuffer &cmd, uint32_t slot) const {
+    cmd.bindBufferRange(GL_UNIFORM_BUFFER, 3, _buffer, uint32_t(slot * _stride), sizeof(MaterialEntry));
+}
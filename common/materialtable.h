@@ -0,0 +1,204 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "commandbuffer.h"
+#include "idObject.h"
+#include "image.h"
+#include "prerequisites.h"
+#include "texture.h"
+
+enum MaterialBindingModel {
+    MATERIAL_BINDING_PER_DRAW,       // material ubo and texture units bound for every draw
+    MATERIAL_BINDING_TEXTURE_ARRAY,  // material ssbo, textures packed into arrays grouped by size and format
+    MATERIAL_BINDING_BINDLESS,       // material ssbo holding ARB_bindless_texture handles
+};
+
+// texture units 0 .. MAX_MATERIAL_TEXTURE_ARRAYS-1 are used by the texture array binding model
+constexpr uint32_t MAX_MATERIAL_TEXTURE_ARRAYS = 16;
+
+// ssbo binding point of the material table
+constexpr uint32_t MATERIAL_TABLE_BINDING = 0;
+
+/**
+ * @brief reference to a texture from the material table, {0, 0} means no texture
+ * bindless: 64 bit handle split in lo/hi, texture array: {array index + 1, layer}, per draw: {texture unit + 1, 0}
+ */
+using MaterialTextureRef = glm::uvec2;
+
+/**
+ * @brief std430/std140 layout, must match MaterialEntry and UBOMaterial in blinnphong.frag
+ */
+struct MaterialEntry {
+    glm::vec4 baseColor{1, 1, 1, 1};
+    float shininess{200};
+    uint32_t pad0{};
+    MaterialTextureRef baseColorTex{};
+    MaterialTextureRef normalTex{};
+    uint32_t pad1[2]{};
+};
+static_assert(sizeof(MaterialEntry) == 48);
+
+/**
+ * @brief all material textures of the same size and format share one GL_TEXTURE_2D_ARRAY
+ */
+class TextureArrayPool {
+    struct Array {
+        GL::ImageHandle image{};
+        GL::Format format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        uint32_t layerCount{};
+        uint32_t capacity{};
+        // layers below layerCount whose image was removed, filled again before the array grows
+        std::vector<uint32_t> freeLayers;
+        bool mipmapDirty{false};
+    };
+    std::vector<Array> _arrays;
+
+    // image id -> ref
+    std::unordered_map<IdType, MaterialTextureRef> _refs;
+
+    void grow(Array &array);
+    // reports getGpuBytes() to the TextureManager budget
+    void updateBudget() const;
+
+public:
+    ~TextureArrayPool();
+
+    /**
+     * @brief copy the image into a layer of a matching array, the same image is only added once
+     *
+     * @return {0, 0} if the image has no data or all array slots are used by other sizes/formats
+     */
+    MaterialTextureRef addImage(Image *image);
+
+    /**
+     * @brief give the layer of the image back to its array, the next image of the same size and format takes it
+     */
+    void removeImage(Image *image);
+
+    /**
+     * @brief upload the pixels of an already added image again, its size and format must not change
+     */
+    void updateImage(Image *image);
+
+    /**
+     * @brief generate pending mipmaps and bind array i to texture unit i
+     */
+    void bind();
+
+    size_t getArrayCount() const { return _arrays.size(); }
+    size_t getGpuBytes() const;
+};
+
+struct MaterialUploadStats {
+    uint64_t bytes;       // bytes sent with glBufferSubData
+    uint32_t ranges;      // number of glBufferSubData calls
+    uint32_t materials;   // dirty materials uploaded
+    uint32_t reallocations;
+};
+
+/**
+ * @brief parameters of every material in one contiguous gpu array, indexed by material slot
+ * ssbo models read it in shaders with gl_BaseInstance, switching material is then free and draws of different
+ * materials can be merged. the per draw model binds the slot range as ubo 3.
+ * edits only mark slots dirty, dirty slots are coalesced into range uploads once per frame in bind()
+ */
+class MaterialTable : public Singleton<MaterialTable> {
+    MaterialBindingModel _bindingModel;
+
+    // cpu mirror of the gpu array, entries are _stride bytes apart
+    std::vector<std::byte> _mirror;
+    size_t _stride{sizeof(MaterialEntry)};
+    uint32_t _slotCount{};
+    std::vector<uint32_t> _freeSlots;
+
+    // source textures of each entry
+    std::vector<std::array<Texture *, 2>> _entryTextures;
+
+    // slots referencing each texture. bindless: handles are resolved again only for textures whose storage changed
+    // since the last bind(). texture array: the layer is freed once no slot references the texture
+    std::unordered_map<Texture *, std::vector<uint32_t>> _textureSlots;
+    std::vector<Texture *> _staleTextures;
+    // TextureManager outlives the table
+    std::array<Connection, 2> _textureConnections;
+
+    // one bit per slot
+    std::vector<uint64_t> _dirtyBits;
+
+    GL::BufferHandle _buffer{};
+    size_t _bufferCapacity{};
+
+    MaterialUploadStats _lastUploadStats{};
+    MaterialUploadStats _totalUploadStats{};
+
+    TextureArrayPool _arrayPool;
+
+    MaterialTextureRef makeRef(Texture *texture, uint32_t textureUnit);
+    MaterialEntry &entry(uint32_t slot) { return *reinterpret_cast<MaterialEntry *>(_mirror.data() + slot * _stride); }
+    void markDirty(uint32_t slot) { _dirtyBits[slot / 64] |= uint64_t(1) << (slot % 64); }
+    void setEntryTextures(uint32_t slot, std::array<Texture *, 2> const &textures);
+    void refreshBindlessRefs(uint32_t slot);
+    void upload();
+
+public:
+    // clean slots between two dirty ranges up to which the ranges are merged into one upload
+    uint32_t mergeGap{4};
+
+    MaterialTable();
+    ~MaterialTable();
+
+    /**
+     * @brief best model supported by the context, bindless > texture array > per draw
+     */
+    static MaterialBindingModel detectBindingModel();
+
+    /**
+     * @brief must be called before any material is prepared, unsupported models fall back to the detected one
+     */
+    void setBindingModel(MaterialBindingModel model);
+    constexpr MaterialBindingModel getBindingModel() const { return _bindingModel; }
+    constexpr bool isEnabled() const { return _bindingModel != MATERIAL_BINDING_PER_DRAW; }
+
+    /**
+     * @brief shader defines selecting the binding model in blinnphong.frag
+     */
+    std::vector<std::string> getShaderDefines() const;
+
+    uint32_t allocateSlot();
+    void freeSlot(uint32_t slot);
+
+    /**
+     * @brief only updates the cpu mirror, the slot is uploaded on next bind()
+     * per draw model: textures are expected on unit 0 (base color) and 1 (normal)
+     */
+    void setEntry(uint32_t slot, MaterialEntry const &entry, Texture *baseColorTexture, Texture *normalTexture);
+    MaterialEntry const &getEntry(uint32_t slot) const {
+        return *reinterpret_cast<MaterialEntry const *>(_mirror.data() + slot * _stride);
+    }
+
+    /**
+     * @brief once per frame before drawing, refresh stale bindless handles, upload dirty ranges and bind the table
+     * residency of the textures is up to the draws, see MaterialBlinnPhong::prepareDrawImpl
+     */
+    void bind();
+
+    /**
+     * @brief per draw model, bind the parameters of one slot as ubo 3
+     */
+    void bindSlot(uint32_t slot) const;
+    void recordBindSlot(GL::CommandBuffer &cmd, uint32_t slot) const;
+
+    constexpr GL::BufferHandle getBuffer() const { return _buffer; }
+
+    size_t getMaterialCount() const { return _slotCount - _freeSlots.size(); }
+    size_t getTextureArrayCount() const { return _arrayPool.getArrayCount(); }
+
+    constexpr MaterialUploadStats const &getLastUploadStats() const { return _lastUploadStats; }
+    constexpr MaterialUploadStats const &getTotalUploadStats() const { return _totalUploadStats; }
+};
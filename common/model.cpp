@@ -4,6 +4,9 @@
 #include <filesystem>
 
 #include "common.h"
+#include "filewatcher.h"
+#include "fileview.h"
+#include "jobsystem.h"
 #include "node.h"
 #include "transform.h"
 
@@ -12,106 +15,162 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+namespace {
+// read .mtl files through a mapped view instead of an ifstream
+class MaterialFileViewReader : public tinyobj::MaterialReader {
+    std::string _baseDir;
+
+public:
+    explicit MaterialFileViewReader(std::string_view baseDir) : _baseDir(baseDir) {}
+    bool operator()(const std::string &matId, std::vector<tinyobj::material_t> *materials,
+                    std::map<std::string, int> *matMap, std::string *warn, std::string *err) override {
+        auto path = _baseDir.empty() ? matId : _baseDir + "/" + matId;
+        FileView file;
+        if (!file.open(path)) {
+            if (warn) (*warn) += "Material file [ " + path + " ] not found.\n";
+            return false;
+        }
+        FileViewStream stream(file);
+        std::string warning, error;
+        tinyobj::LoadMtl(matMap, materials, &stream, &warning, &error);
+        if (warn) (*warn) += warning;
+        if (err) (*err) += error;
+        return true;
+    }
+};
+}  // namespace
+
 bool ModelLoaderObj::load(Model *dstModel) {
     auto parentPath = std::filesystem::path(dstModel->path).parent_path();
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.mtl_search_path = parentPath.string();  // Path to material files
 
-    tinyobj::ObjReader reader;
+    FileView objFile;
+    if (!objFile.open(dstModel->path)) {
+        LOG("failed to open model file", dstModel->path);
+        return false;
+    }
+    FileViewStream objStream(objFile);
+    MaterialFileViewReader mtlReader(parentPath.string());
 
-    if (!reader.ParseFromFile(std::string(dstModel->path), reader_config)) {
-        if (!reader.Error().empty()) {
-            std::cerr << "TinyObjReader: " << reader.Error();
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &objStream, &mtlReader)) {
+        if (!err.empty()) {
+            std::cerr << "TinyObjReader: " << err;
         }
-        exit(1);
+        return false;
     }
 
-    if (!reader.Warning().empty()) {
-        std::cout << "TinyObjReader: " << reader.Warning();
+    if (!warn.empty()) {
+        std::cout << "TinyObjReader: " << warn;
     }
 
-    auto &attrib = reader.GetAttrib();
-    auto &shapes = reader.GetShapes();
-    auto &materials = reader.GetMaterials();
-
     std::vector<IdType> materialIds;
+    std::vector<ResourceHandle<Image>> images;
 
-    // parse materials
+    // parse materials, the model references the ones its meshes use once loaded
+    std::vector<ResourceHandle<MaterialBlinnPhong>> newMaterials;
     for (auto &&e : materials) {
         // e.
-        auto material = static_cast<MaterialBlinnPhong *>(
-            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG).get());
+        auto material = newMaterials.emplace_back(static_cast<MaterialBlinnPhong *>(
+            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG).get()));
         materialIds.emplace_back(material->getId());
 
-        // diffuse texture
         material->setBaseColor(glm::vec4(e.diffuse[0], e.diffuse[1], e.diffuse[2], 1.));
         if (!e.diffuse_texname.empty())
-            material->setBaseColorImage(
-                ImageManager::getSingleton().create(parentPath.string() + "/" + e.diffuse_texname));
+            images.emplace_back(ImageManager::getSingleton().create(parentPath.string() + "/" + e.diffuse_texname));
         if (!e.normal_texname.empty())
-            material->setNormalImage(ImageManager::getSingleton().create(parentPath.string() + "/" + e.normal_texname));
+            images.emplace_back(ImageManager::getSingleton().create(parentPath.string() + "/" + e.normal_texname));
+    }
+
+    // decode the textures in parallel, texture creation then finds them loaded
+    {
+        std::vector<Image *> uniqueImages;
+        for (auto &&e : images)
+            if (e && std::find(uniqueImages.begin(), uniqueImages.end(), e.get()) == uniqueImages.end())
+                uniqueImages.emplace_back(e.get());
+        JobSystem::getSingleton().parallelFor((uint32_t)uniqueImages.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (auto i = begin; i < end; ++i) uniqueImages[i]->load();
+        });
+    }
+    for (size_t i = 0, imageIndex = 0; i < materials.size(); ++i) {
+        if (!materials[i].diffuse_texname.empty()) newMaterials[i]->setBaseColorImage(images[imageIndex++].get());
+        if (!materials[i].normal_texname.empty()) newMaterials[i]->setNormalImage(images[imageIndex++].get());
     }
 
     // parse model
     dstModel->nodes.emplace_back(Model::NodeAttribute{-1, -1});
 
+    std::vector<Primitive *> trianglePrimitives;
     for (size_t i = 0; i < shapes.size(); ++i) {
         auto &&shape = shapes[i];
 
         dstModel->meshviews.emplace_back(
-            Model::MeshView{(int)dstModel->meshes.size(), materialIds[shape.mesh.material_ids[0]]});
+            Model::MeshView{(int)dstModel->meshes.size(),
+                            shape.mesh.material_ids[0] < 0 ? INVALID_ID : materialIds[shape.mesh.material_ids[0]]});
 
         auto newMesh = dstModel->meshes.emplace_back(std::make_shared<Mesh>());
         dstModel->nodes.emplace_back(Model::NodeAttribute{(int)i, 0});
 
         auto trianglePrimitive = newMesh->primitives.emplace_back(std::make_unique<Primitive>()).get();
         trianglePrimitive->topology = GL::PrimitiveTopology::TRIANGLE_LIST;
+        trianglePrimitives.emplace_back(trianglePrimitive);
+    }
 
-        size_t indexOffset = 0;
-
-        std::unordered_map<Vertex, uint32_t> vertexIndexMap;
-        Vertex tempVertex;
-
-        // trangulated , fv is 3
-        for (auto face : shape.mesh.num_face_vertices) {
-            for (unsigned char v = 0; v < face; ++v, ++indexOffset) {
-                auto index = shape.mesh.indices[indexOffset];
-                tempVertex = {};
-
-                auto vx = attrib.vertices[3 * index.vertex_index + 0];
-                auto vy = attrib.vertices[3 * index.vertex_index + 1];
-                auto vz = attrib.vertices[3 * index.vertex_index + 2];
-                tempVertex.pos = {vx, vy, vz};
-
-                if (index.normal_index >= 0) {
-                    auto nx = attrib.normals[3 * index.normal_index + 0];
-                    auto ny = attrib.normals[3 * index.normal_index + 1];
-                    auto nz = attrib.normals[3 * index.normal_index + 2];
-                    tempVertex.normal = {nx, ny, nz};
-                }
-                if (index.texcoord_index >= 0) {
-                    auto tx = attrib.texcoords[2 * index.texcoord_index + 0];
-                    auto ty = attrib.texcoords[2 * index.texcoord_index + 1];
-                    tempVertex.texCoord = {tx, ty};
-                }
-                auto it = vertexIndexMap.find(tempVertex);
-                if (it == vertexIndexMap.end()) {
-                    trianglePrimitive->indices.emplace_back(vertexIndexMap[tempVertex] =
-                                                                (uint32_t)trianglePrimitive->positions.size());
-                    trianglePrimitive->positions.emplace_back(tempVertex.pos);
-                    trianglePrimitive->normals.emplace_back(tempVertex.normal);
-                    trianglePrimitive->texcoords.emplace_back(tempVertex.texCoord);
-                    trianglePrimitive->colors.emplace_back(tempVertex.color);
-                } else {
-                    trianglePrimitive->indices.emplace_back(it->second);
+    // every shape welds its vertices into its own primitive, shapes are independent jobs
+    JobSystem::getSingleton().parallelFor((uint32_t)shapes.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (auto i = begin; i < end; ++i) {
+            auto &&shape = shapes[i];
+            auto trianglePrimitive = trianglePrimitives[i];
+
+            size_t indexOffset = 0;
+
+            std::unordered_map<Vertex, uint32_t> vertexIndexMap;
+            Vertex tempVertex;
+
+            // trangulated , fv is 3
+            for (auto face : shape.mesh.num_face_vertices) {
+                for (unsigned char v = 0; v < face; ++v, ++indexOffset) {
+                    auto index = shape.mesh.indices[indexOffset];
+                    tempVertex = {};
+
+                    auto vx = attrib.vertices[3 * index.vertex_index + 0];
+                    auto vy = attrib.vertices[3 * index.vertex_index + 1];
+                    auto vz = attrib.vertices[3 * index.vertex_index + 2];
+                    tempVertex.pos = {vx, vy, vz};
+
+                    if (index.normal_index >= 0) {
+                        auto nx = attrib.normals[3 * index.normal_index + 0];
+                        auto ny = attrib.normals[3 * index.normal_index + 1];
+                        auto nz = attrib.normals[3 * index.normal_index + 2];
+                        tempVertex.normal = {nx, ny, nz};
+                    }
+                    if (index.texcoord_index >= 0) {
+                        auto tx = attrib.texcoords[2 * index.texcoord_index + 0];
+                        auto ty = attrib.texcoords[2 * index.texcoord_index + 1];
+                        tempVertex.texCoord = {tx, ty};
+                    }
+                    auto it = vertexIndexMap.find(tempVertex);
+                    if (it == vertexIndexMap.end()) {
+                        trianglePrimitive->indices.emplace_back(vertexIndexMap[tempVertex] =
+                                                                    (uint32_t)trianglePrimitive->positions.size());
+                        trianglePrimitive->positions.emplace_back(tempVertex.pos);
+                        trianglePrimitive->normals.emplace_back(tempVertex.normal);
+                        trianglePrimitive->texcoords.emplace_back(tempVertex.texCoord);
+                        trianglePrimitive->colors.emplace_back(tempVertex.color);
+                    } else {
+                        trianglePrimitive->indices.emplace_back(it->second);
+                    }
                 }
             }
+            trianglePrimitive->positions.shrink_to_fit();
+            trianglePrimitive->normals.shrink_to_fit();
+            trianglePrimitive->texcoords.shrink_to_fit();
+            trianglePrimitive->indices.shrink_to_fit();
         }
-        trianglePrimitive->positions.shrink_to_fit();
-        trianglePrimitive->normals.shrink_to_fit();
-        trianglePrimitive->texcoords.shrink_to_fit();
-        trianglePrimitive->indices.shrink_to_fit();
-    }
+    });
     return true;
 }
 //=======================================
@@ -270,7 +329,7 @@ void Primitive::upload() {
 
     _uploaded = true;
 }
-void Primitive::draw() {
+void Primitive::draw(uint32_t firstInstance) {
     glBindVertexBuffer(0, _positionBuffer, 0, sizeof(float) * 3);
     if (_normalBuffer) glBindVertexBuffer(1, _normalBuffer, 0, sizeof(float) * 3);
     if (_texcoordBuffer) glBindVertexBuffer(2, _texcoordBuffer, 0, sizeof(float) * 2);
@@ -279,35 +338,112 @@ void Primitive::draw() {
     if (_indexBuffer) {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
         // bind indexbuffer
-        GL::DrawIndexed(topology, GL::DataType::DATA_TYPE_UNSIGNED_INT, _drawIndexedIndirectCmd);
+        auto cmd = _drawIndexedIndirectCmd;
+        cmd.firstInstance = firstInstance;
+        GL::DrawIndexed(topology, GL::DataType::DATA_TYPE_UNSIGNED_INT, cmd);
     } else {
-        GL::Draw(topology, _drawIndirectCmd);
+        auto cmd = _drawIndirectCmd;
+        cmd.firstInstance = firstInstance;
+        GL::Draw(topology, cmd);
     }
 }
+void Primitive::record(GL::CommandBuffer &cmd, uint32_t firstInstance) const {
+    cmd.bindVertexBuffer(0, _positionBuffer, 0, sizeof(float) * 3);
+    if (_normalBuffer) cmd.bindVertexBuffer(1, _normalBuffer, 0, sizeof(float) * 3);
+    if (_texcoordBuffer) cmd.bindVertexBuffer(2, _texcoordBuffer, 0, sizeof(float) * 2);
+    if (_colordBuffer) cmd.bindVertexBuffer(3, _colordBuffer, 0, sizeof(float) * 4);
+
+    if (_indexBuffer) {
+        cmd.bindIndexBuffer(_indexBuffer);
+        auto drawCmd = _drawIndexedIndirectCmd;
+        drawCmd.firstInstance = firstInstance;
+        cmd.drawIndexed(topology, GL::DataType::DATA_TYPE_UNSIGNED_INT, drawCmd);
+    } else {
+        auto drawCmd = _drawIndirectCmd;
+        drawCmd.firstInstance = firstInstance;
+        cmd.draw(topology, drawCmd);
+    }
+}
+size_t Primitive::getDataSize() const {
+    return positions.size() * sizeof(glm::vec3) + normals.size() * sizeof(glm::vec3) +
+           texcoords.size() * sizeof(glm::vec2) + colors.size() * sizeof(glm::vec4) + indices.size() * sizeof(uint32_t);
+}
 Primitive::~Primitive() {
-    glDeleteBuffers(1, &_positionBuffer);
-    glDeleteBuffers(1, &_normalBuffer);
-    glDeleteBuffers(1, &_texcoordBuffer);
-    glDeleteBuffers(1, &_colordBuffer);
-    glDeleteBuffers(1, &_indexBuffer);
+    if (!_uploaded) return;
+    ResourceManager::getSingleton().deferRelease(
+        [buffers = std::array{_positionBuffer, _normalBuffer, _texcoordBuffer, _colordBuffer, _indexBuffer}] {
+            glDeleteBuffers(static_cast<GLsizei>(buffers.size()), buffers.data());
+        },
+        getDataSize());
 }
 //=======================================
-Model::Model(std::string_view path, ModelLoader *loader) : path(path), loader(loader) {
+Model::Model(std::string_view path, ModelLoader *loader) : Resource(RESOURCE_MODEL), path(path), loader(loader) {
     name = std::filesystem::path(path).filename().string();
     load();
 }
 void Model::load() {
     if (loaded || !loader) return;
-    std::fstream fs(path.data());
-    if (fs.is_open()) {
-        loader->load(this);
-        loaded = true;
+    setState(RESOURCE_STATE_LOADING);
+    // an fstream opens read-write, closing it is a write to the AssetReloader and the model reloaded itself forever
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        setState(RESOURCE_STATE_FAILED);
+        LOG("failed to load image", name, "path ", path);
+        return;
+    }
+    loaded = loader->load(this);
+    if (!loaded) {
+        setState(RESOURCE_STATE_FAILED);
         return;
     }
-    LOG("failed to load image", name, "path ", path);
+    referenceMaterials();
+    for (auto &&mesh : meshes)
+        for (auto &&e : mesh->primitives) e->upload();
+    updateMemory();
+    setState(RESOURCE_STATE_LOADED);
+}
+void Model::referenceMaterials() {
+    for (auto &&e : meshviews) addDependency(MaterialManager::getSingleton().getMaterial(e.materialId).get());
+}
+void Model::updateMemory() {
+    if (!loader) return;
+    size_t cpuBytes{}, gpuBytes{};
+    for (auto &&mesh : meshes) {
+        for (auto &&e : mesh->primitives) {
+            cpuBytes += e->getDataSize();
+            if (e->_uploaded) gpuBytes += e->getDataSize();
+        }
+    }
+    setCpuBytes(cpuBytes);
+    setGpuBytes(gpuBytes);
+}
+bool Model::reload() {
+    if (!loader) return false;
+    Model newModel;
+    newModel.path = path;
+    newModel.loader = loader;
+    newModel.load();
+
+    // materials created by the new parse are not used, the scene keeps the current ones. only newModel references
+    // them, they are collected after it
+    if (!newModel.loaded) return false;
+    if (newModel.meshes.size() != meshes.size()) {
+        LOG("mesh count of", name, "changed, re-add the model to see the new meshes");
+        return false;
+    }
+    // mesh objects are shared with the renderers, swap their content in place. the replaced primitives are
+    // destroyed with newModel, which queues their buffers for release
+    for (size_t i = 0; i < meshes.size(); ++i) meshes[i]->primitives.swap(newModel.meshes[i]->primitives);
+    updateMemory();
+    return true;
 }
 //=======================================
-ModelManager::ModelManager() { registerModelLoader<ModelLoaderObj>("obj"); }
+ModelManager::ModelManager() {
+    // models release their materials and queue their buffers on destruction
+    MaterialManager::getSingleton();
+    ResourceManager::getSingleton();
+    registerModelLoader<ModelLoaderObj>("obj");
+}
 ModelLoader *ModelManager::getModelLoader(std::string_view name) const {
     auto it = _modelLoaders.find(std::string(name));
     if (it == _modelLoaders.cend()) {
@@ -315,12 +451,48 @@ ModelLoader *ModelManager::getModelLoader(std::string_view name) const {
     }
     return it->second.get();
 }
-Model *ModelManager::createModel(std::string_view path, std::string_view modelLoaderName) {
+ResourceHandle<Model> ModelManager::addModel(std::unique_ptr<Model> model) {
+    auto ret = _models.emplace(model->getId(), std::move(model)).first->get();
+    // built in code, loaded models did this in load()
+    if (!ret->loader) {
+        ret->referenceMaterials();
+        ret->setState(RESOURCE_STATE_LOADED);
+    }
+    return ret;
+}
+std::string ModelManager::getModelKey(std::string_view path) {
+    // two spellings of a file share the model, two files of the same name in different directories do not
+    std::error_code ec;
+    auto ret = std::filesystem::weakly_canonical(std::filesystem::path(path), ec);
+    if (ec) ret = std::filesystem::absolute(std::filesystem::path(path), ec);
+    return ret.lexically_normal().generic_string();
+}
+ResourceHandle<Model> ModelManager::createModel(std::string_view path, std::string_view modelLoaderName) {
+    auto key = getModelKey(path);
+    if (auto it = _modelIds.find(key); it != _modelIds.end()) return getModel(it->second);
     auto loader = getModelLoader(modelLoaderName);
-    auto model = new Model(path, loader);
-    return _models.emplace(std::string(model->name), std::unique_ptr<Model>(model)).first->second.get();
+    // the model keeps the canonical path, collectGarbage finds its entry with it
+    auto model = addModel(std::make_unique<Model>(key, loader));
+    _modelIds.emplace(key, model->getId());
+    model->_watchId = AssetReloader::getSingleton().watch(path, [model = model.get()] { model->reload(); });
+    return model;
 }
-Model *ModelManager::createLine(glm::vec3 const &p0, glm::vec3 const &p1) {
+size_t ModelManager::collectGarbage() {
+    return eraseUnreferenced(_models, [this](Model &model) {
+        if (model._watchId) AssetReloader::getSingleton().unwatch(model._watchId);
+        if (!model.loader) return;
+        if (auto it = _modelIds.find(model.path); it != _modelIds.end() && it->second == model.getId())
+            _modelIds.erase(it);
+    });
+}
+void ModelManager::clear() {
+    auto referenced = eraseAll(_models, [](Model &model) {
+        if (model._watchId) AssetReloader::getSingleton().unwatch(model._watchId);
+    });
+    if (referenced) LOG(referenced, "models still referenced at shutdown");
+    _modelIds.clear();
+}
+ResourceHandle<Model> ModelManager::createLine(glm::vec3 const &p0, glm::vec3 const &p1) {
     std::string name = "line";
     auto model = new Model(name);
     auto mesh = MeshFactory::getSingleton().createLine(p0, p1);
@@ -328,10 +500,9 @@ Model *ModelManager::createLine(glm::vec3 const &p0, glm::vec3 const &p1) {
     model->meshes.emplace_back(mesh);
     model->meshviews = {{0, material->getId()}};
     model->nodes = {{0, -1}};
-    _models.emplace(name, std::unique_ptr<Model>(model));
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createQuad(glm::vec2 size, int countx, int county) {
+ResourceHandle<Model> ModelManager::createQuad(glm::vec2 size, int countx, int county) {
     std::string name = "quad";
     auto model = new Model(name);
     auto mesh = MeshFactory::getSingleton().createQuad(size, countx, county);
@@ -339,10 +510,9 @@ Model *ModelManager::createQuad(glm::vec2 size, int countx, int county) {
     model->meshes = {mesh};
     model->meshviews = {{0, material->getId()}};
     model->nodes = {{0, -1}};
-    _models.emplace(name, std::unique_ptr<Model>(model));
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createAxis() {
+ResourceHandle<Model> ModelManager::createAxis() {
     std::string name = "axis";
     auto model = new Model(name);
     auto mesh = MeshFactory::getSingleton().createAxis();
@@ -350,10 +520,9 @@ Model *ModelManager::createAxis() {
     model->meshes = {mesh};
     model->meshviews = {{0, material->getId()}};
     model->nodes = {{0, -1}};
-    _models.emplace(name, std::unique_ptr<Model>(model));
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createSphere(float radius) {
+ResourceHandle<Model> ModelManager::createSphere(float radius) {
     std::string name = "sphere";
     auto model = new Model(name);
     auto mesh = MeshFactory::getSingleton().createSphere();
@@ -361,10 +530,9 @@ Model *ModelManager::createSphere(float radius) {
     model->meshes = {mesh};
     model->meshviews = {{0, material->getId()}};
     model->nodes = {{0, -1}};
-    _models.emplace(name, std::unique_ptr<Model>(model));
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createCube(glm::vec3 const &size) {
+ResourceHandle<Model> ModelManager::createCube(glm::vec3 const &size) {
     std::string name = "cube";
     auto model = new Model(name);
     auto mesh = MeshFactory::getSingleton().createCube();
@@ -372,18 +540,17 @@ Model *ModelManager::createCube(glm::vec3 const &size) {
     model->meshes = {mesh};
     model->meshviews = {{0, material->getId()}};
     model->nodes = {{0, -1}};
-    _models.emplace(name, std::unique_ptr<Model>(model));
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createTestModel1() {
+ResourceHandle<Model> ModelManager::createTestModel1() {
     std::string name = "model1";
     auto model = new Model(name);
 
     auto mesh = MeshFactory::getSingleton().createCube();
     auto material0 = MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG);
     auto material1 = MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG);
-    std::static_pointer_cast<MaterialBlinnPhong>(material0)->setBaseColor(glm::vec4(1, 0, 0, 1));
-    std::static_pointer_cast<MaterialBlinnPhong>(material1)->setBaseColor(glm::vec4(0, 1, 0, 1));
+    static_cast<MaterialBlinnPhong *>(material0.get())->setBaseColor(glm::vec4(1, 0, 0, 1));
+    static_cast<MaterialBlinnPhong *>(material1.get())->setBaseColor(glm::vec4(0, 1, 0, 1));
 
     model->meshes = {mesh};
     model->meshviews = {{0, material0->getId()}, {0, material1->getId()}};
@@ -392,23 +559,17 @@ Model *ModelManager::createTestModel1() {
         {0, -1, {0, 2, 0}, {1, 0, 0, 0}, {0.2, 2, 0.2}},
         {1, 0, {0, 3, 0}, {1, 0, 0, 0}, {0.2, 1, 0.2}},
     };
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
-Model *ModelManager::createTestModel2() {
+ResourceHandle<Model> ModelManager::createTestModel2() {
     std::string name = "model2";
     auto model = new Model(name);
 
     auto mesh = MeshFactory::getSingleton().createCube();
-    std::vector<std::shared_ptr<MaterialBlinnPhong>> materials{
-        std::static_pointer_cast<MaterialBlinnPhong>(
-            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG)),
-        std::static_pointer_cast<MaterialBlinnPhong>(
-            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG)),
-        std::static_pointer_cast<MaterialBlinnPhong>(
-            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG)),
-        std::static_pointer_cast<MaterialBlinnPhong>(
-            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG)),
-    };
+    std::vector<ResourceHandle<MaterialBlinnPhong>> materials;
+    for (int i = 0; i < 4; ++i)
+        materials.emplace_back(static_cast<MaterialBlinnPhong *>(
+            MaterialManager::getSingleton().createMaterial(MATERIAL_BLINNPHONG).get()));
     materials[1]->setBaseColor({1, 0, 0, 1});
     materials[2]->setBaseColor({0, 1, 0, 1});
     materials[3]->setBaseColor({0, 0, 1, 1});
@@ -435,7 +596,7 @@ Model *ModelManager::createTestModel2() {
         {1, 7, {0, -2, 0}, {1, 0, 0, 0}, {0.5, 1, 0.5}},
     };
 
-    return model;
+    return addModel(std::unique_ptr<Model>(model));
 }
 //===========================================
 MeshRenderer::MeshRenderer(Node *parent, std::shared_ptr<Mesh> mesh) : Renderer(parent), _mesh(mesh) {
@@ -443,20 +604,33 @@ MeshRenderer::MeshRenderer(Node *parent, std::shared_ptr<Mesh> mesh) : Renderer(
         e->upload();
     }
 }
+Material *MeshRenderer::getDrawMaterial() const {
+    return _material ? _material.get() : MaterialManager::getSingleton().getDefaultMaterial(MATERIAL_UNLITCOLOR);
+}
 void MeshRenderer::draw(bool bindTechnique) {
-    if (_material)
-        _material->bind(bindTechnique);
-    else
-        MaterialManager::getSingleton().getDefaultMaterial(MATERIAL_UNLITCOLOR)->bind(bindTechnique);
+    auto material = getDrawMaterial();
+    material->bind(bindTechnique);
 
     glBindBufferRange(GL_UNIFORM_BUFFER, 0, _parent->getComponent<Transform>()->getTransformBufferHandle(), 0,
                       sizeof(glm::mat4));
 
     for (auto &&e : _mesh->primitives) {
-        e->draw();
+        e->draw(material->tableSlot);
+    }
+}
+void MeshRenderer::prepareDraw() { getDrawMaterial()->prepareDraw(); }
+void MeshRenderer::record(GL::CommandBuffer &cmd) const {
+    auto material = getDrawMaterial();
+    material->record(cmd);
+
+    cmd.bindBufferRange(GL_UNIFORM_BUFFER, 0, _parent->getComponent<Transform>()->getTransformBufferHandle(), 0,
+                        sizeof(glm::mat4));
+
+    for (auto &&e : _mesh->primitives) {
+        e->record(cmd, material->tableSlot);
     }
 }
-void MeshRenderer::setMaterial(uint32_t materialId) {
+void MeshRenderer::setMaterial(IdType materialId) {
     _material = MaterialManager::getSingleton().getMaterial(materialId);
 }
-void MeshRenderer::setMaterial(std::shared_ptr<Material> material) { _material = material; }
\ No newline at end of file
+void MeshRenderer::setMaterial(ResourceHandle<Material> material) { _material = std::move(material); }
\ No newline at end of file
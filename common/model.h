@@ -9,7 +9,9 @@
 #include "material.h"
 #include "prerequisites.h"
 #include "renderer.h"
+#include "resource.h"
 #include "singleton.h"
+#include "slotmap.h"
 
 class Model;
 
@@ -53,7 +55,16 @@ struct Primitive {
 
     void upload();
 
-    void draw();
+    /**
+     * @brief firstInstance is forwarded as gl_BaseInstance, used as material index by the material table
+     */
+    void draw(uint32_t firstInstance = 0);
+    void record(GL::CommandBuffer &cmd, uint32_t firstInstance = 0) const;
+
+    // size of the vertex and index arrays, the buffers hold the same once uploaded
+    size_t getDataSize() const;
+
+    // the buffers are deleted once the frames in flight are done with them
     ~Primitive();
 };
 
@@ -81,9 +92,21 @@ public:
     std::shared_ptr<Mesh> createAxis();
 };
 
-struct Model : public IdObject {
+/**
+ * @brief references the materials of its mesh views, the geometry of loaded models is accounted to them. meshes of
+ * MeshFactory are shared by every model built on them and not accounted
+ */
+struct Model : public IdObject<Model>, public Resource {
     friend class ModelManager;
 
+private:
+    // AssetReloader watch of the file, 0 if not watched
+    uint64_t _watchId{};
+
+    void referenceMaterials();
+    void updateMemory();
+
+public:
     std::string name;
     std::string path;
 
@@ -108,30 +131,48 @@ struct Model : public IdObject {
     bool loaded{false};
 
     Model(std::string_view path, ModelLoader *loader);
-    Model(std::string_view name) : name(name) {}
-    Model() {}
+    Model(std::string_view name) : Resource(RESOURCE_MODEL), name(name) {}
+    Model() : Model("") {}
 
     void load();
+
+    /**
+     * @brief parse the file again and replace the geometry of existing meshes, the mesh count must not change
+     */
+    bool reload();
 };
 
 class ModelManager : public Singleton<ModelManager> {
-    std::unordered_map<std::string, std::unique_ptr<Model>> _models;
+    SlotMap<std::unique_ptr<Model>> _models;
+    // models loaded from files by canonical path
+    std::unordered_map<std::string, IdType> _modelIds;
     std::unordered_map<std::string, std::unique_ptr<ModelLoader>> _modelLoaders;
 
+    ResourceHandle<Model> addModel(std::unique_ptr<Model> model);
+    static std::string getModelKey(std::string_view path);
+
 public:
     ModelManager();
 
-    Model *createModel(std::string_view path, std::string_view modelLoaderName = "obj");
-    Model *createLine(glm::vec3 const &p0, glm::vec3 const &p1);
-    Model *createQuad(glm::vec2 size = glm::vec2{1, 1}, int countx = 1, int county = 1);
-    Model *createAxis();
-    Model *createSphere(float radius = 1);
-    Model *createCube(glm::vec3 const &size = glm::vec3(1));
-
-    Model *createTestModel1();
-    Model *createTestModel2();
-
-    Model *getModel(std::string_view name) const { return _models.at(std::string(name)).get(); }
+    /**
+     * @brief models are shared by file, whatever path names it, and destroyed once nothing references them, a scene references the
+     * models added to it
+     */
+    ResourceHandle<Model> createModel(std::string_view path, std::string_view modelLoaderName = "obj");
+    ResourceHandle<Model> createLine(glm::vec3 const &p0, glm::vec3 const &p1);
+    ResourceHandle<Model> createQuad(glm::vec2 size = glm::vec2{1, 1}, int countx = 1, int county = 1);
+    ResourceHandle<Model> createAxis();
+    ResourceHandle<Model> createSphere(float radius = 1);
+    ResourceHandle<Model> createCube(glm::vec3 const &size = glm::vec3(1));
+
+    ResourceHandle<Model> createTestModel1();
+    ResourceHandle<Model> createTestModel2();
+
+    Model *getModel(std::string_view path) const { return _models.at(_modelIds.at(getModelKey(path))).get(); }
+    Model *getModel(IdType id) const {
+        auto p = _models.find(id);
+        return p ? p->get() : nullptr;
+    }
 
     ModelLoader *getModelLoader(std::string_view name) const;
 
@@ -139,18 +180,31 @@ public:
     void registerModelLoader(std::string_view loaderName) {
         _modelLoaders.emplace(loaderName, std::make_unique<Loader_T>());
     }
+
+    /**
+     * @brief destroy models nothing references, see ResourceManager::collectGarbage
+     */
+    size_t collectGarbage();
+
+    /**
+     * @brief destroy every model, at shutdown before the context is destroyed
+     */
+    void clear();
 };
 
 //============================
 class MeshRenderer : public Renderer {
     std::shared_ptr<Mesh> _mesh;
-    std::shared_ptr<Material> _material{};
+    ResourceHandle<Material> _material{};
 
 public:
     MeshRenderer(Node *parent, std::shared_ptr<Mesh> mesh);
 
-    void setMaterial(uint32_t materialId);
-    void setMaterial(std::shared_ptr<Material> material);
+    void setMaterial(IdType materialId);
+    void setMaterial(ResourceHandle<Material> material);
 
     void draw(bool bindTechnique = true) override;
+    void prepareDraw() override;
+    Material *getDrawMaterial() const override;
+    void record(GL::CommandBuffer &cmd) const override;
 };
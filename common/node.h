@@ -2,7 +2,7 @@
 #include "component.h"
 #include "prerequisites.h"
 
-class Node : public IdObject {
+class Node : public IdObject<Node> {
 protected:
     std::string _name;
 
@@ -0,0 +1,209 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "imgui/imgui.h"
+
+namespace {
+thread_local void *threadBuffer{};
+
+void writeJsonString(std::ostream &os, const char *str) {
+    os << '"';
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') os << '\\';
+        os << *str;
+    }
+    os << '"';
+}
+}  // namespace
+
+void ProfileScope::begin() {
+    auto &&profiler = Profiler::getSingleton();
+    _buffer = profiler.getThreadBuffer();
+    ++_buffer->depth;
+    _startNs = profiler.now();
+}
+void ProfileScope::end() {
+    auto endNs = Profiler::getSingleton().now();
+    auto depth = --_buffer->depth;
+    auto head = _buffer->head.load(std::memory_order_relaxed);
+    _buffer->events[head % Profiler::ThreadBuffer::CAPACITY] =
+        CpuProfileEvent{_name, _startNs, endNs, depth, _buffer->threadIndex};
+    _buffer->head.store(head + 1, std::memory_order_release);
+}
+
+GpuProfileScope::GpuProfileScope(const char *name) : _cpuScope(name) {
+    if (!Profiler::isEnabled()) return;
+    _active = true;
+    Profiler::getSingleton().beginGpuScope(name, _cpuScope.getStartNs());
+}
+GpuProfileScope::~GpuProfileScope() {
+    if (_active) Profiler::getSingleton().endGpuScope();
+}
+
+//==============================================
+Profiler::Profiler() : _startTime(Clock::now()) { _debugGroupSupported = GLEW_VERSION_4_3 || GLEW_KHR_debug; }
+Profiler::~Profiler() {
+    // no gpu scope ran, there may be no gl either
+    for (auto &&e : _gpuQuerySets)
+        if (!e.queries.empty()) glDeleteQueries(e.queries.size(), e.queries.data());
+}
+Profiler::ThreadBuffer *Profiler::getThreadBuffer() {
+    if (!threadBuffer) threadBuffer = registerThread();
+    return static_cast<ThreadBuffer *>(threadBuffer);
+}
+Profiler::ThreadBuffer *Profiler::registerThread() {
+    std::lock_guard lock(_threadBuffersMutex);
+    auto &&buffer = _threadBuffers.emplace_back(std::make_unique<ThreadBuffer>());
+    buffer->threadIndex = static_cast<uint32_t>(_threadBuffers.size() - 1);
+    return buffer.get();
+}
+void Profiler::beginGpuScope(const char *name, uint64_t cpuStartNs) {
+    if (_debugGroupSupported) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    auto &&set = _gpuQuerySets[_gpuQuerySetIndex];
+    auto query = static_cast<uint32_t>(set.scopes.size() * 2);
+    if (query == set.queries.size()) {
+        set.queries.resize(query + 2);
+        glGenQueries(2, &set.queries[query]);
+    }
+    _gpuScopeStack.emplace_back(static_cast<uint32_t>(set.scopes.size()));
+    set.scopes.emplace_back(GpuScope{name, cpuStartNs, _gpuDepth++, query});
+    glQueryCounter(set.queries[query], GL_TIMESTAMP);
+}
+void Profiler::endGpuScope() {
+    auto &&set = _gpuQuerySets[_gpuQuerySetIndex];
+    glQueryCounter(set.queries[set.scopes[_gpuScopeStack.back()].query + 1], GL_TIMESTAMP);
+    _gpuScopeStack.pop_back();
+    --_gpuDepth;
+    if (_debugGroupSupported) glPopDebugGroup();
+}
+void Profiler::collectCpuEvents(std::vector<CpuProfileEvent> &out) {
+    std::lock_guard lock(_threadBuffersMutex);
+    for (auto &&buffer : _threadBuffers) {
+        auto head = buffer->head.load(std::memory_order_acquire);
+        // the owner lapped the ring, oldest events are lost
+        if (head - buffer->tail > ThreadBuffer::CAPACITY) buffer->tail = head - ThreadBuffer::CAPACITY;
+        auto first = out.size();
+        for (auto i = buffer->tail; i < head; ++i) out.emplace_back(buffer->events[i % ThreadBuffer::CAPACITY]);
+        // the owner writes event i + CAPACITY over event i while its head is at i + CAPACITY, the copies of slots
+        // it reached meanwhile may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto written = buffer->head.load(std::memory_order_relaxed);
+        if (written + 1 > buffer->tail + ThreadBuffer::CAPACITY) {
+            auto torn = std::min(written + 1 - ThreadBuffer::CAPACITY, head) - buffer->tail;
+            out.erase(out.begin() + first, out.begin() + first + torn);
+        }
+        buffer->tail = head;
+    }
+}
+void Profiler::collectGpuEvents(GpuQuerySet &set, std::vector<GpuProfileEvent> &out) {
+    for (auto &&e : set.scopes) {
+        GLint available{};
+        glGetQueryObjectiv(set.queries[e.query + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        // still running after GPU_FRAME_LATENCY frames, drop it rather than stall
+        if (!available) continue;
+        GLuint64 begin{}, end{};
+        glGetQueryObjectui64v(set.queries[e.query], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(set.queries[e.query + 1], GL_QUERY_RESULT, &end);
+        out.emplace_back(GpuProfileEvent{e.name, e.cpuStartNs, (end - begin) * 1e-6, e.depth});
+    }
+    set.scopes.clear();
+}
+void Profiler::newFrame() {
+    if (!isEnabled()) return;
+
+    _lastFrame.frameIndex = _frameIndex++;
+    _lastFrame.cpuEvents.clear();
+    _lastFrame.gpuEvents.clear();
+    collectCpuEvents(_lastFrame.cpuEvents);
+    // scopes are pushed when they end, parents after their children
+    std::sort(_lastFrame.cpuEvents.begin(), _lastFrame.cpuEvents.end(), [](auto &&a, auto &&b) {
+        return a.threadIndex != b.threadIndex ? a.threadIndex < b.threadIndex : a.startNs < b.startNs;
+    });
+
+    _gpuQuerySetIndex = (_gpuQuerySetIndex + 1) % GPU_FRAME_LATENCY;
+    collectGpuEvents(_gpuQuerySets[_gpuQuerySetIndex], _lastFrame.gpuEvents);
+
+    if (_traceFramesLeft) {
+        _traceCpuEvents.insert(_traceCpuEvents.end(), _lastFrame.cpuEvents.begin(), _lastFrame.cpuEvents.end());
+        _traceGpuEvents.insert(_traceGpuEvents.end(), _lastFrame.gpuEvents.begin(), _lastFrame.gpuEvents.end());
+        if (--_traceFramesLeft == 0) {
+            std::ofstream os(_tracePath);
+            if (os) {
+                writeChromeTrace(os, _traceCpuEvents, _traceGpuEvents);
+                std::cout << "profiler trace written to " << _tracePath << std::endl;
+            } else
+                LOG("failed to write profiler trace", _tracePath);
+            _traceCpuEvents = {};
+            _traceGpuEvents = {};
+        }
+    }
+}
+void Profiler::captureTrace(std::string_view path, uint32_t frameCount) {
+    _tracePath = path;
+    _traceFramesLeft = frameCount;
+    _traceCpuEvents.clear();
+    _traceGpuEvents.clear();
+    setEnabled(true);
+}
+void Profiler::writeChromeTrace(std::ostream &os, std::vector<CpuProfileEvent> const &cpuEvents,
+                                std::vector<GpuProfileEvent> const &gpuEvents) {
+    // complete events ("ph":"X"), times in microseconds, gpu scopes on their own track
+    constexpr uint32_t GPU_TRACK = 1000;
+    os << "{\"traceEvents\":[\n";
+    os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACK
+       << ",\"args\":{\"name\":\"gpu\"}}";
+    for (auto &&e : cpuEvents) {
+        os << ",\n{\"name\":";
+        writeJsonString(os, e.name);
+        os << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.threadIndex << ",\"ts\":" << e.startNs * 1e-3
+           << ",\"dur\":" << (e.endNs - e.startNs) * 1e-3 << "}";
+    }
+    for (auto &&e : gpuEvents) {
+        os << ",\n{\"name\":";
+        writeJsonString(os, e.name);
+        os << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << GPU_TRACK << ",\"ts\":" << e.cpuStartNs * 1e-3
+           << ",\"dur\":" << e.ms * 1e3 << "}";
+    }
+    os << "\n]}\n";
+}
+void Profiler::drawPanel() {
+    ImGui::Begin("profiler");
+    bool enabled = isEnabled();
+    if (ImGui::Checkbox("enabled", &enabled)) setEnabled(enabled);
+    ImGui::SameLine();
+    if (ImGui::Button("capture 120 frames")) captureTrace(WORKING_DIR "/profile_trace.json", 120);
+    if (isCapturing()) {
+        ImGui::SameLine();
+        ImGui::Text("capturing, %u frames left", _traceFramesLeft);
+    }
+
+    if (ImGui::BeginTable("cpu", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("cpu scope");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableHeadersRow();
+        for (auto &&e : _lastFrame.cpuEvents) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("[%u] %*s%s", e.threadIndex, e.depth * 2, "", e.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", (e.endNs - e.startNs) * 1e-6);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::BeginTable("gpu", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("gpu pass");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableHeadersRow();
+        for (auto &&e : _lastFrame.gpuEvents) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", e.depth * 2, "", e.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", e.ms);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "prerequisites.h"
+
+/**
+ * PROFILE_SCOPE("name")      cpu time of the enclosing block, recorded on any thread
+ * PROFILE_GPU_SCOPE("name")  cpu time, gpu time (GL_TIMESTAMP at begin and end) and a debug group visible in gpu
+ *                            debuggers, gpu scopes nest
+ * names must be string literals, only the pointer is stored.
+ * when the profiler is disabled a scope costs one relaxed atomic load, defining PROFILER_DISABLED removes them.
+ */
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(_gpuProfileScope, __LINE__)(name)
+#endif
+
+struct CpuProfileEvent {
+    const char *name;
+    uint64_t startNs;  // since profiler start
+    uint64_t endNs;
+    uint32_t depth;
+    uint32_t threadIndex;
+};
+
+struct GpuProfileEvent {
+    const char *name;
+    uint64_t cpuStartNs;  // gpu timestamps have no common time base with the cpu clock, traces place it at the cpu start
+    double ms;
+    uint32_t depth;
+};
+
+struct FrameProfile {
+    uint64_t frameIndex;
+    std::vector<CpuProfileEvent> cpuEvents;
+    std::vector<GpuProfileEvent> gpuEvents;  // results of frame frameIndex + 1 - GPU_FRAME_LATENCY
+};
+
+class Profiler : public Singleton<Profiler> {
+public:
+    // query sets in flight, results are read this many frames late so the cpu never waits on the gpu
+    static constexpr uint32_t GPU_FRAME_LATENCY = 3;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static inline std::atomic<bool> _enabled{false};
+
+    /**
+     * single producer ring, only the owning thread writes, newFrame() reads up to head on the main thread.
+     * events older than CAPACITY are overwritten if the collector falls behind, the collector drops the events it
+     * copied while the owner was overwriting them
+     */
+    struct ThreadBuffer {
+        static constexpr uint32_t CAPACITY = 1 << 13;
+        std::array<CpuProfileEvent, CAPACITY> events;
+        std::atomic<uint64_t> head{0};
+        uint64_t tail{0};
+        uint32_t depth{0};
+        uint32_t threadIndex;
+    };
+    std::mutex _threadBuffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> _threadBuffers;
+
+    struct GpuScope {
+        const char *name;
+        uint64_t cpuStartNs;
+        uint32_t depth;
+        uint32_t query;  // begin timestamp, end timestamp at query + 1
+    };
+    struct GpuQuerySet {
+        std::vector<GLuint> queries;
+        std::vector<GpuScope> scopes;
+    };
+    std::array<GpuQuerySet, GPU_FRAME_LATENCY> _gpuQuerySets;
+    uint32_t _gpuQuerySetIndex{};
+    uint32_t _gpuDepth{};
+    // scopes open on the gpu, their index in the current set
+    std::vector<uint32_t> _gpuScopeStack;
+    bool _debugGroupSupported{false};
+
+    Clock::time_point _startTime;
+    uint64_t _frameIndex{};
+    FrameProfile _lastFrame{};
+
+    std::string _tracePath;
+    uint32_t _traceFramesLeft{};
+    std::vector<CpuProfileEvent> _traceCpuEvents;
+    std::vector<GpuProfileEvent> _traceGpuEvents;
+
+    ThreadBuffer *registerThread();
+    void collectCpuEvents(std::vector<CpuProfileEvent> &out);
+    void collectGpuEvents(GpuQuerySet &set, std::vector<GpuProfileEvent> &out);
+
+    friend class ProfileScope;
+    friend class GpuProfileScope;
+    ThreadBuffer *getThreadBuffer();
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime).count();
+    }
+    void beginGpuScope(const char *name, uint64_t cpuStartNs);
+    void endGpuScope();
+
+public:
+    Profiler();
+    ~Profiler();
+
+    static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+
+    /**
+     * @brief frame boundary, called by the main loop before anything of the frame is recorded.
+     * gathers the events of every thread for the previous frame and reads the oldest gpu query set
+     */
+    void newFrame();
+
+    /**
+     * @brief events of the last completed frame
+     */
+    constexpr FrameProfile const &getLastFrame() const { return _lastFrame; }
+
+    /**
+     * @brief record the next frameCount frames and write them as chrome trace json (chrome://tracing, perfetto)
+     * enables the profiler
+     */
+    void captureTrace(std::string_view path, uint32_t frameCount);
+    constexpr bool isCapturing() const { return _traceFramesLeft > 0; }
+
+    static void writeChromeTrace(std::ostream &os, std::vector<CpuProfileEvent> const &cpuEvents,
+                                 std::vector<GpuProfileEvent> const &gpuEvents);
+
+    /**
+     * @brief imgui window listing the scopes of the last frame
+     */
+    void drawPanel();
+};
+
+class ProfileScope {
+    Profiler::ThreadBuffer *_buffer{};
+    const char *_name;
+    uint64_t _startNs{};
+
+public:
+    explicit ProfileScope(const char *name) : _name(name) {
+        if (!Profiler::isEnabled()) return;
+        begin();
+    }
+    ~ProfileScope() {
+        if (_buffer) end();
+    }
+    ProfileScope(ProfileScope const &) = delete;
+    ProfileScope &operator=(ProfileScope const &) = delete;
+
+    uint64_t getStartNs() const { return _startNs; }
+
+private:
+    void begin();
+    void end();
+};
+
+class GpuProfileScope {
+    ProfileScope _cpuScope;
+    bool _active{false};
+
+public:
+    explicit GpuProfileScope(const char *name);
+    ~GpuProfileScope();
+    GpuProfileScope(GpuProfileScope const &) = delete;
+    GpuProfileScope &operator=(GpuProfileScope const &) = delete;
+};
@@ -1,9 +1,25 @@
 #pragma once
+#include "commandbuffer.h"
 #include "component.h"
 
+struct Material;
+
 class Renderer : public Component {
 public:
     Renderer(Node* parent) : Component(parent) {}
 
     virtual void draw(bool bindTechnique = true) = 0;
+
+    /**
+     * @brief main thread, once per frame before record: build, upload and mark everything the draw uses
+     */
+    virtual void prepareDraw() {}
+    /**
+     * @brief material prepareDraw prepares, if any. the renderer prepares the materials of all draws together
+     */
+    virtual Material *getDrawMaterial() const { return nullptr; }
+    /**
+     * @brief the gl calls of draw() as commands, runs on job threads after prepareDraw, must not call gl
+     */
+    virtual void record(GL::CommandBuffer& cmd) const = 0;
 };
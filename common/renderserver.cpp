@@ -1,6 +1,10 @@
 #include "renderserver.h"
 
+#include "jobsystem.h"
+#include "profiler.h"
+
 std::array<std::unique_ptr<Technique>, POST_PROCESS_NUM> RenderServer::techniques;
+GL::FramebufferHandle RenderServer::outputFramebuffer{};
 
 PostProcess::PostProcess() { renderTechnique = std::make_unique<TechniquePostProcessRender>(); }
 
@@ -24,7 +28,8 @@ void PostProcess::postProcess() {
 void PostProcess::run() {
     postProcess();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    PROFILE_GPU_SCOPE(getGpuPassName(GPU_PASS_RESOLVE));
+    glBindFramebuffer(GL_FRAMEBUFFER, RenderServer::outputFramebuffer);
     renderTechnique->bind();
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, inColorTexture);
@@ -32,6 +37,34 @@ void PostProcess::run() {
     glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
+namespace {
+// nearest and clamp to edge, the passes read single texels
+void createAOImage(GL::ImageHandle *image, GLenum format, int width, int height) {
+    glGenTextures(1, image);
+    glBindTexture(GL_TEXTURE_2D, *image);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+// red channel of level 0, waits for the gpu
+std::vector<float> readAOImage(GL::ImageHandle image, int width, int height) {
+    std::vector<float> ret(size_t(width) * height);
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, image);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, ret.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return ret;
+}
+}  // namespace
+
+const char *getSSAOResolutionName(SSAOResolution resolution) {
+    static const char *names[]{"full", "half", "quarter"};
+    return names[resolution];
+}
+
 PostProcessSSAO::PostProcessSSAO() { technique = std::make_unique<TechniqueSSAO>(); }
 PostProcessSSAO::~PostProcessSSAO() {}
 
@@ -48,16 +81,47 @@ void PostProcessSSAO::initImpl()
                                           GL::BUFFER_STORAGE_MAP_COHERENT_BIT | GL::BUFFER_STORAGE_MAP_PERSISTENT_BIT |
                                               GL::BUFFER_STORAGE_MAP_WRITE_BIT},
                      &shadingParams, &uboShadingPara);
+    GL::createBuffer(GL::BufferCreateInfo{{}, sizeof(Paras), GL::BUFFER_STORAGE_DYNAMIC_STORAGE_BIT}, nullptr,
+                     &uboReferencePara);
 
-    // create result image
-    glGenTextures(1, &resultAO);
-    glBindTexture(GL_TEXTURE_2D, resultAO);
-    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, resultTexWidth, resultTexHeight);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // create result images
+    for (auto image : {&resultAORaw, &resultAO}) createAOImage(image, GL_R32F, resultTexWidth, resultTexHeight);
+    outputAO = resultAO;
+}
+void PostProcessSSAO::updateTargets() {
+    if (params.resolution != targetResolution) {
+        glDeleteTextures(depthPyramid.size(), depthPyramid.data());
+        glDeleteTextures(1, &lowAO);
+        glDeleteTextures(1, &lowAOTemp);
+        glDeleteTextures(1, &upsampledAO);
+        depthPyramid = {};
+        lowAO = lowAOTemp = upsampledAO = 0;
+        targetResolution = params.resolution;
+        auto scale = 1 << targetResolution;
+        lowWidth = (resultTexWidth + scale - 1) / scale;
+        lowHeight = (resultTexHeight + scale - 1) / scale;
+        if (targetResolution != SSAO_RESOLUTION_FULL) {
+            for (int i = 0; i < targetResolution; ++i)
+                createAOImage(&depthPyramid[i], GL_R32F, (resultTexWidth + (2 << i) - 1) >> (i + 1),
+                              (resultTexHeight + (2 << i) - 1) >> (i + 1));
+            createAOImage(&lowAO, GL_R32F, lowWidth, lowHeight);
+            createAOImage(&lowAOTemp, GL_R32F, lowWidth, lowHeight);
+            createAOImage(&upsampledAO, GL_R32F, resultTexWidth, resultTexHeight);
+        }
+    }
+    if (params.temporal && !historyAO[0]) {
+        for (auto &&e : historyAO) createAOImage(&e, GL_RG32F, resultTexWidth, resultTexHeight);
+        historyValid = false;
+    }
+    if (params.temporal && !historyValid) {
+        // view z 0 rejects every texel
+        for (auto e : historyAO) glClearTexImage(e, 0, GL_RG, GL_FLOAT, nullptr);
+        historyValid = true;
+    }
 }
 void PostProcessSSAO::renderSetting() {
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, resultAO);
+    glBindTexture(GL_TEXTURE_2D, outputAO);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboShadingPara);
 }
 void PostProcessSSAO::updateAOParams()
@@ -76,15 +140,123 @@ void PostProcessSSAO::updateShadingParams()
     glUnmapBuffer(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
-void PostProcessSSAO::postProcessImpl() {
-    technique->bind();
+void PostProcessSSAO::setCamera(glm::mat4 const &V, glm::mat4 const &P) {
+    glm::vec4 projScale{P[0][0], P[1][1], P[2][0], P[2][1]};
+    glm::vec4 projDepth{P[2][2], P[2][3], P[3][2], P[3][3]};
+    glm::vec4 projOffset{P[3][0], P[3][1], 0, 0};
+    bool changed = projScale != params.projScale || projDepth != params.projDepth || projOffset != params.projOffset;
+    params.projScale = projScale;
+    params.projDepth = projDepth;
+    params.projOffset = projOffset;
+    // the history is reprojected with this frame's projection
+    if (changed) historyValid = false;
+    if (params.temporal) {
+        params.reprojection = prevV * glm::inverse(V);
+        ++params.frameIndex;
+        changed = true;
+    } else {
+        // the history goes stale while it is not updated
+        historyValid = false;
+        changed |= params.frameIndex != 0;
+        params.frameIndex = 0;
+    }
+    prevV = V;
+    // before the first run the buffer is created from params
+    if (changed && isInit) updateAOParams();
+}
+float PostProcessSSAO::getSamplesPerPixel() const {
+    return float(params.sampleDirections * params.sampleStepNum * 2) / float(1 << (params.resolution * 2));
+}
+void PostProcessSSAO::dispatchAO(SSAODispatch variant, GL::ImageHandle depth, GL::ImageHandle target, int width,
+                                 int height, GL::BufferHandle paras) {
+    auto &&ssao = static_cast<TechniqueSSAO &>(*technique);
+    ssao.dispatch = variant;
+    ssao.bind();
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, inDepth);
+    glBindTexture(GL_TEXTURE_2D, depth);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, inNormal);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, paras);
+    glBindImageTexture(0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    if (variant == SSAO_DISPATCH_TILED)
+        glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+    else
+        glDispatchCompute(width * height / 1024 + 1, 1, 1);
+}
+void PostProcessSSAO::blurAO() {
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    static_cast<TechniqueSSAO &>(*technique).bindBlur();
+    glBindImageTexture(0, resultAORaw, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, resultAO, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((resultTexWidth + 15) / 16, (resultTexHeight + 15) / 16, 1);
+}
+void PostProcessSSAO::dispatchFilter(SSAOFilterPass pass, std::initializer_list<GL::ImageHandle> inputs,
+                                     GL::ImageHandle output, GLenum format, int width, int height) {
+    // the inputs were written by the previous pass
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    static_cast<TechniqueSSAO &>(*technique).bindFilter(pass);
+    GLenum unit = GL_TEXTURE0;
+    for (auto e : inputs) {
+        glActiveTexture(unit++);
+        glBindTexture(GL_TEXTURE_2D, e);
+    }
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboPara);
-    glBindImageTexture(0, resultAO, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-    glDispatchCompute(resultTexWidth * resultTexHeight / 1024 + 1, 1, 1);
+    glBindImageTexture(0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+    glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+}
+void PostProcessSSAO::postProcessImpl() {
+    PROFILE_GPU_SCOPE(getGpuPassName(GPU_PASS_SSAO));
+    updateTargets();
+    if (params.resolution == SSAO_RESOLUTION_FULL) {
+        dispatchAO(dispatch, inDepth, resultAORaw, resultTexWidth, resultTexHeight, uboPara);
+        blurAO();
+        outputAO = resultAO;
+    } else {
+        // depth pyramid down to the ao resolution
+        auto depth = inDepth;
+        for (int i = 0; i < params.resolution; ++i) {
+            dispatchFilter(SSAO_FILTER_DOWNSAMPLE, {depth}, depthPyramid[i], GL_R32F,
+                           (resultTexWidth + (2 << i) - 1) >> (i + 1), (resultTexHeight + (2 << i) - 1) >> (i + 1));
+            depth = depthPyramid[i];
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        dispatchAO(dispatch, depth, lowAO, lowWidth, lowHeight, uboPara);
+        dispatchFilter(SSAO_FILTER_DENOISE, {lowAO, depth}, lowAOTemp, GL_R32F, lowWidth, lowHeight);
+        dispatchFilter(SSAO_FILTER_DENOISE_VERTICAL, {lowAOTemp, depth}, lowAO, GL_R32F, lowWidth, lowHeight);
+        dispatchFilter(SSAO_FILTER_UPSAMPLE, {lowAO, depth, inDepth}, upsampledAO, GL_R32F, resultTexWidth,
+                       resultTexHeight);
+        outputAO = upsampledAO;
+    }
+    if (params.temporal) {
+        auto history = historyAO[historyIndex];
+        historyIndex ^= 1;
+        dispatchFilter(SSAO_FILTER_TEMPORAL, {outputAO, inDepth, history}, historyAO[historyIndex], GL_RG32F,
+                       resultTexWidth, resultTexHeight);
+        outputAO = historyAO[historyIndex];
+    }
+    // the resolve pass samples outputAO
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+std::vector<float> PostProcessSSAO::computeRawAO(SSAODispatch variant) {
+    if (!isInit) return {};
+    dispatchAO(variant, inDepth, resultAORaw, resultTexWidth, resultTexHeight, uboPara);
+    return readAOImage(resultAORaw, resultTexWidth, resultTexHeight);
+}
+std::vector<float> PostProcessSSAO::computeReferenceAO() {
+    if (!isInit) return {};
+    // setCamera advances frameIndex every temporal frame, the reference does not depend on it
+    auto reference = params;
+    reference.resolution = SSAO_RESOLUTION_FULL;
+    reference.temporal = 0;
+    reference.frameIndex = 0;
+    glNamedBufferSubData(uboReferencePara, 0, sizeof(Paras), &reference);
+    dispatchAO(dispatch, inDepth, resultAORaw, resultTexWidth, resultTexHeight, uboReferencePara);
+    blurAO();
+    return readAOImage(resultAO, resultTexWidth, resultTexHeight);
+}
+std::vector<float> PostProcessSSAO::readAO() {
+    if (!isInit) return {};
+    return readAOImage(outputAO, resultTexWidth, resultTexHeight);
 }
 
 //===============================================================
@@ -94,14 +266,65 @@ RenderTarget::~RenderTarget() {
     glDeleteFramebuffers(1, &fbo);
 }
 
+const char *getGpuPassName(GpuPass pass) {
+    static const char *names[]{"environment", "geometry", "depth_pyramid", "ssao", "resolve"};
+    return names[pass];
+}
+namespace {
+// profiler scope names are compared by pointer
+constexpr const char *GPU_FRAME_SCOPE = "render scene";
+}  // namespace
+
+//===============================================================
+
 RenderServer::RenderServer() {
     _gridNode = std::make_unique<Node>();
     _gridNode->addComponent<Grid>();
-    Input::framebufferResizeSignal.Connect(&RenderServer::onFramebufferResize, this);
+    Input::framebufferResizeSignal.Connect(&RenderServer::onFramebufferResize, this, DeliveryPolicy::COALESCED);
     createDefaultFBO();
     initPostProcessTechniques();
 }
+RenderServer::~RenderServer() {}
 void RenderServer::initPostProcessTechniques() {}
+void RenderServer::readGpuPassTimings() {
+    _gpuFrameMs = 0;
+    _gpuPassMs = {};
+    if (!Profiler::isEnabled()) return;
+    for (auto &&e : Profiler::getSingleton().getLastFrame().gpuEvents) {
+        if (e.name == GPU_FRAME_SCOPE) _gpuFrameMs += e.ms;
+        for (int i = 0; i < GPU_PASS_NUM; ++i)
+            if (e.name == getGpuPassName(static_cast<GpuPass>(i))) _gpuPassMs[i] += e.ms;
+    }
+    for (int i = 0; i < GPU_PASS_NUM; ++i) _gpuPassMsAverage[i] += (_gpuPassMs[i] - _gpuPassMsAverage[i]) * 0.05f;
+}
+
+void RenderServer::recordDraws(std::vector<RenderSnapshot::Draw> const &draws) {
+    PROFILE_SCOPE("record draws");
+    auto start = std::chrono::steady_clock::now();
+    auto &&jobSystem = JobSystem::getSingleton();
+    auto count = static_cast<uint32_t>(draws.size());
+    // below a few dozen draws a chunk costs more to schedule than to record
+    auto grainSize = (std::max)((count + jobSystem.getThreadCount() - 1) / jobSystem.getThreadCount(), 32u);
+    auto chunkCount = (count + grainSize - 1) / grainSize;
+    while (_commandBuffers.size() < chunkCount) _commandBuffers.emplace_back(std::make_unique<GL::CommandBuffer>());
+
+    jobSystem.parallelFor(count, grainSize, [&](uint32_t begin, uint32_t end) {
+        auto &&cmd = *_commandBuffers[begin / grainSize];
+        cmd.reset();
+        for (auto i = begin; i < end; ++i) draws[i].renderer->record(cmd);
+    });
+
+    _recordedCommandBuffers.clear();
+    for (uint32_t i = 0; i < chunkCount; ++i) _recordedCommandBuffers.emplace_back(_commandBuffers[i].get());
+    _drawRecordMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    _drawReplayMs = 0;
+}
+void RenderServer::replayDraws() {
+    PROFILE_SCOPE("replay draws");
+    auto start = std::chrono::steady_clock::now();
+    GL::executeCommandBuffers(_recordedCommandBuffers);
+    _drawReplayMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
 void RenderServer::createDefaultFBO() {
     _defaultRenderTarget.images.resize(3);
@@ -126,6 +349,11 @@ void RenderServer::createDefaultFBO() {
     glBindTexture(GL_TEXTURE_2D, *image);
     glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, (GLsizei)Input::framebufferWidth,
                    (GLsizei)Input::framebufferHeight);
+    // ssao reads single texels, the tiled variant with texelFetch, the other one has to sample the same ones
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glBindTexture(GL_TEXTURE_2D, 0);
 
     //
@@ -142,45 +370,88 @@ void RenderServer::createDefaultFBO() {
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         THROW("framebuffer is not complete");
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 }
 void RenderServer::recreateDefaultFBO() {
     _defaultRenderTarget.~RenderTarget();
     createDefaultFBO();
 }
 void RenderServer::renderScene(Scene *scene) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    scene->environment->render();
-
-    if (postProcessType != POST_PROCESS_NONE) {
-        glBindFramebuffer(GL_FRAMEBUFFER, _defaultRenderTarget.fbo);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    scene->buildSnapshot(_snapshot);
+    renderSnapshot(scene, _snapshot);
+}
+void RenderServer::renderSnapshot(Scene *scene, RenderSnapshot const &snapshot) {
+    readGpuPassTimings();
+    PROFILE_GPU_SCOPE(GPU_FRAME_SCOPE);
+    {
+        PROFILE_SCOPE("snapshot upload");
+        for (auto &&e : snapshot.draws) e.transform->uploadModelMatrix(e.model, e.poseVersion);
+        for (auto &&e : snapshot.lights) e.light->uploadUBO(e.ubo);
+        snapshot.camera->uploadPVBuffer(snapshot.cameraData);
+    }
+    {
+        PROFILE_SCOPE("texture residency");
+        TextureManager::getSingleton().update();
+    }
+    // without light only the ambient term is shaded, every light pass replays the same draws
+    Material::lightCountClass = snapshot.lights.empty() ? 0 : 1;
+    {
+        // materials get their table slot and their textures storage here, the table upload below sends both
+        PROFILE_SCOPE("prepare draws");
+        _drawMaterials.clear();
+        for (auto &&e : snapshot.draws)
+            if (auto material = e.renderer->getDrawMaterial()) _drawMaterials.emplace_back(material);
+        Material::prepareDraws(_drawMaterials);
+        for (auto &&e : snapshot.draws) e.renderer->prepareDraw();
     }
-    if (showGrid) _gridNode->getComponent<Grid>()->draw();
+    {
+        PROFILE_SCOPE("material upload");
+        MaterialTable::getSingleton().bind();
+    }
+
+    {
+        PROFILE_GPU_SCOPE(getGpuPassName(GPU_PASS_ENVIRONMENT));
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        scene->environment->render();
 
-    scene->_editorCameraNode->getComponent<Camera>()->bind();
+        if (postProcessType != POST_PROCESS_NONE) {
+            glBindFramebuffer(GL_FRAMEBUFFER, _defaultRenderTarget.fbo);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        if (showGrid) _gridNode->getComponent<Grid>()->draw();
+    }
 
-    std::vector<Renderer *> renderers;
-    scene->_root->getComponents(renderers, true);
+    snapshot.camera->bind();
 
-    std::vector<Light *> lights;
-    scene->_root->getComponents(lights, true);
+    recordDraws(snapshot.draws);
+    Material::lightCountClass = 1;
 
-    for (auto e : lights) {
-        e->bind(2);
-        for (auto e : renderers) {
-            e->draw();
+    {
+        PROFILE_GPU_SCOPE(getGpuPassName(GPU_PASS_GEOMETRY));
+        if (snapshot.lights.empty()) replayDraws();
+        for (auto &&e : snapshot.lights) {
+            e.light->bind(2);
+            replayDraws();
         }
     }
 
+    if (buildDepthPyramid && postProcessType != POST_PROCESS_NONE) {
+        PROFILE_GPU_SCOPE(getGpuPassName(GPU_PASS_DEPTH_PYRAMID));
+        if (!_depthPyramid) _depthPyramid = std::make_unique<DepthPyramid>();
+        _depthPyramid->build(_defaultRenderTarget.images[2],
+                             glm::uvec2(Input::framebufferWidth, Input::framebufferHeight), snapshot.frameIndex);
+    }
+
     //
     if (postProcessType != POST_PROCESS_NONE) {
         PostProcessSSAO::getSingleton().inColorTexture= _defaultRenderTarget.images[0];
         PostProcessSSAO::getSingleton().inNormal = _defaultRenderTarget.images[1];
         PostProcessSSAO::getSingleton().inDepth = _defaultRenderTarget.images[2];
-        scene->_editorCameraNode->getComponent<Camera>()->bind();
+        snapshot.camera->bind();
+        PostProcessSSAO::getSingleton().setCamera(snapshot.cameraData.V, snapshot.cameraData.P);
         PostProcessSSAO::getSingleton().run();
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 }
-void RenderServer::onFramebufferResize(int width, int height) { recreateDefaultFBO(); }
\ No newline at end of file
+// recreateDefaultFBO reads the new size from Input
+void RenderServer::onFramebufferResize(int, int) { recreateDefaultFBO(); }
\ No newline at end of file
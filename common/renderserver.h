@@ -1,4 +1,8 @@
 #pragma once
+#include <cstddef>
+
+#include "commandbuffer.h"
+#include "depthpyramid.h"
 #include "scene.h"
 #include "singleton.h"
 
@@ -8,6 +12,26 @@ enum PostProcessType {
     POST_PROCESS_NUM,
 };
 
+// passes timed by their profiler gpu scope, named getGpuPassName
+enum GpuPass {
+    GPU_PASS_ENVIRONMENT,    // sky and grid
+    GPU_PASS_GEOMETRY,       // opaque scene draws
+    GPU_PASS_DEPTH_PYRAMID,  // min max depth pyramid
+    GPU_PASS_SSAO,           // ao compute
+    GPU_PASS_RESOLVE,        // post process composition to the output framebuffer
+    GPU_PASS_NUM,
+};
+const char *getGpuPassName(GpuPass pass);
+
+// resolution the ao is computed at
+enum SSAOResolution {
+    SSAO_RESOLUTION_FULL,
+    SSAO_RESOLUTION_HALF,
+    SSAO_RESOLUTION_QUARTER,
+    SSAO_RESOLUTION_Num,
+};
+const char *getSSAOResolutionName(SSAOResolution resolution);
+
 struct RenderTarget {
     GL::FramebufferHandle fbo;
     std::vector<GL::ImageHandle> images;
@@ -43,16 +67,46 @@ class PostProcessSSAO : public PostProcess, public Singleton<PostProcessSSAO> {
     void initImpl() override;
     void postProcessImpl() override;
     void renderSetting() override;
+    void dispatchAO(SSAODispatch variant, GL::ImageHandle depth, GL::ImageHandle target, int width, int height,
+                    GL::BufferHandle paras);
+    void blurAO();
+    // 16x16 groups over the output, textures bound to units 0.. in order
+    void dispatchFilter(SSAOFilterPass pass, std::initializer_list<GL::ImageHandle> inputs, GL::ImageHandle output,
+                        GLenum format, int width, int height);
+    void updateTargets();
 
+    // full resolution, written by the ao pass, blurred into resultAO
+    GL::ImageHandle resultAORaw;
     GL::ImageHandle resultAO;
 
+    // below full resolution, created for the current mode: depth pyramid levels from half resolution down to the ao
+    // resolution, raw ao and denoise target at ao resolution, the upsampled ao
+    std::array<GL::ImageHandle, SSAO_RESOLUTION_Num - 1> depthPyramid{};
+    GL::ImageHandle lowAO{};
+    GL::ImageHandle lowAOTemp{};
+    GL::ImageHandle upsampledAO{};
+    int lowWidth{}, lowHeight{};
+    int targetResolution{};
+
+    // rg: accumulated ao, view z. written alternately, cleared when the history is invalid
+    std::array<GL::ImageHandle, 2> historyAO{};
+    uint32_t historyIndex{};
+    bool historyValid{};
+    glm::mat4 prevV{1};
+
+    // sampled by the resolve pass
+    GL::ImageHandle outputAO{};
+
     GL::BufferHandle uboPara;
+    // params of computeReferenceAO, the frame's own stay untouched
+    GL::BufferHandle uboReferencePara;
     GL::BufferHandle uboShadingPara;
 
 public:
     GL::ImageHandle inDepth;
     GL::ImageHandle inNormal;
 
+    // std140, UBOParas in ssao.comp and ssaofilter.comp
     struct Paras
     {
         int aoType;
@@ -61,14 +115,58 @@ public:
         int sampleDirections{4};
         float maxRadius0{10};
         float maxRadius1{15};
+        // SSAOResolution, below full resolution the ao is denoised and upsampled
+        int resolution;
+        // accumulate over frames, the sample directions rotate every frame so fewer are needed per frame
+        int temporal;
+        // entries of the projection matrix for view space reconstruction, set by setCamera
+        glm::vec4 projScale;   // P[0][0], P[1][1], P[2][0], P[2][1]
+        glm::vec4 projDepth;   // P[2][2], P[2][3], P[3][2], P[3][3]
+        glm::vec4 projOffset;  // P[3][0], P[3][1]
+        // view space of this frame to the one of the previous frame, set by setCamera
+        glm::mat4 reprojection{1};
+        int frameIndex;
+        // share of the history kept each frame
+        float historyWeight{0.9f};
+        // depth difference, relative to the depth, at which the filters and the history stop blending
+        float depthSigma{0.05f};
+        float padding;
     }params{};
+    static_assert(offsetof(Paras, projScale) == 32 && offsetof(Paras, reprojection) == 80 &&
+                  offsetof(Paras, frameIndex) == 144 && sizeof(Paras) == 160);
 
     struct ShadingParams {
         int shadingMode;
     } shadingParams{};
 
+    SSAODispatch dispatch{SSAO_DISPATCH_TILED};
+
     void updateAOParams();
     void updateShadingParams();
+    /**
+     * @brief camera of the frame, the parameters are only uploaded when they changed (every frame with temporal)
+     */
+    void setCamera(glm::mat4 const &V, glm::mat4 const &P);
+
+    /**
+     * @brief ao samples per frame pixel and frame of the current parameters, the cost of the ao pass
+     */
+    float getSamplesPerPixel() const;
+
+    /**
+     * @brief run only the ao pass with the given variant on the current inputs and read the unblurred result back,
+     * waits for the gpu. for comparing the variants
+     */
+    std::vector<float> computeRawAO(SSAODispatch variant);
+    /**
+     * @brief full resolution ao of the current inputs without temporal accumulation and with the sample directions
+     * of frame 0, what the reduced modes approximate. waits for the gpu
+     */
+    std::vector<float> computeReferenceAO();
+    /**
+     * @brief ao the last run produced, at frame resolution. waits for the gpu
+     */
+    std::vector<float> readAO();
 
     PostProcessSSAO();
     ~PostProcessSSAO();
@@ -86,15 +184,81 @@ class RenderServer : public Singleton<RenderServer> {
 
     void initPostProcessTechniques();
 
+    // read from the gpu scopes of the last frame the profiler collected
+    float _gpuFrameMs{};
+    std::array<float, GPU_PASS_NUM> _gpuPassMs{};
+    std::array<float, GPU_PASS_NUM> _gpuPassMsAverage{};
+    void readGpuPassTimings();
+
+    // scene draws are recorded in chunks on job threads, one command buffer per chunk, and replayed in chunk order
+    std::vector<std::unique_ptr<GL::CommandBuffer>> _commandBuffers;
+    std::vector<GL::CommandBuffer const *> _recordedCommandBuffers;
+    float _drawRecordMs{};
+    float _drawReplayMs{};
+    void recordDraws(std::vector<RenderSnapshot::Draw> const &draws);
+    void replayDraws();
+    // materials of the snapshot draws, reused every frame
+    std::vector<Material *> _drawMaterials;
+
+    // renderScene builds its snapshot here
+    RenderSnapshot _snapshot;
+
+    // created by the first frame that builds it
+    std::unique_ptr<DepthPyramid> _depthPyramid;
+
 public:
     RenderServer();
-    ~RenderServer() {}
+    ~RenderServer();
 
+    /**
+     * @brief gpu time of a pass a few frames ago (Profiler::GPU_FRAME_LATENCY), 0 if it did not run or the profiler
+     * is disabled
+     */
+    float getGpuPassMs(GpuPass pass) const { return _gpuPassMs[pass]; }
+    /**
+     * @brief exponential moving average, steadier for tuning parameters by hand
+     */
+    float getGpuPassMsAverage(GpuPass pass) const { return _gpuPassMsAverage[pass]; }
+    /**
+     * @brief gpu time of a whole renderSnapshot, same frame as getGpuPassMs
+     */
+    float getGpuFrameMs() const { return _gpuFrameMs; }
+
+    /**
+     * @brief cpu time of the last frame spent recording the scene draws (wall time of the parallel recording) and
+     * replaying them, replay is summed over the light passes
+     */
+    float getDrawRecordMs() const { return _drawRecordMs; }
+    float getDrawReplayMs() const { return _drawReplayMs; }
+
+    /**
+     * @brief snapshot the scene and render it, for callers that simulate and render in one stage
+     */
     void renderScene(Scene* scene);
+    /**
+     * @brief render a snapshot built by Scene::buildSnapshot, uploads its poses, view and lights first.
+     * the scene only provides the environment, so its simulation may already be working on the next frame
+     */
+    void renderSnapshot(Scene* scene, RenderSnapshot const& snapshot);
+
+    // where the final image goes, 0 is the window, headless runs set an offscreen framebuffer
+    static GL::FramebufferHandle outputFramebuffer;
 
     PostProcessType postProcessType{};
 
     bool showGrid = true;
 
+    // build the depth pyramid after the opaque pass, needs a post process (the scene depth is only kept in a
+    // texture when the frame goes through one)
+    bool buildDepthPyramid = false;
+    /**
+     * @brief pyramid of the last frame that built one, null before
+     */
+    DepthPyramid *getDepthPyramid() const { return _depthPyramid.get(); }
+    /**
+     * @brief depth attachment of the frame the post processes read
+     */
+    GL::ImageHandle getDepthImage() const { return _defaultRenderTarget.images[2]; }
+
     void onFramebufferResize(int width, int height);
 };
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "resource.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "image.h"
+#include "material.h"
+#include "model.h"
+#include "texture.h"
+
+namespace {
+// per type totals, updated from any thread
+std::array<std::atomic<uint32_t>, RESOURCE_Num> g_counts{};
+std::array<std::array<std::atomic<uint32_t>, RESOURCE_STATE_Num>, RESOURCE_Num> g_states{};
+std::array<std::atomic<size_t>, RESOURCE_Num> g_cpuBytes{};
+std::array<std::atomic<size_t>, RESOURCE_Num> g_gpuBytes{};
+// set when a reference count of the type dropped to 0, collectGarbage skips the other types
+std::array<std::atomic<bool>, RESOURCE_Num> g_garbage{};
+}  // namespace
+
+char const *getResourceTypeName(ResourceType type) {
+    static const char *names[]{"image", "texture", "material", "model"};
+    return names[type];
+}
+
+Resource::Resource(ResourceType type) : _type(type) {
+    g_counts[_type].fetch_add(1, std::memory_order_relaxed);
+    g_states[_type][RESOURCE_STATE_UNLOADED].fetch_add(1, std::memory_order_relaxed);
+}
+Resource::~Resource() {
+    clearDependencies();
+    setCpuBytes(0);
+    setGpuBytes(0);
+    g_states[_type][getState()].fetch_sub(1, std::memory_order_relaxed);
+    g_counts[_type].fetch_sub(1, std::memory_order_relaxed);
+}
+void Resource::release() {
+    if (_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) g_garbage[_type].store(true, std::memory_order_release);
+}
+void Resource::setState(ResourceState state) {
+    auto old = _state.exchange(state, std::memory_order_acq_rel);
+    if (old == state) return;
+    g_states[_type][old].fetch_sub(1, std::memory_order_relaxed);
+    g_states[_type][state].fetch_add(1, std::memory_order_relaxed);
+}
+void Resource::setCpuBytes(size_t bytes) {
+    // unsigned wrap around subtracts when the size shrinks
+    g_cpuBytes[_type].fetch_add(bytes - _cpuBytes, std::memory_order_relaxed);
+    _cpuBytes = bytes;
+}
+void Resource::setGpuBytes(size_t bytes) {
+    g_gpuBytes[_type].fetch_add(bytes - _gpuBytes, std::memory_order_relaxed);
+    _gpuBytes = bytes;
+}
+void Resource::addDependency(Resource *resource) {
+    if (!resource || std::find(_dependencies.begin(), _dependencies.end(), resource) != _dependencies.end()) return;
+    resource->addRef();
+    _dependencies.emplace_back(resource);
+}
+void Resource::removeDependency(Resource *resource) {
+    auto it = std::find(_dependencies.begin(), _dependencies.end(), resource);
+    if (it == _dependencies.end()) return;
+    _dependencies.erase(it);
+    resource->release();
+}
+void Resource::replaceDependency(Resource *oldResource, Resource *newResource) {
+    if (oldResource == newResource) return;
+    // add first, the old one may be the last reference to something the new one shares
+    addDependency(newResource);
+    removeDependency(oldResource);
+}
+void Resource::clearDependencies() {
+    for (auto e : _dependencies) e->release();
+    _dependencies.clear();
+}
+
+//==================================
+ResourceManager::~ResourceManager() {
+    // the context is gone during static destruction, AppBase::~AppBase freed everything while it was current
+    assert(_pending.empty() && _releases.empty() && "gpu objects released after the context was destroyed");
+}
+void ResourceManager::retire(PendingRelease &pending) {
+    for (auto &&e : pending.releases) e();
+    _pendingBytes -= pending.gpuBytes;
+    if (pending.fence) glDeleteSync(pending.fence);
+}
+void ResourceManager::deferRelease(std::function<void()> release, size_t gpuBytes) {
+    _releases.emplace_back(std::move(release));
+    _releaseBytes += gpuBytes;
+}
+size_t ResourceManager::collectGarbage() {
+    auto takeGarbage = [](ResourceType type) { return g_garbage[type].exchange(false, std::memory_order_acq_rel); };
+    size_t ret{};
+    if (takeGarbage(RESOURCE_MODEL)) ret += ModelManager::getSingleton().collectGarbage();
+    if (takeGarbage(RESOURCE_MATERIAL)) ret += MaterialManager::getSingleton().collectGarbage();
+    if (takeGarbage(RESOURCE_TEXTURE)) ret += TextureManager::getSingleton().collectGarbage();
+    if (takeGarbage(RESOURCE_IMAGE)) ret += ImageManager::getSingleton().collectGarbage();
+    _collected += ret;
+    return ret;
+}
+void ResourceManager::update() {
+    collectGarbage();
+    // fences signal in order, stop at the first frame still running
+    while (!_pending.empty()) {
+        auto status = glClientWaitSync(_pending.front().fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) break;
+        retire(_pending.front());
+        _pending.pop_front();
+    }
+    if (_releases.empty()) return;
+    _pending.emplace_back(PendingRelease{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(_releases),
+                                         _releaseBytes});
+    _pendingBytes += _releaseBytes;
+    _releases.clear();
+    _releaseBytes = 0;
+}
+void ResourceManager::flush() {
+    collectGarbage();
+    // nothing queued also means no gl object was ever created, there may be no context
+    if (_pending.empty() && _releases.empty()) return;
+    glFinish();
+    for (auto &&e : _pending) retire(e);
+    _pending.clear();
+    for (auto &&e : _releases) e();
+    _releases.clear();
+    _releaseBytes = 0;
+}
+ResourceStats ResourceManager::getStats() const {
+    ResourceStats ret{};
+    for (int i = 0; i < RESOURCE_Num; ++i) {
+        auto &&e = ret.types[i];
+        e.count = g_counts[i].load(std::memory_order_relaxed);
+        for (int j = 0; j < RESOURCE_STATE_Num; ++j) e.states[j] = g_states[i][j].load(std::memory_order_relaxed);
+        e.cpuBytes = g_cpuBytes[i].load(std::memory_order_relaxed);
+        e.gpuBytes = g_gpuBytes[i].load(std::memory_order_relaxed);
+    }
+    ret.pendingReleaseBytes = _pendingBytes + _releaseBytes;
+    ret.pendingReleaseFrames = static_cast<uint32_t>(_pending.size());
+    ret.collected = _collected;
+    return ret;
+}
+void ResourceManager::printReport(std::ostream &os) const {
+    auto stats = getStats();
+    os << "resources:";
+    for (int i = 0; i < RESOURCE_Num; ++i) {
+        auto &&e = stats.types[i];
+        os << " " << e.count << " " << getResourceTypeName(ResourceType(i)) << " (" << e.states[RESOURCE_STATE_LOADED]
+           << " loaded, " << e.states[RESOURCE_STATE_FAILED] << " failed, cpu " << (e.cpuBytes >> 10) << " KiB, gpu "
+           << (e.gpuBytes >> 10) << " KiB),";
+    }
+    os << " pending release " << (stats.pendingReleaseBytes >> 10) << " KiB, collected " << stats.collected << '\n';
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "gl/glew.h"
+#include "noncopyable.h"
+#include "singleton.h"
+#include "slotmap.h"
+
+enum ResourceType {
+    RESOURCE_IMAGE,
+    RESOURCE_TEXTURE,
+    RESOURCE_MATERIAL,
+    RESOURCE_MODEL,
+    RESOURCE_Num,
+};
+
+enum ResourceState {
+    RESOURCE_STATE_UNLOADED,
+    RESOURCE_STATE_LOADING,
+    RESOURCE_STATE_LOADED,
+    RESOURCE_STATE_FAILED,
+    RESOURCE_STATE_Num,
+};
+
+char const *getResourceTypeName(ResourceType type);
+
+/**
+ * @brief base of the assets owned by the managers. ResourceHandle counts references, the manager destroys a
+ * resource nobody references in ResourceManager::collectGarbage. a resource references what it is built from
+ * (model -> materials -> textures -> images), so an unused chain is freed from the top in one pass.
+ * references are taken on the main thread, they may be dropped on any thread. memory is accounted per type as
+ * resources report it
+ */
+class Resource : public NonCopyable {
+    ResourceType _type;
+    std::atomic<uint32_t> _refCount{};
+    std::atomic<ResourceState> _state{RESOURCE_STATE_UNLOADED};
+    size_t _cpuBytes{};
+    size_t _gpuBytes{};
+    // each one holds a reference
+    std::vector<Resource *> _dependencies;
+
+protected:
+    void setState(ResourceState state);
+    void setCpuBytes(size_t bytes);
+    void setGpuBytes(size_t bytes);
+
+public:
+    Resource(ResourceType type);
+    ~Resource();
+
+    void addRef() { _refCount.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+    uint32_t getRefCount() const { return _refCount.load(std::memory_order_acquire); }
+
+    /**
+     * @brief keep resource alive as long as this one, adding the same resource twice is a no-op
+     */
+    void addDependency(Resource *resource);
+    void removeDependency(Resource *resource);
+    /**
+     * @brief swap one dependency for another, either may be null
+     */
+    void replaceDependency(Resource *oldResource, Resource *newResource);
+    void clearDependencies();
+    std::vector<Resource *> const &getDependencies() const { return _dependencies; }
+
+    constexpr ResourceType getResourceType() const { return _type; }
+    ResourceState getState() const { return _state.load(std::memory_order_acquire); }
+    bool isLoaded() const { return getState() == RESOURCE_STATE_LOADED; }
+
+    // bytes owned by this resource, what dependencies hold is counted by them
+    constexpr size_t getCpuBytes() const { return _cpuBytes; }
+    constexpr size_t getGpuBytes() const { return _gpuBytes; }
+};
+
+/**
+ * @brief counted reference to a resource of type T
+ */
+template <typename T>
+class ResourceHandle {
+    template <typename U>
+    friend class ResourceHandle;
+
+    T *_p{};
+
+public:
+    ResourceHandle() = default;
+    ResourceHandle(std::nullptr_t) {}
+    ResourceHandle(T *p) : _p(p) {
+        if (_p) _p->addRef();
+    }
+    ResourceHandle(ResourceHandle const &other) : ResourceHandle(other._p) {}
+    ResourceHandle(ResourceHandle &&other) noexcept : _p(std::exchange(other._p, nullptr)) {}
+    template <typename U>
+    ResourceHandle(ResourceHandle<U> const &other) : ResourceHandle(other._p) {}
+    template <typename U>
+    ResourceHandle(ResourceHandle<U> &&other) noexcept : _p(std::exchange(other._p, nullptr)) {}
+    ~ResourceHandle() { reset(); }
+
+    ResourceHandle &operator=(ResourceHandle other) noexcept {
+        std::swap(_p, other._p);
+        return *this;
+    }
+
+    void reset() {
+        if (_p) _p->release();
+        _p = nullptr;
+    }
+
+    T *get() const { return _p; }
+    T *operator->() const { return _p; }
+    T &operator*() const { return *_p; }
+    explicit operator bool() const { return _p != nullptr; }
+    bool operator==(ResourceHandle const &other) const { return _p == other._p; }
+};
+
+/**
+ * @brief erase the resources nobody references, onErase runs before each one is destroyed. main thread
+ */
+template <typename T, typename F>
+size_t eraseUnreferenced(SlotMap<std::unique_ptr<T>> &resources, F &&onErase) {
+    std::vector<IdType> ids;
+    auto keys = resources.keys();
+    auto it = resources.begin();
+    for (size_t i = 0; i < keys.size(); ++i, ++it)
+        if ((*it)->getRefCount() == 0) ids.emplace_back(keys[i]);
+    for (auto id : ids) {
+        onErase(*resources.find(id)->get());
+        resources.erase(id);
+    }
+    return ids.size();
+}
+
+/**
+ * @brief destroy every resource, referenced or not, at shutdown while the context is current. onErase runs before
+ * each one is destroyed. handles still held elsewhere dangle afterwards
+ *
+ * @return number of resources that were still referenced
+ */
+template <typename T, typename F>
+size_t eraseAll(SlotMap<std::unique_ptr<T>> &resources, F &&onErase) {
+    size_t ret{};
+    for (auto &&e : resources) {
+        if (e->getRefCount()) ++ret;
+        onErase(*e);
+    }
+    resources.clear();
+    return ret;
+}
+
+struct ResourceTypeStats {
+    uint32_t count;
+    std::array<uint32_t, RESOURCE_STATE_Num> states;
+    size_t cpuBytes;
+    size_t gpuBytes;
+};
+
+struct ResourceStats {
+    std::array<ResourceTypeStats, RESOURCE_Num> types;
+    // gpu memory freed by the application but possibly still read by frames in flight
+    size_t pendingReleaseBytes;
+    uint32_t pendingReleaseFrames;
+    uint64_t collected;
+};
+
+/**
+ * @brief collects unreferenced resources and delays freeing gpu objects until the frames that may use them are
+ * done on the gpu. gl keeps deleted names alive while in use, but bindless handles have to stay resident and the
+ * memory is only given back then, so budgets would count it as free too early
+ */
+class ResourceManager : public Singleton<ResourceManager> {
+    struct PendingRelease {
+        GLsync fence;
+        std::vector<std::function<void()>> releases;
+        size_t gpuBytes;
+    };
+
+    // queued since the last fence
+    std::vector<std::function<void()>> _releases;
+    size_t _releaseBytes{};
+    std::deque<PendingRelease> _pending;
+    size_t _pendingBytes{};
+    uint64_t _collected{};
+
+    void retire(PendingRelease &pending);
+
+public:
+    ~ResourceManager();
+
+    /**
+     * @brief run release once the gpu finished every command submitted so far, main thread
+     *
+     * @param gpuBytes memory given back by release, reported as pending until then
+     */
+    void deferRelease(std::function<void()> release, size_t gpuBytes = 0);
+
+    /**
+     * @brief destroy resources nobody references, models first so what they release goes in the same pass
+     *
+     * @return number of resources destroyed
+     */
+    size_t collectGarbage();
+
+    /**
+     * @brief call once per frame after the frame is submitted: collects garbage, fences the releases queued
+     * during the frame and runs the ones whose fence has signaled
+     */
+    void update();
+
+    /**
+     * @brief wait for the gpu and run every pending release, before the context is destroyed. AppBase clears the
+     * managers first, nothing may be queued after that
+     */
+    void flush();
+
+    ResourceStats getStats() const;
+    void printReport(std::ostream &os) const;
+};
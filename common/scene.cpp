@@ -1,5 +1,9 @@
 #include "scene.h"
 
+#include <algorithm>
+
+#include "profiler.h"
+
 Scene::Scene() { init(); }
 Scene::Scene(std::string_view name) : _name(name) { init(); }
 
@@ -16,8 +20,8 @@ void Scene::init() {
         glm::radians(60.f), float(800) / 600}, 0.1, 1000.f);
     _editorCameraNode->addComponent<EditCameraController>();
 
-    Input::framebufferResizeSignal.Connect(
-        std::bind(&Scene::onFramebufferResize, this, std::placeholders::_1, std::placeholders::_2));
+    // a window drag resize reports many sizes per frame, only the last one matters
+    Input::framebufferResizeSignal.Connect(&Scene::onFramebufferResize, this, DeliveryPolicy::COALESCED);
 }
 void Scene::prepare() {
     std::vector<Behaviour *> behaviours;
@@ -28,6 +32,13 @@ void Scene::prepare() {
     for (auto p : lights) p->prepare();
 }
 void Scene::update(float dt) {
+    PROFILE_SCOPE("scene update");
+    Input::nextFrame();
+
+    std::vector<Transform *> transforms;
+    _root->getComponents(transforms, true);
+    for (auto p : transforms) p->storePreviousState();
+
     _root->update();
 
     updateSignal(dt);
@@ -36,6 +47,32 @@ void Scene::update(float dt) {
     _root->getComponents(behaviours, true);
     for (auto p : behaviours) p->updatePerFrame(dt);
 }
+void Scene::interpolate(float alpha) {
+    PROFILE_SCOPE("scene interpolate");
+    std::vector<Transform *> transforms;
+    _root->getComponents(transforms, true);
+    for (auto p : transforms) p->interpolate(alpha);
+}
+void Scene::buildSnapshot(RenderSnapshot &snapshot) {
+    PROFILE_SCOPE("build snapshot");
+    snapshot.clear();
+
+    auto camera = _editorCameraNode->getComponent<Camera>();
+    snapshot.camera = camera;
+    snapshot.cameraData = camera->getUBO();
+
+    std::vector<Renderer *> renderers;
+    std::vector<Light *> lights;
+    _root->getComponents(renderers, true);
+    _root->getComponents(lights, true);
+    snapshot.draws.reserve(renderers.size());
+    for (auto e : renderers) {
+        auto transform = e->getParent()->getComponent<Transform>();
+        snapshot.draws.emplace_back(
+            RenderSnapshot::Draw{e, transform, transform->getModelMatrix(), transform->getPoseVersion()});
+    }
+    for (auto e : lights) snapshot.lights.emplace_back(RenderSnapshot::LightData{e, e->uboData});
+}
 void Scene::cleanup() {}
 void Scene::onFramebufferResize(int width, int height) {
     _editorCameraNode->getComponent<Camera>()->setPerspective(glm::radians(60.f), float(width) / height);
@@ -58,6 +95,8 @@ Node *Scene::createCamera(Node *parent) {
 }
 Node *Scene::addModel(Model *model, Node *parent) {
     if (!parent) parent = _root.get();
+    if (std::none_of(_models.begin(), _models.end(), [model](auto &&e) { return e.get() == model; }))
+        _models.emplace_back(model);
 
     std::vector<Node *> tempObjects;
     Node *root;
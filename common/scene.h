@@ -1,6 +1,7 @@
 #pragma once
 #include "camera.h"
 #include "environment.h"
+#include "framepipeline.h"
 #include "grid.h"
 #include "idObject.h"
 #include "input.h"
@@ -11,7 +12,7 @@
 #include "singleton.h"
 #include "transform.h"
 
-class Scene : public IdObject {
+class Scene : public IdObject<Scene> {
 protected:
     friend class RenderServer;
     std::string _name;
@@ -20,6 +21,9 @@ protected:
 
     Node* _editorCameraNode;
 
+    // models instantiated in the scene, kept for hot reload while the scene lives
+    std::vector<ResourceHandle<Model>> _models;
+
     void init();
 
 public:
@@ -33,14 +37,31 @@ public:
     std::string_view getName() const { return _name; }
 
     Node* getRoot() const { return _root.get(); }
+    Node* getEditorCameraNode() const { return _editorCameraNode; }
 
     void prepare();
+    /**
+     * @brief one simulation step
+     */
     void update(float dt);
+    /**
+     * @brief blend rendered transforms between the last two updates, alpha in [0, 1]
+     */
+    void interpolate(float alpha);
+    /**
+     * @brief copy the current render poses, the editor camera view and the lights into snapshot, no gl call.
+     * runs on the simulation stage, which must not add or remove nodes, components or materials while the render
+     * stage draws the previous snapshot
+     */
+    void buildSnapshot(RenderSnapshot& snapshot);
     void cleanup();
 
     Node* createLight(Node* parent = nullptr);
     Node* createCamera(Node* parent = nullptr);
 
+    /**
+     * @brief instantiate the nodes of model, the scene references it until destroyed
+     */
     Node* addModel(Model* model, Node* parent = nullptr);
 
     void onFramebufferResize(int, int);
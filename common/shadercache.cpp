@@ -0,0 +1,246 @@
+#include "shadercache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include "fileview.h"
+
+namespace {
+constexpr uint32_t CACHE_MAGIC = 0x4e424350;  // "PCBN"
+constexpr uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+};
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    auto p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+GLenum getShaderType(GL::ShaderStageFlagBits stage) {
+    switch (stage) {
+        case GL::SHADER_STAGE_VERTEX_BIT:
+            return GL_VERTEX_SHADER;
+        case GL::SHADER_STAGE_FRAGMENT_BIT:
+            return GL_FRAGMENT_SHADER;
+        case GL::SHADER_STAGE_GEOMETRY_BIT:
+            return GL_GEOMETRY_SHADER;
+        case GL::SHADER_STAGE_TESS_CONTROL_BIT:
+            return GL_TESS_CONTROL_SHADER;
+        case GL::SHADER_STAGE_TESS_EVALUATION_BIT:
+            return GL_TESS_EVALUATION_SHADER;
+        case GL::SHADER_STAGE_COMPUTE_BIT:
+            return GL_COMPUTE_SHADER;
+        default:
+            THROW("unsupported shader stage", stage);
+    }
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+ProgramCache::ProgramCache() {
+    auto getString = [](GLenum name) {
+        auto str = reinterpret_cast<const char *>(glGetString(name));
+        return std::string(str ? str : "");
+    };
+    _driverId = getString(GL_VENDOR) + '|' + getString(GL_RENDERER) + '|' + getString(GL_VERSION);
+    _binarySupported = !GL::getSupportedProgramBinaryFormat().empty();
+
+    if (GLEW_KHR_parallel_shader_compile) {
+        // let the driver pick the number of compiler threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        _parallelCompile = true;
+    }
+    setCacheDir(SHADER_CACHE_DIR);
+}
+void ProgramCache::setCacheDir(std::string_view dir) {
+    _cacheDir = dir;
+    if (_cacheDir.empty()) return;
+    std::error_code ec;
+    std::filesystem::create_directories(_cacheDir, ec);
+    if (ec) {
+        LOG("failed to create shader cache dir, cache disabled:", _cacheDir, ec.message());
+        _cacheDir.clear();
+    }
+}
+uint64_t ProgramCache::computeKey(ProgramSources const &sources) const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = fnv1a(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = fnv1a(hash, _driverId.data(), _driverId.size());
+    for (auto &&e : sources.stages) {
+        hash = fnv1a(hash, &e.stage, sizeof(e.stage));
+        hash = fnv1a(hash, e.code.data(), e.code.size());
+    }
+    return hash;
+}
+std::string ProgramCache::cacheFile(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return _cacheDir + "/" + name;
+}
+GL::ProgramHandle ProgramCache::loadBinary(uint64_t key) {
+    if (!_binarySupported || _cacheDir.empty()) return 0;
+
+    auto path = cacheFile(key);
+    FileView file;
+    if (!file.open(path)) return 0;
+
+    auto start = std::chrono::steady_clock::now();
+    CacheHeader header{};
+    if (file.size() >= sizeof(header)) memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key ||
+        file.size() != sizeof(header) + header.size) {
+        ++_stats.rejected;
+        file = FileView();
+        std::filesystem::remove(path);
+        return 0;
+    }
+
+    auto program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramBinary(program, header.format, file.data() + sizeof(header), header.size);
+    GLint success{};
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    _stats.loadMs += elapsedMs(start);
+    if (!success) {
+        // driver changed the binary format without changing its version strings
+        glDeleteProgram(program);
+        ++_stats.rejected;
+        file = FileView();
+        std::filesystem::remove(path);
+        return 0;
+    }
+    return program;
+}
+void ProgramCache::saveBinary(uint64_t key, GL::ProgramHandle program) {
+    if (!_binarySupported || _cacheDir.empty()) return;
+
+    GLint length{};
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> data(length);
+    GLenum format{};
+    glGetProgramBinary(program, length, &length, &format, data.data());
+
+    CacheHeader header{CACHE_MAGIC, CACHE_VERSION, key, format, static_cast<uint32_t>(length)};
+    // write to a temporary file first, a concurrent reader never sees a partial binary
+    auto path = cacheFile(key);
+    auto tmpPath = path + ".tmp";
+    {
+        std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!os) return;
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        os.write(data.data(), length);
+        if (!os) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) std::filesystem::remove(tmpPath, ec);
+}
+GL::ProgramHandle ProgramCache::getProgram(ProgramSources const &sources) {
+    return getPrograms(std::span<ProgramSources const>(&sources, 1))[0];
+}
+std::vector<GL::ProgramHandle> ProgramCache::getPrograms(std::span<ProgramSources const> sources) {
+    std::vector<GL::ProgramHandle> ret(sources.size());
+
+    struct Pending {
+        size_t index;
+        uint64_t key;
+        std::vector<GLuint> shaders{};
+        GLuint program{};
+    };
+    std::vector<Pending> pendings;
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        auto key = computeKey(sources[i]);
+        ret[i] = loadBinary(key);
+        if (ret[i])
+            ++_stats.hits;
+        else
+            pendings.emplace_back(Pending{i, key});
+    }
+    if (pendings.empty()) return ret;
+
+    auto start = std::chrono::steady_clock::now();
+    // submit every compile and link before querying any status, so the driver can work on them in parallel
+    for (auto &&e : pendings) {
+        for (auto &&stage : sources[e.index].stages) {
+            auto shader = glCreateShader(getShaderType(stage.stage));
+            auto code = stage.code.data();
+            auto length = static_cast<GLint>(stage.code.size());
+            glShaderSource(shader, 1, &code, &length);
+            glCompileShader(shader);
+            e.shaders.emplace_back(shader);
+        }
+    }
+    for (auto &&e : pendings) {
+        e.program = glCreateProgram();
+        glProgramParameteri(e.program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        glProgramParameteri(e.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        for (auto shader : e.shaders) glAttachShader(e.program, shader);
+        glLinkProgram(e.program);
+    }
+    for (auto &&e : pendings) {
+        if (_parallelCompile) {
+            GLint completed{};
+            while (glGetProgramiv(e.program, GL_COMPLETION_STATUS_KHR, &completed), !completed)
+                std::this_thread::yield();
+        }
+        GLint success{};
+        glGetProgramiv(e.program, GL_LINK_STATUS, &success);
+        if (!success) {
+            std::string log;
+            for (auto shader : e.shaders) {
+                GLint len{};
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
+                std::string shaderLog(len, '\0');
+                if (len) glGetShaderInfoLog(shader, len, nullptr, shaderLog.data());
+                log += shaderLog;
+            }
+            GLint len{};
+            glGetProgramiv(e.program, GL_INFO_LOG_LENGTH, &len);
+            std::string programLog(len, '\0');
+            if (len) glGetProgramInfoLog(e.program, len, nullptr, programLog.data());
+            log += programLog;
+            // the caller gets none of the batch, cache hits and programs linked before this one included
+            for (auto &&p : pendings) {
+                for (auto shader : p.shaders) glDeleteShader(shader);
+                glDeleteProgram(p.program);
+                ret[p.index] = 0;
+            }
+            for (auto program : ret)
+                if (program) glDeleteProgram(program);
+            THROW("failed to link program", log);
+        }
+        for (auto shader : e.shaders) {
+            glDetachShader(e.program, shader);
+            glDeleteShader(shader);
+        }
+        e.shaders.clear();
+        saveBinary(e.key, e.program);
+        ret[e.index] = e.program;
+        ++_stats.misses;
+    }
+    _stats.compileMs += elapsedMs(start);
+    return ret;
+}
+void ProgramCache::printReport(std::ostream &os) const {
+    os << "shader program cache (" << (_stats.misses ? "cold" : "warm") << "): " << _stats.hits << " hits, "
+       << _stats.misses << " compiled, " << _stats.rejected << " rejected, binary load " << _stats.loadMs
+       << " ms, compile " << _stats.compileMs << " ms, parallel compile " << (_parallelCompile ? "on" : "off")
+       << '\n';
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "prerequisites.h"
+
+struct ShaderSource {
+    GL::ShaderStageFlagBits stage;
+    std::string code;
+};
+
+struct ProgramSources {
+    std::vector<ShaderSource> stages;
+};
+
+struct ProgramCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t rejected;  // binaries refused by the driver or corrupted, recompiled
+    double loadMs;      // time spent in glProgramBinary
+    double compileMs;   // time spent compiling and linking missed programs
+};
+
+/**
+ * @brief persistent cache of linked separable programs (glGetProgramBinary/glProgramBinary)
+ * a program is keyed by the hash of its stage sources and the driver vendor/renderer/version strings, so driver
+ * updates or shader edits miss the cache and fall back to compilation.
+ * when GL_KHR_parallel_shader_compile is available every stage of a batch is submitted before waiting for any.
+ */
+class ProgramCache : public Singleton<ProgramCache> {
+    std::string _cacheDir;
+    std::string _driverId;
+    bool _binarySupported{false};
+    bool _parallelCompile{false};
+
+    ProgramCacheStats _stats{};
+
+    uint64_t computeKey(ProgramSources const &sources) const;
+    std::string cacheFile(uint64_t key) const;
+    GL::ProgramHandle loadBinary(uint64_t key);
+    void saveBinary(uint64_t key, GL::ProgramHandle program);
+
+public:
+    ProgramCache();
+
+    /**
+     * @brief defaults to SHADER_CACHE_DIR, an empty path disables the cache
+     */
+    void setCacheDir(std::string_view dir);
+    std::string const &getCacheDir() const { return _cacheDir; }
+
+    /**
+     * @brief linked separable program, throw if compilation or linking fails
+     */
+    GL::ProgramHandle getProgram(ProgramSources const &sources);
+
+    /**
+     * @brief compile every missed program of the batch in parallel (if supported) before waiting for them
+     */
+    std::vector<GL::ProgramHandle> getPrograms(std::span<ProgramSources const> sources);
+
+    constexpr ProgramCacheStats const &getStats() const { return _stats; }
+    constexpr bool isParallelCompileSupported() const { return _parallelCompile; }
+
+    /**
+     * @brief print hit/miss counts and time spent, cold (any miss) or warm
+     */
+    void printReport(std::ostream &os) const;
+};
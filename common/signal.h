@@ -1,15 +1,26 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
 #include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
 #include <set>
+#include <stdexcept>
 #include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include "eventqueue.h"
+#include "smallfunction.h"
+
 template <class... Ts>
 struct overloaded : Ts... {
     using Ts::operator()...;
@@ -118,6 +129,19 @@ protected:
     void track_signal(const SignalBase &signal) { _trackedObjects.emplace_back(signal.lock_pimpl()); }
 };
 
+// member function bound to its object, comparable so Disconnect(f, owner) finds it again
+template <typename Function, typename T>
+struct BoundMemberFunction {
+    Function f;
+    T *owner;
+
+    template <typename... Args>
+    decltype(auto) operator()(Args &&...args) const {
+        return std::invoke(f, owner, std::forward<Args>(args)...);
+    }
+    bool operator==(BoundMemberFunction const &) const = default;
+};
+
 template <typename _Signature>
 class Slot;
 
@@ -126,43 +150,24 @@ template <typename Ret_, typename... Args>
 class Slot<Ret_(Args...)> : public SlotBase {
 public:
     using signature_type = Ret_(Args...);
-    using function_type = std::function<signature_type>;
+    using function_type = SmallFunction<signature_type>;
     using result_type = Ret_;
 
-    // template <typename T>
     Slot() = default;
 
     template <typename Function, typename T, typename ReturnType = std::invoke_result_t<Function, T *, Args...>>
         requires std::invocable<Function, T *, Args...> && std::is_same_v<ReturnType, Ret_>
-    Slot(Function &&f, T *owner) {
-        _slotFunction = [func = std::move(f), owner](Args... args) -> Ret_ {
-            if constexpr (std::is_void_v<ReturnType>)
-                std::invoke(func, owner, args...);
-            else
-                return std::invoke(func, owner, args...);
-        };
-    }
+    Slot(Function &&f, T *owner) : _slotFunction(BoundMemberFunction<std::decay_t<Function>, T>{f, owner}) {}
 
     template <typename Function, typename ReturnType = std::invoke_result_t<Function, Args...>>
         requires std::invocable<Function, Args...> && std::is_same_v<ReturnType, Ret_>
-    Slot(Function &&f) {
-        // #if __cpp_lib_move_only_function
-        _slotFunction = [func = std::move(f)](Args... args) -> Ret_ {
-            if constexpr (std::is_void_v<ReturnType>)
-                std::invoke(func, args...);
-            else
-                std::invoke(func, args...);
-        };
-    }
+    Slot(Function &&f) : _slotFunction(std::forward<Function>(f)) {}
 
     // check if empty
     explicit operator bool() const noexcept { return bool(_slotFunction); }
 
     // invocation
-    result_type operator()(Args... args) const {
-        lock();
-        if (_slotFunction) return _slotFunction(args...);
-    }
+    result_type operator()(Args... args) const { return _slotFunction(std::forward<Args>(args)...); }
 
     Slot &Track(const std::weak_ptr<void> &v) {
         _trackedObjects.emplace_back(v);
@@ -181,111 +186,36 @@ public:
     constexpr const function_type &SlotFunction() const { return _slotFunction; }
     constexpr function_type &SlotFunction() { return _slotFunction; }
 
-    bool operator==(const Slot &other) const {
-        return _slotFunction.target<signature_type>() == other._slotFunction.target<signature_type>();
-    }
+    bool operator==(const Slot &other) const { return _slotFunction == other._slotFunction; }
 
 private:
     function_type _slotFunction;
 };
 
-// called by combiner, wrap slot iter and arguments
-template <typename _ConnectionBody, typename _ConnectionBodyIter, typename... _Args>
-class SlotCallIterator {
-public:
-    using result_type = typename _ConnectionBody::slot_type::result_type;
-
-    SlotCallIterator(_ConnectionBodyIter it, std::shared_ptr<std::tuple<_Args...>> args) : _iter(it), _args(args) {}
-    result_type operator*() { return invokeFunc(std::make_index_sequence<sizeof...(_Args)>{}); }
-    bool operator==(const SlotCallIterator &other) { return _iter == other._iter; }
-    bool operator!=(const SlotCallIterator &other) { return _iter != other._iter; }
-    SlotCallIterator &operator++() {
-        ++_iter;
-        return *this;
-    };
-    SlotCallIterator &operator--() {
-        --_iter;
-        return *this;
-    };
-    SlotCallIterator operator++(int) {
-        auto ret = *this;
-        _iter++;
-        return ret;
-    };
-    SlotCallIterator operator--(int) {
-        auto ret = *this;
-        _iter++;
-        return ret;
-    };
-
-private:
-    _ConnectionBodyIter _iter;
-    std::shared_ptr<std::tuple<_Args...>> _args;
-
-    template <size_t... I>
-    result_type invokeFunc(std::index_sequence<I...>) {
-        return (*(*_iter)->GetSlot())(std::get<I>(*_args)...);
-    }
-};
-
+/**
+ * @brief shared between a connection of the signal and the Connection handles given out for it
+ */
 class ConnectionBodyBase {
-    mutable bool _connected{true};
+    // atomic, deferred deliveries check it on the dispatching thread
+    mutable std::atomic<bool> _connected{true};
+    tracked_container_type _trackedObjects;
 
 public:
-    virtual ~ConnectionBodyBase() {}
+    ConnectionBodyBase() = default;
+    explicit ConnectionBodyBase(tracked_container_type const &trackedObjects) : _trackedObjects(trackedObjects) {}
 
-    void Disconnect() {
-        if (_connected) {
-            std::unique_lock<ConnectionBodyBase> lk(*this);
-            ReleaseSlot();
-            _connected = false;
-        }
-    }
+    void Disconnect() { _connected.store(false, std::memory_order_relaxed); }
+    // false once disconnected or one of the tracked objects expired
     bool Connected() const {
-        if (SlotExpired()) _connected = false;
-        return _connected;
-    }
-
-    virtual void lock() = 0;
-    virtual void unlock() = 0;
-    virtual std::shared_ptr<void> ReleaseSlot() = 0;
-    virtual bool SlotExpired() const = 0;
-};
-
-template <typename _SlotType, typename _GroupKey>
-class ConnectionBody : public ConnectionBodyBase {
-    _GroupKey _group{};
-    std::shared_ptr<_SlotType> _slot;
-    std::shared_ptr<std::mutex> _mutex;  // from  signal
-
-public:
-    using slot_type = _SlotType;
-
-    ConnectionBody(const _SlotType &slotIn, const std::shared_ptr<std::mutex> &signalMutex) noexcept
-        : _slot(new _SlotType(slotIn)), _mutex(signalMutex) {}
-    ConnectionBody(_GroupKey group, const _SlotType &slotIn, const std::shared_ptr<std::mutex> &signalMutex) noexcept
-        : _group(group), _slot(new _SlotType(slotIn)), _mutex(signalMutex) {}
-    ~ConnectionBody() { Disconnect(); }
-
-    void DisconnectExpiredSlot() {
-        if (_slot && _slot->Expired()) {
-            Disconnect();
+        if (!_connected.load(std::memory_order_relaxed)) return false;
+        for (auto &&e : _trackedObjects) {
+            if (std::get<std::weak_ptr<void>>(e).expired()) {
+                _connected.store(false, std::memory_order_relaxed);
+                return false;
+            }
         }
+        return true;
     }
-
-    void lock() override { _mutex->lock(); }
-    void unlock() override { _mutex->unlock(); }
-
-    constexpr std::shared_ptr<_SlotType> GetSlot() const { return _slot; }
-
-    std::shared_ptr<void> ReleaseSlot() override {
-        std::shared_ptr<_SlotType> ret;
-        ret.swap(_slot);
-        return ret;
-    }
-    bool SlotExpired() const override { return _slot->expired(); }
-    const _GroupKey &GroupKey() const { return _group; }
-    void SetGroupKey(const _GroupKey &group) { _group = group; }
 };
 
 class Connection {
@@ -297,117 +227,309 @@ public:
 
     // connection management
     void Disconnect() const {
-        if (!_weakConnectionBody.expired()) _weakConnectionBody.lock()->Disconnect();
+        if (auto p = _weakConnectionBody.lock()) p->Disconnect();
     }
     bool Connected() const noexcept {
-        if (!_weakConnectionBody.expired()) return _weakConnectionBody.lock()->Connected();
+        if (auto p = _weakConnectionBody.lock()) return p->Connected();
         return false;
     }
 
     void Swap(Connection &other) noexcept { std::swap(_weakConnectionBody, other._weakConnectionBody); }
+};
 
-    // blocking
-    // bool Blocked() const noexcept {}
-    // bool operator==(const Connection &other) const noexcept {}
-    // bool operator!=(const Connection &other) const noexcept { return !(*this == other); }
-    // bool operator<(const Connection &other) const noexcept {}
+enum class DeliveryPolicy {
+    // the slot runs in the emitting thread during the emission
+    DIRECT,
+    // every emission is posted to an event queue, the slot runs in emission order when the queue is dispatched
+    QUEUED,
+    // emissions until the next dispatch collapse into one call with the latest arguments, for high frequency values
+    // like mouse positions or the framebuffer size
+    COALESCED,
 };
 
+/**
+ * @brief slot of a QUEUED or COALESCED connection, only signals returning void whose arguments can be copied into
+ * an event can defer their slots
+ */
+template <typename _Signature>
+struct DeferredDelivery {
+    static constexpr bool supported = false;
+    SmallFunction<_Signature> function;
+};
+
+template <typename... Args>
+struct DeferredDelivery<void(Args...)> {
+    using function_type = SmallFunction<void(Args...)>;
+    using values_type = std::tuple<std::decay_t<Args>...>;
+
+    // a queued event holds the state pointer and a copy of the arguments
+    static constexpr bool supported =
+        (std::is_copy_constructible_v<std::decay_t<Args>> && ...) &&
+        std::is_nothrow_move_constructible_v<values_type> &&
+        sizeof(std::shared_ptr<void>) + sizeof(values_type) <= EventQueue::EVENT_SIZE &&
+        alignof(values_type) <= alignof(std::max_align_t);
+
+    function_type function;
+    std::weak_ptr<ConnectionBodyBase> body;
+    EventQueue *queue;
+    // COALESCED, arguments of the latest emission not yet delivered
+    std::mutex latestMutex;
+    std::optional<values_type> latest;
+
+    bool connected() const {
+        auto p = body.lock();
+        return p && p->Connected();
+    }
+
+    /**
+     * @brief what the signal calls on emission instead of the slot, the arguments are copied into the event
+     */
+    static function_type makeForwarder(std::shared_ptr<DeferredDelivery> const &state, DeliveryPolicy policy) {
+        if (policy == DeliveryPolicy::QUEUED) {
+            return [state](Args... args) {
+                state->queue->post([state, values = values_type(args...)]() mutable {
+                    if (state->connected()) std::apply(state->function, values);
+                });
+            };
+        }
+        return [state](Args... args) {
+            std::unique_lock lock(state->latestMutex);
+            bool posted = state->latest.has_value();
+            state->latest.emplace(args...);
+            lock.unlock();
+            if (posted) return;
+            state->queue->post([state] {
+                std::unique_lock lock(state->latestMutex);
+                auto values = std::move(*state->latest);
+                state->latest.reset();
+                lock.unlock();
+                if (state->connected()) std::apply(state->function, values);
+            });
+        };
+    }
+};
+
+/**
+ * @brief connections live in a flat vector ordered by group, emitting does not allocate: the arguments are passed
+ * by reference to the combiner, slot callables are stored inline.
+ * disconnected and expired connections are skipped and removed after the outermost emission, connections made
+ * during an emission are added after it and not called by it.
+ * not thread safe, connect and emit on one thread, ConcurrentSignal is the thread safe variant. a connection with
+ * a QUEUED or COALESCED DeliveryPolicy runs its slot on the thread dispatching the given event queue instead
+ */
 template <typename _Signature, typename _Combiner = last_value<typename std::function<_Signature>::result_type>,
           typename _Group = int, std::enable_if_t<std::is_function_v<_Signature>, bool> = true>
 class Signal : public SignalBase {
 public:
     using signature_type = _Signature;
     using group_type = _Group;
-    using slot_function_type = std::function<signature_type>;
     using slot_type = Slot<signature_type>;
+    using slot_function_type = typename slot_type::function_type;
     using combiner_type = _Combiner;
     using result_type = typename combiner_type::result_type;
-    using connection_body_type = ConnectionBody<slot_type, group_type>;
 
-    struct ConnectionCompare {
-        bool operator()(const std::shared_ptr<connection_body_type> &lhs,
-                        const std::shared_ptr<connection_body_type> &rhs) const {
-            return lhs->GroupKey() < rhs->GroupKey();
-        };
+private:
+    using deferred_delivery_type = DeferredDelivery<signature_type>;
+
+    struct ConnectionEntry {
+        group_type group;
+        // the slot, or the forwarder of a deferred connection
+        slot_function_type function;
+        std::shared_ptr<ConnectionBodyBase> body;
+        std::shared_ptr<deferred_delivery_type> deferred;
+
+        bool matches(slot_function_type const &f) const {
+            return (deferred ? deferred->function : function) == f;
+        }
+    };
+
+    // called by the combiner, dereferencing calls the slot
+    template <typename... _Args>
+    class SlotCallIterator {
+        Signal const *_signal;
+        size_t _index;
+        size_t _end;
+        std::tuple<_Args &...> *_args;
+
+        void skipDisconnected() {
+            while (_index < _end && !_signal->_connections[_index].body->Connected()) {
+                _signal->_needsCompaction = true;
+                ++_index;
+            }
+        }
+
+    public:
+        using result_type = typename slot_type::result_type;
+
+        SlotCallIterator(Signal const *signal, size_t index, size_t end, std::tuple<_Args &...> *args)
+            : _signal(signal), _index(index), _end(end), _args(args) {
+            skipDisconnected();
+        }
+        result_type operator*() const {
+            return std::apply([this](auto &...args) { return _signal->_connections[_index].function(args...); },
+                              *_args);
+        }
+        bool operator==(const SlotCallIterator &other) const { return _index == other._index; }
+        bool operator!=(const SlotCallIterator &other) const { return _index != other._index; }
+        SlotCallIterator &operator++() {
+            ++_index;
+            skipDisconnected();
+            return *this;
+        }
+        SlotCallIterator operator++(int) {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
     };
-    using connection_container_type = std::multiset<std::shared_ptr<connection_body_type>, ConnectionCompare>;
-    using connection_container_iterator_type = typename connection_container_type::iterator;
 
-    Signal() : _mutex(std::make_shared<std::mutex>()), _handle(std::make_shared<int>()) {}
+    mutable std::vector<ConnectionEntry> _connections;
+    // connected while emitting, merged when the outermost emission returns
+    mutable std::vector<ConnectionEntry> _pendingConnections;
+    mutable uint32_t _emitDepth{};
+    mutable bool _needsCompaction{};
+
+    std::shared_ptr<int> _handle;
+
+    combiner_type _combiner{};
+
+    std::shared_ptr<void> lock_pimpl() const override { return _handle; }
+
+    Connection insert(group_type group, slot_type const &slot) const {
+        auto body = std::make_shared<ConnectionBodyBase>(slot.tracked_objects());
+        add(ConnectionEntry{group, slot.SlotFunction(), body, nullptr});
+        return Connection(body);
+    }
+    // only instantiated by the Connect overloads taking a policy, which reject signals that cannot defer
+    Connection insert(group_type group, slot_type const &slot, DeliveryPolicy policy, EventQueue *queue) const {
+        if (policy == DeliveryPolicy::DIRECT) return insert(group, slot);
+        auto body = std::make_shared<ConnectionBodyBase>(slot.tracked_objects());
+        ConnectionEntry entry{group, {}, body, std::make_shared<deferred_delivery_type>()};
+        entry.deferred->function = slot.SlotFunction();
+        entry.deferred->body = body;
+        entry.deferred->queue = queue;
+        entry.function = deferred_delivery_type::makeForwarder(entry.deferred, policy);
+        add(std::move(entry));
+        return Connection(body);
+    }
+    void add(ConnectionEntry &&entry) const {
+        if (_emitDepth > 0)
+            _pendingConnections.emplace_back(std::move(entry));
+        else
+            insertSorted(std::move(entry));
+    }
+    void insertSorted(ConnectionEntry &&entry) const {
+        auto it = std::upper_bound(_connections.begin(), _connections.end(), entry.group,
+                                   [](group_type const &group, auto &&e) { return group < e.group; });
+        _connections.emplace(it, std::move(entry));
+    }
+    // outside of emissions only
+    void compact() const {
+        for (auto &&e : _pendingConnections) insertSorted(std::move(e));
+        _pendingConnections.clear();
+        if (_needsCompaction) {
+            std::erase_if(_connections, [](auto &&e) { return !e.body->Connected(); });
+            _needsCompaction = false;
+        }
+    }
+    void disconnectIf(auto &&pred) {
+        for (auto &&list : {&_connections, &_pendingConnections}) {
+            for (auto &&e : *list) {
+                if (e.body->Connected() && pred(e)) {
+                    e.body->Disconnect();
+                    _needsCompaction = true;
+                    return;
+                }
+            }
+        }
+    }
+
+    struct EmitScope {
+        Signal const &signal;
+        explicit EmitScope(Signal const &s) : signal(s) { ++signal._emitDepth; }
+        ~EmitScope() {
+            if (--signal._emitDepth == 0 && (signal._needsCompaction || !signal._pendingConnections.empty()))
+                signal.compact();
+        }
+    };
+
+public:
+    Signal() : _handle(std::make_shared<int>()) {}
     ~Signal() {}
 
     template <typename Function, typename T>
     Connection Connect(Function &&f, T *owner, group_type group = 0) {
-        const std::lock_guard<std::mutex> lock(*_mutex);
-        return Connection(
-            *_connections.emplace(std::make_shared<connection_body_type>(group, slot_type(f, owner), _mutex)));
+        return insert(group, slot_type(f, owner));
     }
     template <typename Function>
     Connection Connect(Function &&f, group_type group = 0) {
-        const std::lock_guard<std::mutex> lock(*_mutex);
-        return Connection(*_connections.emplace(std::make_shared<connection_body_type>(group, slot_type(f), _mutex)));
+        if constexpr (std::is_same_v<std::decay_t<Function>, slot_type>)
+            return insert(group, f);
+        else
+            return insert(group, slot_type(std::forward<Function>(f)));
+    }
+    /**
+     * @brief connect with a delivery policy, deferred slots run when queue is dispatched
+     */
+    template <typename Function, typename T>
+    Connection Connect(Function &&f, T *owner, DeliveryPolicy policy,
+                       EventQueue &queue = MainEventQueue::getSingleton(), group_type group = 0) {
+        static_assert(deferred_delivery_type::supported,
+                      "only signals returning void with small copyable arguments can defer delivery");
+        return insert(group, slot_type(f, owner), policy, &queue);
+    }
+    template <typename Function>
+    Connection Connect(Function &&f, DeliveryPolicy policy, EventQueue &queue = MainEventQueue::getSingleton(),
+                       group_type group = 0) {
+        static_assert(deferred_delivery_type::supported,
+                      "only signals returning void with small copyable arguments can defer delivery");
+        if constexpr (std::is_same_v<std::decay_t<Function>, slot_type>)
+            return insert(group, f, policy, &queue);
+        else
+            return insert(group, slot_type(std::forward<Function>(f)), policy, &queue);
     }
 
-    bool Contains(const slot_type &slot) {
-        return std::find_if(_connections.cbegin(), _connections.cend(),
-                            [&slot](auto &&e) { return *e->GetSlot() == slot; }) != _connections.cend();
+    bool Contains(const slot_type &slot) const {
+        auto pred = [&slot](auto &&e) { return e.body->Connected() && e.matches(slot.SlotFunction()); };
+        return std::any_of(_connections.begin(), _connections.end(), pred) ||
+               std::any_of(_pendingConnections.begin(), _pendingConnections.end(), pred);
     }
     template <typename Function, typename T>
     void Disconnect(Function &&f, T *owner) {
-        auto it = std::find_if(_connections.cbegin(), _connections.cend(),
-                               [slot = slot_type(f, owner)](auto &&e) { return *e->GetSlot() == slot; });
-        if (it != _connections.cend()) {
-            _connections.erase(it);
-            return;
-        }
+        disconnectIf([slot = slot_type(f, owner)](auto &&e) { return e.matches(slot.SlotFunction()); });
+        if (_emitDepth == 0) compact();
     }
     template <typename Function>
     void Disconnect(Function &&f) {
-        ;
-        auto it = std::find_if(_connections.cbegin(), _connections.cend(),
-                               [slot = slot_type(f)](auto &&e) { return *e->GetSlot() == slot; });
-        if (it != _connections.cend()) {
-            _connections.erase(it);
-            return;
-        }
+        disconnectIf([slot = slot_type(f)](auto &&e) { return e.matches(slot.SlotFunction()); });
+        if (_emitDepth == 0) compact();
+    }
+    void DisconnectAllConnections() {
+        for (auto &&e : _connections) e.body->Disconnect();
+        for (auto &&e : _pendingConnections) e.body->Disconnect();
+        _needsCompaction = true;
+        if (_emitDepth == 0) compact();
+    }
+    bool Empty() const { return ConnectionNum() == 0; }
+    size_t ConnectionNum() const {
+        auto connected = [](auto &&e) { return e.body->Connected(); };
+        return std::count_if(_connections.begin(), _connections.end(), connected) +
+               std::count_if(_pendingConnections.begin(), _pendingConnections.end(), connected);
     }
-    void DisconnectAllConnections() { _connections.clear(); }
-    constexpr bool Empty() const { return _connections.empty(); }
-    constexpr size_t ConnectionNum() const { return _connections.size(); }
 
     void ClearExpiredConnections() const {
-        while (true) {
-            auto it = std::find_if(_connections.begin(), _connections.end(), [](auto &&e) {
-                auto a = e->GetSlot();
-                return !a || e->SlotExpired();
-            });
-            if (it == _connections.end())
-                break;
-            else
-                _connections.erase(it);
-        }
-    };
+        _needsCompaction = true;
+        if (_emitDepth == 0) compact();
+    }
 
     template <typename... Args>
     result_type operator()(Args &&...args) const {
-        ClearExpiredConnections();
-        auto a = std::make_shared<std::tuple<Args...>>(args...);
-        return _combiner(
-            SlotCallIterator<connection_body_type, connection_container_iterator_type, Args...>(_connections.begin(),
-                                                                                                a),
-            SlotCallIterator<connection_body_type, connection_container_iterator_type, Args...>(_connections.end(), a));
+        EmitScope scope(*this);
+        std::tuple<Args &...> refs(args...);
+        auto end = _connections.size();
+        return _combiner(SlotCallIterator<Args...>(this, 0, end, &refs),
+                         SlotCallIterator<Args...>(this, end, end, &refs));
     }
 
     constexpr std::shared_ptr<int> getHandle() const { return _handle; }
-
-private:
-    mutable connection_container_type _connections{};
-
-    std::shared_ptr<std::mutex> _mutex;
-    std::shared_ptr<int> _handle;
-
-    combiner_type _combiner{};
-
-    std::shared_ptr<void> lock_pimpl() const override { return _handle; }
 };
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "handle.h"
+
+/**
+ * @brief map from generational ids to values, stored densely. the index of an id selects a slot in a sparse
+ * array, the slot points into the packed value array, the stored id rejects stale handles. lookup is two array
+ * reads instead of hashing, iteration walks the packed values. erasing moves the last value into the hole, so
+ * pointers and iteration order do not survive erase.
+ * keys must come from one HandleAllocator (the ids of one IdObject type), not thread safe
+ */
+template <typename T>
+class SlotMap {
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    // handle index -> position in _values
+    std::vector<uint32_t> _slots;
+    std::vector<IdType> _keys;
+    std::vector<T> _values;
+
+    uint32_t position(IdType id) const {
+        auto index = getHandleIndex(id);
+        if (index >= _slots.size()) return EMPTY;
+        auto pos = _slots[index];
+        return pos != EMPTY && _keys[pos] == id ? pos : EMPTY;
+    }
+
+public:
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    /**
+     * @brief returns the value and true, or the value already stored for id and false
+     */
+    template <typename... Args>
+    std::pair<T *, bool> emplace(IdType id, Args &&...args) {
+        if (id == INVALID_ID) throw std::invalid_argument("invalid id");
+        auto index = getHandleIndex(id);
+        if (index >= _slots.size()) _slots.resize(index + 1, EMPTY);
+        if (auto pos = _slots[index]; pos != EMPTY) {
+            if (_keys[pos] == id) return {&_values[pos], false};
+            // the index was reused, the previous owner was destroyed without being erased
+            erase(_keys[pos]);
+        }
+        _slots[index] = static_cast<uint32_t>(_values.size());
+        _keys.emplace_back(id);
+        _values.emplace_back(std::forward<Args>(args)...);
+        return {&_values.back(), true};
+    }
+
+    bool erase(IdType id) {
+        auto pos = position(id);
+        if (pos == EMPTY) return false;
+        auto last = static_cast<uint32_t>(_values.size() - 1);
+        if (pos != last) {
+            _values[pos] = std::move(_values[last]);
+            _keys[pos] = _keys[last];
+            _slots[getHandleIndex(_keys[pos])] = pos;
+        }
+        _values.pop_back();
+        _keys.pop_back();
+        _slots[getHandleIndex(id)] = EMPTY;
+        return true;
+    }
+
+    T *find(IdType id) {
+        auto pos = position(id);
+        return pos == EMPTY ? nullptr : &_values[pos];
+    }
+    T const *find(IdType id) const {
+        auto pos = position(id);
+        return pos == EMPTY ? nullptr : &_values[pos];
+    }
+    T &at(IdType id) {
+        if (auto p = find(id)) return *p;
+        throw std::out_of_range("id not in slot map");
+    }
+    T const &at(IdType id) const {
+        if (auto p = find(id)) return *p;
+        throw std::out_of_range("id not in slot map");
+    }
+    bool contains(IdType id) const { return position(id) != EMPTY; }
+
+    void clear() {
+        _slots.clear();
+        _keys.clear();
+        _values.clear();
+    }
+    void reserve(size_t count) {
+        _keys.reserve(count);
+        _values.reserve(count);
+    }
+
+    size_t size() const { return _values.size(); }
+    bool empty() const { return _values.empty(); }
+
+    // ids in the order of the values
+    std::span<IdType const> keys() const { return _keys; }
+
+    iterator begin() { return _values.begin(); }
+    iterator end() { return _values.end(); }
+    const_iterator begin() const { return _values.begin(); }
+    const_iterator end() const { return _values.end(); }
+};
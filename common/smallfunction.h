@@ -0,0 +1,128 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief copyable type erased callable with inline storage, callables up to _InlineSize bytes (a member function
+ * pointer with its object, a lambda capturing a few pointers) are stored without allocating.
+ * two SmallFunctions compare equal when they hold the same equality comparable callable, lambdas never do
+ */
+template <typename _Signature, size_t _InlineSize = 4 * sizeof(void *)>
+class SmallFunction;
+
+template <typename Ret_, typename... Args, size_t _InlineSize>
+class SmallFunction<Ret_(Args...), _InlineSize> {
+public:
+    // F is stored without allocating
+    template <typename F>
+    static constexpr bool storedInline =
+        sizeof(F) <= _InlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+private:
+    struct Ops {
+        Ret_ (*invoke)(void *, Args &&...);
+        void (*copy)(void *dst, void const *src);
+        void (*move)(void *dst, void *src) noexcept;
+        void (*destroy)(void *) noexcept;
+        bool (*equal)(void const *, void const *);
+    };
+
+    template <typename F>
+    static F *get(void *storage) {
+        if constexpr (storedInline<F>)
+            return std::launder(reinterpret_cast<F *>(storage));
+        else
+            return *reinterpret_cast<F **>(storage);
+    }
+    template <typename F>
+    static F const *get(void const *storage) {
+        return get<F>(const_cast<void *>(storage));
+    }
+
+    template <typename F>
+    static constexpr Ops opsFor{
+        [](void *s, Args &&...args) -> Ret_ { return std::invoke(*get<F>(s), std::forward<Args>(args)...); },
+        [](void *dst, void const *src) {
+            if constexpr (storedInline<F>)
+                new (dst) F(*get<F>(src));
+            else
+                *reinterpret_cast<F **>(dst) = new F(*get<F>(src));
+        },
+        [](void *dst, void *src) noexcept {
+            if constexpr (storedInline<F>) {
+                new (dst) F(std::move(*get<F>(src)));
+                get<F>(src)->~F();
+            } else {
+                *reinterpret_cast<F **>(dst) = *reinterpret_cast<F **>(src);
+            }
+        },
+        [](void *s) noexcept {
+            if constexpr (storedInline<F>)
+                get<F>(s)->~F();
+            else
+                delete get<F>(s);
+        },
+        [](void const *lhs, void const *rhs) {
+            if constexpr (std::equality_comparable<F>)
+                return bool(*get<F>(lhs) == *get<F>(rhs));
+            else
+                return false;
+        },
+    };
+
+    Ops const *_ops{};
+    alignas(std::max_align_t) std::byte _storage[_InlineSize];
+
+public:
+    SmallFunction() = default;
+    template <typename F>
+        requires(!std::is_same_v<std::decay_t<F>, SmallFunction> && std::is_invocable_r_v<Ret_, std::decay_t<F> &, Args...>)
+    SmallFunction(F &&f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (storedInline<Fn>)
+            new (_storage) Fn(std::forward<F>(f));
+        else
+            *reinterpret_cast<Fn **>(_storage) = new Fn(std::forward<F>(f));
+        _ops = &opsFor<Fn>;
+    }
+    SmallFunction(SmallFunction const &other) : _ops(other._ops) {
+        if (_ops) _ops->copy(_storage, other._storage);
+    }
+    SmallFunction(SmallFunction &&other) noexcept : _ops(other._ops) {
+        if (_ops) _ops->move(_storage, other._storage);
+        other._ops = nullptr;
+    }
+    SmallFunction &operator=(SmallFunction const &other) {
+        if (this != &other) *this = SmallFunction(other);
+        return *this;
+    }
+    SmallFunction &operator=(SmallFunction &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _ops = other._ops;
+            if (_ops) _ops->move(_storage, other._storage);
+            other._ops = nullptr;
+        }
+        return *this;
+    }
+    ~SmallFunction() { reset(); }
+
+    void reset() {
+        if (_ops) _ops->destroy(_storage);
+        _ops = nullptr;
+    }
+
+    explicit operator bool() const noexcept { return _ops; }
+
+    Ret_ operator()(Args... args) const {
+        return _ops->invoke(const_cast<std::byte *>(_storage), std::forward<Args>(args)...);
+    }
+
+    bool operator==(SmallFunction const &other) const {
+        return _ops && _ops == other._ops && _ops->equal(_storage, other._storage);
+    }
+};
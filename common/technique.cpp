@@ -1,41 +1,200 @@
 #include "technique.h"
 
+#include <algorithm>
+
 #include "common.h"
+#include "filewatcher.h"
+#include "fileview.h"
+#include "shadercache.h"
+
+std::string injectShaderDefines(std::string_view code, std::vector<std::string> const &defines) {
+    std::string ret;
+    ret.reserve(code.size() + defines.size() * 32);
+    size_t pos = 0;
+    auto versionPos = code.find("#version");
+    if (versionPos != std::string_view::npos) {
+        pos = code.find('\n', versionPos);
+        pos = pos == std::string_view::npos ? code.size() : pos + 1;
+        ret.append(code.substr(0, pos));
+    }
+    for (auto &&e : defines) {
+        ret += "#define ";
+        ret += e;
+        ret += '\n';
+    }
+    ret.append(code.substr(pos));
+    return ret;
+}
 
-std::string TechniqueEnv::vertFile = "common.vert";
-std::string TechniqueEnv::fragFile = "environment.frag";
+namespace {
+ShaderSource loadShaderSource(GL::ShaderStageFlagBits stage, std::string const &file,
+                              std::vector<std::string> const &defines) {
+    FileView code(shaderPath(file.data()));
+    return {stage, injectShaderDefines(code.view(), defines)};
+}
+ProgramSources graphicsSources(std::string const &vertFile, std::string const &fragFile,
+                               std::vector<std::string> const &defines) {
+    return {{loadShaderSource(GL::SHADER_STAGE_VERTEX_BIT, vertFile, defines),
+             loadShaderSource(GL::SHADER_STAGE_FRAGMENT_BIT, fragFile, defines)}};
+}
+ProgramSources computeSources(std::string const &compFile, std::vector<std::string> const &defines) {
+    return {{loadShaderSource(GL::SHADER_STAGE_COMPUTE_BIT, compFile, defines)}};
+}
+// one program per pipeline, the programs missing from the cache are compiled as one batch
+void createGraphicsPipelines(std::span<ProgramSources const> sources, GL::VertexInputStateCreateInfo const &vertexInput,
+                             std::span<GL::PipelineHandle *const> pipelines) {
+    auto programs = ProgramCache::getSingleton().getPrograms(sources);
+    for (size_t i = 0; i < programs.size(); ++i)
+        GL::createGraphicsPipeline(programs[i], GL::SHADER_STAGE_VERTEX_BIT | GL::SHADER_STAGE_FRAGMENT_BIT,
+                                   vertexInput, pipelines[i]);
+}
+void createComputePipelines(std::span<ProgramSources const> sources, std::span<GL::PipelineHandle *const> pipelines) {
+    auto programs = ProgramCache::getSingleton().getPrograms(sources);
+    for (size_t i = 0; i < programs.size(); ++i) GL::createComputePipeline(programs[i], pipelines[i]);
+}
+void createGraphicsPipeline(std::string const &vertFile, std::string const &fragFile,
+                            std::vector<std::string> const &defines, GL::VertexInputStateCreateInfo const &vertexInput,
+                            GL::PipelineHandle *pipeline) {
+    auto sources = graphicsSources(vertFile, fragFile, defines);
+    createGraphicsPipelines({&sources, 1}, vertexInput, {&pipeline, 1});
+}
+void createComputePipeline(std::string const &compFile, std::vector<std::string> const &defines,
+                           GL::PipelineHandle *pipeline) {
+    auto sources = computeSources(compFile, defines);
+    createComputePipelines({&sources, 1}, {&pipeline, 1});
+}
 
-TechniqueEnv::TechniqueEnv() {
-    auto vertCode = readFile(shaderPath(vertFile.data()));
-    auto fragCode = readFile(shaderPath(fragFile.data()));
+// swap gl objects only, PipelineHandle deletes its objects on destruction and is not movable
+void swapPipeline(GL::PipelineHandle &lhs, GL::PipelineHandle &rhs) {
+    std::swap(lhs.pipeline, rhs.pipeline);
+    std::swap(lhs.vao, rhs.vao);
+    lhs.programs.swap(rhs.programs);
+}
 
-    GL::ShaderCreateInfo vertShaderCreateInfo{GL::SHADER_STAGE_VERTEX_BIT, vertCode.size(), vertCode.data()};
-    GL::ShaderCreateInfo fragShaderCreateInfo{GL::SHADER_STAGE_FRAGMENT_BIT, fragCode.size(), fragCode.data()};
+// build new pipelines and replace the old ones, all old ones are kept if any fails to compile
+template <typename F>
+void rebuildPipelines(std::span<GL::PipelineHandle> pipelines, F &&create) {
+    std::vector<GL::PipelineHandle> newPipelines(pipelines.size());
+    std::vector<GL::PipelineHandle *> pointers;
+    for (auto &&e : newPipelines) pointers.emplace_back(&e);
+    try {
+        create(std::span<GL::PipelineHandle *const>(pointers));
+    } catch (std::exception &e) {
+        std::cerr << "shader reload failed, keep previous pipeline\n" << e.what() << std::endl;
+        return;
+    }
+    for (size_t i = 0; i < pipelines.size(); ++i) swapPipeline(pipelines[i], newPipelines[i]);
+}
+template <typename F>
+void rebuildPipeline(GL::PipelineHandle &pipeline, F &&create) {
+    rebuildPipelines({&pipeline, 1}, [&](std::span<GL::PipelineHandle *const> p) { create(p[0]); });
+}
+
+// position, normal, texcoord, color in separate buffers
+GL::VertexInputStateCreateInfo meshVertexInputState() {
+    return {{
+                {sizeof(float) * 3, 0},  // position
+                {sizeof(float) * 3, 0},  // normal
+                {sizeof(float) * 2, 0},  // texcoord
+                {sizeof(float) * 4, 0},  // color
+            },
+            {
+                {0, 0, 3, GL::DATA_TYPE_FLOAT, false, 0},
+                {1, 1, 3, GL::DATA_TYPE_FLOAT, false, 0},
+                {2, 2, 2, GL::DATA_TYPE_FLOAT, false, 0},
+                {3, 3, 4, GL::DATA_TYPE_FLOAT, false, 0},
+            }};
+}
+}  // namespace
 
-    GL::GraphicsPipelineCreateInfo pipelineCI{false};
-    pipelineCI.stages.resize(2);
-    pipelineCI.stages[0] = {GL::SHADER_STAGE_VERTEX_BIT, 0, "main"};
-    pipelineCI.stages[1] = {GL::SHADER_STAGE_FRAGMENT_BIT, 0, "main"};
+//=================
+std::vector<std::string> ShaderVariantKey::getDefines() const {
+    std::vector<std::string> ret;
+    if (features & SHADER_FEATURE_ALBEDO_TEXTURE_BIT) ret.emplace_back("HAS_ALBEDO_TEXTURE");
+    if (features & SHADER_FEATURE_NORMAL_MAP_BIT) ret.emplace_back("HAS_NORMAL_MAP");
+    if (features & SHADER_FEATURE_INSTANCING_BIT) ret.emplace_back("INSTANCING");
+    ret.emplace_back("LIGHT_COUNT " + std::to_string(lightCountClass));
+    return ret;
+}
 
-    GL::createShader(vertShaderCreateInfo, &pipelineCI.stages[0].shaderHandle);
-    GL::createShader(fragShaderCreateInfo, &pipelineCI.stages[1].shaderHandle);
+Technique::~Technique() {
+    for (auto e : _fileWatches) AssetReloader::getSingleton().unwatch(e);
+}
+void Technique::watchShaderFiles(std::initializer_list<std::string_view> files, std::function<void()> onChanged) {
+    for (auto &&e : files)
+        _fileWatches.emplace_back(AssetReloader::getSingleton().watch(shaderPath(std::string(e).data()), onChanged));
+}
 
-    std::vector<GL::VertexBindingDescription> bindingDescriptions{
-        {sizeof(float) * 3, 0},  // position
-        {sizeof(float) * 3, 0},  // normal
-        {sizeof(float) * 2, 0},  // texcoord
-        {sizeof(float) * 4, 0},  // color
-    };
+std::vector<TechniquePermutations *> &TechniquePermutations::instances() {
+    static auto ret = new std::vector<TechniquePermutations *>;
+    return *ret;
+}
+TechniquePermutations::TechniquePermutations(std::string_view name, std::string_view vertFile,
+                                             std::string_view fragFile, std::vector<std::string> const &defines,
+                                             GL::VertexInputStateCreateInfo const &vertexInput)
+    : _name(name), _vertFile(vertFile), _fragFile(fragFile), _defines(defines), _vertexInput(vertexInput) {
+    instances().emplace_back(this);
+    watchShaderFiles({_vertFile, _fragFile}, [this] { reload(); });
+}
+TechniquePermutations::~TechniquePermutations() { std::erase(instances(), this); }
+GL::PipelineHandle &TechniquePermutations::getVariant(ShaderVariantKey const &key) {
+    auto it = _variants.find(key.value());
+    if (it != _variants.end()) return *it->second;
+    buildPipelines({&key, 1});
+    return *_variants[key.value()];
+}
+void TechniquePermutations::buildPipelines(std::span<ShaderVariantKey const> keys) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint64_t> missing;
+    std::vector<ProgramSources> sources;
+    for (auto &&key : keys) {
+        if (_variants.count(key.value()) || std::count(missing.begin(), missing.end(), key.value())) continue;
+        auto defines = _defines;
+        auto variantDefines = key.getDefines();
+        defines.insert(defines.end(), variantDefines.begin(), variantDefines.end());
+        missing.emplace_back(key.value());
+        sources.emplace_back(graphicsSources(_vertFile, _fragFile, defines));
+    }
+    if (missing.empty()) return;
+
+    std::vector<std::unique_ptr<GL::PipelineHandle>> pipelines;
+    std::vector<GL::PipelineHandle *> pointers;
+    for (size_t i = 0; i < missing.size(); ++i)
+        pointers.emplace_back(pipelines.emplace_back(std::make_unique<GL::PipelineHandle>()).get());
+    createGraphicsPipelines(sources, _vertexInput, pointers);
+    for (size_t i = 0; i < missing.size(); ++i) _variants[missing[i]] = std::move(pipelines[i]);
+    _compileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+void TechniquePermutations::reload() {
+    std::vector<ShaderVariantKey> keys;
+    for (auto &&[key, pipeline] : _variants) keys.emplace_back(ShaderVariantKey{uint32_t(key), uint32_t(key >> 32)});
+    auto variants = std::move(_variants);
+    _variants.clear();
+    try {
+        buildPipelines(keys);
+    } catch (std::exception &e) {
+        std::cerr << "shader reload failed, keep previous variants of " << _name << "\n" << e.what() << std::endl;
+        _variants = std::move(variants);
+    }
+}
+void TechniquePermutations::bind(ShaderVariantKey const &key) {
+    auto &&pipeline = getVariant(key);
+    glBindProgramPipeline(pipeline.pipeline);
+    glBindVertexArray(pipeline.vao);
+}
+void TechniquePermutations::printReport(std::ostream &os) {
+    for (auto e : instances())
+        os << "technique " << e->_name << ": " << e->getVariantCount() << " variants, " << e->_compileMs << " ms\n";
+}
 
-    std::vector<GL::VertexAttributeDescription> attributeDescriptions{
-        {0, 0, 3, GL::DATA_TYPE_FLOAT, false, 0},
-        {1, 1, 3, GL::DATA_TYPE_FLOAT, false, 0},
-        {2, 2, 2, GL::DATA_TYPE_FLOAT, false, 0},
-        {3, 3, 4, GL::DATA_TYPE_FLOAT, false, 0},
+std::string TechniqueEnv::vertFile = "common.vert";
+std::string TechniqueEnv::fragFile = "environment.frag";
+TechniqueEnv::TechniqueEnv() {
+    auto create = [](GL::PipelineHandle *p) {
+        createGraphicsPipeline(vertFile, fragFile, {}, meshVertexInputState(), p);
     };
-    pipelineCI.vertexInputState = {bindingDescriptions, attributeDescriptions};
-
-    GL::createGraphicsPipeline(pipelineCI, &pipeline);
+    create(&pipeline);
+    watchShaderFiles({vertFile, fragFile}, [this, create] { rebuildPipeline(pipeline, create); });
 }
 void TechniqueEnv::bind() {
     glBindProgramPipeline(pipeline.pipeline);
@@ -45,34 +204,21 @@ void TechniqueEnv::bind() {
 std::string TechniqueUnlitColor::vertFile = "unlitColor.vert";
 std::string TechniqueUnlitColor::fragFile = "unlitColor.frag";
 TechniqueUnlitColor::TechniqueUnlitColor() {
-    auto vertCode = readFile(shaderPath(vertFile.data()));
-    auto fragCode = readFile(shaderPath(fragFile.data()));
-
-    GL::ShaderCreateInfo vertShaderCreateInfo{GL::SHADER_STAGE_VERTEX_BIT, vertCode.size(), vertCode.data()};
-    GL::ShaderCreateInfo fragShaderCreateInfo{GL::SHADER_STAGE_FRAGMENT_BIT, fragCode.size(), fragCode.data()};
-
-    GL::GraphicsPipelineCreateInfo pipelineCI{false};
-    pipelineCI.stages.resize(2);
-    pipelineCI.stages[0] = {GL::SHADER_STAGE_VERTEX_BIT, 0, "main"};
-    pipelineCI.stages[1] = {GL::SHADER_STAGE_FRAGMENT_BIT, 0, "main"};
-
-    GL::createShader(vertShaderCreateInfo, &pipelineCI.stages[0].shaderHandle);
-    GL::createShader(fragShaderCreateInfo, &pipelineCI.stages[1].shaderHandle);
-
-    std::vector<GL::VertexBindingDescription> bindingDescriptions{
-        {sizeof(float) * 3, 0},  // position
-        {},
-        {},
-        {sizeof(float) * 4, 0},  // color
-    };
-
-    std::vector<GL::VertexAttributeDescription> attributeDescriptions{
-        {0, 0, 3, GL::DATA_TYPE_FLOAT, false, 0},
-        {3, 3, 4, GL::DATA_TYPE_FLOAT, false, 0},
+    GL::VertexInputStateCreateInfo vertexInput{{
+                                                   {sizeof(float) * 3, 0},  // position
+                                                   {},
+                                                   {},
+                                                   {sizeof(float) * 4, 0},  // color
+                                               },
+                                               {
+                                                   {0, 0, 3, GL::DATA_TYPE_FLOAT, false, 0},
+                                                   {3, 3, 4, GL::DATA_TYPE_FLOAT, false, 0},
+                                               }};
+    auto create = [vertexInput](GL::PipelineHandle *p) {
+        createGraphicsPipeline(vertFile, fragFile, {}, vertexInput, p);
     };
-    pipelineCI.vertexInputState = {bindingDescriptions, attributeDescriptions};
-
-    GL::createGraphicsPipeline(pipelineCI, &pipeline);
+    create(&pipeline);
+    watchShaderFiles({vertFile, fragFile}, [this, create] { rebuildPipeline(pipeline, create); });
 }
 void TechniqueUnlitColor::bind() {
     glBindProgramPipeline(pipeline.pipeline);
@@ -81,62 +227,16 @@ void TechniqueUnlitColor::bind() {
 
 std::string TechniqueBlinnPhong ::vertFile = "common.vert";
 std::string TechniqueBlinnPhong ::fragFile = "blinnphong.frag";
-TechniqueBlinnPhong::TechniqueBlinnPhong() {
-    auto vertCode = readFile(shaderPath(vertFile.data()));
-    auto fragCode = readFile(shaderPath(fragFile.data()));
-
-    GL::ShaderCreateInfo vertShaderCreateInfo{GL::SHADER_STAGE_VERTEX_BIT, vertCode.size(), vertCode.data()};
-    GL::ShaderCreateInfo fragShaderCreateInfo{GL::SHADER_STAGE_FRAGMENT_BIT, fragCode.size(), fragCode.data()};
-
-    GL::GraphicsPipelineCreateInfo pipelineCI{false};
-    pipelineCI.stages.resize(2);
-    pipelineCI.stages[0] = {GL::SHADER_STAGE_VERTEX_BIT, 0, "main"};
-    pipelineCI.stages[1] = {GL::SHADER_STAGE_FRAGMENT_BIT, 0, "main"};
-
-    GL::createShader(vertShaderCreateInfo, &pipelineCI.stages[0].shaderHandle);
-    GL::createShader(fragShaderCreateInfo, &pipelineCI.stages[1].shaderHandle);
-
-    std::vector<GL::VertexBindingDescription> bindingDescriptions{
-        {sizeof(float) * 3, 0},  // position
-        {sizeof(float) * 3, 0},  // normal
-        {sizeof(float) * 2, 0},  // texcoord
-        {sizeof(float) * 4, 0},  // color
-    };
-
-    std::vector<GL::VertexAttributeDescription> attributeDescriptions{
-        {0, 0, 3, GL::DATA_TYPE_FLOAT, false, 0},
-        {1, 1, 3, GL::DATA_TYPE_FLOAT, false, 0},
-        {2, 2, 2, GL::DATA_TYPE_FLOAT, false, 0},
-        {3, 3, 4, GL::DATA_TYPE_FLOAT, false, 0},
-    };
-    pipelineCI.vertexInputState = {bindingDescriptions, attributeDescriptions};
-
-    GL::createGraphicsPipeline(pipelineCI, &pipeline);
-}
-void TechniqueBlinnPhong::bind() {
-    glBindProgramPipeline(pipeline.pipeline);
-    glBindVertexArray(pipeline.vao);
-}
+TechniqueBlinnPhong::TechniqueBlinnPhong(std::vector<std::string> const &defines)
+    : TechniquePermutations("blinnphong", vertFile, fragFile, defines, meshVertexInputState()) {}
 
 //=================
 std::string TechniqueGrid ::vertFile = "grid.vert";
 std::string TechniqueGrid ::fragFile = "grid.frag";
 TechniqueGrid::TechniqueGrid() {
-    auto vertCode = readFile(shaderPath(vertFile.data()));
-    auto fragCode = readFile(shaderPath(fragFile.data()));
-
-    GL::ShaderCreateInfo vertShaderCreateInfo{GL::SHADER_STAGE_VERTEX_BIT, vertCode.size(), vertCode.data()};
-    GL::ShaderCreateInfo fragShaderCreateInfo{GL::SHADER_STAGE_FRAGMENT_BIT, fragCode.size(), fragCode.data()};
-
-    GL::GraphicsPipelineCreateInfo pipelineCI{false};
-    pipelineCI.stages.resize(2);
-    pipelineCI.stages[0] = {GL::SHADER_STAGE_VERTEX_BIT, 0, "main"};
-    pipelineCI.stages[1] = {GL::SHADER_STAGE_FRAGMENT_BIT, 0, "main"};
-
-    GL::createShader(vertShaderCreateInfo, &pipelineCI.stages[0].shaderHandle);
-    GL::createShader(fragShaderCreateInfo, &pipelineCI.stages[1].shaderHandle);
-
-    GL::createGraphicsPipeline(pipelineCI, &pipeline);
+    auto create = [](GL::PipelineHandle *p) { createGraphicsPipeline(vertFile, fragFile, {}, {}, p); };
+    create(&pipeline);
+    watchShaderFiles({vertFile, fragFile}, [this, create] { rebuildPipeline(pipeline, create); });
 }
 void TechniqueGrid::bind() {
     glBindProgramPipeline(pipeline.pipeline);
@@ -147,21 +247,9 @@ void TechniqueGrid::bind() {
 std::string TechniquePostProcessRender ::vertFile = "renderintriangle.vert";
 std::string TechniquePostProcessRender ::fragFile = "postprocessrender.frag";
 TechniquePostProcessRender::TechniquePostProcessRender() {
-    auto vertCode = readFile(shaderPath(vertFile.data()));
-    auto fragCode = readFile(shaderPath(fragFile.data()));
-
-    GL::ShaderCreateInfo vertShaderCreateInfo{GL::SHADER_STAGE_VERTEX_BIT, vertCode.size(), vertCode.data()};
-    GL::ShaderCreateInfo fragShaderCreateInfo{GL::SHADER_STAGE_FRAGMENT_BIT, fragCode.size(), fragCode.data()};
-
-    GL::GraphicsPipelineCreateInfo pipelineCI{false};
-    pipelineCI.stages.resize(2);
-    pipelineCI.stages[0] = {GL::SHADER_STAGE_VERTEX_BIT, 0, "main"};
-    pipelineCI.stages[1] = {GL::SHADER_STAGE_FRAGMENT_BIT, 0, "main"};
-
-    GL::createShader(vertShaderCreateInfo, &pipelineCI.stages[0].shaderHandle);
-    GL::createShader(fragShaderCreateInfo, &pipelineCI.stages[1].shaderHandle);
-
-    GL::createGraphicsPipeline(pipelineCI, &pipeline);
+    auto create = [](GL::PipelineHandle *p) { createGraphicsPipeline(vertFile, fragFile, {}, {}, p); };
+    create(&pipeline);
+    watchShaderFiles({vertFile, fragFile}, [this, create] { rebuildPipeline(pipeline, create); });
 }
 void TechniquePostProcessRender::bind() {
     glBindProgramPipeline(pipeline.pipeline);
@@ -169,15 +257,68 @@ void TechniquePostProcessRender::bind() {
 }
 
 //===============================
+const char *getSSAODispatchName(SSAODispatch dispatch) {
+    static const char *names[]{"linear", "tiled"};
+    return names[dispatch];
+}
+
 std::string TechniqueSSAO ::compFile = "ssao.comp";
+std::string TechniqueSSAO ::blurFile = "ssaoblur.comp";
+std::string TechniqueSSAO ::filterFile = "ssaofilter.comp";
 TechniqueSSAO::TechniqueSSAO() {
-    auto compCode = readFile(shaderPath(compFile.data()));
-    GL::ShaderCreateInfo compShaderCreateInfo{GL::SHADER_STAGE_COMPUTE_BIT, compCode.size(), compCode.data()};
-    GL::ComputePipelineCreateInfo pipelineCI{false};
-    pipelineCI.stage = {GL::SHADER_STAGE_COMPUTE_BIT, 0, "main"};
-    GL::createShader(compShaderCreateInfo, &pipelineCI.stage.shaderHandle);
-    GL::createComputePipeline(pipelineCI, &pipeline);
+    // in SSAOFilterPass order
+    static const std::vector<std::string> filterDefines[]{
+        {"SSAO_DOWNSAMPLE"},
+        {"SSAO_DENOISE"},
+        {"SSAO_DENOISE", "SSAO_DENOISE_VERTICAL"},
+        {"SSAO_UPSAMPLE"},
+        {"SSAO_TEMPORAL"},
+    };
+    auto dispatchSources = [] {
+        return std::vector<ProgramSources>{computeSources(compFile, {}), computeSources(compFile, {"SSAO_TILED"})};
+    };
+    auto filterSources = [] {
+        std::vector<ProgramSources> ret;
+        for (auto &&e : filterDefines) ret.emplace_back(computeSources(filterFile, e));
+        return ret;
+    };
+
+    // every variant in one batch, a file change rebuilds the variants of that file
+    auto sources = dispatchSources();
+    sources.emplace_back(computeSources(blurFile, {}));
+    for (auto &&e : filterSources()) sources.emplace_back(std::move(e));
+    std::vector<GL::PipelineHandle *> all{&pipelines[SSAO_DISPATCH_LINEAR], &pipelines[SSAO_DISPATCH_TILED],
+                                          &blurPipeline};
+    for (auto &&e : filterPipelines) all.emplace_back(&e);
+    createComputePipelines(sources, all);
+
+    watchShaderFiles({compFile}, [this, dispatchSources] {
+        rebuildPipelines(pipelines, [&](auto p) { createComputePipelines(dispatchSources(), p); });
+    });
+    watchShaderFiles({blurFile}, [this] {
+        rebuildPipeline(blurPipeline, [](GL::PipelineHandle *p) { createComputePipeline(blurFile, {}, p); });
+    });
+    watchShaderFiles({filterFile}, [this, filterSources] {
+        rebuildPipelines(filterPipelines, [&](auto p) { createComputePipelines(filterSources(), p); });
+    });
 }
 void TechniqueSSAO::bind() {
+    glBindProgramPipeline(pipelines[dispatch].pipeline);
+}
+void TechniqueSSAO::bindBlur() {
+    glBindProgramPipeline(blurPipeline.pipeline);
+}
+void TechniqueSSAO::bindFilter(SSAOFilterPass pass) {
+    glBindProgramPipeline(filterPipelines[pass].pipeline);
+}
+
+//===============================
+std::string TechniqueDepthPyramid ::compFile = "depthpyramid.comp";
+TechniqueDepthPyramid::TechniqueDepthPyramid() {
+    auto create = [](GL::PipelineHandle *p) { createComputePipeline(compFile, {}, p); };
+    create(&pipeline);
+    watchShaderFiles({compFile}, [this, create] { rebuildPipeline(pipeline, create); });
+}
+void TechniqueDepthPyramid::bind() {
     glBindProgramPipeline(pipeline.pipeline);
-}
\ No newline at end of file
+}
@@ -1,4 +1,13 @@
 #pragma once
+#include <array>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "prerequisites.h"
 
 enum MaterialType {
@@ -7,10 +16,98 @@ enum MaterialType {
     MATERIAL_Num,
 };
 
+/**
+ * @brief insert "#define NAME" lines right after the #version directive of a glsl source
+ */
+std::string injectShaderDefines(std::string_view code, std::vector<std::string> const &defines);
+
+enum ShaderFeatureFlagBits {
+    SHADER_FEATURE_ALBEDO_TEXTURE_BIT = 0x1,  // HAS_ALBEDO_TEXTURE
+    SHADER_FEATURE_NORMAL_MAP_BIT = 0x2,      // HAS_NORMAL_MAP
+    SHADER_FEATURE_INSTANCING_BIT = 0x4,      // INSTANCING
+};
+using ShaderFeatureFlags = uint32_t;
+
+/**
+ * @brief selects one compiled variant of a technique, every feature becomes a #define of the variant source
+ */
+struct ShaderVariantKey {
+    ShaderFeatureFlags features{};
+    // LIGHT_COUNT, number of lights shaded per pass
+    uint32_t lightCountClass{1};
+
+    constexpr uint64_t value() const { return (uint64_t(lightCountClass) << 32) | features; }
+    std::vector<std::string> getDefines() const;
+};
+
 struct Technique {
-    virtual ~Technique() {}
+    virtual ~Technique();
     // bind pipeline
     virtual void bind() = 0;
+    // techniques without permutations ignore the key
+    virtual void bind(ShaderVariantKey const &) { bind(); }
+    /**
+     * @brief pipeline bind() would bind, built if needed (main thread), for recording into command buffers.
+     * null for techniques that are not used by materials
+     */
+    virtual GL::PipelineHandle *getPipeline(ShaderVariantKey const &) { return nullptr; }
+    /**
+     * @brief build the pipelines of these variants ahead of getPipeline, techniques with permutations compile the
+     * missing ones as one batch (see ProgramCache::getPrograms), the others built everything on construction
+     */
+    virtual void buildPipelines(std::span<ShaderVariantKey const>) {}
+
+protected:
+    // AssetReloader callbacks, removed on destruction
+    std::vector<uint64_t> _fileWatches;
+
+    /**
+     * @brief call onChanged when one of the shader files (relative to SHADER_DIR) is modified
+     */
+    void watchShaderFiles(std::initializer_list<std::string_view> files, std::function<void()> onChanged);
+};
+
+/**
+ * @brief technique compiled in variants, a variant is built (through the program cache) the first time it is bound
+ */
+class TechniquePermutations : public Technique {
+    // never destroyed, techniques may be static objects of other translation units
+    static std::vector<TechniquePermutations *> &instances();
+
+    std::string _name;
+    std::string _vertFile;
+    std::string _fragFile;
+    std::vector<std::string> _defines;
+    GL::VertexInputStateCreateInfo _vertexInput;
+
+    std::unordered_map<uint64_t, std::unique_ptr<GL::PipelineHandle>> _variants;
+    double _compileMs{};
+
+    // rebuild every existing variant, keep the old ones if any fails to compile
+    void reload();
+
+public:
+    TechniquePermutations(std::string_view name, std::string_view vertFile, std::string_view fragFile,
+                          std::vector<std::string> const &defines, GL::VertexInputStateCreateInfo const &vertexInput);
+    ~TechniquePermutations();
+
+    // variant bound by bind()
+    ShaderVariantKey defaultKey{};
+
+    void bind() override { bind(defaultKey); }
+    void bind(ShaderVariantKey const &key) override;
+    GL::PipelineHandle *getPipeline(ShaderVariantKey const &key) override { return &getVariant(key); }
+
+    GL::PipelineHandle &getVariant(ShaderVariantKey const &key);
+    void buildPipelines(std::span<ShaderVariantKey const> keys) override;
+
+    size_t getVariantCount() const { return _variants.size(); }
+    double getCompileMs() const { return _compileMs; }
+
+    /**
+     * @brief variant count and time spent building them, per technique
+     */
+    static void printReport(std::ostream &os);
 };
 struct TechniqueEnv : public Technique {
     static std::string vertFile;
@@ -26,16 +123,14 @@ struct TechniqueUnlitColor : Technique {
     GL::PipelineHandle pipeline;
     TechniqueUnlitColor();
     void bind() override;
+    GL::PipelineHandle *getPipeline(ShaderVariantKey const &) override { return &pipeline; }
 };
 
-struct TechniqueBlinnPhong : Technique {
+struct TechniqueBlinnPhong : TechniquePermutations {
     static std::string vertFile;
     static std::string fragFile;
-    GL::PipelineHandle pipeline;
 
-    TechniqueBlinnPhong();
-
-    void bind() override;
+    TechniqueBlinnPhong(std::vector<std::string> const &defines = {});
 };
 
 struct TechniqueGrid : Technique {
@@ -58,11 +153,45 @@ struct TechniquePostProcessRender: Technique {
     void bind() override;
 };
 
+enum SSAODispatch {
+    SSAO_DISPATCH_LINEAR,  // 1d grid, one pixel per invocation
+    SSAO_DISPATCH_TILED,   // 16x16 tiles, depth of the tile and its apron cached in shared memory
+    SSAO_DISPATCH_Num,
+};
+const char *getSSAODispatchName(SSAODispatch dispatch);
+
+// passes of ssaofilter.comp
+enum SSAOFilterPass {
+    SSAO_FILTER_DOWNSAMPLE,        // next depth pyramid level
+    SSAO_FILTER_DENOISE,           // depth aware blur, horizontal
+    SSAO_FILTER_DENOISE_VERTICAL,  // depth aware blur, vertical
+    SSAO_FILTER_UPSAMPLE,          // bilateral upsample to frame resolution
+    SSAO_FILTER_TEMPORAL,          // accumulation with the reprojected history
+    SSAO_FILTER_Num,
+};
+
 struct TechniqueSSAO : Technique {
     static std::string compFile;
-    GL::PipelineHandle pipeline;
+    static std::string blurFile;
+    static std::string filterFile;
+    std::array<GL::PipelineHandle, SSAO_DISPATCH_Num> pipelines;
+    GL::PipelineHandle blurPipeline;
+    std::array<GL::PipelineHandle, SSAO_FILTER_Num> filterPipelines;
+    // variant bind() binds
+    SSAODispatch dispatch{SSAO_DISPATCH_TILED};
 
     TechniqueSSAO();
 
+    void bind() override;
+    void bindBlur();
+    void bindFilter(SSAOFilterPass pass);
+};
+
+struct TechniqueDepthPyramid : Technique {
+    static std::string compFile;
+    GL::PipelineHandle pipeline;
+
+    TechniqueDepthPyramid();
+
     void bind() override;
 };
\ No newline at end of file
@@ -1,15 +1,69 @@
 #include "texture.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
-Texture::Texture(Image *image) : _pImageSrc(image) { image->load(); }
+#include "filewatcher.h"
+
+namespace {
+size_t computeImageBytes(uint32_t width, uint32_t height, uint32_t levels, GL::Format format) {
+    size_t ret{};
+    for (uint32_t i = 0; i < levels; ++i)
+        ret += size_t(std::max(1u, width >> i)) * std::max(1u, height >> i) * GL::getFormatSize(format);
+    return ret;
+}
+}  // namespace
+
+Texture::Texture(Image *image) : Resource(RESOURCE_TEXTURE), _pImageSrc(image) {
+    addDependency(image);
+    image->load();
+}
 Texture::~Texture() {
-    glDeleteTextures(1, &_image);
-    glDeleteTextures(1, &_imageView);
+    JobSystem::getSingleton().wait(_restreamJob);
+    releaseGpu();
+}
+void Texture::createView(GL::Format format, uint32_t levelCount) {
+    GL::createImageView(GL::ImageViewCreateInfo{_image,
+                                                GL::ImageViewType::IMAGE_VIEW_TYPE_2D,
+                                                format,
+                                                {},
+                                                {GL::ImageAspectFlagBits::IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1}},
+                        false, &_imageView);
+    _target = Map(GL::ImageViewType::IMAGE_VIEW_TYPE_2D, false);
+    storageChanged();
+}
+void Texture::storageChanged() { TextureManager::getSingleton().textureStorageChangedSignal(this); }
+void Texture::releaseGpu() {
+    if (_image || _imageView) {
+        // draws recorded this frame may still sample the storage or the bindless handle
+        ResourceManager::getSingleton().deferRelease(
+            [image = _image, imageView = _imageView, bindlessHandle = _bindlessHandle] {
+                if (bindlessHandle) glMakeTextureHandleNonResidentARB(bindlessHandle);
+                glDeleteTextures(1, &image);
+                glDeleteTextures(1, &imageView);
+            },
+            getGpuBytes());
+    }
+    _bindlessHandle = 0;
+    _image = _imageView = 0;
+    setGpuBytes(0);
 }
 void Texture::upload() {
-    if (_image) return;
+    if (_image || _restreaming) return;
+
+    auto &manager = TextureManager::getSingleton();
+    if (!_pImageSrc->isLoaded()) {
+        // cpu copy was freed after a previous upload
+        requestRestream();
+        return;
+    }
+    if (!_pImageSrc->_data) {
+        setState(RESOURCE_STATE_FAILED);
+        // restore and reload released the previous storage
+        storageChanged();
+        return;
+    }
     _uploaded = true;
 
     GL::Extent3D extent{(uint32_t)(_pImageSrc->_width), (uint32_t)(_pImageSrc->_height), 1};
@@ -26,32 +80,254 @@ void Texture::upload() {
     glGenerateMipmap(target);
     glBindTexture(target, 0);
 
-    _mipmapLevel = std::floor(std::log2(std::max(extent.width, extent.height)));
+    _mipmapLevel = std::floor(std::log2(std::max(extent.width, extent.height))) + 1;
+    _droppedMipLevels = 0;
+    setGpuBytes(computeImageBytes(extent.width, extent.height, _mipmapLevel, _pImageSrc->_format));
+    setState(RESOURCE_STATE_LOADED);
 
-    GL::createImageView(
-        GL::ImageViewCreateInfo{_image,
-                                GL::ImageViewType::IMAGE_VIEW_TYPE_2D,
-                                _pImageSrc->_format,
-                                {},
-                                {GL::ImageAspectFlagBits::IMAGE_ASPECT_COLOR_BIT, 0, _mipmapLevel, 0, 1}},
-        false, &_imageView);
-    _target = Map(GL::ImageViewType::IMAGE_VIEW_TYPE_2D, false);
+    createView(_pImageSrc->_format, _mipmapLevel);
+
+    if (manager._budget.freeCpuAfterUpload && _pImageSrc->canReload()) _pImageSrc->unload();
+}
+void Texture::evict() {
+    if (!_uploaded) return;
+    releaseGpu();
+    _uploaded = false;
+    _droppedMipLevels = 0;
+    _restoreRequested = false;
+    setState(RESOURCE_STATE_UNLOADED);
+    storageChanged();
+}
+void Texture::requestRestream() {
+    // a failed decode is retried by a reload from disk, not every frame
+    if (_restreaming || _pImageSrc->getState() == RESOURCE_STATE_FAILED) return;
+    _restreaming = true;
+    ++TextureManager::getSingleton()._restreams;
+    JobSystem::getSingleton().run([image = _pImageSrc] { image->load(); }, &_restreamJob);
 }
+void Texture::restore() {
+    if (!_pImageSrc->isLoaded()) {
+        requestRestream();
+        return;
+    }
+    releaseGpu();
+    _uploaded = false;
+    _droppedMipLevels = 0;
+    upload();
+}
+bool Texture::dropTopMips(uint32_t count) {
+    if (!_uploaded) return false;
+    count = std::min(count, _mipmapLevel - 1);
+    if (count == 0) return false;
 
-void Texture::bind(uint32_t binding) {
+    auto levels = _mipmapLevel - count;
+    auto dropped = _droppedMipLevels + count;
+    uint32_t width = std::max(1u, uint32_t(_pImageSrc->_width) >> dropped);
+    uint32_t height = std::max(1u, uint32_t(_pImageSrc->_height) >> dropped);
+
+    GL::ImageHandle newImage;
+    GL::createImage(GL::ImageCreateInfo{0, GL::IMAGE_TYPE_2D, _pImageSrc->_format, {width, height, 1}, levels,
+                                        GL::SAMPLE_COUNT_1_BIT},
+                    &newImage);
+    auto target = Map(GL::IMAGE_TYPE_2D, false);
+    for (uint32_t i = 0; i < levels; ++i) {
+        glCopyImageSubData(_image, target, i + count, 0, 0, 0, newImage, target, i, 0, 0, 0,
+                           std::max(1u, width >> i), std::max(1u, height >> i), 1);
+    }
+    releaseGpu();
+    _image = newImage;
+    _mipmapLevel = levels;
+    _droppedMipLevels = dropped;
+    setGpuBytes(computeImageBytes(width, height, levels, _pImageSrc->_format));
+    createView(_pImageSrc->_format, levels);
+    ++TextureManager::getSingleton()._mipDrops;
+    return true;
+}
+TextureResidency Texture::getResidency() const {
+    if (!_uploaded) return TEXTURE_RESIDENCY_EVICTED;
+    if (_droppedMipLevels) return TEXTURE_RESIDENCY_DEGRADED;
+    return TEXTURE_RESIDENCY_RESIDENT;
+}
+
+void Texture::prepareBind() {
     if (!_uploaded) upload();
+    if (_droppedMipLevels) _restoreRequested = true;
+    _lastBoundFrame = TextureManager::getSingleton()._frameIndex;
+}
+void Texture::bind(uint32_t binding) {
+    prepareBind();
     glActiveTexture(GL_TEXTURE0 + binding);
-    glBindTexture(_target, _imageView);
+    glBindTexture(_target, getImageView());
+}
+GL::ImageViewHandle Texture::getImageView() const {
+    return _imageView ? _imageView : TextureManager::getSingleton().getFallbackView();
+}
+uint64_t Texture::getBindlessHandle() {
+    if (!_imageView) return TextureManager::getSingleton().getFallbackBindlessHandle();
+    if (!_bindlessHandle) {
+        _bindlessHandle = glGetTextureHandleARB(_imageView);
+        glMakeTextureHandleResidentARB(_bindlessHandle);
+    }
+    return _bindlessHandle;
+}
+void Texture::reload() {
+    JobSystem::getSingleton().wait(_restreamJob);
+    _restreaming = false;
+    _pImageSrc->unload();
+    _pImageSrc->load();
+    if (!_uploaded) return;
+    releaseGpu();
+    _uploaded = false;
+    _droppedMipLevels = 0;
+    upload();
+}
+
+//===============================
+TextureManager::TextureManager() {
+    // textures release their image and queue their gl objects on destruction
+    ImageManager::getSingleton();
+    ResourceManager::getSingleton();
+}
+GL::ImageViewHandle TextureManager::getFallbackView() {
+    if (!_fallbackImage) {
+        uint8_t texel[]{128, 128, 255, 255};
+        GL::createImage(GL::ImageCreateInfo{0, GL::IMAGE_TYPE_2D, GL_RGBA8, {1, 1, 1}, 1, GL::SAMPLE_COUNT_1_BIT},
+                        &_fallbackImage);
+        updateImageSubData(_fallbackImage, GL::IMAGE_TYPE_2D,
+                           GL::ImageSubData{GL_RGBA, GL::DATA_TYPE_UNSIGNED_BYTE, 0, {{}, {1, 1, 1}}, texel});
+    }
+    return _fallbackImage;
 }
+uint64_t TextureManager::getFallbackBindlessHandle() {
+    if (!_fallbackBindlessHandle) {
+        _fallbackBindlessHandle = glGetTextureHandleARB(getFallbackView());
+        glMakeTextureHandleResidentARB(_fallbackBindlessHandle);
+    }
+    return _fallbackBindlessHandle;
+}
+ResourceHandle<Texture> TextureManager::createTexture(Image *pImage) {
+    if (auto p = _textures.find(pImage->getId())) return p->get();
+    auto texture = _textures.emplace(pImage->getId(), std::make_unique<Texture>(pImage)).first->get();
+    if (pImage->canReload()) {
+        texture->_watchId = AssetReloader::getSingleton().watch(pImage->_path, [this, id = pImage->getId()] {
+            auto p = _textures.find(id);
+            if (!p) return;
+            (*p)->reload();
+            textureReloadedSignal(p->get());
+        });
+    }
+    return texture;
+}
+size_t TextureManager::collectGarbage() {
+    return eraseUnreferenced(_textures, [](Texture &texture) {
+        if (texture._watchId) AssetReloader::getSingleton().unwatch(texture._watchId);
+    });
+}
+void TextureManager::clear() {
+    auto referenced = eraseAll(_textures, [](Texture &texture) {
+        if (texture._watchId) AssetReloader::getSingleton().unwatch(texture._watchId);
+    });
+    if (referenced) LOG(referenced, "textures still referenced at shutdown");
+    if (_fallbackImage) {
+        ResourceManager::getSingleton().deferRelease(
+            [image = _fallbackImage, bindlessHandle = _fallbackBindlessHandle] {
+                if (bindlessHandle) glMakeTextureHandleNonResidentARB(bindlessHandle);
+                glDeleteTextures(1, &image);
+            });
+    }
+    _fallbackImage = 0;
+    _fallbackBindlessHandle = 0;
+}
+void TextureManager::update() {
+    // restreamed textures replace whatever they had, degraded textures used last frame get their full mip chain
+    // back. the budget pass below decides what to drop
+    for (auto &&texture : _textures) {
+        if (texture->_restreaming) {
+            if (!texture->_restreamJob.isDone()) continue;
+            texture->_restreaming = false;
+            texture->_restoreRequested = false;
+            texture->restore();
+        } else if (texture->_restoreRequested) {
+            texture->_restoreRequested = false;
+            texture->restore();
+        }
+    }
+    enforceGpuBudget();
+    enforceCpuBudget();
+    ++_frameIndex;
+}
+void TextureManager::enforceGpuBudget() {
+    size_t total = _externalGpuBytes;
+    std::vector<Texture *> candidates;
+    for (auto &&texture : _textures) {
+        total += texture->getGpuBytes();
+        // a restreaming texture's image belongs to the decode job
+        if (texture->_uploaded && !texture->_restreaming) candidates.emplace_back(texture.get());
+    }
+    if (total <= _budget.gpuBytes) return;
 
-Texture *TextureManager::createTexture(Image *pImage) {
-    auto it = _textures.find(pImage->getId());
-    if (it != _textures.end()) return it->second.get();
-    return _textures.emplace(pImage->getId(), std::make_unique<Texture>(pImage)).first->second.get();
+    // least recently bound first
+    std::sort(candidates.begin(), candidates.end(),
+              [](auto lhs, auto rhs) { return lhs->_lastBoundFrame < rhs->_lastBoundFrame; });
+
+    for (auto texture : candidates) {
+        if (total <= _budget.gpuBytes) break;
+        // never touch what is being drawn this frame
+        if (texture->_lastBoundFrame >= _frameIndex) break;
+
+        while (total > _budget.gpuBytes && texture->_uploaded) {
+            auto before = texture->getGpuBytes();
+            bool stale = _frameIndex - texture->_lastBoundFrame > _budget.evictAfterFrames;
+            uint32_t width = std::max(1u, uint32_t(texture->_pImageSrc->_width) >> texture->_droppedMipLevels);
+            uint32_t height = std::max(1u, uint32_t(texture->_pImageSrc->_height) >> texture->_droppedMipLevels);
+            if (stale || std::max(width, height) / 2 < _budget.minResidentSize || !texture->dropTopMips(1)) {
+                texture->evict();
+                ++_evictions;
+            }
+            total -= before - texture->getGpuBytes();
+        }
+    }
+}
+void TextureManager::enforceCpuBudget() {
+    size_t total{};
+    std::vector<Texture *> candidates;
+    for (auto &&texture : _textures) {
+        if (texture->_restreaming) continue;
+        auto bytes = texture->_pImageSrc->getDataSize();
+        total += bytes;
+        // only copies already on the gpu and decodable again can be dropped
+        if (bytes && texture->_uploaded && texture->_pImageSrc->canReload()) candidates.emplace_back(texture.get());
+    }
+    if (total <= _budget.cpuBytes) return;
+    std::sort(candidates.begin(), candidates.end(),
+              [](auto lhs, auto rhs) { return lhs->_lastBoundFrame < rhs->_lastBoundFrame; });
+    for (auto texture : candidates) {
+        if (total <= _budget.cpuBytes) break;
+        total -= texture->_pImageSrc->getDataSize();
+        texture->_pImageSrc->unload();
+    }
+}
+TextureResidencyStats TextureManager::getStats() const {
+    TextureResidencyStats ret{};
+    ret.gpuBytes = ret.externalGpuBytes = _externalGpuBytes;
+    for (auto &&texture : _textures) {
+        ret.gpuBytes += texture->getGpuBytes();
+        if (!texture->_restreaming) ret.cpuBytes += texture->_pImageSrc->getDataSize();
+        switch (texture->getResidency()) {
+            case TEXTURE_RESIDENCY_EVICTED:
+                ++ret.evictedCount;
+                break;
+            case TEXTURE_RESIDENCY_DEGRADED:
+                ++ret.degradedCount;
+                break;
+            case TEXTURE_RESIDENCY_RESIDENT:
+                ++ret.residentCount;
+                break;
+        }
+    }
+    ret.textureCount = static_cast<uint32_t>(_textures.size());
+    ret.evictions = _evictions;
+    ret.mipDrops = _mipDrops;
+    ret.restreams = _restreams;
+    return ret;
 }
-void TextureManager::removeTexture(Texture const *texture) {
-    auto id = texture->getImage()->getId();
-    auto it = _textures.find(id);
-    if (it == _textures.end()) return;
-    _textures.erase(it);
-}
\ No newline at end of file
@@ -6,8 +6,20 @@
 #include "gl/glew.h"
 #include "idObject.h"
 #include "image.h"
+#include "jobsystem.h"
+#include "resource.h"
+#include "slotmap.h"
 
-class Texture : public IdObject {
+enum TextureResidency {
+    TEXTURE_RESIDENCY_EVICTED,   // no gpu storage, restreamed from the image after the next bind
+    TEXTURE_RESIDENCY_DEGRADED,  // top mip levels dropped to save memory
+    TEXTURE_RESIDENCY_RESIDENT,  // full mip chain on gpu
+};
+
+class Texture : public IdObject<Texture>, public Resource {
+    friend class TextureManager;
+
+    // referenced as a dependency
     Image *_pImageSrc;
     GL::ImageHandle _image{};
     GL::ImageViewHandle _imageView{};
@@ -16,6 +28,35 @@ class Texture : public IdObject {
     GLenum _target{GL_TEXTURE_2D};
     bool _uploaded{false};
 
+    // number of top mip levels currently dropped from gpu storage
+    uint32_t _droppedMipLevels{};
+    uint64_t _lastBoundFrame{};
+    bool _restoreRequested{false};
+
+    // the image is decoded again on a job thread, TextureManager::update uploads it once the job is done. the
+    // image is not touched on the main thread meanwhile
+    JobCounter _restreamJob;
+    bool _restreaming{false};
+
+    // ARB_bindless_texture handle of the view, 0 if not requested
+    uint64_t _bindlessHandle{};
+
+    // AssetReloader watch of the image file, 0 if not watched
+    uint64_t _watchId{};
+
+    void createView(GL::Format format, uint32_t levelCount);
+    // emits TextureManager::textureStorageChangedSignal
+    void storageChanged();
+    // the gl objects are deleted once the frames in flight are done with them
+    void releaseGpu();
+
+    // keep mip levels [count, ...] and free the larger ones, return false if nothing can be dropped
+    bool dropTopMips(uint32_t count);
+
+    void requestRestream();
+    // replace gpu storage with the full mip chain, the current storage stays bound until the image is decoded
+    void restore();
+
 public:
     Texture(Image *image);
     ~Texture();
@@ -25,17 +66,128 @@ public:
     void upload();
 
     void bind(uint32_t binding);
+
+    /**
+     * @brief what bind() does besides the gl bind: uploads the texture if needed and counts as a bind for this frame.
+     * main thread, before recording commands that bind getImageView()
+     */
+    void prepareBind();
+    constexpr GLenum getTarget() const { return _target; }
+    /**
+     * @brief the fallback texture of TextureManager while there is no gpu storage
+     */
+    GL::ImageViewHandle getImageView() const;
+
+    /**
+     * @brief resident bindless handle of the current storage, the fallback's handle while there is no storage.
+     * does not upload or count as a bind, see prepareBind. the handle changes whenever gpu storage is recreated
+     * (eviction, mip drop, restream), textureStorageChangedSignal tells when
+     */
+    uint64_t getBindlessHandle();
+
+    /**
+     * @brief decode the image again and replace gpu storage, used when the file changed on disk
+     */
+    void reload();
+
+    /**
+     * @brief free gpu storage, the texture is uploaded again after the next bind
+     */
+    void evict();
+
+    TextureResidency getResidency() const;
+
+    constexpr uint64_t getLastBoundFrame() const { return _lastBoundFrame; }
+};
+
+struct TextureBudget {
+    size_t gpuBytes{~size_t(0)};
+    size_t cpuBytes{~size_t(0)};
+    // keep textures at least this size (largest dimension) when dropping mips
+    uint32_t minResidentSize{64};
+    // textures not bound for this many frames are evicted entirely instead of being degraded
+    uint32_t evictAfterFrames{120};
+    // free decoded pixels once they are on the gpu, they are decoded again on a job thread when needed
+    bool freeCpuAfterUpload{true};
+};
+
+struct TextureResidencyStats {
+    // includes externalGpuBytes
+    size_t gpuBytes;
+    size_t externalGpuBytes;
+    size_t cpuBytes;
+    uint32_t textureCount;
+    uint32_t residentCount;
+    uint32_t degradedCount;
+    uint32_t evictedCount;
+    uint64_t evictions;
+    uint64_t mipDrops;
+    uint64_t restreams;
 };
 
 class TextureManager : public Singleton<TextureManager> {
-    // texture Id,
-    std::unordered_map<IdType , std::unique_ptr<Texture>> _textures;
+    friend class Texture;
+
+    // by image id
+    SlotMap<std::unique_ptr<Texture>> _textures;
+
+    TextureBudget _budget{};
+
+    uint64_t _frameIndex{1};
+    uint64_t _evictions{};
+    uint64_t _mipDrops{};
+    uint64_t _restreams{};
+    // gpu memory of texture copies the manager does not own (material texture arrays), counted against the budget
+    size_t _externalGpuBytes{};
+
+    // 1x1 flat normal (light blue as a color) bound in place of textures without gpu storage
+    GL::ImageHandle _fallbackImage{};
+    uint64_t _fallbackBindlessHandle{};
+
+    void enforceGpuBudget();
+    void enforceCpuBudget();
 
 public:
-    TextureManager() {}
-    ~TextureManager() {}
+    TextureManager();
 
-    Texture* createTexture(Image *pImage);
+    /**
+     * @brief textures are shared by image, the texture keeps the image alive
+     */
+    ResourceHandle<Texture> createTexture(Image *pImage);
 
-    void removeTexture(Texture const *texture);
-};
\ No newline at end of file
+    // emitted after a texture was reloaded from disk
+    Signal<void(Texture *)> textureReloadedSignal;
+    // emitted when gpu storage of a texture was created, replaced or freed, views and bindless handles taken
+    // before are stale. not emitted when a texture is destroyed
+    Signal<void(Texture *)> textureStorageChangedSignal;
+
+    /**
+     * @brief destroy textures no material references, see ResourceManager::collectGarbage
+     */
+    size_t collectGarbage();
+
+    /**
+     * @brief destroy every texture and the fallback, at shutdown after the materials
+     */
+    void clear();
+
+    void setBudget(TextureBudget const &budget) { _budget = budget; }
+    /**
+     * @brief textures copied into other storage report its size here, it shrinks what is left for the managed ones
+     */
+    void setExternalGpuBytes(size_t bytes) { _externalGpuBytes = bytes; }
+    constexpr TextureBudget const &getBudget() const { return _budget; }
+
+    constexpr uint64_t getFrameIndex() const { return _frameIndex; }
+
+    GL::ImageViewHandle getFallbackView();
+    uint64_t getFallbackBindlessHandle();
+
+    /**
+     * @brief call once per frame before drawing, uploads restreamed textures, restores requested ones and enforces
+     * the budgets
+     */
+    void update();
+
+    TextureResidencyStats getStats() const;
+};
@@ -10,14 +10,20 @@ void Transform::init() {
                                               GL::BUFFER_STORAGE_MAP_PERSISTENT_BIT},
                      &_globalTransformMatrix, &_transformBuffer);
 }
-void Transform::updateTransformBuffer() {
-    // auto m = _globalTransformMatrix * glm::scale(glm::mat4(1), _localScale);
+glm::mat4 Transform::computeModelMatrix() const {
     glm::mat4 m = _localTransformMatrix;
     if (auto p = _parent->getParent()) {
         m = p->getComponent<Transform>()->getGlobalTransformMatrix() * _localTransformMatrix;
     }
-    // auto m = _globalTransformMatrix * glm::scale(glm::mat4(1), _localScale);
-
+    return m;
+}
+void Transform::setModelMatrix(glm::mat4 const &m) {
+    _modelMatrix = m;
+    ++_poseVersion;
+}
+void Transform::uploadModelMatrix(glm::mat4 const &m, uint64_t poseVersion) {
+    if (poseVersion == _uploadedVersion) return;
+    _uploadedVersion = poseVersion;
     glBindBuffer(GL_UNIFORM_BUFFER, _transformBuffer);
     glm::mat4 *data = (glm::mat4 *)glMapBufferRange(
         GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
@@ -146,6 +152,32 @@ void Transform::update() {
         _globalTransformMatrix = p->getComponent<Transform>()->getGlobalTransformMatrix() * _globalTransformMatrix;
         _globalRotationQuat = p->getComponent<Transform>()->getGlobalRotation() * _globalRotationQuat;
     }
-    // update transform buffer
-    updateTransformBuffer();
+    _renderMatrix = _globalTransformMatrix;
+    _interpolated = false;
+    if (!_posed) {
+        storePreviousState();
+        _posed = true;
+    }
+    setModelMatrix(computeModelMatrix());
+}
+void Transform::storePreviousState() {
+    _previousPosition = getGlobalPosition();
+    _previousRotation = _globalRotationQuat;
+}
+void Transform::interpolate(float alpha) {
+    auto position = getGlobalPosition();
+    if (position == _previousPosition && _globalRotationQuat == _previousRotation) {
+        // not moving, the model matrix is the current pose unless a previous frame blended it
+        if (_interpolated) {
+            _renderMatrix = _globalTransformMatrix;
+            _interpolated = false;
+            setModelMatrix(computeModelMatrix());
+        }
+        return;
+    }
+    // global matrices carry no scale, translation and rotation describe them fully
+    _renderMatrix = glm::translate(glm::mat4(1), glm::mix(_previousPosition, position, alpha)) *
+                    glm::mat4_cast(glm::slerp(_previousRotation, _globalRotationQuat, alpha));
+    _interpolated = true;
+    setModelMatrix(_renderMatrix * glm::scale(glm::mat4(1), _localScale));
 }
\ No newline at end of file
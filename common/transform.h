@@ -24,8 +24,23 @@ class Transform : public Component {
 
     GL::BufferHandle _transformBuffer{};
 
+    // global pose at the start of the last simulation tick, rendering interpolates from it to the current pose
+    glm::vec3 _previousPosition{0};
+    glm::quat _previousRotation{1, 0, 0, 0};
+    glm::mat4 _renderMatrix{1};
+    // render pose with scale, what the transform buffer has to hold
+    glm::mat4 _modelMatrix{1};
+    // bumped whenever _modelMatrix changes
+    uint64_t _poseVersion{1};
+    // render stage only, version last written into the transform buffer
+    uint64_t _uploadedVersion{};
+    bool _interpolated{false};
+    // false until the first update, a new transform must not blend from the origin
+    bool _posed{false};
+
     void init();
-    void updateTransformBuffer();
+    glm::mat4 computeModelMatrix() const;
+    void setModelMatrix(glm::mat4 const &m);
 
 public:
     Transform(Node *parent);
@@ -72,5 +87,30 @@ public:
 
     constexpr GL::BufferHandle getTransformBufferHandle() const { return _transformBuffer; }
 
+    /**
+     * @brief called by Scene at the start of every simulation tick
+     */
+    void storePreviousState();
+
+    /**
+     * @brief blend the rendered pose between the previous and the current tick, alpha in [0, 1]
+     */
+    void interpolate(float alpha);
+
+    /**
+     * @brief pose used for rendering, equals the global transform unless interpolated
+     */
+    glm::mat4 const &getRenderMatrix() const { return _renderMatrix; }
+    constexpr glm::vec3 getRenderPosition() const { return glm::vec3(_renderMatrix[3]); }
+
+    constexpr glm::mat4 const &getModelMatrix() const { return _modelMatrix; }
+    constexpr uint64_t getPoseVersion() const { return _poseVersion; }
+
+    /**
+     * @brief render stage, write a model matrix taken from a snapshot into the transform buffer unless that version
+     * is already there. the simulation never touches gl, so it can run on another thread
+     */
+    void uploadModelMatrix(glm::mat4 const &model, uint64_t poseVersion);
+
     void update() override;
 };
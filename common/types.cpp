@@ -189,6 +189,86 @@ int getDataTypeSize(DataType type) {
     }
     return 0;
 }
+int getFormatSize(GLenum format) {
+    switch (format) {
+        case GL_R8:
+        case GL_R8_SNORM:
+        case GL_R8I:
+        case GL_R8UI:
+        case GL_R3_G3_B2:
+        case GL_STENCIL_INDEX8:
+            return 1;
+        case GL_R16:
+        case GL_R16_SNORM:
+        case GL_R16F:
+        case GL_R16I:
+        case GL_R16UI:
+        case GL_RG8:
+        case GL_RG8_SNORM:
+        case GL_RG8I:
+        case GL_RG8UI:
+        case GL_RGB565:
+        case GL_RGB5_A1:
+        case GL_RGBA4:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGB8:
+        case GL_RGB8_SNORM:
+        case GL_RGB8I:
+        case GL_RGB8UI:
+        case GL_SRGB8:
+        case GL_DEPTH_COMPONENT24:
+            return 3;
+        case GL_RGBA8:
+        case GL_RGBA8_SNORM:
+        case GL_RGBA8I:
+        case GL_RGBA8UI:
+        case GL_SRGB8_ALPHA8:
+        case GL_RGB10_A2:
+        case GL_RGB10_A2UI:
+        case GL_R11F_G11F_B10F:
+        case GL_RGB9_E5:
+        case GL_RG16:
+        case GL_RG16_SNORM:
+        case GL_RG16F:
+        case GL_RG16I:
+        case GL_RG16UI:
+        case GL_R32F:
+        case GL_R32I:
+        case GL_R32UI:
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH_COMPONENT32:
+        case GL_DEPTH_COMPONENT32F:
+            return 4;
+        case GL_RGB16:
+        case GL_RGB16_SNORM:
+        case GL_RGB16F:
+        case GL_RGB16I:
+        case GL_RGB16UI:
+            return 6;
+        case GL_RGBA16:
+        case GL_RGBA16_SNORM:
+        case GL_RGBA16F:
+        case GL_RGBA16I:
+        case GL_RGBA16UI:
+        case GL_RG32F:
+        case GL_RG32I:
+        case GL_RG32UI:
+        // 32 bit depth and 8 bit stencil padded to 64 bits
+        case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGB32F:
+        case GL_RGB32I:
+        case GL_RGB32UI:
+            return 12;
+        case GL_RGBA32F:
+        case GL_RGBA32I:
+        case GL_RGBA32UI:
+            return 16;
+    }
+    // unsized and compressed formats have no size per texel, a guess would skew the residency budgets
+    throw std::runtime_error("getFormatSize: not a sized uncompressed format " + std::to_string(format));
+}
 GLenum Map(PrimitiveTopology topology) {
     static GLenum topologyArr[]{
         GL_POINT,
@@ -289,4 +289,9 @@ GLenum Map(BufferMapFlagBits flags);
 GLbitfield Map(ShaderStageFlagBits flagbit);
 
 int getDataTypeSize(DataType type);
+
+/**
+ * @brief bytes per texel of an uncompressed sized internal format, throws for any other format
+ */
+int getFormatSize(GLenum format);
 }  // namespace GL
@@ -0,0 +1,609 @@
+#include <algorithm>
+#include <filesystem>
+
+#include "appbase.h"
+#include "camerapath.h"
+#include "materialtable.h"
+#include "resource.h"
+#include "technique.h"
+
+/**
+ * deterministic frame benchmark
+ *
+ * usage: benchmark <scene file> [--out result.json] [--label name] [--binding per_draw|texture_array|bindless]
+ *                  [--ssao-dispatch linear|tiled] [--ao-type uniform|cosine] [--ssao-check]
+ *                  [--ssao-resolution full|half|quarter] [--ssao-temporal] [--depth-pyramid] [--depth-pyramid-check]
+ *        plus the AppBase options (--headless, --size WxH, --capture dir ...)
+ *
+ * scene file, one command per line, '#' starts a comment, relative paths are resolved against ASSETS_DIR:
+ *   model <path> [tx ty tz] [yaw pitch roll (degrees)]
+ *   instances <nx> <nz> <spacing>    every model is placed on an nx by nz grid around its translation
+ *   spin <degrees per second>        models turn around y every frame, keeps the simulation busy
+ *   light <dx dy dz> [r g b] [intensity]
+ *   camera <px py pz> <tx ty tz>     control point of the camera spline, position and look-at target
+ *   frames <n>                       measured frames, --frames overrides it
+ *   warmup <n>                       frames rendered before measuring, camera stays at the path start
+ *   dt <ms>                          fixed time step, --fixed-dt and --replay-input override it
+ *   postprocess none|ssao
+ *
+ * the camera position only depends on the frame index and every frame advances by the fixed time step, so two runs
+ * of the same scene render the same images and their results can be compared across commits.
+ * the scene update happens in buildSnapshot, with --pipelined it overlaps the rendering of the previous frame and
+ * cpu_frame_ms drops from update + render towards the larger of both on cpu bound scenes.
+ * with --replay-input the camera starts at the beginning of the path and is then driven by the recorded input
+ * through EditCameraController, recorded for example with `test --record-input session.bin`, the warmup frames
+ * replay the start of the recording too
+ *
+ * ssao: gpu_pass_ms.ssao times the ao pass of the selected dispatch plus the blur. to compare the variants run a
+ * scene with `postprocess ssao` once per dispatch, ao type and resolution, e.g. --size 1920x1080 and
+ * --size 3840x2160. --ssao-check runs both variants on the last frame and reports how far their raw ao differs,
+ * with --ssao-resolution below full or --ssao-temporal also how far the final ao is from the full resolution one
+ * (the image difference of the quality modes against the reference)
+ *
+ * checks: the result is written first, then the run fails (exit code 1) if a check is beyond its threshold, see
+ * the thresholds in Benchmark (SSAO_VARIANT_MAX_ABS_DIFF ...). runs with a check exit with 77 (skipped) when there
+ * is no gl context. ctest runs them on assets/benchmarks/checks.txt
+ *
+ * depth pyramid: --depth-pyramid builds the min/max depth pyramid every frame (needs `postprocess ssao`),
+ * gpu_pass_ms.depth_pyramid times it. every measured frame requests a readback of a coarse level,
+ * depth_pyramid.readback_latency_frames is how many frames later it arrived. --depth-pyramid-check compares every
+ * level of the last frame and one readback against the pyramid built on the cpu from the depth buffer, up to the
+ * rounding of the 24 bit depth values (Benchmark::DEPTH_PYRAMID_MAX_ABS_DIFF)
+ */
+
+struct BenchmarkScene {
+    struct ModelDesc {
+        std::string path;
+        glm::vec3 translation{0};
+        glm::vec3 rotation{0};  // yaw pitch roll, degrees
+    };
+    struct LightDesc {
+        glm::vec3 direction{1, 1, 0};
+        glm::vec3 color{1};
+        float intensity{1};
+    };
+    std::string name;
+    std::vector<ModelDesc> models;
+    std::vector<LightDesc> lights;
+    glm::uvec2 instances{1, 1};
+    float instanceSpacing{0};
+    float spin_degPerS{0};
+    CameraPath cameraPath;
+    uint32_t frames{300};
+    uint32_t warmupFrames{30};
+    float dt_ms{1000.f / 60};
+    PostProcessType postProcess{POST_PROCESS_NONE};
+
+    static BenchmarkScene load(std::string const &path) {
+        std::ifstream is(path);
+        if (!is) THROW("failed to open benchmark scene", path);
+
+        auto resolve = [](std::string const &p) {
+            return std::filesystem::path(p).is_absolute() ? p : std::string(ASSETS_DIR) + "/" + p;
+        };
+        auto readVec3 = [](std::istringstream &ss, glm::vec3 &v) { return bool(ss >> v.x >> v.y >> v.z); };
+
+        BenchmarkScene ret{};
+        ret.name = std::filesystem::path(path).stem().string();
+        std::string line;
+        for (int lineNumber = 1; std::getline(is, line); ++lineNumber) {
+            if (auto pos = line.find('#'); pos != std::string::npos) line.resize(pos);
+            std::istringstream ss(line);
+            std::string command;
+            if (!(ss >> command)) continue;
+            if (command == "model") {
+                auto &&e = ret.models.emplace_back();
+                if (!(ss >> e.path)) THROW("model path missing, line", lineNumber);
+                e.path = resolve(e.path);
+                if (readVec3(ss, e.translation)) readVec3(ss, e.rotation);
+            } else if (command == "instances") {
+                if (!(ss >> ret.instances.x >> ret.instances.y >> ret.instanceSpacing) || !ret.instances.x ||
+                    !ret.instances.y)
+                    THROW("instances expects nx nz spacing, line", lineNumber);
+            } else if (command == "spin")
+                ss >> ret.spin_degPerS;
+            else if (command == "light") {
+                auto &&e = ret.lights.emplace_back();
+                if (!readVec3(ss, e.direction)) THROW("light direction missing, line", lineNumber);
+                if (readVec3(ss, e.color)) ss >> e.intensity;
+            } else if (command == "camera") {
+                auto &&e = ret.cameraPath.points.emplace_back();
+                if (!readVec3(ss, e.position) || !readVec3(ss, e.target))
+                    THROW("camera expects position and target, line", lineNumber);
+            } else if (command == "frames")
+                ss >> ret.frames;
+            else if (command == "warmup")
+                ss >> ret.warmupFrames;
+            else if (command == "dt")
+                ss >> ret.dt_ms;
+            else if (command == "postprocess") {
+                std::string type;
+                ss >> type;
+                ret.postProcess = type == "ssao" ? POST_PROCESS_SSAO : POST_PROCESS_NONE;
+            } else
+                THROW("unknown benchmark command", command, "line", lineNumber);
+        }
+        if (ret.frames == 0) THROW("benchmark needs at least one frame");
+        return ret;
+    }
+};
+
+struct BenchmarkOptions {
+    std::string scenePath;
+    std::string outPath;
+    std::string label;
+    std::string bindingModel;  // empty: detected
+    SSAODispatch ssaoDispatch{SSAO_DISPATCH_TILED};
+    int aoType{};
+    bool ssaoCheck{};
+    SSAOResolution ssaoResolution{SSAO_RESOLUTION_FULL};
+    bool ssaoTemporal{};
+    bool depthPyramid{};
+    bool depthPyramidCheck{};
+
+    static BenchmarkOptions parse(int argc, const char **argv) {
+        BenchmarkOptions ret{};
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            if (arg == "--out" && i + 1 < argc)
+                ret.outPath = argv[++i];
+            else if (arg == "--label" && i + 1 < argc)
+                ret.label = argv[++i];
+            else if (arg == "--binding" && i + 1 < argc)
+                ret.bindingModel = argv[++i];
+            else if (arg == "--ssao-dispatch" && i + 1 < argc) {
+                std::string_view value = argv[++i];
+                if (value != "linear" && value != "tiled") THROW("--ssao-dispatch expects linear or tiled");
+                ret.ssaoDispatch = value == "linear" ? SSAO_DISPATCH_LINEAR : SSAO_DISPATCH_TILED;
+            } else if (arg == "--ao-type" && i + 1 < argc) {
+                std::string_view value = argv[++i];
+                if (value != "uniform" && value != "cosine") THROW("--ao-type expects uniform or cosine");
+                ret.aoType = value == "cosine";
+            } else if (arg == "--ssao-resolution" && i + 1 < argc) {
+                std::string_view value = argv[++i];
+                int resolution = 0;
+                while (resolution < SSAO_RESOLUTION_Num &&
+                       value != getSSAOResolutionName(static_cast<SSAOResolution>(resolution)))
+                    ++resolution;
+                if (resolution == SSAO_RESOLUTION_Num) THROW("--ssao-resolution expects full, half or quarter");
+                ret.ssaoResolution = static_cast<SSAOResolution>(resolution);
+            } else if (arg == "--ssao-check")
+                ret.ssaoCheck = true;
+            else if (arg == "--ssao-temporal")
+                ret.ssaoTemporal = true;
+            else if (arg == "--depth-pyramid")
+                ret.depthPyramid = true;
+            else if (arg == "--depth-pyramid-check")
+                ret.depthPyramid = ret.depthPyramidCheck = true;
+            else if (arg.substr(0, 2) == "--") {
+                // AppBase option, skip its value
+                if (arg != "--headless" && arg != "--profile" && arg != "--pipelined" && i + 1 < argc) ++i;
+            } else
+                ret.scenePath = arg;
+        }
+        if (ret.scenePath.empty()) THROW("usage: benchmark <scene file> [--out result.json] [--label name]");
+        return ret;
+    }
+};
+
+struct Summary {
+    double min, mean, p50, p90, p95, p99, max;
+
+    static Summary compute(std::vector<double> values) {
+        if (values.empty()) return {};
+        std::sort(values.begin(), values.end());
+        // nearest rank
+        auto percentile = [&](double p) {
+            auto rank = static_cast<size_t>(std::ceil(p / 100 * values.size()));
+            return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+        };
+        double sum{};
+        for (auto e : values) sum += e;
+        return {values.front(),  sum / values.size(), percentile(50), percentile(90),
+                percentile(95), percentile(99),       values.back()};
+    }
+    void write(std::ostream &os) const {
+        os << "{\"min\": " << min << ", \"mean\": " << mean << ", \"p50\": " << p50 << ", \"p90\": " << p90
+           << ", \"p95\": " << p95 << ", \"p99\": " << p99 << ", \"max\": " << max << "}";
+    }
+};
+
+// per pixel difference of two single channel images
+struct ImageDiff {
+    double meanAbs{-1}, maxAbs{-1}, rms{-1};
+
+    static ImageDiff compute(std::vector<float> const &a, std::vector<float> const &b) {
+        if (a.empty() || a.size() != b.size()) return {};
+        ImageDiff ret{0, 0, 0};
+        for (size_t i = 0; i < a.size(); ++i) {
+            double diff = std::abs(double(a[i]) - b[i]);
+            ret.meanAbs += diff;
+            ret.maxAbs = (std::max)(ret.maxAbs, diff);
+            ret.rms += diff * diff;
+        }
+        ret.meanAbs /= a.size();
+        ret.rms = std::sqrt(ret.rms / a.size());
+        return ret;
+    }
+    bool valid() const { return maxAbs >= 0; }
+    void write(std::ostream &os) const {
+        os << "{\"mean_abs_diff\": " << meanAbs << ", \"max_abs_diff\": " << maxAbs << ", \"rms_diff\": " << rms
+           << "}";
+    }
+};
+
+class Benchmark : public Game {
+    using Clock = std::chrono::steady_clock;
+
+    BenchmarkOptions _options;
+    BenchmarkScene _desc;
+    std::unique_ptr<Scene> _scene;
+    std::vector<Node *> _modelNodes;
+
+    std::vector<double> _frameMs;
+    std::vector<double> _updateMs;
+    std::vector<double> _renderMs;
+    std::vector<double> _gpuMs;
+    std::vector<double> _drawRecordMs;
+    std::vector<double> _drawReplayMs;
+    std::array<std::vector<double>, GPU_PASS_NUM> _gpuPassMs;
+    uint64_t _drawCalls{};
+    uint64_t _triangles{};
+    // --ssao-check: raw ao of the tiled variant against the linear one, final ao against the full resolution one
+    ImageDiff _ssaoVariantDiff;
+    // the tiled variant reads the same depth texels from shared memory, only the float rounding of the
+    // reconstruction may differ
+    static constexpr double SSAO_VARIANT_MAX_ABS_DIFF = 1e-3;
+    // the reduced modes blur edges and thin features, single pixels differ a lot, the image as a whole may not
+    static constexpr double SSAO_REFERENCE_MEAN_ABS_DIFF = 0.01;
+    static constexpr double SSAO_REFERENCE_RMS_DIFF = 0.05;
+    ImageDiff _ssaoReferenceDiff;
+    // level read back every measured frame, 6 above the coarsest one (about 64 frame pixels per texel at 4k)
+    static constexpr uint32_t DEPTH_READBACK_LEVEL_FROM_COARSEST = 6;
+    std::vector<double> _depthReadbackLatency;
+    uint32_t _depthReadbackRejected{};
+    // --depth-pyramid-check: texels that differ from the cpu pyramid by more than DEPTH_PYRAMID_MAX_ABS_DIFF, -1 when
+    // not checked. min and max are depth buffer values, but the sampler and glGetTexImage may round the 24 bit
+    // values to float differently
+    static constexpr double DEPTH_PYRAMID_MAX_ABS_DIFF = 2.0 / ((1 << 24) - 1);
+    int64_t _depthPyramidMismatches{-1};
+    double _depthPyramidMaxDiff{};
+    int64_t _depthReadbackMismatches{-1};
+    // checks beyond their threshold, the run fails once the result is written
+    std::vector<std::string> _checkFailures;
+
+    Clock::time_point _lastFrameStart{};
+    uint32_t _frame{};
+    // simulation stage, one ahead of _frame when pipelined
+    uint32_t _simulationFrame{};
+
+    static double elapsedMs(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+public:
+    Benchmark(BenchmarkOptions const &options, BenchmarkScene const &desc)
+        : Game("benchmark"), _options(options), _desc(desc) {}
+
+    constexpr BenchmarkScene const &getScene() const { return _desc; }
+
+    void init() override {
+        if (!_options.bindingModel.empty()) {
+            static const std::pair<const char *, MaterialBindingModel> models[]{
+                {"per_draw", MATERIAL_BINDING_PER_DRAW},
+                {"texture_array", MATERIAL_BINDING_TEXTURE_ARRAY},
+                {"bindless", MATERIAL_BINDING_BINDLESS},
+            };
+            auto it = std::find_if(std::begin(models), std::end(models),
+                                   [&](auto &&e) { return _options.bindingModel == e.first; });
+            if (it == std::end(models)) THROW("unknown material binding model", _options.bindingModel);
+            MaterialTable::getSingleton().setBindingModel(it->second);
+        }
+
+        _scene = std::make_unique<Scene>(_desc.name);
+        _scene->environment->setClearColor(0.2, 0.2, 0.2, 1);
+        for (auto &&e : _desc.lights) {
+            auto light = _scene->createLight()->getComponent<Light>();
+            light->uboData.direction = e.direction;
+            light->uboData.color = e.color;
+            light->uboData.intensity = e.intensity;
+        }
+        for (auto &&e : _desc.models) {
+            auto model = ModelManager::getSingleton().createModel(e.path);
+            model->load();
+            if (!model->loaded) THROW("failed to load model", e.path);
+            auto rotation = glm::radians(e.rotation);
+            auto center = (glm::vec2(_desc.instances) - 1.f) * 0.5f;
+            for (uint32_t x = 0; x < _desc.instances.x; ++x) {
+                for (uint32_t z = 0; z < _desc.instances.y; ++z) {
+                    auto offset = glm::vec3(x - center.x, 0, z - center.y) * _desc.instanceSpacing;
+                    auto node = _modelNodes.emplace_back(_scene->addModel(model.get()));
+                    node->getComponent<Transform>()
+                        ->translate(e.translation + offset)
+                        ->yaw(rotation.x)
+                        ->pitch(rotation.y)
+                        ->roll(rotation.z);
+                }
+            }
+        }
+        _scene->prepare();
+
+        // the scene only learns the aspect ratio from resize events
+        _scene->getEditorCameraNode()->getComponent<Camera>()->setPerspective(
+            glm::radians(60.f), float(Input::framebufferWidth) / Input::framebufferHeight);
+
+        RenderServer::getSingleton().postProcessType = _desc.postProcess;
+        PostProcessSSAO::getSingleton().dispatch = _options.ssaoDispatch;
+        PostProcessSSAO::getSingleton().params.aoType = _options.aoType;
+        PostProcessSSAO::getSingleton().params.resolution = _options.ssaoResolution;
+        PostProcessSSAO::getSingleton().params.temporal = _options.ssaoTemporal;
+        RenderServer::getSingleton().buildDepthPyramid = _options.depthPyramid;
+        RenderServer::getSingleton().showGrid = false;
+
+        _frameMs.reserve(_desc.frames);
+        _updateMs.reserve(_desc.frames);
+        _renderMs.reserve(_desc.frames);
+        _gpuMs.reserve(_desc.frames);
+        _drawRecordMs.reserve(_desc.frames);
+        _drawReplayMs.reserve(_desc.frames);
+    }
+
+    // simulation stage, no gl. the frame after the last measured one is still simulated when pipelined, it is not
+    // recorded so finish() can read the results meanwhile
+    void buildSnapshot(RenderSnapshot &snapshot, float /*alpha*/) override {
+        auto start = Clock::now();
+        auto frame = _simulationFrame++;
+        bool measured = frame >= _desc.warmupFrames && frame < _desc.warmupFrames + _desc.frames;
+        auto measuredIndex = frame >= _desc.warmupFrames ? frame - _desc.warmupFrames : 0;
+
+        float t = _desc.frames > 1 ? (std::min)(float(measuredIndex) / (_desc.frames - 1), 1.f) : 0.f;
+        bool replayingInput = !getParent()->getCreateInfo().replayInputPath.empty();
+        if (!replayingInput || frame == 0)
+            _desc.cameraPath.apply(replayingInput ? 0.f : t, _scene->getEditorCameraNode()->getComponent<Transform>());
+        if (_desc.spin_degPerS != 0) {
+            auto angle = glm::radians(_desc.spin_degPerS * _desc.dt_ms / 1000);
+            for (auto e : _modelNodes) e->getComponent<Transform>()->yaw(angle);
+        }
+
+        _scene->update(_desc.dt_ms);
+        _scene->buildSnapshot(snapshot);
+        if (measured) _updateMs.emplace_back(elapsedMs(start, Clock::now()));
+    }
+
+    void render(float /*dt*/) override {
+        auto frameStart = Clock::now();
+        bool measured = _frame >= _desc.warmupFrames;
+        auto measuredIndex = measured ? _frame - _desc.warmupFrames : 0;
+        if (measured && measuredIndex > 0) _frameMs.emplace_back(elapsedMs(_lastFrameStart, frameStart));
+        _lastFrameStart = frameStart;
+
+        GL::resetDrawStats();
+        RenderServer::getSingleton().renderSnapshot(_scene.get(), *getParent()->getRenderSnapshot());
+        auto renderEnd = Clock::now();
+
+        if (measured) {
+            _renderMs.emplace_back(elapsedMs(frameStart, renderEnd));
+            // gpu times come from the profiler's gpu scopes and lag a few frames behind, the first measured frames
+            // may still report warmup ones. 0 when the gpu had not finished that frame in time
+            auto &&renderServer = RenderServer::getSingleton();
+            if (renderServer.getGpuFrameMs() > 0) _gpuMs.emplace_back(renderServer.getGpuFrameMs());
+            for (int i = 0; i < GPU_PASS_NUM; ++i)
+                _gpuPassMs[i].emplace_back(renderServer.getGpuPassMs(static_cast<GpuPass>(i)));
+            _drawRecordMs.emplace_back(RenderServer::getSingleton().getDrawRecordMs());
+            _drawReplayMs.emplace_back(RenderServer::getSingleton().getDrawReplayMs());
+            _drawCalls += GL::getDrawStats().drawCalls;
+            _triangles += GL::getDrawStats().triangles;
+            if (auto pyramid = RenderServer::getSingleton().getDepthPyramid()) readBackDepthPyramid(*pyramid);
+        }
+
+        if (++_frame == _desc.warmupFrames + _desc.frames) finish();
+    }
+
+    void finish() {
+        glFinish();
+        _frameMs.emplace_back(elapsedMs(_lastFrameStart, Clock::now()));
+        if (_options.ssaoCheck && _desc.postProcess == POST_PROCESS_SSAO) checkSSAO();
+        if (_options.depthPyramidCheck && RenderServer::getSingleton().getDepthPyramid()) checkDepthPyramid();
+
+        if (_options.outPath.empty())
+            writeReport(std::cout);
+        else {
+            std::ofstream os(_options.outPath);
+            if (!os) THROW("failed to write benchmark result", _options.outPath);
+            writeReport(os);
+            std::cout << "benchmark result written to " << _options.outPath << std::endl;
+        }
+        for (auto &&e : _checkFailures) std::cout << "check failed: " << e << std::endl;
+        if (!_checkFailures.empty()) THROW(_checkFailures.size(), "benchmark checks failed");
+    }
+
+    void expectBelow(char const *what, double value, double threshold) {
+        if (value <= threshold) return;
+        std::ostringstream ss;
+        ss << what << " " << value << " > " << threshold;
+        _checkFailures.emplace_back(ss.str());
+    }
+
+    // inputs and camera of the last frame are still bound
+    void checkSSAO() {
+        auto &&ssao = PostProcessSSAO::getSingleton();
+        // before the reference overwrites the full resolution targets
+        auto result = ssao.readAO();
+        _ssaoVariantDiff = ImageDiff::compute(ssao.computeRawAO(SSAO_DISPATCH_LINEAR),
+                                              ssao.computeRawAO(SSAO_DISPATCH_TILED));
+        if (!_ssaoVariantDiff.valid())
+            _checkFailures.emplace_back("ssao variants differ in size");
+        else
+            expectBelow("ssao tiled vs linear max_abs_diff", _ssaoVariantDiff.maxAbs, SSAO_VARIANT_MAX_ABS_DIFF);
+        if (_options.ssaoResolution == SSAO_RESOLUTION_FULL && !_options.ssaoTemporal) return;
+        _ssaoReferenceDiff = ImageDiff::compute(ssao.computeReferenceAO(), result);
+        if (!_ssaoReferenceDiff.valid()) {
+            _checkFailures.emplace_back("ssao reference differs in size");
+            return;
+        }
+        expectBelow("ssao reference mean_abs_diff", _ssaoReferenceDiff.meanAbs, SSAO_REFERENCE_MEAN_ABS_DIFF);
+        expectBelow("ssao reference rms_diff", _ssaoReferenceDiff.rms, SSAO_REFERENCE_RMS_DIFF);
+    }
+
+    // never waits, the result of an earlier frame arrives when the gpu is done with it
+    void readBackDepthPyramid(DepthPyramid &pyramid) {
+        auto level = pyramid.getLevelCount() - (std::min)(pyramid.getLevelCount(), DEPTH_READBACK_LEVEL_FROM_COARSEST);
+        if (!pyramid.requestReadback(level)) ++_depthReadbackRejected;
+        DepthPyramidReadback readback{};
+        while (pyramid.pollReadback(readback))
+            _depthReadbackLatency.emplace_back(double(pyramid.getFrameIndex() - readback.frameIndex));
+    }
+
+    // the pyramid of the last frame against the one built on the cpu from its depth buffer
+    void checkDepthPyramid() {
+        auto &&pyramid = *RenderServer::getSingleton().getDepthPyramid();
+        auto frameSize = pyramid.getFrameSize();
+        std::vector<float> depth(size_t(frameSize.x) * frameSize.y);
+        glBindTexture(GL_TEXTURE_2D, RenderServer::getSingleton().getDepthImage());
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        auto reference = DepthPyramid::buildReference(depth, frameSize);
+
+        auto compare = [&](DepthPyramidReadback const &level) {
+            auto &&expected = reference[level.level].texels;
+            if (expected.size() != level.texels.size()) return int64_t(expected.size());
+            int64_t ret{};
+            for (size_t i = 0; i < expected.size(); ++i) {
+                auto diff = glm::abs(expected[i] - level.texels[i]);
+                auto maxDiff = double((std::max)(diff.x, diff.y));
+                _depthPyramidMaxDiff = (std::max)(_depthPyramidMaxDiff, maxDiff);
+                ret += maxDiff > DEPTH_PYRAMID_MAX_ABS_DIFF;
+            }
+            return ret;
+        };
+        _depthPyramidMismatches = 0;
+        for (uint32_t i = 0; i < pyramid.getLevelCount(); ++i) _depthPyramidMismatches += compare(pyramid.readLevel(i));
+
+        // the pixel buffer path, drain the readbacks still in flight and check a fresh one
+        DepthPyramidReadback readback{};
+        while (!pyramid.requestReadback(0)) {
+            glFinish();
+            pyramid.pollReadback(readback);
+        }
+        glFinish();
+        while (pyramid.pollReadback(readback)) {}
+        _depthReadbackMismatches = readback.level == 0 ? compare(readback) : -1;
+        expectBelow("depth pyramid mismatches", double(_depthPyramidMismatches), 0);
+        if (_depthReadbackMismatches < 0)
+            _checkFailures.emplace_back("depth pyramid readback of level 0 never arrived");
+        else
+            expectBelow("depth pyramid readback mismatches", double(_depthReadbackMismatches), 0);
+    }
+
+    void writeReport(std::ostream &os) const {
+        static const char *bindingModels[]{"per_draw", "texture_array", "bindless"};
+        auto renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+        auto frames = static_cast<double>(_desc.frames);
+
+        os << "{\n";
+        os << "  \"label\": \"" << _options.label << "\",\n";
+        os << "  \"scene\": \"" << _desc.name << "\",\n";
+        os << "  \"renderer\": \"" << (renderer ? renderer : "") << "\",\n";
+        os << "  \"resolution\": [" << Input::framebufferWidth << ", " << Input::framebufferHeight << "],\n";
+        os << "  \"material_binding\": \"" << bindingModels[MaterialTable::getSingleton().getBindingModel()]
+           << "\",\n";
+        os << "  \"warmup_frames\": " << _desc.warmupFrames << ",\n";
+        os << "  \"frames\": " << _desc.frames << ",\n";
+        os << "  \"dt_ms\": " << _desc.dt_ms << ",\n";
+        os << "  \"pipelined\": " << (getParent()->getCreateInfo().pipelined ? "true" : "false") << ",\n";
+        os << "  \"input_replay\": \"" << getParent()->getCreateInfo().replayInputPath << "\",\n";
+        os << "  \"cpu_frame_ms\": ";
+        auto frame = Summary::compute(_frameMs);
+        frame.write(os);
+        os << ",\n  \"fps\": " << (frame.mean > 0 ? 1000 / frame.mean : 0.);
+        os << ",\n  \"cpu_stage_ms\": {\n    \"update\": ";
+        Summary::compute(_updateMs).write(os);
+        os << ",\n    \"render\": ";
+        Summary::compute(_renderMs).write(os);
+        os << "\n  },\n  \"gpu_frame_ms\": ";
+        Summary::compute(_gpuMs).write(os);
+        os << ",\n  \"gpu_pass_ms\": {";
+        for (int i = 0; i < GPU_PASS_NUM; ++i) {
+            os << (i ? ",\n    \"" : "\n    \"") << getGpuPassName(static_cast<GpuPass>(i)) << "\": ";
+            Summary::compute(_gpuPassMs[i]).write(os);
+        }
+        os << "\n  }";
+        os << ",\n  \"draw_record_ms\": ";
+        Summary::compute(_drawRecordMs).write(os);
+        os << ",\n  \"draw_replay_ms\": ";
+        auto replay = Summary::compute(_drawReplayMs);
+        replay.write(os);
+        os << ",\n  \"replay_ms_per_10k_draws\": " << (_drawCalls ? replay.mean * 1e4 * frames / _drawCalls : 0.);
+        os << ",\n  \"draw_calls_per_frame\": " << _drawCalls / frames << ",\n";
+        os << "  \"triangles_per_frame\": " << _triangles / frames << ",\n";
+        os << "  \"ssao\": {\"dispatch\": \"" << getSSAODispatchName(_options.ssaoDispatch) << "\", \"ao_type\": \""
+           << (_options.aoType ? "cosine" : "uniform") << "\"";
+        os << ", \"resolution\": \"" << getSSAOResolutionName(_options.ssaoResolution) << "\", \"temporal\": "
+           << (_options.ssaoTemporal ? "true" : "false")
+           << ", \"samples_per_pixel\": " << PostProcessSSAO::getSingleton().getSamplesPerPixel();
+        if (_ssaoVariantDiff.valid()) {
+            os << ", \"check\": ";
+            _ssaoVariantDiff.write(os);
+        }
+        if (_ssaoReferenceDiff.valid()) {
+            os << ", \"reference\": ";
+            _ssaoReferenceDiff.write(os);
+        }
+        os << "},\n";
+        if (auto pyramid = RenderServer::getSingleton().getDepthPyramid()) {
+            auto size = pyramid->getLevelSize(0);
+            os << "  \"depth_pyramid\": {\"levels\": " << pyramid->getLevelCount() << ", \"size\": [" << size.x
+               << ", " << size.y << "], \"readbacks\": " << _depthReadbackLatency.size()
+               << ", \"readbacks_rejected\": " << _depthReadbackRejected << ", \"readback_latency_frames\": ";
+            Summary::compute(_depthReadbackLatency).write(os);
+            if (_depthPyramidMismatches >= 0) {
+                os << ", \"check\": {\"mismatches\": " << _depthPyramidMismatches
+                   << ", \"max_abs_diff\": " << _depthPyramidMaxDiff
+                   << ", \"readback_mismatches\": " << _depthReadbackMismatches << "}";
+            }
+            os << "},\n";
+        }
+        auto resources = ResourceManager::getSingleton().getStats();
+        os << "  \"resources\": {";
+        for (int i = 0; i < RESOURCE_Num; ++i) {
+            auto &&e = resources.types[i];
+            os << (i ? ",\n    \"" : "\n    \"") << getResourceTypeName(ResourceType(i))
+               << "\": {\"count\": " << e.count << ", \"loaded\": " << e.states[RESOURCE_STATE_LOADED]
+               << ", \"failed\": " << e.states[RESOURCE_STATE_FAILED] << ", \"cpu_bytes\": " << e.cpuBytes
+               << ", \"gpu_bytes\": " << e.gpuBytes << "}";
+        }
+        os << ",\n    \"pending_release_bytes\": " << resources.pendingReleaseBytes << "\n  }\n";
+        os << "}\n";
+    }
+};
+
+int main(int argc, const char **argv) {
+    try {
+        auto options = BenchmarkOptions::parse(argc, argv);
+        auto createInfo = parseCommandLine(argc, argv);
+
+        // the scene decides run length and time step, --frames and --fixed-dt override it
+        auto desc = BenchmarkScene::load(options.scenePath);
+        if (createInfo.frameCount) desc.frames = createInfo.frameCount;
+        if (createInfo.fixedTimeStep_ms > 0) desc.dt_ms = createInfo.fixedTimeStep_ms;
+        createInfo.frameCount = desc.warmupFrames + desc.frames;
+        createInfo.fixedTimeStep_ms = desc.dt_ms;
+        // gpu frame and pass times are read from the profiler
+        createInfo.profile = true;
+
+        AppBase app(createInfo);
+        // a replayed recording brings its own time step
+        desc.dt_ms = app.getCreateInfo().fixedTimeStep_ms;
+        try {
+            app.run<Benchmark>(options, desc);
+        } catch (std::exception const &e) {
+            // ctest skips the checks where no context can be created
+            if (app.getWindow() || !(options.ssaoCheck || options.depthPyramidCheck)) throw;
+            std::cout << e.what() << std::endl;
+            return 77;
+        }
+    } catch (std::exception const &e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+}
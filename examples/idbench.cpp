@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "idObject.h"
+#include "slotmap.h"
+
+/**
+ * id and lookup table microbenchmarks, no window or gl context
+ *
+ * usage: idbench [--objects N] [--lookups N] [--threads N]
+ *
+ *   alloc    HandleAllocator allocate + free from 1..N threads, checks that no live id is handed out twice and that
+ *            a freed id is not alive any more once its index is reused
+ *   lookup   ids of live objects looked up in the unordered_map<IdType, ...> the managers used and in a SlotMap, in
+ *            creation order and shuffled, plus a walk over every value, with 1k, 100k and --objects entries
+ */
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+// the timed lookups feed it so the compiler cannot drop them
+volatile uint64_t lookupSink;
+
+struct Object : IdObject<Object> {
+    uint64_t payload[4]{};
+};
+
+double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+bool runAlloc(uint32_t threadCount, uint32_t count) {
+    HandleAllocator allocator;
+    std::vector<std::vector<IdType>> ids(threadCount);
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            auto &&live = ids[t];
+            live.reserve(count / 2);
+            // keep half of them so freed indices get reused while other threads allocate
+            for (uint32_t i = 0; i < count; ++i) {
+                auto id = allocator.allocate();
+                if (i % 2)
+                    allocator.free(id);
+                else
+                    live.emplace_back(id);
+            }
+        });
+    }
+    for (auto &&e : threads) e.join();
+    auto ns = elapsed_ns(start);
+
+    std::vector<IdType> all;
+    for (auto &&e : ids) all.insert(all.end(), e.begin(), e.end());
+    std::sort(all.begin(), all.end());
+    bool unique = std::adjacent_find(all.begin(), all.end()) == all.end();
+    std::vector<uint32_t> indices;
+    for (auto e : all) indices.emplace_back(getHandleIndex(e));
+    std::sort(indices.begin(), indices.end());
+    unique = unique && std::adjacent_find(indices.begin(), indices.end()) == indices.end();
+    bool alive = std::all_of(all.begin(), all.end(), [&](IdType e) { return allocator.isAlive(e); });
+
+    // a freed handle must not come back to life when its index is reused
+    auto stale = all.front();
+    allocator.free(stale);
+    auto reused = allocator.allocate();
+    bool generations = getHandleIndex(reused) == getHandleIndex(stale) && !allocator.isAlive(stale) &&
+                       allocator.isAlive(reused) && reused != stale;
+
+    printf("alloc    %2u threads  %8u ids/thread  %7.1f ns/op  capacity %u for %u live\n", threadCount, count,
+           ns / (double(count) * threadCount), allocator.getCapacity(), allocator.getAliveCount());
+    bool ok = unique && alive && generations;
+    if (!ok) printf("alloc    FAILED  unique %d alive %d generations %d\n", unique, alive, generations);
+    return ok;
+}
+
+template <typename F>
+double bestOf(int runs, F &&f) {
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i) {
+        auto start = Clock::now();
+        f();
+        best = (std::min)(best, elapsed_ns(start));
+    }
+    return best;
+}
+
+bool runLookup(uint32_t objectCount, uint32_t lookupCount) {
+    // objects are created and destroyed in between like assets over a session, so the ids have gaps
+    std::vector<std::unique_ptr<Object>> objects, discarded;
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        objects.emplace_back(std::make_unique<Object>());
+        if (i % 4 == 0) discarded.emplace_back(std::make_unique<Object>());
+    }
+    discarded.clear();
+
+    std::unordered_map<IdType, Object *> map;
+    SlotMap<Object *> slotMap;
+    for (auto &&e : objects) {
+        map.emplace(e->getId(), e.get());
+        slotMap.emplace(e->getId(), e.get());
+    }
+
+    std::vector<IdType> sequential, shuffled;
+    for (uint32_t i = 0; i < lookupCount; ++i) sequential.emplace_back(objects[i % objectCount]->getId());
+    shuffled = sequential;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+
+    uint64_t sink = 0;
+    auto mapLookup = [&](std::vector<IdType> const &ids) {
+        for (auto id : ids) sink += map.find(id)->second->payload[0];
+    };
+    auto slotLookup = [&](std::vector<IdType> const &ids) {
+        for (auto id : ids) sink += (*slotMap.find(id))->payload[0];
+    };
+    auto mapSeq = bestOf(5, [&] { mapLookup(sequential); }) / lookupCount;
+    auto slotSeq = bestOf(5, [&] { slotLookup(sequential); }) / lookupCount;
+    auto mapRand = bestOf(5, [&] { mapLookup(shuffled); }) / lookupCount;
+    auto slotRand = bestOf(5, [&] { slotLookup(shuffled); }) / lookupCount;
+    auto mapWalk = bestOf(5, [&] {
+                       for (auto &&[id, p] : map) sink += p->payload[0];
+                   }) / objectCount;
+    auto slotWalk = bestOf(5, [&] {
+                        for (auto p : slotMap) sink += p->payload[0];
+                    }) / objectCount;
+
+    printf("lookup   %8u objects  in order %5.1f / %5.1f ns  shuffled %5.1f / %5.1f ns  walk %5.2f / %5.2f ns  "
+           "(unordered_map / SlotMap)\n",
+           objectCount, mapSeq, slotSeq, mapRand, slotRand, mapWalk, slotWalk);
+
+    lookupSink = sink;
+
+    // same answers, stale ids rejected
+    bool ok = true;
+    for (auto &&e : objects) ok = ok && *slotMap.find(e->getId()) == map.at(e->getId());
+    auto erased = objects.back()->getId();
+    slotMap.erase(erased);
+    objects.pop_back();
+    auto reused = std::make_unique<Object>();
+    ok = ok && !slotMap.contains(erased) && !slotMap.contains(reused->getId()) &&
+         getHandleIndex(reused->getId()) == getHandleIndex(erased) && slotMap.size() == objects.size();
+    for (auto &&e : objects) ok = ok && *slotMap.find(e->getId()) == e.get();
+    if (!ok) printf("lookup   FAILED\n");
+    return ok;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    uint32_t objectCount = 1000000;
+    uint32_t lookupCount = 1 << 22;
+    uint32_t maxThreads = (std::max)(std::thread::hardware_concurrency(), 2u);
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        auto value = (uint32_t)std::strtoul(argv[i + 1], nullptr, 10);
+        if (arg == "--objects")
+            objectCount = (std::max)(value, 1u);
+        else if (arg == "--lookups")
+            lookupCount = (std::max)(value, 1u);
+        else if (arg == "--threads")
+            maxThreads = (std::max)(value, 1u);
+    }
+
+    bool ok = true;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) ok = runAlloc(threads, 1 << 18) && ok;
+    for (uint32_t objects : {1000u, 100000u, objectCount}) ok = runLookup(objects, lookupCount) && ok;
+    printf("ids %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "input.h"
+
+/**
+ * input delivery microbenchmark, no window or gl context
+ *
+ * usage: inputbench [--frames N] [--moves N]
+ *
+ * replays a synthetic event stream through the Input callbacks the window uses, N mouse moves per frame (133 is a
+ * 8 kHz mouse at 60 Hz) with button presses, scrolls and key presses in between, to 1, 10, 100 and 1000 behaviours:
+ *   fanout   every behaviour is connected to the mouse button, move and scroll signals like Behaviour used to be,
+ *            one virtual call per event and behaviour
+ *   batched  the events are folded into Input::getFrame() while they arrive, every behaviour reads it once in
+ *            updatePerFrame
+ * reports ns per frame and virtual calls per frame, then checks that the batched frames add up to what the
+ * behaviours connected to the signals saw
+ */
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+struct BehaviourBase {
+    virtual ~BehaviourBase() = default;
+    virtual void updatePerFrame(float /*frameDtMs*/) {}
+};
+
+// totals over the whole replay, the same quantities from both paths
+struct Totals {
+    double cursorX{}, cursorY{};
+    double dx{}, dy{};
+    double scroll{};
+    uint32_t presses{};
+    uint32_t releases{};
+    bool cursorValid{};
+};
+
+struct FanoutBehaviour : BehaviourBase {
+    Totals totals;
+    uint64_t *calls;
+
+    explicit FanoutBehaviour(uint64_t *calls) : calls(calls) {
+        Input::mouseButtonSignal.Connect(&FanoutBehaviour::onMouseButton, this);
+        Input::mouseMoveSignal.Connect(&FanoutBehaviour::onMouseMove, this);
+        Input::scrollSignal.Connect(&FanoutBehaviour::onScroll, this);
+    }
+    ~FanoutBehaviour() {
+        Input::mouseButtonSignal.Disconnect(&FanoutBehaviour::onMouseButton, this);
+        Input::mouseMoveSignal.Disconnect(&FanoutBehaviour::onMouseMove, this);
+        Input::scrollSignal.Disconnect(&FanoutBehaviour::onScroll, this);
+    }
+    virtual void onMouseButton(KeyCode key, KeyState state) {
+        ++*calls;
+        if (key != INPUT_MOUSE_BUTTON_LEFT) return;
+        if (state == STATE_PRESS)
+            ++totals.presses;
+        else
+            ++totals.releases;
+    }
+    virtual void onMouseMove(double x, double y) {
+        ++*calls;
+        if (totals.cursorValid) {
+            totals.dx += x - totals.cursorX;
+            totals.dy += y - totals.cursorY;
+        }
+        totals.cursorX = x;
+        totals.cursorY = y;
+        totals.cursorValid = true;
+    }
+    virtual void onScroll(double, double y) {
+        ++*calls;
+        totals.scroll += y;
+    }
+};
+
+struct BatchedBehaviour : BehaviourBase {
+    Totals totals;
+
+    void updatePerFrame(float) override {
+        auto &&input = Input::getFrame();
+        totals.dx += input.cursorDelta.x;
+        totals.dy += input.cursorDelta.y;
+        totals.scroll += input.scroll.y;
+        totals.presses += input.wasPressed(INPUT_MOUSE_BUTTON_LEFT);
+        totals.releases += input.wasReleased(INPUT_MOUSE_BUTTON_LEFT);
+        totals.cursorX = input.cursor.x;
+        totals.cursorY = input.cursor.y;
+    }
+};
+
+// one frame of the synthetic stream, the same for every run
+void replayFrame(uint32_t frame, uint32_t moveCount) {
+    if (frame % 8 == 0) Input::onMouseButton(GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, 0);
+    if (frame % 16 == 0) Input::onKeyBoard(GLFW_KEY_W, GLFW_KEY_W, GLFW_PRESS, 0);
+    for (uint32_t i = 0; i < moveCount; ++i) {
+        auto t = double(frame * moveCount + i);
+        Input::onMouseMove(640 + 300 * std::sin(t * 0.001), 360 + 200 * std::cos(t * 0.0013));
+        if (i == moveCount / 2 && frame % 4 == 0) Input::onScroll(0, 1);
+    }
+    if (frame % 8 == 4) Input::onMouseButton(GLFW_MOUSE_BUTTON_LEFT, GLFW_RELEASE, 0);
+    if (frame % 16 == 8) Input::onKeyBoard(GLFW_KEY_W, GLFW_KEY_W, GLFW_RELEASE, 0);
+}
+
+bool near(double a, double b) { return std::abs(a - b) <= 1e-6 * (std::max)(1.0, std::abs(a)); }
+
+bool runBehaviours(uint32_t behaviourCount, uint32_t frameCount, uint32_t moveCount) {
+    uint64_t calls = 0;
+    std::vector<std::unique_ptr<BehaviourBase>> fanout, batched;
+    for (uint32_t i = 0; i < behaviourCount; ++i) fanout.emplace_back(std::make_unique<FanoutBehaviour>(&calls));
+
+    auto start = Clock::now();
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        replayFrame(frame, moveCount);
+        // the scene still ticks every behaviour
+        for (auto &&e : fanout) e->updatePerFrame(16.f);
+        calls += behaviourCount;
+    }
+    auto fanoutNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frameCount;
+    auto fanoutCalls = double(calls) / frameCount;
+    auto expected = static_cast<FanoutBehaviour &>(*fanout[0]).totals;
+    fanout.clear();
+
+    // the previous run left events behind, start from a clean frame
+    Input::nextFrame();
+    auto startX = Input::getFrame().cursor.x, startY = Input::getFrame().cursor.y;
+    for (uint32_t i = 0; i < behaviourCount; ++i) batched.emplace_back(std::make_unique<BatchedBehaviour>());
+    calls = 0;
+    uint32_t maxEvents = 0;
+    start = Clock::now();
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        replayFrame(frame, moveCount);
+        Input::nextFrame();
+        maxEvents = (std::max)(maxEvents, Input::getFrame().eventCount);
+        for (auto &&e : batched) e->updatePerFrame(16.f);
+        calls += behaviourCount;
+    }
+    auto batchedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frameCount;
+    auto batchedCalls = double(calls) / frameCount;
+    auto totals = static_cast<BatchedBehaviour &>(*batched[0]).totals;
+
+    printf("%5u behaviours  fanout %10.0f ns/frame %8.0f calls/frame   batched %9.0f ns/frame %6.0f calls/frame  "
+           "x%.1f\n",
+           behaviourCount, fanoutNs, fanoutCalls, batchedNs, batchedCalls, fanoutNs / batchedNs);
+
+    // the fanout behaviours saw the first position of the replay without a delta, the batched frames continue
+    // from wherever the cursor was before
+    auto firstX = 640.0, firstY = 360.0 + 200;
+    bool ok = near(totals.cursorX, expected.cursorX) && near(totals.cursorY, expected.cursorY) &&
+              near(totals.dx, expected.dx + firstX - startX) && near(totals.dy, expected.dy + firstY - startY) &&
+              totals.scroll == expected.scroll && totals.presses == expected.presses &&
+              totals.releases == expected.releases && maxEvents > moveCount;
+    // every raw event of the last frame is still in the ring
+    if (moveCount + 4 <= Input::EVENT_CAPACITY) {
+        uint32_t moves = 0;
+        for (uint32_t i = 0; i < Input::getFrame().eventCount; ++i)
+            moves += Input::getFrameEvent(i).type == InputEventType::MOUSE_MOVE;
+        ok = ok && moves == moveCount;
+    }
+    if (!ok)
+        printf("batched totals FAILED  dx %f/%f dy %f/%f scroll %f/%f presses %u/%u releases %u/%u\n", totals.dx,
+               expected.dx, totals.dy, expected.dy, totals.scroll, expected.scroll, totals.presses,
+               expected.presses, totals.releases, expected.releases);
+    return ok;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    uint32_t frameCount = 2000;
+    uint32_t moveCount = 133;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        auto value = (uint32_t)std::strtoul(argv[i + 1], nullptr, 10);
+        if (arg == "--frames")
+            frameCount = (std::max)(value, 1u);
+        else if (arg == "--moves")
+            moveCount = (std::max)(value, 1u);
+    }
+
+    bool ok = true;
+    for (uint32_t behaviourCount : {1u, 10u, 100u, 1000u})
+        ok = runBehaviours(behaviourCount, frameCount, moveCount) && ok;
+    printf("batched totals %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
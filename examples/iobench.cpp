@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <sys/resource.h>
+#endif
+
+#include "common.h"
+#include "config.h"
+#include "image.h"
+#include "stb_image.h"
+
+/**
+ * image loading benchmark, no window or gl context
+ *
+ * usage: iobench [--dir DIR] [--mode stdio|copy|mapped]
+ *
+ * decodes every image in DIR (the sponza texture set by default) one after the other, freeing each one before the
+ * next like the texture upload does:
+ *   stdio   stbi_load on the path, how ImageLoaderSTB read before
+ *   copy    readFile into a string, then stbi_load_from_memory
+ *   mapped  ImageLoaderSTB, decoding from a FileView
+ * without --mode every mode runs in its own process so the peak rss of one does not hide the others. reports wall
+ * time and peak rss per mode and fails if the decoded pixels differ
+ */
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+double peakRssMB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+uint64_t fnv1a(uint64_t hash, void const *data, size_t size) {
+    auto p = static_cast<unsigned char const *>(data);
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+std::vector<std::string> listImages(std::string const &dir) {
+    std::vector<std::string> ret;
+    std::error_code ec;
+    for (auto &&e : std::filesystem::directory_iterator(dir, ec))
+        if (e.is_regular_file()) ret.emplace_back(e.path().string());
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+// decode every image, 0 if one fails
+uint64_t runMode(std::string const &mode, std::vector<std::string> const &paths, size_t *decodedBytes) {
+    uint64_t hash = 14695981039346656037ull;
+    ImageLoaderSTB loader;
+    stbi_set_flip_vertically_on_load_thread(true);
+    for (auto &&path : paths) {
+        int w{}, h{}, n{};
+        stbi_uc *pixels{};
+        if (mode == "stdio") {
+            pixels = stbi_load(path.c_str(), &w, &h, &n, 4);
+        } else if (mode == "copy") {
+            auto bytes = readFile(path);
+            pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const *>(bytes.data()), int(bytes.size()), &w,
+                                           &h, &n, 4);
+        } else {
+            Image image(path, &loader);
+            image.load();
+            if (!image._loaded) return 0;
+            hash = fnv1a(hash, image._data, image._dataSize);
+            *decodedBytes += image._dataSize;
+            continue;
+        }
+        if (!pixels) return 0;
+        auto size = size_t(w) * h * 4;
+        hash = fnv1a(hash, pixels, size);
+        *decodedBytes += size;
+        stbi_image_free(pixels);
+    }
+    return hash;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string dir = ASSETS_DIR "/models/sponza/textures";
+    std::string mode;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--dir")
+            dir = argv[i + 1];
+        else if (arg == "--mode")
+            mode = argv[i + 1];
+    }
+    auto paths = listImages(dir);
+    if (paths.empty()) {
+        printf("no images in %s\n", dir.c_str());
+        return 77;
+    }
+
+    if (!mode.empty()) {
+        size_t decodedBytes = 0;
+        auto start = Clock::now();
+        auto hash = runMode(mode, paths, &decodedBytes);
+        auto ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        printf("%-7s %3zu images  %8.1f MB decoded  %8.1f ms  peak rss %7.1f MB  checksum %016llx\n", mode.c_str(),
+               paths.size(), decodedBytes / (1024.0 * 1024.0), ms, peakRssMB(), (unsigned long long)hash);
+        return hash ? 0 : 1;
+    }
+
+    bool ok = true;
+    unsigned long long expected = 0;
+    for (char const *e : {"stdio", "copy", "mapped"}) {
+        auto cmd = "\"" + std::string(argv[0]) + "\" --dir \"" + dir + "\" --mode " + e;
+        auto pipe = popen(cmd.c_str(), "r");
+        char line[256]{};
+        bool read = pipe && fgets(line, sizeof(line), pipe);
+        int status = pipe ? pclose(pipe) : -1;
+        printf("%s", read ? line : "");
+        unsigned long long hash = 0;
+        auto found = read ? strstr(line, "checksum ") : nullptr;
+        if (found) sscanf(found, "checksum %llx", &hash);
+        if (!expected) expected = hash;
+        if (status != 0 || !hash || hash != expected) {
+            printf("%s FAILED\n", e);
+            ok = false;
+        }
+    }
+    printf("decoded pixels %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
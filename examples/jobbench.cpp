@@ -0,0 +1,146 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "commandbuffer.h"
+#include "jobsystem.h"
+
+/**
+ * job system microbenchmarks, no window or gl context
+ *
+ * usage: jobbench [--jobs N] [--elements N] [--draws N] [--threads N]
+ *
+ *   spawn    cost per run() + wait() of an empty job, 0 workers (spawn and pop on one thread) and all workers
+ *   steal    jobs spawned by the main thread that were taken by workers, and the time until the last one finished
+ *   scaling  parallelFor over a compute bound array for 1..N threads, best of 5, speedup against 1 thread
+ *   record   draws recorded into GL::CommandBuffer chunks like RenderServer does, 1..N threads, ms per 10k draws
+ *            (replay needs a gl context, the benchmark example reports it)
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void benchmarkSpawn(uint32_t workerCount, uint32_t jobCount) {
+    JobSystem jobSystem(workerCount);
+    JobCounter counter;
+    // batches stay below the deque capacity so every job goes through the deque
+    const uint32_t batch = WorkStealingDeque::CAPACITY / 2;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < jobCount; i += batch) {
+        for (uint32_t j = i; j < (std::min)(i + batch, jobCount); ++j) jobSystem.run([] {}, &counter);
+        jobSystem.wait(counter);
+    }
+    auto ms = elapsed_ms(start);
+    printf("spawn    %2u workers  %8u jobs  %8.1f ns/job\n", workerCount, jobCount, ms * 1e6 / jobCount);
+}
+
+static void benchmarkSteal(uint32_t workerCount, uint32_t jobCount) {
+    if (workerCount == 0) return;
+    JobSystem jobSystem(workerCount);
+    std::atomic<uint32_t> stolen{0};
+    JobCounter counter;
+    const uint32_t batch = WorkStealingDeque::CAPACITY / 2;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < jobCount; i += batch) {
+        for (uint32_t j = i; j < (std::min)(i + batch, jobCount); ++j)
+            jobSystem.run(
+                [&] {
+                    if (!jobSystem.isMainThread()) stolen.fetch_add(1, std::memory_order_relaxed);
+                },
+                &counter);
+        jobSystem.wait(counter);
+    }
+    auto ms = elapsed_ms(start);
+    printf("steal    %2u workers  %8u jobs  %8.1f ns/job  %5.1f%% stolen\n", workerCount, jobCount,
+           ms * 1e6 / jobCount, 100.0 * stolen.load() / jobCount);
+}
+
+static double runScaling(uint32_t threadCount, std::vector<float> &data) {
+    JobSystem jobSystem(threadCount - 1);
+    double best = 1e30;
+    for (int i = 0; i < 5; ++i) {
+        auto start = Clock::now();
+        jobSystem.parallelFor((uint32_t)data.size(), [&](uint32_t begin, uint32_t end) {
+            for (auto k = begin; k < end; ++k) {
+                float x = data[k];
+                for (int n = 0; n < 16; ++n) x = std::sqrt(x * x + 1.f) * 0.5f;
+                data[k] = x;
+            }
+        });
+        best = (std::min)(best, elapsed_ms(start));
+    }
+    return best;
+}
+
+static double runRecord(uint32_t threadCount, uint32_t drawCount,
+                        std::vector<std::unique_ptr<GL::CommandBuffer>> &commandBuffers) {
+    JobSystem jobSystem(threadCount - 1);
+    auto grainSize = (std::max)((drawCount + threadCount - 1) / threadCount, 32u);
+    auto chunkCount = (drawCount + grainSize - 1) / grainSize;
+    while (commandBuffers.size() < chunkCount) commandBuffers.emplace_back(std::make_unique<GL::CommandBuffer>());
+    double best = 1e30;
+    for (int i = 0; i < 5; ++i) {
+        auto start = Clock::now();
+        jobSystem.parallelFor(drawCount, grainSize, [&](uint32_t begin, uint32_t end) {
+            auto &&cmd = *commandBuffers[begin / grainSize];
+            cmd.reset();
+            for (auto k = begin; k < end; ++k) {
+                // what MeshRenderer records for one primitive with a blinn phong material
+                cmd.bindPipeline(1, 1);
+                cmd.bindBufferRange(GL_UNIFORM_BUFFER, 3, 1, k % 256 * 256, 32);
+                cmd.bindBufferRange(GL_UNIFORM_BUFFER, 0, k, 0, 64);
+                for (uint32_t binding = 0; binding < 4; ++binding) cmd.bindVertexBuffer(binding, k, 0, 12);
+                cmd.bindIndexBuffer(k);
+                cmd.drawIndexed(GL::PrimitiveTopology::TRIANGLE_LIST, GL::DATA_TYPE_UNSIGNED_INT, {36, 1, 0, 0, 0});
+            }
+        });
+        best = (std::min)(best, elapsed_ms(start));
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    uint32_t jobCount = 1 << 20;
+    uint32_t elementCount = 1 << 22;
+    uint32_t drawCount = 100000;
+    uint32_t maxThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        auto value = (uint32_t)std::strtoul(argv[i + 1], nullptr, 10);
+        if (arg == "--jobs")
+            jobCount = value;
+        else if (arg == "--elements")
+            elementCount = value;
+        else if (arg == "--draws")
+            drawCount = value;
+        else if (arg == "--threads")
+            maxThreads = (std::max)(value, 1u);
+    }
+
+    benchmarkSpawn(0, jobCount);
+    benchmarkSpawn(maxThreads - 1, jobCount);
+    benchmarkSteal(maxThreads - 1, jobCount);
+
+    std::vector<float> data(elementCount, 1.f);
+    double base = 0;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+        auto ms = runScaling(threads, data);
+        if (threads == 1) base = ms;
+        printf("scaling  %2u threads  %8.2f ms  x%.2f\n", threads, ms, base / ms);
+    }
+
+    std::vector<std::unique_ptr<GL::CommandBuffer>> commandBuffers;
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+        auto ms = runRecord(threads, drawCount, commandBuffers);
+        if (threads == 1) base = ms;
+        printf("record   %2u threads  %8u draws  %8.3f ms/10k draws  x%.2f\n", threads, drawCount,
+               ms * 1e4 / drawCount, base / ms);
+    }
+    return 0;
+}
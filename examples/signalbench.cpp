@@ -0,0 +1,344 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "concurrentsignal.h"
+#include "eventqueue.h"
+#include "signal.h"
+
+/**
+ * Signal emission microbenchmark, no window or gl context
+ *
+ * usage: signalbench [--emits N] [--threads N] [--stress seconds]
+ *
+ * emits a Signal<void(double, double)> (the shape of Input::mouseMoveSignal) with 1, 10 and 1000 member function
+ * slots connected, against the emission path Signal had before (reproduced below) and ConcurrentSignal, reports ns
+ * per emit and heap allocations per emit.
+ * concurrent: emits per second of a ConcurrentSignal with 10 slots from 1..N emitter threads while another thread
+ * keeps connecting and disconnecting.
+ * delivery: QUEUED and COALESCED connections through an EventQueue. checks that events of every producer thread
+ * arrive in emission order, that a queue smaller than the burst applies back pressure instead of dropping, that
+ * coalesced emissions deliver only the latest value per dispatch and that disconnected slots get nothing, for
+ * Signal and ConcurrentSignal, then
+ * reports post + dispatch cost per event.
+ * --stress: emitters and connectors race for the given time, every connector frees the object of its slot right
+ * after Disconnect + synchronize, so a slot called too late reads freed memory (build with -fsanitize=thread or
+ * address to catch it) or a cleared marker (counted without sanitizers)
+ */
+
+static std::atomic<uint64_t> allocationCount{0};
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace legacy {
+// what an emission of the old Signal did: clear expired connections by repeated find_if over a multiset, copy the
+// arguments into a shared tuple, copy the slot shared_ptr and lock the tracked objects per call, go through a
+// std::function wrapping a lambda wrapping the member function
+struct Slot {
+    std::vector<std::weak_ptr<void>> trackedObjects;
+    std::function<void(double, double)> function;
+
+    bool expired() const {
+        for (auto &&e : trackedObjects)
+            if (e.expired()) return true;
+        return false;
+    }
+    std::vector<std::shared_ptr<void>> lock() const {
+        std::vector<std::shared_ptr<void>> ret;
+        for (auto &&e : trackedObjects) ret.emplace_back(e.lock());
+        return ret;
+    }
+    void operator()(double x, double y) const {
+        lock();
+        if (function) function(x, y);
+    }
+};
+struct ConnectionBody {
+    int group{};
+    std::shared_ptr<Slot> slot;
+    std::shared_ptr<Slot> GetSlot() const { return slot; }
+};
+struct Compare {
+    bool operator()(std::shared_ptr<ConnectionBody> const &lhs, std::shared_ptr<ConnectionBody> const &rhs) const {
+        return lhs->group < rhs->group;
+    }
+};
+class Signal {
+    mutable std::multiset<std::shared_ptr<ConnectionBody>, Compare> _connections;
+
+public:
+    template <typename Function, typename T>
+    void Connect(Function f, T *owner) {
+        auto slot = std::make_shared<Slot>();
+        slot->function = [f, owner](double x, double y) { std::invoke(f, owner, x, y); };
+        _connections.emplace(std::make_shared<ConnectionBody>(ConnectionBody{0, slot}));
+    }
+    template <typename... Args>
+    void operator()(Args &&...args) const {
+        while (true) {
+            auto it = std::find_if(_connections.begin(), _connections.end(), [](auto &&e) {
+                auto a = e->GetSlot();
+                return !a || a->expired();
+            });
+            if (it == _connections.end()) break;
+            _connections.erase(it);
+        }
+        auto a = std::make_shared<std::tuple<Args...>>(args...);
+        for (auto &&e : _connections) std::apply([&](auto &&...v) { (*e->GetSlot())(v...); }, *a);
+    }
+};
+}  // namespace legacy
+
+struct Receiver {
+    double sum{};
+    void onMouseMove(double x, double y) { sum += x - y; }
+};
+// called from several emitters at once
+struct SharedReceiver {
+    std::atomic<uint64_t> calls{0};
+    void onMouseMove(double, double) { calls.fetch_add(1, std::memory_order_relaxed); }
+};
+
+using Clock = std::chrono::steady_clock;
+
+template <typename SignalType>
+static void run(char const *name, uint32_t slotCount, uint32_t emitCount) {
+    std::vector<Receiver> receivers(slotCount);
+    SignalType signal;
+    for (auto &&e : receivers) signal.Connect(&Receiver::onMouseMove, &e);
+    // fewer emits for many slots, the total slot calls stay comparable
+    auto emits = (std::max)(emitCount / slotCount, 1000u);
+    signal(0.0, 0.0);
+
+    auto allocations = allocationCount.load();
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < emits; ++i) signal(double(i), 1.0);
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    allocations = allocationCount.load() - allocations;
+
+    double checksum{};
+    for (auto &&e : receivers) checksum += e.sum;
+    printf("%-6s %5u slots  %10.1f ns/emit  %7.2f ns/slot call  %6.2f allocs/emit  (checksum %g)\n", name, slotCount,
+           ns / emits, ns / (double(emits) * slotCount), double(allocations) / emits, checksum);
+}
+
+static void runConcurrent(uint32_t emitterCount, uint32_t emitCount) {
+    ConcurrentSignal<void(double, double)> signal;
+    std::vector<SharedReceiver> receivers(10);
+    for (auto &&e : receivers) signal.Connect(&SharedReceiver::onMouseMove, &e);
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> churn{0};
+    std::thread connector([&] {
+        std::atomic<uint64_t> calls{0};
+        while (running.load(std::memory_order_relaxed)) {
+            auto id = signal.Connect([&calls](double, double) { calls.fetch_add(1, std::memory_order_relaxed); });
+            signal.Disconnect(id);
+            churn.fetch_add(1, std::memory_order_relaxed);
+        }
+        signal.synchronize();
+    });
+
+    auto start = Clock::now();
+    std::vector<std::thread> emitters;
+    for (uint32_t t = 0; t < emitterCount; ++t)
+        emitters.emplace_back([&, t] {
+            for (uint32_t i = 0; i < emitCount; ++i) signal(double(i), double(t));
+        });
+    for (auto &&e : emitters) e.join();
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    running.store(false);
+    connector.join();
+    printf("concurrent  %2u emitters  %8.2f M emits/s  %8.1f ns/emit per thread  %8llu connect+disconnect\n",
+           emitterCount, emitterCount * emitCount / seconds * 1e-6, seconds * 1e9 / emitCount,
+           (unsigned long long)churn.load());
+}
+
+// object of a stress slot, freed right after its slot is disconnected and the signal synchronized
+struct StressTarget {
+    static constexpr uint32_t ALIVE = 0x600dcafe;
+    std::atomic<uint32_t> marker{ALIVE};
+    std::atomic<uint64_t> calls{0};
+};
+
+static int runStress(uint32_t threadCount, double seconds) {
+    ConcurrentSignal<void(uint32_t)> signal;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> emits{0}, lateCalls{0}, connections{0};
+
+    auto emitter = [&] {
+        uint64_t n = 0;
+        while (running.load(std::memory_order_relaxed)) signal(uint32_t(n++));
+        emits.fetch_add(n);
+    };
+    auto connector = [&] {
+        while (running.load(std::memory_order_relaxed)) {
+            auto target = std::make_unique<StressTarget>();
+            auto p = target.get();
+            auto id = signal.Connect([p, &lateCalls](uint32_t) {
+                if (p->marker.load(std::memory_order_relaxed) != StressTarget::ALIVE) lateCalls.fetch_add(1);
+                p->calls.fetch_add(1, std::memory_order_relaxed);
+            });
+            std::this_thread::yield();
+            signal.Disconnect(id);
+            signal.synchronize();
+            target->marker.store(0);
+            connections.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> threads;
+    auto half = (std::max)(threadCount / 2, 1u);
+    for (uint32_t i = 0; i < half; ++i) threads.emplace_back(emitter);
+    for (uint32_t i = 0; i < half; ++i) threads.emplace_back(connector);
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running.store(false);
+    for (auto &&e : threads) e.join();
+    printf("stress  %u emitters  %u connectors  %llu emits  %llu connections  %llu late calls  %zu left\n", half, half,
+           (unsigned long long)emits.load(), (unsigned long long)connections.load(),
+           (unsigned long long)lateCalls.load(), signal.ConnectionNum());
+    return lateCalls.load() == 0 && signal.Empty() ? 0 : 1;
+}
+
+static bool check(bool condition, char const *what) {
+    printf("delivery  %-58s %s\n", what, condition ? "ok" : "FAILED");
+    return condition;
+}
+
+static bool runDelivery(uint32_t producerCount, uint32_t eventCount) {
+    bool ok = true;
+    {
+        // every producer emits its own signal, all of them deliver into one small queue
+        EventQueue queue(256);
+        std::vector<uint32_t> next(producerCount, 0);
+        bool ordered = true;
+        std::vector<std::unique_ptr<Signal<void(uint32_t, uint32_t)>>> signals;
+        for (uint32_t p = 0; p < producerCount; ++p) {
+            auto &&signal = signals.emplace_back(std::make_unique<Signal<void(uint32_t, uint32_t)>>());
+            signal->Connect(
+                [&](uint32_t producer, uint32_t value) {
+                    ordered &= value == next[producer];
+                    next[producer] = value + 1;
+                },
+                DeliveryPolicy::QUEUED, queue);
+        }
+        std::atomic<uint32_t> finished{0};
+        std::vector<std::thread> producers;
+        for (uint32_t p = 0; p < producerCount; ++p)
+            producers.emplace_back([&, p] {
+                for (uint32_t i = 0; i < eventCount; ++i) (*signals[p])(p, i);
+                finished.fetch_add(1);
+            });
+        // the consumer keeps dispatching until every producer is done and the queue is drained
+        while (finished.load() < producerCount) queue.dispatch();
+        queue.dispatch();
+        for (auto &&e : producers) e.join();
+        ok &= check(ordered, "queued events keep the order of each producer");
+        ok &= check(std::all_of(next.begin(), next.end(), [&](auto e) { return e == eventCount; }),
+                    "bounded queue applies back pressure, nothing dropped");
+    }
+    {
+        EventQueue queue(16);
+        Signal<void(uint32_t)> signal;
+        uint32_t received = 0;
+        signal.Connect([&](uint32_t) { ++received; }, DeliveryPolicy::QUEUED, queue);
+        // more than the capacity from the consumer thread itself, posting dispatches to make room
+        for (uint32_t i = 0; i < 100; ++i) signal(i);
+        queue.dispatch();
+        ok &= check(received == 100, "consumer posting into its full queue dispatches inline");
+    }
+    {
+        EventQueue queue;
+        Signal<void(int, int)> signal;
+        std::vector<std::pair<int, int>> received;
+        signal.Connect([&](int w, int h) { received.emplace_back(w, h); }, DeliveryPolicy::COALESCED, queue);
+        for (int i = 1; i <= 1000; ++i) signal(i, 2 * i);
+        queue.dispatch();
+        ok &= check(received.size() == 1 && received[0] == std::make_pair(1000, 2000),
+                    "coalesced emissions deliver the latest value once");
+        signal(1, 1);
+        signal(2, 2);
+        queue.dispatch();
+        ok &= check(received.size() == 2 && received[1] == std::make_pair(2, 2), "coalescing starts over per dispatch");
+    }
+    {
+        EventQueue queue;
+        Signal<void(int)> signal;
+        int queuedCalls = 0, coalescedCalls = 0;
+        auto queued = signal.Connect([&](int) { ++queuedCalls; }, DeliveryPolicy::QUEUED, queue);
+        auto coalesced = signal.Connect([&](int) { ++coalescedCalls; }, DeliveryPolicy::COALESCED, queue);
+        signal(1);
+        queued.Disconnect();
+        coalesced.Disconnect();
+        queue.dispatch();
+        ok &= check(queuedCalls == 0 && coalescedCalls == 0, "slots disconnected before dispatch are not called");
+    }
+    {
+        // the Input signals: emitted on one thread, a COALESCED slot connected from another
+        EventQueue queue;
+        ConcurrentSignal<void(int, int)> signal;
+        std::vector<std::pair<int, int>> received;
+        std::thread([&] {
+            signal.Connect([&](int w, int h) { received.emplace_back(w, h); }, DeliveryPolicy::COALESCED, queue);
+        }).join();
+        for (int i = 1; i <= 1000; ++i) signal(i, 2 * i);
+        queue.dispatch();
+        ok &= check(received.size() == 1 && received[0] == std::make_pair(1000, 2000),
+                    "concurrent signal coalesces like Signal");
+        auto id = signal.Connect([&](int w, int h) { received.emplace_back(w, h); }, DeliveryPolicy::QUEUED, queue);
+        signal(3, 3);
+        signal.Disconnect(id);
+        signal.DisconnectAllConnections();
+        queue.dispatch();
+        ok &= check(received.size() == 1, "concurrent signal drops events of removed connections");
+    }
+    {
+        EventQueue queue(1 << 16);
+        Signal<void(double, double)> signal;
+        Receiver receiver;
+        signal.Connect(&Receiver::onMouseMove, &receiver, DeliveryPolicy::QUEUED, queue);
+        auto allocations = allocationCount.load();
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < eventCount; ++i) {
+            signal(double(i), 1.0);
+            if ((i & 0xfff) == 0xfff) queue.dispatch();
+        }
+        queue.dispatch();
+        auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        printf("delivery  queued post + dispatch  %8.1f ns/event  %6.2f allocs/event\n", ns / eventCount,
+               double(allocationCount.load() - allocations) / eventCount);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint32_t emitCount = 1000000;
+    uint32_t maxThreads = (std::max)(std::thread::hardware_concurrency(), 2u);
+    double stressSeconds = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--emits")
+            emitCount = (uint32_t)std::strtoul(argv[i + 1], nullptr, 10);
+        else if (arg == "--threads")
+            maxThreads = (std::max)((uint32_t)std::strtoul(argv[i + 1], nullptr, 10), 1u);
+        else if (arg == "--stress")
+            stressSeconds = std::strtod(argv[i + 1], nullptr);
+    }
+    if (stressSeconds > 0) return runStress(maxThreads, stressSeconds);
+
+    for (uint32_t slotCount : {1u, 10u, 1000u}) {
+        run<legacy::Signal>("old", slotCount, emitCount);
+        run<Signal<void(double, double)>>("new", slotCount, emitCount);
+        run<ConcurrentSignal<void(double, double)>>("conc", slotCount, emitCount);
+    }
+    for (uint32_t threads = 1; threads <= maxThreads; ++threads) runConcurrent(threads, emitCount / 10);
+    return runDelivery(maxThreads, emitCount / 10) ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "appbase.h"
+#include "profiler.h"
 
 const char *testModelPath = ASSETS_DIR "/models/viking_room/viking_room.obj";
 //const char* testModelPath = ASSETS_DIR "/models/sponza/sponza.obj";
@@ -20,7 +21,7 @@ public:
 
         auto model = ModelManager::getSingleton().createModel(testModelPath);
         model->load();
-        auto node = scene->addModel(model);
+        auto node = scene->addModel(model.get());
         node->getComponent<Transform>()->yaw(glm::radians(-90.f))->pitch(glm::radians(-90.f));
 
         scene->prepare();
@@ -76,10 +77,44 @@ public:
         flag |= ImGui::InputInt("sampleDirections", &aoParam.sampleDirections);
         flag |= ImGui::SliderFloat("maxRadius0", &aoParam.maxRadius0, 0, aoParam.maxRadius1);
         flag |= ImGui::SliderFloat("maxRadius1", &aoParam.maxRadius1, aoParam.maxRadius0, 100);
+        {
+            if (ImGui::BeginCombo("ao resolution",
+                                  getSSAOResolutionName(static_cast<SSAOResolution>(aoParam.resolution)))) {
+                for (int i = 0; i < SSAO_RESOLUTION_Num; ++i) {
+                    const bool is_selected = (aoParam.resolution == i);
+                    if (ImGui::Selectable(getSSAOResolutionName(static_cast<SSAOResolution>(i)), is_selected)) {
+                        aoParam.resolution = i;
+                        flag = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+        }
+        bool temporal = aoParam.temporal;
+        if (ImGui::Checkbox("temporal", &temporal)) {
+            aoParam.temporal = temporal;
+            flag = true;
+        }
+        flag |= ImGui::SliderFloat("historyWeight", &aoParam.historyWeight, 0, 0.98f);
+        ImGui::Text("samples/pixel %.2f", PostProcessSSAO::getSingleton().getSamplesPerPixel());
+        ImGui::Checkbox("depth pyramid", &RenderServer::getSingleton().buildDepthPyramid);
+
+        // tune the ao parameters against their measured cost
+        if (ImGui::CollapsingHeader("gpu passes (ms)", ImGuiTreeNodeFlags_DefaultOpen)) {
+            auto &&renderServer = RenderServer::getSingleton();
+            if (!Profiler::isEnabled()) ImGui::TextDisabled("timed by the profiler, enable it in its window");
+            for (int i = 0; i < GPU_PASS_NUM; ++i) {
+                auto pass = static_cast<GpuPass>(i);
+                ImGui::Text("%-14s %6.3f (avg %6.3f)", getGpuPassName(pass), renderServer.getGpuPassMs(pass),
+                            renderServer.getGpuPassMsAverage(pass));
+            }
+        }
 
         ImGui::End();
 
         if (flag) PostProcessSSAO::getSingleton().updateAOParams();
+
+        Profiler::getSingleton().drawPanel();
     }
 
     void init() override {
@@ -87,16 +122,22 @@ public:
         configScene0();
     }
 
+    void tick(float dt) override { scene->update(dt); }
+
+    void buildSnapshot(RenderSnapshot &snapshot, float alpha) override {
+        scene->interpolate(alpha);
+        scene->buildSnapshot(snapshot);
+    }
+
     void render(float dt) override {
-        scene->update(dt);
-        RenderServer::getSingleton().renderScene(scene.get());
+        RenderServer::getSingleton().renderSnapshot(scene.get(), *getParent()->getRenderSnapshot());
         gui->render(dt);
     }
 };
 
 int main(int argc, const char **argv) {
     try {
-        AppBase app;
+        AppBase app(parseCommandLine(argc, argv));
         app.run<Hello>();
 
     } catch (std::exception const &e) {
@@ -0,0 +1,199 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "filewatcher.h"
+#include "model.h"
+#include "technique.h"
+#include "testcontext.h"
+
+/**
+ * files are written to a scratch directory and changed while AssetReloader::update() runs once per "frame":
+ * a compute technique swaps its pipeline when its shader changes and keeps it when the new source does not compile,
+ * a model swaps the geometry of its meshes and queues the replaced buffers for release. models are shared by file,
+ * not by file name. loading a file must not
+ * look like a change, nothing reloads while the files stay untouched. a file is no longer reported once its last
+ * callback is removed
+ */
+
+namespace {
+namespace fs = std::filesystem;
+
+constexpr auto FRAME_TIME = std::chrono::milliseconds(5);
+constexpr int MAX_FRAMES = 400;
+
+void writeFile(fs::path const &path, std::string const &content) { std::ofstream(path) << content; }
+
+// run frames until done() or MAX_FRAMES
+bool runFrames(std::function<bool()> done) {
+    for (int i = 0; i < MAX_FRAMES; ++i) {
+        AssetReloader::getSingleton().update();
+        if (done()) return true;
+        std::this_thread::sleep_for(FRAME_TIME);
+    }
+    return false;
+}
+
+// no reload for a while
+bool settles() {
+    auto count = AssetReloader::getSingleton().getReloadCount();
+    runFrames([] { return false; });
+    return AssetReloader::getSingleton().getReloadCount() == count;
+}
+
+std::string computeShader(int value) {
+    return "#version 450\nlayout(local_size_x = 1) in;\nlayout(std430, binding = 0) buffer Out { int v; };\n"
+           "void main() { v = " +
+           std::to_string(value) + "; }\n";
+}
+
+int testShader(fs::path const &dir) {
+    auto file = dir / "reload.comp";
+    writeFile(file, computeShader(1));
+    TechniqueDepthPyramid::compFile = fs::relative(file, SHADER_DIR).generic_string();
+    TechniqueDepthPyramid technique;
+    CHECK(technique.pipeline.pipeline != 0);
+    CHECK(settles());
+
+    auto reloads = AssetReloader::getSingleton().getReloadCount();
+    auto pipeline = technique.pipeline.pipeline;
+    auto program = technique.pipeline.programs;
+    writeFile(file, computeShader(2));
+    CHECK(runFrames([&] { return AssetReloader::getSingleton().getReloadCount() > reloads; }));
+    CHECK(technique.pipeline.pipeline != pipeline);
+    CHECK(technique.pipeline.programs != program);
+    CHECK(settles());
+
+    // a broken shader keeps what works
+    reloads = AssetReloader::getSingleton().getReloadCount();
+    pipeline = technique.pipeline.pipeline;
+    writeFile(file, "#version 450\nnot glsl\n");
+    CHECK(runFrames([&] { return AssetReloader::getSingleton().getReloadCount() > reloads; }));
+    CHECK(technique.pipeline.pipeline == pipeline);
+    return 0;
+}
+
+std::string objFile(float x) {
+    return "mtllib reload.mtl\nv 0 0 0\nv " + std::to_string(x) +
+           " 0 0\nv 0 1 0\nvn 0 0 1\nvt 0 0\nusemtl m\nf 1/1/1 2/1/1 3/1/1\n";
+}
+
+int testModel(fs::path const &dir) {
+    auto file = dir / "reload.obj";
+    writeFile(dir / "reload.mtl", "newmtl m\nKd 1 1 1\n");
+    writeFile(file, objFile(1));
+    // same file name, another file
+    fs::create_directories(dir / "other");
+    writeFile(dir / "other" / "reload.mtl", "newmtl m\nKd 1 1 1\n");
+    writeFile(dir / "other" / "reload.obj", objFile(3));
+    auto model = ModelManager::getSingleton().createModel(file.string());
+    CHECK(model->isLoaded());
+    CHECK(ModelManager::getSingleton().createModel((dir / "other" / ".." / "reload.obj").string()) == model);
+    {
+        auto other = ModelManager::getSingleton().createModel((dir / "other" / "reload.obj").string());
+        CHECK(other != model);
+        CHECK(other->meshes[0]->primitives[0]->positions[1].x == 3.f);
+    }
+    ModelManager::getSingleton().collectGarbage();
+    CHECK(settles());
+
+    auto &resources = ResourceManager::getSingleton();
+    resources.flush();
+    auto gpuBytes = resources.getStats().types[RESOURCE_MODEL].gpuBytes;
+    auto mesh = model->meshes[0];
+    auto primitive = mesh->primitives[0].get();
+    auto primitiveBytes = primitive->getDataSize();
+    CHECK(gpuBytes == primitiveBytes);
+
+    auto reloads = AssetReloader::getSingleton().getReloadCount();
+    writeFile(file, objFile(2));
+    CHECK(runFrames([&] { return AssetReloader::getSingleton().getReloadCount() > reloads; }));
+    // same mesh object, new geometry
+    CHECK(model->meshes[0] == mesh);
+    CHECK(mesh->primitives[0].get() != primitive);
+    CHECK(mesh->primitives[0]->positions.size() == 3);
+    CHECK(mesh->primitives[0]->positions[1].x == 2.f);
+    CHECK(settles());
+
+    // the replaced buffers wait for the frames in flight and are then freed, nothing accumulates
+    CHECK(resources.getStats().pendingReleaseBytes == primitiveBytes);
+    resources.flush();
+    auto stats = resources.getStats();
+    CHECK(stats.pendingReleaseBytes == 0);
+    CHECK(stats.types[RESOURCE_MODEL].gpuBytes == gpuBytes);
+    return 0;
+}
+
+// what the poll of a FileWatcher reports within MAX_FRAMES
+std::vector<std::string> pollFrames(FileWatcher &watcher) {
+    std::vector<std::string> ret;
+    for (int i = 0; i < MAX_FRAMES && ret.empty(); ++i) {
+        ret = watcher.poll();
+        std::this_thread::sleep_for(FRAME_TIME);
+    }
+    return ret;
+}
+
+int testUnwatch(fs::path const &dir) {
+    auto first = dir / "first.txt", second = dir / "second.txt";
+    writeFile(first, "0");
+    writeFile(second, "0");
+    {
+        // the directory stays watched while a file in it is
+        FileWatcher watcher;
+        watcher.watch(first.string());
+        watcher.watch(second.string());
+        watcher.unwatch(first.string());
+        writeFile(first, "1");
+        writeFile(second, "1");
+        auto changed = pollFrames(watcher);
+        CHECK(changed.size() == 1 && changed[0] == FileWatcher::normalize(second.string()));
+        watcher.unwatch(second.string());
+        writeFile(second, "2");
+        CHECK(pollFrames(watcher).empty());
+    }
+
+    // a callback removed by an earlier one of the same batch does not run
+    auto &reloader = AssetReloader::getSingleton();
+    uint64_t removed{};
+    int removedRuns{};
+    auto remover = reloader.watch(first.string(), [&] { reloader.unwatch(removed); });
+    removed = reloader.watch(first.string(), [&] { ++removedRuns; });
+    CHECK(settles());
+    auto reloads = reloader.getReloadCount();
+    writeFile(first, "3");
+    CHECK(runFrames([&] { return reloader.getReloadCount() > reloads; }));
+    CHECK(removedRuns == 0);
+
+    // nothing is reported once the last callback of the file is gone
+    reloader.unwatch(remover);
+    writeFile(first, "4");
+    CHECK(settles());
+    return 0;
+}
+
+int run() {
+    auto dir = fs::current_path() / "assetreload";
+    fs::remove_all(dir);
+    // one directory each, the directory watch of one would see the files of the other being written
+    fs::create_directories(dir / "shader");
+    fs::create_directories(dir / "model");
+    fs::create_directories(dir / "unwatch");
+    int ret = testShader(dir / "shader");
+    if (!ret) ret = testModel(dir / "model");
+    if (!ret) ret = testUnwatch(dir / "unwatch");
+    return ret;
+}
+}  // namespace
+
+int main() {
+    auto app = createTestApp();
+    if (!app) return TEST_SKIPPED;
+    return run();
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "depthpyramid.h"
+#include "testcontext.h"
+
+/**
+ * DepthPyramid::buildReference without a gl context, the pyramid the benchmark checks the gpu one against: level 0
+ * has half the frame size rounded up to a power of two and each level halves it down to 1x1, every texel holds the
+ * min and max of the frame pixels it covers (pixels past the frame repeat the edge), and the depth range of any
+ * rectangle is conservative at every level
+ */
+
+namespace {
+// random depths with a few flat areas, like a depth buffer with a cleared background
+std::vector<float> makeDepth(glm::uvec2 size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> value(0.f, 1.f);
+    std::vector<float> ret(size_t(size.x) * size.y);
+    for (uint32_t y = 0; y < size.y; ++y)
+        for (uint32_t x = 0; x < size.x; ++x) ret[size_t(y) * size.x + x] = x < size.x / 3 ? 1.f : value(rng);
+    return ret;
+}
+
+// min and max of the frame pixels [begin, end), clamped to the frame like the pyramid
+glm::vec2 bruteForceRange(std::vector<float> const &depth, glm::uvec2 frameSize, glm::uvec2 begin, glm::uvec2 end) {
+    glm::vec2 ret{1, 0};
+    end = glm::min(end, frameSize);
+    begin = glm::min(begin, frameSize - 1u);
+    for (auto y = begin.y; y < std::max(end.y, begin.y + 1); ++y) {
+        for (auto x = begin.x; x < std::max(end.x, begin.x + 1); ++x) {
+            auto d = depth[size_t(y) * frameSize.x + x];
+            ret = {std::min(ret.x, d), std::max(ret.y, d)};
+        }
+    }
+    return ret;
+}
+
+int testFrame(glm::uvec2 frameSize, uint32_t seed) {
+    auto depth = makeDepth(frameSize, seed);
+    auto pyramid = DepthPyramid::buildReference(depth, frameSize);
+    CHECK(!pyramid.empty());
+
+    // level 0 is the smallest power of two covering the frame, the last level is 1x1
+    auto size = pyramid[0].size;
+    CHECK(std::has_single_bit(size.x) && std::has_single_bit(size.y));
+    CHECK(size.x * 2 >= frameSize.x && (size.x == 1 || size.x < frameSize.x));
+    CHECK(size.y * 2 >= frameSize.y && (size.y == 1 || size.y < frameSize.y));
+    for (uint32_t i = 0; i < pyramid.size(); ++i) {
+        CHECK(pyramid[i].level == i);
+        CHECK(pyramid[i].size == glm::max(size >> i, glm::uvec2(1)));
+        CHECK(pyramid[i].texels.size() == size_t(pyramid[i].size.x) * pyramid[i].size.y);
+    }
+    CHECK(pyramid.back().size == glm::uvec2(1));
+    auto total = bruteForceRange(depth, frameSize, {}, frameSize);
+    CHECK(pyramid.back().at(0, 0) == total);
+
+    // every texel is exactly the range of the pixels it covers
+    for (auto &&level : pyramid) {
+        auto texelPixels = 2u << level.level;
+        for (uint32_t y = 0; y < level.size.y; ++y) {
+            for (uint32_t x = 0; x < level.size.x; ++x) {
+                auto begin = glm::uvec2(x, y) * texelPixels;
+                CHECK(level.at(x, y) == bruteForceRange(depth, frameSize, begin, begin + texelPixels));
+            }
+        }
+    }
+
+    // rectangles: the range of every level contains the exact one, an object behind it is occluded, one in front
+    // of the nearest depth is not
+    std::mt19937 rng(seed + 1);
+    for (int i = 0; i < 200; ++i) {
+        glm::uvec2 a{rng() % frameSize.x, rng() % frameSize.y};
+        glm::uvec2 b{rng() % frameSize.x, rng() % frameSize.y};
+        auto pixelMin = glm::min(a, b), pixelMax = glm::max(a, b);
+        auto exact = bruteForceRange(depth, frameSize, pixelMin, pixelMax + 1u);
+        for (auto &&level : pyramid) {
+            auto range = level.getDepthRange(pixelMin, pixelMax);
+            CHECK(range.x <= exact.x && range.y >= exact.y);
+            CHECK(!level.isOccluded(pixelMin, pixelMax, exact.x));
+            CHECK(level.isOccluded(pixelMin, pixelMax, std::nextafter(range.y, 2.f)));
+        }
+    }
+    return 0;
+}
+}  // namespace
+
+int main() {
+    // power of two, odd, and wider than high by more than a level
+    for (auto size : {glm::uvec2(64, 64), glm::uvec2(37, 23), glm::uvec2(320, 240), glm::uvec2(1, 1),
+                      glm::uvec2(130, 3)}) {
+        if (auto ret = testFrame(size, size.x * 1000 + size.y)) {
+            printf("frame %ux%u\n", size.x, size.y);
+            return ret;
+        }
+    }
+    return 0;
+}
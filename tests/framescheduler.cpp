@@ -0,0 +1,138 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "framescheduler.h"
+#include "testcontext.h"
+
+/**
+ * FrameScheduler without a gl context: the tick sequence depends only on the frame times, the same total time gives
+ * the same simulation whatever the render rate, ticks beyond maxTicksPerFrame are counted as dropped, and a frame
+ * cap never lets a frame start before its deadline
+ */
+
+namespace {
+using namespace std::chrono_literals;
+using Duration = FrameScheduler::Duration;
+
+struct Run {
+    std::vector<uint32_t> ticks;
+    std::vector<float> alphas;
+    // a body under constant acceleration, integrated once per tick
+    double position{};
+    double velocity{};
+};
+
+Run simulate(FrameScheduler &scheduler, std::vector<Duration> const &frameTimes) {
+    Run ret;
+    auto dt = scheduler.getTickInterval_ms() * 1e-3;
+    for (auto &&e : frameTimes) {
+        auto ticks = scheduler.beginFrame(e);
+        for (uint32_t i = 0; i < ticks; ++i) {
+            ret.velocity += 9.81 * dt;
+            ret.position += ret.velocity * dt;
+        }
+        ret.ticks.emplace_back(ticks);
+        ret.alphas.emplace_back(scheduler.getAlpha());
+    }
+    return ret;
+}
+
+// jittered frame times around period
+std::vector<Duration> frameTimes(Duration period, uint32_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int64_t> jitter(-period.count() / 4, period.count() / 4);
+    std::vector<Duration> ret(count);
+    for (auto &&e : ret) e = period + Duration(jitter(rng));
+    return ret;
+}
+
+int testRepeatable() {
+    auto times = frameTimes(7ms, 2000, 1);
+    FrameScheduler a, b;
+    auto runA = simulate(a, times);
+    auto runB = simulate(b, times);
+    CHECK(runA.ticks == runB.ticks);
+    CHECK(runA.alphas == runB.alphas);
+    CHECK(runA.position == runB.position);
+    CHECK(a.getTickIndex() == b.getTickIndex());
+    return 0;
+}
+
+int testRenderRateIndependent() {
+    // one second rendered at 144, 60 and 24 fps, the frame times of each add up exactly
+    constexpr auto TOTAL = Duration(1s);
+    std::vector<std::vector<Duration>> rates;
+    for (auto fps : {144, 60, 24}) {
+        std::vector<Duration> times(fps, TOTAL / fps);
+        times.back() += TOTAL - times.front() * fps;
+        rates.emplace_back(times);
+    }
+    FrameScheduler reference;
+    auto expected = simulate(reference, rates.front());
+    // no drops at these rates, every whole tick of the second ran
+    CHECK(reference.getDroppedTicks() == 0);
+    CHECK(reference.getTickIndex() == uint64_t(TOTAL / (Duration(1s) / 60)));
+    for (auto &&e : rates) {
+        FrameScheduler scheduler;
+        auto run = simulate(scheduler, e);
+        CHECK(scheduler.getTickIndex() == reference.getTickIndex());
+        // the same ticks in the same order, bit for bit the same state
+        CHECK(run.position == expected.position);
+        CHECK(run.velocity == expected.velocity);
+        CHECK(run.alphas.back() == expected.alphas.back());
+    }
+    return 0;
+}
+
+int testDroppedTicks() {
+    FrameScheduler::Settings settings{};
+    settings.maxTicksPerFrame = 4;
+    FrameScheduler scheduler(settings);
+    auto interval = Duration(1s) / 60;
+    // a hitch of 10 ticks runs 4 and drops 6, the next frame is not made longer by it
+    CHECK(scheduler.beginFrame(interval * 10) == 4);
+    CHECK(scheduler.getDroppedTicks() == 6);
+    CHECK(scheduler.beginFrame(interval) == 1);
+    CHECK(scheduler.getTickIndex() == 5);
+    return 0;
+}
+
+int testFixedFrameTime() {
+    FrameScheduler::Settings settings{};
+    settings.tickRate_hz = 100;
+    settings.fixedFrameTime_ms = 25;
+    FrameScheduler scheduler(settings);
+    // the measured time is ignored, 25 ms are 2.5 ticks
+    for (uint32_t i = 0; i < 8; ++i) CHECK(scheduler.beginFrame() == (i % 2 ? 3u : 2u));
+    CHECK(scheduler.getTickIndex() == 20);
+    CHECK(scheduler.getAlpha() == 0.f);
+    return 0;
+}
+
+int testFrameCap() {
+    constexpr uint32_t FRAMES = 20;
+    FrameScheduler::Settings settings{};
+    settings.frameCap_fps = 200;
+    FrameScheduler scheduler(settings);
+    // the first frame starts the deadline grid, each later one ends a period after the one before
+    scheduler.endFrame();
+    auto start = FrameScheduler::Clock::now();
+    for (uint32_t i = 0; i < FRAMES; ++i) scheduler.endFrame();
+    auto elapsed = FrameScheduler::Clock::now() - start;
+    CHECK(elapsed >= Duration(1s) / 200 * (FRAMES - 1));
+    printf("%u frames capped at 200 fps took %.2f ms\n", FRAMES,
+           std::chrono::duration<double, std::milli>(elapsed).count());
+    return 0;
+}
+}  // namespace
+
+int main() {
+    if (auto ret = testRepeatable()) return ret;
+    if (auto ret = testRenderRateIndependent()) return ret;
+    if (auto ret = testDroppedTicks()) return ret;
+    if (auto ret = testFixedFrameTime()) return ret;
+    if (auto ret = testFrameCap()) return ret;
+    return 0;
+}
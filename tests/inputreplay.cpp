@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+
+#include "appbase.h"
+#include "inputrecorder.h"
+#include "testcontext.h"
+
+/**
+ * input recording and replay without a gl context. a session feeds the Input callbacks the way glfwPollEvents does,
+ * records them, and simulates with the frame loop of AppBase::mainLoop: the gui captures the mouse for a while in the
+ * middle. replaying the file must tick the same way and end in bit for bit the same state. AppBase takes the time
+ * step from the recording, and forces one when recording without --fixed-dt
+ */
+
+namespace {
+namespace fs = std::filesystem;
+
+constexpr uint32_t FRAMES = 240;
+// 2.4 ticks per frame, frames run 2 or 3 ticks and events wait for the first of them
+constexpr InputRecordingTiming TIMING{20.f, 120.f};
+
+struct SessionState {
+    glm::dvec2 look{};
+    double zoom{};
+    uint32_t clicks{};
+    uint64_t ticks{};
+};
+
+bool guiCaptures(uint32_t frame) { return frame >= 100 && frame < 140; }
+
+// AppBase::mainLoop without rendering: poll, then the ticks of the frame
+SessionState simulate(std::function<void(uint32_t)> const &poll) {
+    FrameScheduler::Settings settings{};
+    settings.fixedFrameTime_ms = TIMING.fixedTimeStep_ms;
+    settings.tickRate_hz = TIMING.tickRate_hz;
+    FrameScheduler scheduler(settings);
+    SessionState ret;
+    for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+        poll(frame);
+        auto ticks = scheduler.beginFrame();
+        for (uint32_t i = 0; i < ticks; ++i) {
+            // what Scene::update and EditCameraController do with it
+            Input::nextFrame();
+            auto &&input = Input::getFrame();
+            if (!input.guiWantCaptureMouse) {
+                ret.look += input.cursorDelta * 0.01;
+                ret.zoom += input.scroll.y;
+                if (input.wasPressed(INPUT_MOUSE_BUTTON_LEFT)) ++ret.clicks;
+            }
+        }
+        ret.ticks += ticks;
+    }
+    return ret;
+}
+
+int testReplay(fs::path const &path) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> step(-8, 8);
+    glm::dvec2 cursor{320, 240};
+    SessionState recorded;
+    {
+        InputRecorder recorder(path.string(), TIMING);
+        Input::recorder = &recorder;
+        recorded = simulate([&](uint32_t frame) {
+            // the gui rendered the previous frame
+            Input::guiWantCaptureMouse = guiCaptures(frame);
+            recorder.setFrameIndex(frame, Input::guiWantCaptureMouse);
+            // a few moves per frame, some frames without any event
+            if (frame % 7 == 3) return;
+            for (int i = 0; i < 3; ++i) {
+                cursor += glm::dvec2(step(rng), step(rng));
+                Input::onMouseMove(cursor.x, cursor.y);
+            }
+            if (frame % 11 == 0) Input::onMouseButton(GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, 0);
+            if (frame % 11 == 1) Input::onMouseButton(GLFW_MOUSE_BUTTON_LEFT, GLFW_RELEASE, 0);
+            if (frame % 13 == 0) Input::onScroll(0, 1);
+        });
+        Input::recorder = nullptr;
+    }
+    CHECK(recorded.clicks > 0 && recorded.zoom > 0);
+
+    InputReplay replay(path.string());
+    CHECK(replay.getTiming().fixedTimeStep_ms == TIMING.fixedTimeStep_ms);
+    CHECK(replay.getTiming().tickRate_hz == TIMING.tickRate_hz);
+    bool guiReplayed = true;
+    auto replayed = simulate([&](uint32_t frame) {
+        // this run's gui never captures, the recorded value wins
+        Input::guiWantCaptureMouse = false;
+        replay.replay(frame);
+        guiReplayed &= Input::guiWantCaptureMouse == guiCaptures(frame);
+    });
+    CHECK(guiReplayed);
+    CHECK(replay.finished());
+    CHECK(replayed.ticks == recorded.ticks);
+    CHECK(replayed.look == recorded.look);
+    CHECK(replayed.zoom == recorded.zoom);
+    CHECK(replayed.clicks == recorded.clicks);
+    return 0;
+}
+
+int testAppTiming(fs::path const &replayPath, fs::path const &recordPath) {
+    {
+        // the recording's step replaces --fixed-dt, headless runs take its frame count
+        AppCreateInfo createInfo{};
+        createInfo.headless = true;
+        createInfo.fixedTimeStep_ms = 5;
+        createInfo.replayInputPath = replayPath.string();
+        AppBase app(createInfo);
+        CHECK(app.getCreateInfo().fixedTimeStep_ms == TIMING.fixedTimeStep_ms);
+        CHECK(app.getCreateInfo().tickRate_hz == TIMING.tickRate_hz);
+        CHECK(app.getCreateInfo().frameCount == FRAMES);
+    }
+    {
+        // recording without a step runs one tick per frame, capped to the tick rate
+        AppCreateInfo createInfo{};
+        createInfo.recordInputPath = recordPath.string();
+        AppBase app(createInfo);
+        CHECK(app.getCreateInfo().fixedTimeStep_ms == 1000 / createInfo.tickRate_hz);
+        CHECK(app.getCreateInfo().frameCap_fps == createInfo.tickRate_hz);
+    }
+    InputReplay replay(recordPath.string());
+    CHECK(replay.getTiming().fixedTimeStep_ms == 1000 / AppCreateInfo{}.tickRate_hz);
+    return 0;
+}
+}  // namespace
+
+int main() {
+    auto dir = fs::current_path() / "inputreplay";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    if (auto ret = testReplay(dir / "session.bin")) return ret;
+    if (auto ret = testAppTiming(dir / "session.bin", dir / "forced.bin")) return ret;
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "jobsystem.h"
+#include "testcontext.h"
+
+/**
+ * JobSystem without a gl context: a job stolen by a worker keeps running while the thread that spawned it goes
+ * round its job ring several times. the ring must not hand out the running job's slot again, its captures and its
+ * counter stay intact and every job spawned meanwhile runs exactly once
+ */
+
+namespace {
+int testRingReuse() {
+    JobSystem jobSystem(1);
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    int result{};
+    JobCounter longCounter;
+    // captures live in the ring slot, a reused slot would overwrite value and the counter
+    int value = 12345;
+    jobSystem.run(
+        [&, value] {
+            started.store(true);
+            while (!release.load()) std::this_thread::yield();
+            result = value;
+        },
+        &longCounter);
+    // the only worker takes it, the main thread keeps spawning
+    while (!started.load()) std::this_thread::yield();
+
+    constexpr uint32_t ROUNDS = 3;
+    const uint32_t batch = WorkStealingDeque::CAPACITY / 2;
+    const uint32_t total = WorkStealingDeque::CAPACITY * 2 * ROUNDS;
+    std::atomic<uint32_t> executed{0};
+    JobCounter counter;
+    for (uint32_t i = 0; i < total; i += batch) {
+        for (uint32_t j = 0; j < batch; ++j)
+            jobSystem.run([&executed] { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        jobSystem.wait(counter);
+    }
+    CHECK(executed.load() == total);
+    CHECK(!longCounter.isDone());
+
+    release.store(true);
+    jobSystem.wait(longCounter);
+    CHECK(result == value);
+    return 0;
+}
+
+int testParallelFor() {
+    JobSystem jobSystem(3);
+    constexpr uint32_t COUNT = 1 << 16;
+    std::vector<std::atomic<uint32_t>> hits(COUNT);
+    // more chunks than the ring holds, several frames in a row
+    for (uint32_t frame = 0; frame < 4; ++frame)
+        jobSystem.parallelFor(COUNT, 4, [&](uint32_t begin, uint32_t end) {
+            for (auto i = begin; i < end; ++i) hits[i].fetch_add(1, std::memory_order_relaxed);
+        });
+    for (auto &&e : hits) CHECK(e.load() == 4);
+    return 0;
+}
+}  // namespace
+
+int main() {
+    if (auto ret = testRingReuse()) return ret;
+    if (auto ret = testParallelFor()) return ret;
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "materialtable.h"
+#include "testcontext.h"
+
+/**
+ * texture arrays: images of one size and format fill an array up to the layer limit before a second one is made,
+ * the arrays count against the TextureManager budget and the layer of a removed image is used again.
+ * bindless: MaterialTable::bind() resolves handles only for textures whose storage changed and does not keep
+ * textures alive on its own, an evicted texture falls back to the fallback handle.
+ * edits: thousands of slots change every frame, after bind() the gpu array holds exactly what was set and the
+ * upload sent the dirty ranges merged as mergeGap says, nothing more
+ */
+
+namespace {
+ResourceHandle<Image> createImage(std::string const &name, uint8_t value) {
+    uint8_t texels[4 * 4 * 4];
+    std::fill(std::begin(texels), std::end(texels), value);
+    return ImageManager::getSingleton().create(name, 4, 4, GL_RGBA8, GL_RGBA, GL::DATA_TYPE_UNSIGNED_BYTE,
+                                               sizeof(texels), texels);
+}
+
+int testTextureArrays() {
+    GLint maxLayers{};
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    std::vector<ResourceHandle<Image>> images;
+    TextureArrayPool pool;
+    // one more than fits, then one more to see the second array is filled instead of a third being made
+    for (int i = 0; i < maxLayers + 2; ++i) {
+        images.emplace_back(createImage("array" + std::to_string(i), uint8_t(i)));
+        auto ref = pool.addImage(images.back().get());
+        CHECK(ref.x == (i < maxLayers ? 1u : 2u));
+        CHECK(ref.y == uint32_t(i < maxLayers ? i : i - maxLayers));
+    }
+    CHECK(pool.getArrayCount() == 2);
+    CHECK(TextureManager::getSingleton().getStats().externalGpuBytes == pool.getGpuBytes());
+
+    // a removed image gives its layer to the next one, the arrays do not grow
+    auto gpuBytes = pool.getGpuBytes();
+    pool.removeImage(images[3].get());
+    images.emplace_back(createImage("array reused", 1));
+    CHECK(pool.addImage(images.back().get()) == MaterialTextureRef(1, 3));
+    CHECK(pool.getGpuBytes() == gpuBytes);
+    return 0;
+}
+
+int testEdits() {
+    constexpr uint32_t SLOTS = 20000;
+    constexpr uint32_t EDITS_PER_FRAME = 4000;
+    constexpr uint32_t FRAMES = 16;
+
+    auto &table = MaterialTable::getSingleton();
+    std::vector<uint32_t> slots(SLOTS);
+    std::vector<MaterialEntry> expected(SLOTS);
+    for (auto &&e : slots) e = table.allocateSlot();
+    auto firstSlot = slots.front();
+    CHECK(slots.back() == firstSlot + SLOTS - 1);
+    table.bind();
+
+    std::mt19937 rng(7);
+    uint64_t totalBytes = 0;
+    for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+        // dense runs and scattered single slots
+        std::vector<uint32_t> dirty;
+        for (uint32_t i = 0; i < EDITS_PER_FRAME; ++i) {
+            uint32_t index = i < EDITS_PER_FRAME / 2 ? (frame * 997 + i) % SLOTS : rng() % SLOTS;
+            MaterialEntry entry{};
+            entry.baseColor = glm::vec4(float(frame), float(i), float(index), 1);
+            entry.shininess = float(rng() % 1000);
+            table.setEntry(slots[index], entry, nullptr, nullptr);
+            expected[index] = entry;
+            dirty.emplace_back(slots[index]);
+        }
+        table.bind();
+
+        // what upload() should have sent
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        uint64_t bytes = 0;
+        uint32_t ranges = 0;
+        for (size_t i = 0; i < dirty.size();) {
+            size_t last = i;
+            while (last + 1 < dirty.size() && dirty[last + 1] <= dirty[last] + table.mergeGap + 1) ++last;
+            bytes += uint64_t(dirty[last] - dirty[i] + 1) * sizeof(MaterialEntry);
+            ++ranges;
+            i = last + 1;
+        }
+        auto &&stats = table.getLastUploadStats();
+        CHECK(stats.reallocations == 0);
+        CHECK(stats.materials == dirty.size());
+        CHECK(stats.ranges == ranges);
+        CHECK(stats.bytes == bytes);
+        CHECK(stats.bytes < SLOTS * sizeof(MaterialEntry));
+        totalBytes += stats.bytes;
+
+        std::vector<MaterialEntry> gpu(SLOTS);
+        glGetNamedBufferSubData(table.getBuffer(), firstSlot * sizeof(MaterialEntry), SLOTS * sizeof(MaterialEntry),
+                                gpu.data());
+        CHECK(memcmp(gpu.data(), expected.data(), SLOTS * sizeof(MaterialEntry)) == 0);
+    }
+    printf("%u edits per frame over %u slots: %.1f KiB uploaded per frame, %.1f KiB table\n", EDITS_PER_FRAME,
+           SLOTS, totalBytes / 1024.0 / FRAMES, SLOTS * sizeof(MaterialEntry) / 1024.0);
+
+    for (auto &&e : slots) table.freeSlot(e);
+    return 0;
+}
+
+int testBindless() {
+    auto &table = MaterialTable::getSingleton();
+    table.setBindingModel(MATERIAL_BINDING_BINDLESS);
+    if (table.getBindingModel() != MATERIAL_BINDING_BINDLESS) {
+        printf("no ARB_bindless_texture, bindless part skipped\n");
+        return 0;
+    }
+    auto &manager = TextureManager::getSingleton();
+    auto image = createImage("bindless", 255);
+    auto texture = manager.createTexture(image.get());
+    auto slot = table.allocateSlot();
+    auto handleOf = [&] {
+        auto ref = table.getEntry(slot).baseColorTex;
+        return uint64_t(ref.x) | uint64_t(ref.y) << 32;
+    };
+
+    // not drawn yet, no storage
+    table.setEntry(slot, MaterialEntry{}, texture.get(), nullptr);
+    CHECK(handleOf() == manager.getFallbackBindlessHandle());
+
+    // a draw uploads it, the next bind picks up the new handle
+    texture->prepareBind();
+    table.bind();
+    CHECK(handleOf() == texture->getBindlessHandle());
+    CHECK(handleOf() != manager.getFallbackBindlessHandle());
+
+    // binding the table is not a use of the texture
+    auto lastBound = texture->getLastBoundFrame();
+    manager.update();
+    table.bind();
+    CHECK(texture->getLastBoundFrame() == lastBound);
+
+    texture->evict();
+    table.bind();
+    CHECK(handleOf() == manager.getFallbackBindlessHandle());
+
+    table.freeSlot(slot);
+    return 0;
+}
+}  // namespace
+
+int main() {
+    auto app = createTestApp();
+    if (!app) return TEST_SKIPPED;
+    if (MaterialTable::detectBindingModel() == MATERIAL_BINDING_PER_DRAW) {
+        printf("no shader storage buffers or draw parameters\n");
+        return TEST_SKIPPED;
+    }
+    if (auto ret = testTextureArrays()) return ret;
+    if (auto ret = testBindless()) return ret;
+    if (auto ret = testEdits()) return ret;
+    ResourceManager::getSingleton().collectGarbage();
+    return 0;
+}
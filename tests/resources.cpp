@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "material.h"
+#include "model.h"
+#include "testcontext.h"
+
+/**
+ * reference counting of the resource chain model -> material -> texture -> image: each holds one reference on what
+ * it is built from, a chain nobody references is destroyed in a single collectGarbage pass and what is still held
+ * from outside survives it. the gpu buffers of a destroyed model are released once flushed. with texture arrays the
+ * layer of a destroyed material's texture is taken by the next texture of the same size
+ */
+
+namespace {
+namespace fs = std::filesystem;
+
+// a 2x2 binary ppm of one color, decoded by stb like any other image file
+void writeImage(fs::path const &path, uint8_t value) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n2 2\n255\n";
+    for (int i = 0; i < 4 * 3; ++i) file.put(char(value));
+}
+
+// one textured triangle
+fs::path writeModel(fs::path const &dir, std::string const &name, uint8_t texel) {
+    writeImage(dir / (name + ".ppm"), texel);
+    std::ofstream(dir / (name + ".mtl")) << "newmtl m\nKd 1 1 1\nmap_Kd " << name << ".ppm\n";
+    std::ofstream(dir / (name + ".obj")) << "mtllib " << name
+                                         << ".mtl\nv 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nvt 0 0\nusemtl m\n"
+                                            "f 1/1/1 2/1/1 3/1/1\n";
+    return dir / (name + ".obj");
+}
+
+uint32_t count(ResourceStats const &stats, ResourceType type) { return stats.types[type].count; }
+
+int testCascade(fs::path const &dir) {
+    auto &resources = ResourceManager::getSingleton();
+    // the default materials are made with the managers, not counted below
+    ModelManager::getSingleton();
+    resources.flush();
+    auto before = resources.getStats();
+
+    auto model = ModelManager::getSingleton().createModel(writeModel(dir, "cascade", 200).string());
+    CHECK(model->isLoaded());
+    auto after = resources.getStats();
+    for (int i = 0; i < RESOURCE_Num; ++i) CHECK(count(after, ResourceType(i)) == count(before, ResourceType(i)) + 1);
+    CHECK(after.types[RESOURCE_MODEL].gpuBytes > before.types[RESOURCE_MODEL].gpuBytes);
+
+    // one reference from the handle above, one from each link of the chain
+    ResourceHandle<Material> material = MaterialManager::getSingleton().getMaterial(model->meshviews[0].materialId);
+    CHECK(model->getRefCount() == 1);
+    CHECK(material->getRefCount() == 2);
+    CHECK(material->getDependencies().size() == 1);
+    auto texture = material->getDependencies()[0];
+    CHECK(texture->getResourceType() == RESOURCE_TEXTURE && texture->getRefCount() == 1);
+    CHECK(texture->getDependencies().size() == 1);
+    auto image = texture->getDependencies()[0];
+    CHECK(image->getResourceType() == RESOURCE_IMAGE && image->getRefCount() == 1);
+
+    // the material is still held, only the model goes
+    model.reset();
+    auto collected = resources.getStats().collected;
+    CHECK(resources.collectGarbage() == 1);
+    auto stats = resources.getStats();
+    CHECK(count(stats, RESOURCE_MODEL) == count(before, RESOURCE_MODEL));
+    CHECK(count(stats, RESOURCE_MATERIAL) == count(before, RESOURCE_MATERIAL) + 1);
+    CHECK(material->getRefCount() == 1);
+    CHECK(texture->getRefCount() == 1 && image->getRefCount() == 1);
+    // the buffers wait for the frames in flight
+    CHECK(stats.pendingReleaseBytes > 0);
+    CHECK(stats.types[RESOURCE_MODEL].gpuBytes == before.types[RESOURCE_MODEL].gpuBytes);
+
+    // the rest of the chain in one pass
+    material.reset();
+    CHECK(resources.collectGarbage() == 3);
+    stats = resources.getStats();
+    for (int i = 0; i < RESOURCE_Num; ++i) CHECK(count(stats, ResourceType(i)) == count(before, ResourceType(i)));
+    CHECK(stats.collected == collected + 4);
+    CHECK(resources.collectGarbage() == 0);
+
+    resources.flush();
+    stats = resources.getStats();
+    CHECK(stats.pendingReleaseBytes == 0);
+    CHECK(stats.pendingReleaseFrames == 0);
+    for (int i = 0; i < RESOURCE_Num; ++i) CHECK(stats.types[i].gpuBytes == before.types[i].gpuBytes);
+    return 0;
+}
+
+int testLayerReuse(fs::path const &dir) {
+    auto &table = MaterialTable::getSingleton();
+    if (table.getBindingModel() != MATERIAL_BINDING_TEXTURE_ARRAY) {
+        printf("no texture array binding model, layer reuse skipped\n");
+        return 0;
+    }
+    auto &resources = ResourceManager::getSingleton();
+    auto layerOf = [&](ResourceHandle<Model> const &model) {
+        auto material = MaterialManager::getSingleton().getMaterial(model->meshviews[0].materialId);
+        material->prepare();
+        return table.getEntry(material->tableSlot).baseColorTex;
+    };
+
+    auto first = ModelManager::getSingleton().createModel(writeModel(dir, "layer0", 10).string());
+    auto second = ModelManager::getSingleton().createModel(writeModel(dir, "layer1", 20).string());
+    auto firstLayer = layerOf(first);
+    auto secondLayer = layerOf(second);
+    CHECK(firstLayer != MaterialTextureRef{} && secondLayer != MaterialTextureRef{});
+    CHECK(firstLayer != secondLayer);
+    auto arrays = table.getTextureArrayCount();
+
+    // the first chain goes, its layer is the next one handed out instead of a new one at the end
+    first.reset();
+    resources.collectGarbage();
+    auto third = ModelManager::getSingleton().createModel(writeModel(dir, "layer2", 30).string());
+    CHECK(layerOf(third) == firstLayer);
+    CHECK(table.getTextureArrayCount() == arrays);
+
+    // a material keeping its texture keeps the layer
+    CHECK(layerOf(second) == secondLayer);
+    return 0;
+}
+
+int run() {
+    auto dir = fs::current_path() / "resources";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    if (auto ret = testCascade(dir)) return ret;
+    return testLayerReuse(dir);
+}
+}  // namespace
+
+int main() {
+    auto app = createTestApp();
+    if (!app) return TEST_SKIPPED;
+    return run();
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdio>
+#include <exception>
+#include <memory>
+
+#include "appbase.h"
+
+// ctest reports a test exiting with this code as skipped, see newtest in CMakeLists.txt
+constexpr int TEST_SKIPPED = 77;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                    \
+        }                                                                \
+    } while (false)
+
+/**
+ * @brief headless app with a current gl context and no game, null if no context can be created here
+ */
+inline std::unique_ptr<AppBase> createTestApp(int width = 64, int height = 64) {
+    AppCreateInfo createInfo{};
+    createInfo.width = width;
+    createInfo.height = height;
+    createInfo.headless = true;
+    createInfo.frameCount = 1;
+    auto app = std::make_unique<AppBase>(createInfo);
+    try {
+        app->initWindow();
+        app->initOpengl();
+    } catch (std::exception const &e) {
+        printf("no gl context: %s\n", e.what());
+        return nullptr;
+    }
+    return app;
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stb_image.h"
+#include "testcontext.h"
+#include "texture.h"
+
+/**
+ * TextureManager under a gpu budget far below the sponza texture set: draws bind a sliding window of textures every
+ * frame, what falls out of it is degraded and evicted, what comes back into it is restreamed on a job thread.
+ * checks after every frame that the budget holds, that every texture that lost its storage was counted as exactly
+ * one eviction, and at the end that restreamed storage holds the same pixels as a fresh decode of the file
+ */
+
+namespace {
+constexpr size_t BUDGET = 24 << 20;
+constexpr uint32_t WINDOW = 2;
+constexpr uint32_t FRAMES = 200;
+// decodes on job threads finish within a few frames of a real frame time
+constexpr auto FRAME_TIME = std::chrono::milliseconds(2);
+
+// rgba8 level 0 of the texture's storage
+std::vector<uint8_t> readLevel0(Texture *texture) {
+    auto image = texture->getImage();
+    std::vector<uint8_t> ret(size_t(image->_width) * image->_height * 4);
+    glGetTextureImage(texture->getImageView(), 0, GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(ret.size()), ret.data());
+    return ret;
+}
+
+std::vector<uint8_t> decode(std::string const &path) {
+    int w{}, h{}, n{};
+    stbi_set_flip_vertically_on_load_thread(true);
+    auto pixels = stbi_load(path.c_str(), &w, &h, &n, 4);
+    std::vector<uint8_t> ret(pixels, pixels + size_t(w) * h * 4);
+    stbi_image_free(pixels);
+    return ret;
+}
+
+int run() {
+    std::vector<std::string> paths;
+    for (auto &&e : std::filesystem::directory_iterator(ASSETS_DIR "/models/sponza/textures"))
+        paths.emplace_back(e.path().string());
+    std::sort(paths.begin(), paths.end());
+    CHECK(paths.size() > 2 * WINDOW);
+
+    auto &manager = TextureManager::getSingleton();
+    TextureBudget budget{};
+    budget.gpuBytes = BUDGET;
+    budget.evictAfterFrames = 8;
+    manager.setBudget(budget);
+
+    std::vector<ResourceHandle<Texture>> textures;
+    for (auto &&e : paths) textures.emplace_back(manager.createTexture(ImageManager::getSingleton().create(e).get()));
+
+    size_t maxTextureBytes = 0;
+    std::vector<TextureResidency> residency(textures.size(), TEXTURE_RESIDENCY_EVICTED);
+    uint64_t lostStorage = 0;
+    for (uint32_t frame = 0; frame < FRAMES; ++frame) {
+        manager.update();
+        auto stats = manager.getStats();
+        // the textures drawn last frame are never touched
+        CHECK(stats.gpuBytes <= BUDGET + WINDOW * maxTextureBytes);
+        for (size_t i = 0; i < textures.size(); ++i) {
+            auto current = textures[i]->getResidency();
+            if (current == TEXTURE_RESIDENCY_EVICTED && residency[i] != TEXTURE_RESIDENCY_EVICTED) ++lostStorage;
+            residency[i] = current;
+        }
+        CHECK(stats.evictions == lostStorage);
+
+        // the window moves by one texture every other frame
+        for (uint32_t i = 0; i < WINDOW; ++i) {
+            auto &&texture = textures[(frame / 2 + i) % textures.size()];
+            texture->prepareBind();
+            // bound textures always have something to sample, the fallback while they are restreamed
+            CHECK(texture->getImageView() != 0);
+            maxTextureBytes = (std::max)(maxTextureBytes, texture->getGpuBytes());
+        }
+        ResourceManager::getSingleton().update();
+        std::this_thread::sleep_for(FRAME_TIME);
+    }
+    auto stats = manager.getStats();
+    printf("gpu %.1f MB of %.1f MB budget, %u resident %u degraded %u evicted, %llu evictions %llu mip drops %llu "
+           "restreams\n",
+           stats.gpuBytes / 1048576.0, BUDGET / 1048576.0, stats.residentCount, stats.degradedCount,
+           stats.evictedCount, (unsigned long long)stats.evictions, (unsigned long long)stats.mipDrops,
+           (unsigned long long)stats.restreams);
+    CHECK(stats.evictions > 0);
+    CHECK(stats.mipDrops > 0);
+    CHECK(stats.restreams > 0);
+    // decoded pixels are freed after upload, nothing the budget did keeps cpu copies around
+    CHECK(stats.cpuBytes == 0);
+
+    // the first texture went out of the window long ago, bring it back and compare with the file
+    auto &&texture = textures[0];
+    CHECK(texture->getResidency() == TEXTURE_RESIDENCY_EVICTED);
+    for (uint32_t frame = 0; frame < 5000 && texture->getResidency() != TEXTURE_RESIDENCY_RESIDENT; ++frame) {
+        texture->prepareBind();
+        manager.update();
+        ResourceManager::getSingleton().update();
+        std::this_thread::sleep_for(FRAME_TIME);
+    }
+    CHECK(texture->getResidency() == TEXTURE_RESIDENCY_RESIDENT);
+    CHECK(readLevel0(texture.get()) == decode(paths[0]));
+    return 0;
+}
+}  // namespace
+
+int main() {
+    auto app = createTestApp();
+    if (!app) return TEST_SKIPPED;
+    auto ret = run();
+    ResourceManager::getSingleton().collectGarbage();
+    return ret;
+}